@@ -38,6 +38,7 @@
 #include "ppf.h"
 #include "psxdma.h"
 #include "psxevents.h"
+#include "psxhle.h"
 
 #if defined(CDR_LOG) || defined(CDR_LOG_I) || defined(CDR_LOG_IO)
 static const char *CmdName[0x100]= {
@@ -1568,6 +1569,10 @@ void psxDma3(u32 madr, u32 bcr, u32 chcr) {
 			psxCpu->Clear(madr, cdsize / 4);
 #endif
 
+			// Catch libc stubs in executables/overlays loaded by the game
+			if (size > 0)
+				psxHLELibcScan(madr, size);
+
 			pTransfer += cdsize;
 
 			if( chcr == 0x11400100 ) {
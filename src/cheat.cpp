@@ -15,7 +15,54 @@ static cheat_t* ct = NULL;
 
 static u32 run_interval = 200u;
 
-static u32 next_ticks = 0u;
+/* Enabled cheats are compiled into one flat list of operations, so that
+ * cheat_apply() doesn't parse code lines or go through psxMem*() page tables
+ * every time it runs. Each entry starts with a CHEAT_OP_ENTRY op, holding
+ * the index of the next entry's first op. RAM and scratchpad addresses are
+ * resolved to host pointers at compile time. Anything else (unmapped space,
+ * ranges crossing the end of RAM) keeps going through psxMem*().
+ * The list is rebuilt on the next cheat_apply() after cheats are loaded or
+ * toggled. 'cont_enabled' is still checked while applying, as codes
+ * themselves can change it.
+ */
+enum {
+	CHEAT_OP_ENTRY,    // start of entry: n=entry index, next=index of next entry op
+	CHEAT_OP_WRITE,    // *addr = value
+	CHEAT_OP_ADD,      // *addr += value
+	CHEAT_OP_SLIDE,    // n writes at addr+step*k of value+value2*k, k=1..n
+	CHEAT_OP_COPY,     // copy n bytes from addr to addr2
+	CHEAT_OP_IF,       // continue entry only if *addr <cmp> value
+	CHEAT_OP_MCODE,    // stop all cheats unless *addr == value, disable entry
+	CHEAT_OP_DELAY,    // disable entry, wait 'value' ms before next run
+	CHEAT_OP_IF_PAD,   // continue entry only if all 'value' buttons pressed
+	CHEAT_OP_PAD_ON,   // enable all entries if all 'value' buttons pressed
+	CHEAT_OP_PAD_OFF,  // disable all entries, stop if all 'value' buttons pressed
+	CHEAT_OP_BREAK     // skip rest of entry (unknown or truncated code)
+};
+
+enum { CHEAT_CMP_EQ, CHEAT_CMP_NE, CHEAT_CMP_GT, CHEAT_CMP_LT };
+
+typedef struct cheat_op_ {
+	u8  type;
+	u8  width;   // 1 or 2 bytes
+	u8  cmp;     // CHEAT_CMP_* for CHEAT_OP_IF
+	u16 value;
+	u16 value2;
+	u32 addr;
+	u32 addr2;
+	u32 step;
+	u32 n;
+	int next;
+	u8  *host;   // Host address of 'addr', or NULL
+	u8  *host2;  // Host address of 'addr2', or NULL
+} cheat_op_t;
+
+static cheat_op_t *ops = NULL;
+static int num_ops = 0;
+static int ops_cap = 0;
+static bool ops_dirty = true;
+
+static u32 wait_vblanks = 0u;
 
 extern char cheatsdir[PATH_MAX];
 
@@ -27,6 +74,8 @@ void cheat_load(void)
 	int i, disableall, buf_pos = 0;
 	cheat_entry_t* entry = NULL;
 	cheat_unload();
+	ops_dirty = true;
+	wait_vblanks = 0u;
 	snprintf(cheat_filename, sizeof(cheat_filename), "%s/%s.txt", cheatsdir, CdromId);
 	f = fopen(cheat_filename, "r");
 	if (f) {
@@ -150,6 +199,9 @@ void cheat_unload(void)
 	}
 	free(ct);
 	ct = NULL;
+	free(ops);
+	ops = NULL;
+	num_ops = ops_cap = 0;
 }
 
 void cheat_set_run_per_sec(int r)
@@ -162,155 +214,264 @@ const cheat_t* cheat_get(void)
 	return ct;
 }
 
-static int cheat_run_code(const cheat_line_t* lines, int total, int* mcode_run)
+// Number of VBlanks in 'ms' milliseconds, rounded up
+static u32 cheat_ms_to_vblanks(u32 ms)
+{
+	const u32 rate = Config.PsxType ? 50 : 60;
+	return (ms * rate + 999) / 1000;
+}
+
+// Host address of 'size' bytes at cheat address 'addr', if they lie in RAM
+//  (or one of its mirrors) or scratchpad. Otherwise NULL.
+static u8* cheat_host_ptr(u32 addr, u32 size)
+{
+	if (addr < 0x800000u) {
+		if ((addr & 0x1fffff) + size > 0x200000)
+			return NULL;
+		return (u8*)psxM + (addr & 0x1fffff);
+	}
+	if (addr >= 0x1F800000u && addr + size <= 0x1F800400u)
+		return (u8*)psxH + (addr & 0x3ff);
+	return NULL;
+}
+
+static cheat_op_t* cheat_add_op(u8 type)
+{
+	if (ops_cap <= num_ops) {
+		ops_cap = num_ops + 64;
+		ops = (cheat_op_t*) realloc(ops, ops_cap * sizeof(cheat_op_t));
+	}
+	cheat_op_t *op = &ops[num_ops++];
+	memset(op, 0, sizeof(*op));
+	op->type = type;
+	return op;
+}
+
+static void cheat_add_mem_op(u8 type, u8 width, u32 addr, u16 value)
+{
+	cheat_op_t *op = cheat_add_op(type);
+	op->width = width;
+	op->addr = addr;
+	op->value = value;
+	op->host = cheat_host_ptr(addr, width);
+}
+
+static void cheat_add_if_op(u8 width, u8 cmp, u32 addr, u16 value)
+{
+	cheat_add_mem_op(CHEAT_OP_IF, width, addr, value);
+	ops[num_ops-1].cmp = cmp;
+}
+
+// Compile one code line (two for slide and copy codes), returns number of
+//  lines consumed
+static int cheat_compile_code(const cheat_line_t* lines, int total)
 {
 	u32 code1 = lines->code1;
 	u16 code2 = lines->code2;
+	u32 addr = code1 & 0x00FFFFFFu;
 	switch (code1 >> 24) {
-	case 0x10: {
-		u32 addr = code1 & 0x00FFFFFFu;
-		psxMemWrite16(addr, psxMemRead16(addr) + code2);
-		return 1;
-	}
-	case 0x11: {
-		u32 addr = code1 & 0x00FFFFFFu;
-		psxMemWrite16(addr, psxMemRead16(addr) - code2);
-		return 1;
-	}
-	case 0x20: {
-		u32 addr = code1 & 0x00FFFFFFu;
-		psxMemWrite8(addr, psxMemRead8(addr) + (code2 & 0xFFu));
-		return 1;
-	}
-	case 0x21: {
-		u32 addr = code1 & 0x00FFFFFFu;
-		psxMemWrite8(addr, psxMemRead8(addr) - (code2 & 0xFFu));
-		return 1;
-	}
-	case 0x1F: {
-		if (code1 >= 0x1F800000u && code1 < 0x1F800400u) {
-			psxMemWrite16(code1, code2);
-		} else return 1;
-	}
-	case 0x30:psxMemWrite8(code1 & 0x00FFFFFFu, code2 & 0xFFu);
-		return 1;
-	case 0x80:psxMemWrite16(code1 & 0x00FFFFFFu, code2);
+	case 0x10: cheat_add_mem_op(CHEAT_OP_ADD, 2, addr, code2); return 1;
+	case 0x11: cheat_add_mem_op(CHEAT_OP_ADD, 2, addr, -code2); return 1;
+	case 0x20: cheat_add_mem_op(CHEAT_OP_ADD, 1, addr, code2 & 0xFFu); return 1;
+	case 0x21: cheat_add_mem_op(CHEAT_OP_ADD, 1, addr, -(code2 & 0xFFu)); return 1;
+	case 0x1F:
+		// Scratchpad write. Other 0x1F codes are ignored.
+		if (code1 >= 0x1F800000u && code1 < 0x1F800400u)
+			cheat_add_mem_op(CHEAT_OP_WRITE, 2, code1, code2);
 		return 1;
+	case 0x30: cheat_add_mem_op(CHEAT_OP_WRITE, 1, addr, code2 & 0xFFu); return 1;
+	case 0x80: cheat_add_mem_op(CHEAT_OP_WRITE, 2, addr, code2); return 1;
 	case 0x50: {
-		u32 cnt, addr, value, addrstep, addrend, bits;
-		if (total < 2) return -1;
-		cnt = (code1 >> 8) & 0xFFFFu;
-		addrstep = code1 & 0xFFu;
-		addr = (++lines)->code1;
-		bits = (addr >> 28) != 3 ? 1 : 0; // 1=16bit 0=8bit
-		addr &= 0x00FFFFFFu;
-		addrend = addr + cnt * addrstep;
-		value = lines->code2;
-		while (addr < addrend) {
-			addr += addrstep;
-			value += code2;
-			bits ? psxMemWrite16(addr, value) : psxMemWrite8(addr, value & 0xFFu);
-		}
+		if (total < 2) break;
+		cheat_op_t *op = cheat_add_op(CHEAT_OP_SLIDE);
+		op->n = (code1 >> 8) & 0xFFFFu;
+		op->step = code1 & 0xFFu;
+		op->width = ((lines + 1)->code1 >> 28) != 3 ? 2 : 1;
+		op->addr = (lines + 1)->code1 & 0x00FFFFFFu;
+		op->value = (lines + 1)->code2;
+		op->value2 = code2;
+		if (!op->step) op->n = 0;
+		if (op->n)
+			op->host = cheat_host_ptr(op->addr, op->n * op->step + op->width);
 		return 2;
 	}
-	case 0xE0:if (psxMemRead8(code1 & 0x00FFFFFFu) != (code2 & 0xFFu)) return -1;
-		return 1;
-	case 0xE1:if (psxMemRead8(code1 & 0x00FFFFFFu) == (code2 & 0xFFu)) return -1;
-		return 1;
-	case 0xE2:if (psxMemRead8(code1 & 0x00FFFFFFu) <= (code2 & 0xFFu)) return -1;
-		return 1;
-	case 0xE3:if (psxMemRead8(code1 & 0x00FFFFFFu) >= (code2 & 0xFFu)) return -1;
-		return 1;
-	case 0xD0:if (psxMemRead16(code1 & 0x00FFFFFFu) != code2) return -1;
-		return 1;
-	case 0xD1:if (psxMemRead16(code1 & 0x00FFFFFFu) == code2) return -1;
-		return 1;
-	case 0xD2:if (psxMemRead16(code1 & 0x00FFFFFFu) <= code2) return -1;
-		return 1;
-	case 0xD3:if (psxMemRead16(code1 & 0x00FFFFFFu) >= code2) return -1;
-		return 1;
-	case 0xC0:if (psxMemRead16(code1 & 0x00FFFFFFu) != code2) return -2;
-		*mcode_run = 1;
-		return 1;
+	case 0xE0: cheat_add_if_op(1, CHEAT_CMP_EQ, addr, code2 & 0xFFu); return 1;
+	case 0xE1: cheat_add_if_op(1, CHEAT_CMP_NE, addr, code2 & 0xFFu); return 1;
+	case 0xE2: cheat_add_if_op(1, CHEAT_CMP_GT, addr, code2 & 0xFFu); return 1;
+	case 0xE3: cheat_add_if_op(1, CHEAT_CMP_LT, addr, code2 & 0xFFu); return 1;
+	case 0xD0: cheat_add_if_op(2, CHEAT_CMP_EQ, addr, code2); return 1;
+	case 0xD1: cheat_add_if_op(2, CHEAT_CMP_NE, addr, code2); return 1;
+	case 0xD2: cheat_add_if_op(2, CHEAT_CMP_GT, addr, code2); return 1;
+	case 0xD3: cheat_add_if_op(2, CHEAT_CMP_LT, addr, code2); return 1;
+	case 0xC0: cheat_add_mem_op(CHEAT_OP_MCODE, 2, addr, code2); return 1;
 	case 0xC1:
-		if (code2 > 0) {
-			*mcode_run = 1;
-#ifdef TIME_IN_MSEC
-			next_ticks = get_ticks() + code2;
-#else
-			next_ticks = get_ticks() / 1000 + code2;
-#endif
-			return -2;
-		}
+		if (code2 > 0)
+			cheat_add_op(CHEAT_OP_DELAY)->value = code2;
 		return 1;
-	case 0xD4: {
-		if ((pad_read(0) & code2) == code2) return 1;
-		return -1;
+	case 0xD4: cheat_add_op(CHEAT_OP_IF_PAD)->value = code2; return 1;
+	case 0xD5: cheat_add_op(CHEAT_OP_PAD_ON)->value = code2; return 1;
+	case 0xD6: cheat_add_op(CHEAT_OP_PAD_OFF)->value = code2; return 1;
+	case 0xC2: {
+		if (total < 2) break;
+		cheat_op_t *op = cheat_add_op(CHEAT_OP_COPY);
+		op->addr = addr;
+		op->addr2 = (lines + 1)->code1 & 0x00FFFFFFu;
+		op->n = code2;
+		op->host = cheat_host_ptr(op->addr, op->n);
+		op->host2 = cheat_host_ptr(op->addr2, op->n);
+		return 2;
 	}
-	case 0xD5: {
-		if ((pad_read(0) & code2) == code2) {
-			int i;
-			for (i = 0; i < ct->num_entries; ++i) {
-				if (ct->entries[i].cont_enabled == 0)
-					ct->entries[i].cont_enabled = 1;
-			}
-		}
-		return 1;
 	}
-	case 0xD6: {
-		if ((pad_read(0) & code2) == code2) {
-			int i;
-			for (i = 0; i < ct->num_entries; ++i) {
-				if (ct->entries[i].cont_enabled == 1)
-					ct->entries[i].cont_enabled = 0;
-			}
-			return -2;
-		}
-		return 1;
+	cheat_add_op(CHEAT_OP_BREAK);
+	return total;
+}
+
+static void cheat_compile(void)
+{
+	int i;
+	num_ops = 0;
+	for (i = 0; i < ct->num_entries; ++i) {
+		const cheat_entry_t* entry = &ct->entries[i];
+		int j = 0, entry_op;
+		if (entry->user_enabled == 0) continue;
+		entry_op = num_ops;
+		cheat_add_op(CHEAT_OP_ENTRY)->n = i;
+		while (j < entry->num_lines)
+			j += cheat_compile_code(&entry->lines[j], entry->num_lines - j);
+		ops[entry_op].next = num_ops;
 	}
-	case 0xC2: {
-		u32 src, dst, srcend;
-		if (total < 2) return -1;
-		src = code1 & 0x00FFFFFFu;
-		srcend = src + code2;
-		dst = (lines + 1)->code1 & 0x00FFFFFFu;
-		// TODO: optimize block copy algorithm
-		while (src < srcend) {
-			psxMemWrite8(dst++, psxMemRead8(src++));
-		}
-		return 2;
+	ops_dirty = false;
+}
+
+static inline u16 cheat_read(const cheat_op_t* op)
+{
+	if (op->host)
+		return op->width == 1 ? *op->host : SWAPu16(*(u16*)op->host);
+	return op->width == 1 ? psxMemRead8(op->addr) : psxMemRead16(op->addr);
+}
+
+static inline void cheat_write(u8* host, u32 addr, u8 width, u16 value)
+{
+	if (!host) {
+		width == 1 ? psxMemWrite8(addr, value) : psxMemWrite16(addr, value);
+		return;
 	}
+
+	// Most cheats rewrite the same value every time: skip invalidating code
+	if (width == 1) {
+		if (*host == (u8)value) return;
+		*host = value;
+	} else {
+		if (*(u16*)host == SWAPu16(value)) return;
+		*(u16*)host = SWAPu16(value);
 	}
-	return -1;
+#ifdef PSXREC
+	if (addr < 0x800000u)
+		psxCpu->Clear(addr & ~3, 1);
+#endif
+}
+
+static bool cheat_pad_pressed(u16 buttons)
+{
+	return (pad_read(0) & buttons) == buttons;
 }
 
 void cheat_apply(void)
 {
-	u32 curr_ticks;
-	int i;
+	int i, entry_end = 0;
+	cheat_entry_t* entry = NULL;
 	if (!ct || !ct->num_entries) return;
-#ifdef TIME_IN_MSEC
-	curr_ticks = get_ticks();
-#else
-	curr_ticks = get_ticks() / 1000;
+	if (wait_vblanks) {
+		--wait_vblanks;
+		return;
+	}
+	// Cache is isolated: RAM isn't writable, try again next VBlank
+	if (!psxRegs.writeok) return;
+	wait_vblanks = cheat_ms_to_vblanks(run_interval) - 1;
+	if (ops_dirty) cheat_compile();
+	for (i = 0; i < num_ops; ++i) {
+		const cheat_op_t* op = &ops[i];
+		switch (op->type) {
+		case CHEAT_OP_ENTRY:
+			entry = &ct->entries[op->n];
+			entry_end = op->next;
+			if (entry->cont_enabled == 0) i = entry_end - 1;
+			break;
+		case CHEAT_OP_WRITE:
+			cheat_write(op->host, op->addr, op->width, op->value);
+			break;
+		case CHEAT_OP_ADD:
+			cheat_write(op->host, op->addr, op->width, cheat_read(op) + op->value);
+			break;
+		case CHEAT_OP_SLIDE: {
+			u32 k, value = op->value;
+			for (k = 1; k <= op->n; ++k) {
+				value += op->value2;
+				cheat_write(op->host ? op->host + (k * op->step) : NULL,
+				            op->addr + k * op->step, op->width, value);
+			}
+			break;
+		}
+		case CHEAT_OP_COPY:
+			if (op->host && op->host2) {
+				u32 k;
+				for (k = 0; k < op->n; ++k)
+					op->host2[k] = op->host[k];
+#ifdef PSXREC
+				if (op->n)
+					psxCpu->Clear(op->addr2 & ~3, ((op->addr2 & 3) + op->n + 3) / 4);
 #endif
-	if (curr_ticks < next_ticks) return;
-	next_ticks = curr_ticks + run_interval;
-	for (i = 0; i < ct->num_entries; ++i) {
-		int j, num_lines;
-		cheat_entry_t* entry = &ct->entries[i];
-		if (entry->user_enabled == 0 || entry->cont_enabled == 0) continue;
-		j = 0;
-		num_lines = entry->num_lines;
-		while (j < num_lines) {
-			int mcode_run = 0;
-			int skip_lines = cheat_run_code(&entry->lines[j], num_lines - j, &mcode_run);
-			if (mcode_run) entry->cont_enabled = 0;
-			if (skip_lines <= 0) {
-				if (skip_lines == -2) return;
-				break;
+			} else {
+				u32 src = op->addr, dst = op->addr2, srcend = op->addr + op->n;
+				while (src < srcend)
+					psxMemWrite8(dst++, psxMemRead8(src++));
+			}
+			break;
+		case CHEAT_OP_IF: {
+			u16 v = cheat_read(op);
+			bool pass;
+			switch (op->cmp) {
+			case CHEAT_CMP_EQ: pass = (v == op->value); break;
+			case CHEAT_CMP_NE: pass = (v != op->value); break;
+			case CHEAT_CMP_GT: pass = (v > op->value); break;
+			default:           pass = (v < op->value); break;
+			}
+			if (!pass) i = entry_end - 1;
+			break;
+		}
+		case CHEAT_OP_MCODE:
+			if (cheat_read(op) != op->value) return;
+			entry->cont_enabled = 0;
+			break;
+		case CHEAT_OP_DELAY:
+			entry->cont_enabled = 0;
+			wait_vblanks = cheat_ms_to_vblanks(op->value) - 1;
+			return;
+		case CHEAT_OP_IF_PAD:
+			if (!cheat_pad_pressed(op->value)) i = entry_end - 1;
+			break;
+		case CHEAT_OP_PAD_ON:
+			if (cheat_pad_pressed(op->value)) {
+				int j;
+				for (j = 0; j < ct->num_entries; ++j) {
+					if (ct->entries[j].cont_enabled == 0)
+						ct->entries[j].cont_enabled = 1;
+				}
+			}
+			break;
+		case CHEAT_OP_PAD_OFF:
+			if (cheat_pad_pressed(op->value)) {
+				int j;
+				for (j = 0; j < ct->num_entries; ++j) {
+					if (ct->entries[j].cont_enabled == 1)
+						ct->entries[j].cont_enabled = 0;
+				}
+				return;
 			}
-			j += skip_lines;
+			break;
+		default: // CHEAT_OP_BREAK
+			i = entry_end - 1;
+			break;
 		}
 	}
 }
@@ -321,5 +482,6 @@ void cheat_toggle(int idx)
 	if (ct->entries[idx].user_enabled == 0 || ct->entries[idx].user_enabled == 1) {
 		ct->entries[idx].user_enabled ^= 1;
 		ct->entries[idx].name[0] = ct->entries[idx].user_enabled ? '*' : ' ';
+		ops_dirty = true;
 	}
 }
@@ -992,6 +992,7 @@ long CALLBACK GPU_dmaChain(uint32_t * baseAddrL, uint32_t addr)
  uint32_t dmaMem;
  unsigned char * baseAddrB;
  short count;unsigned int DMACommandCounter = 0;
+ long size = 1;                                        // words, including list headers
 
  GPUIsBusy;
 
@@ -1006,6 +1007,7 @@ long CALLBACK GPU_dmaChain(uint32_t * baseAddrL, uint32_t addr)
    if(CheckForEndlessLoop(addr)) break;
 
    count = baseAddrB[addr+3];
+   size += count + 1;
 
    dmaMem=addr+4;
 
@@ -1017,7 +1019,7 @@ long CALLBACK GPU_dmaChain(uint32_t * baseAddrL, uint32_t addr)
 
  GPUIsIdle;
 
- return 0;
+ return size;
 }
 
 ////////////////////////////////////////////////////////////////////////
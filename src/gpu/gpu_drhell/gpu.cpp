@@ -436,6 +436,7 @@ Sint32  GPU_dmaChain(Uint32 * baseAddr, Uint32 dmaVAddr)
 {
 	Uint32 data, *address, count, offset;
     unsigned int DMACommandCounter = 0;
+	Sint32 size = 1;	// words, including list headers
 	//Uint32 temp;
 	GPU_gp1 &= ~0x14000000;
 
@@ -451,6 +452,7 @@ Sint32  GPU_dmaChain(Uint32 * baseAddr, Uint32 dmaVAddr)
 		data = *address++;
 		count = (data >> 24);
 		offset = data & 0x00FFFFFF;
+		size += count + 1;
 		if (dmaVAddr != offset)
 			dmaVAddr = offset;
 		else
@@ -476,7 +478,7 @@ Sint32  GPU_dmaChain(Uint32 * baseAddr, Uint32 dmaVAddr)
 	}
 	
 	GPU_gp1 |= 0x14000000;
-	return (0);
+	return size;
 }
 
 #define MAXSKIP		6
@@ -1020,6 +1020,7 @@ void  GPU_readDataMem(u32 * dmaAddress, s32 dmaCount)
 long int GPU_dmaChain(u32 * baseAddr, u32 dmaVAddr)
 {
 	u32 temp, data, *address, count, offset;
+	long size = 1;	// words, including list headers
 	GPU_gp1 &= ~0x14000000;
 	dmaVAddr &= 0x00FFFFFF;
 	while (dmaVAddr != 0xFFFFFF) {
@@ -1027,6 +1028,7 @@ long int GPU_dmaChain(u32 * baseAddr, u32 dmaVAddr)
 		data = *address++;
 		count = (data >> 24);
 		offset = data & 0x00FFFFFF;
+		size += count + 1;
 		if (dmaVAddr != offset)
 			dmaVAddr = offset;
 		else
@@ -1052,5 +1054,5 @@ long int GPU_dmaChain(u32 * baseAddr, u32 dmaVAddr)
 	}
 	GPU_gp1 = (GPU_gp1 | 0x14000000) & ~0x60000000;
 
-	return 0;
+	return size;
 }
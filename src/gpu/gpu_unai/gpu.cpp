@@ -119,7 +119,7 @@ long GPU_init(void)
 #endif
 
 	gpu_unai.fb_dirty = true;
-	gpu_unai.dma.last_dma = NULL;
+	gpu_unai.dma.last_dma = ~0u;
 	return (0);
 }
 
@@ -269,54 +269,59 @@ void GPU_writeDataMem(u32* dmaAddress, int dmaCount)
 	gpu_unai.GPU_GP1 = (gpu_unai.GPU_GP1 | 0x14000000) & ~0x60000000;
 }
 
+// Visited chain entries, for loop detection after LD_THRESHOLD entries
+#define LD_THRESHOLD (8*1024)
+static u8 dma_visited[0x200000 / 4 / 8];
+
 long GPU_dmaChain(u32 *rambase, u32 start_addr)
 {
 	#ifdef ENABLE_GPU_LOG_SUPPORT
 		fprintf(stdout,"GPU_dmaChain(0x%x)\n",start_addr);
 	#endif
 
-	u32 addr, *list;
+	u32 addr, w, *list;
 	u32 len, count;
 	long dma_words = 0;
+	bool visited = false;
 
-	if (gpu_unai.dma.last_dma) *gpu_unai.dma.last_dma |= 0x800000;
-	
 	gpu_unai.GPU_GP1 &= ~0x14000000;
 	
 	addr = start_addr & 0xffffff;
-	for (count = 0; addr != 0xffffff; count++)
+	for (count = 0; (addr & 0x800000) == 0; count++)
 	{
-		list = rambase + (addr & 0x1fffff) / 4;
+		w = (addr & 0x1fffff) / 4;
+
+		// Loop detection, tracked on host side (a real machine would loop forever)
+		if (count >= LD_THRESHOLD)
+		{
+			if (dma_visited[w / 8] & (1 << (w & 7)))
+			{
+				#ifdef ENABLE_GPU_LOG_SUPPORT
+					fprintf(stdout,"GPU_dmaChain(LOOP)\n");
+				#endif
+				break;
+			}
+			dma_visited[w / 8] |= 1 << (w & 7);
+			visited = true;
+		}
+
+		list = rambase + w;
 		len = list[0] >> 24;
 		addr = list[0] & 0xffffff;
 
 		dma_words += 1 + len;
 
-		// add loop detection marker
-		list[0] |= 0x800000;
-
 		if (len) GPU_writeDataMem(list + 1, len);
 
-		if (addr & 0x800000)
-		{
-			#ifdef ENABLE_GPU_LOG_SUPPORT
-				fprintf(stdout,"GPU_dmaChain(LOOP)\n");
-			#endif
+		// Reached start of previous chain this frame: it's drawn, then stop
+		if (w == gpu_unai.dma.last_dma)
 			break;
-		}
 	}
 
-	// remove loop detection markers
-	addr = start_addr & 0x1fffff;
-	while (count-- > 0)
-	{
-		list = rambase + addr / 4;
-		addr = list[0] & 0x1fffff;
-		list[0] &= ~0x800000;
-	}
-	
-	if (gpu_unai.dma.last_dma) *gpu_unai.dma.last_dma &= ~0x800000;
-	gpu_unai.dma.last_dma = rambase + (start_addr & 0x1fffff) / 4;
+	if (visited)
+		memset(dma_visited, 0, sizeof(dma_visited));
+
+	gpu_unai.dma.last_dma = (start_addr & 0x1fffff) / 4;
 
 	gpu_unai.GPU_GP1 = (gpu_unai.GPU_GP1 | 0x14000000) & ~0x60000000;
 
@@ -798,7 +803,7 @@ void GPU_updateLace(void)
 	if ((!gpu_unai.frameskip.skipCount) && (gpu_unai.DisplayArea[3] == 480)) gpu_unai.frameskip.skipGPU=true; // Tekken 3 hack
 
 	gpu_unai.fb_dirty=false;
-	gpu_unai.dma.last_dma = NULL;
+	gpu_unai.dma.last_dma = ~0u;
 }
 
 // Allows frontend to signal plugin to redraw screen after returning to emu
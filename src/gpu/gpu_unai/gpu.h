@@ -44,6 +44,14 @@ struct gpu_unai_config_t {
 	uint8_t dithering:1;
 	uint8_t ntsc_fix:1;
 
+	uint8_t bands:3;          // Render in this many horizontal bands on
+	                          //  worker threads, 0/1 disables. Only used
+	                          //  if built with GPU_UNAI_USE_BANDS.
+
+	uint8_t tex_cache:1;      // Draw 4bpp/8bpp textures from a cache of
+	                          //  pages decoded to 16bpp. Only used if built
+	                          //  with GPU_UNAI_USE_TEXCACHE.
+
 	//senquack Only PCSX Rearmed's version of gpu_unai had this, and I
 	// don't think it's necessary. It would require adding 'AH' flag to
 	// gpuSpriteSpanFn() increasing size of sprite span function array.
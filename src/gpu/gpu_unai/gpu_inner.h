@@ -50,6 +50,7 @@
 
 #include "gpu_inner_quantization.h"
 #include "gpu_inner_light.h"
+#include "gpu_inner_simd.h"
 
 // If defined, Gouraud colors are fixed-point 5.11, otherwise they are 8.16
 // This is only for debugging/verification of low-precision colors in C.
@@ -261,6 +262,11 @@ const PSD gpuPixelSpanDrivers[64] =
 template<int CF>
 static void gpuTileSpanFn(u16 *pDst, u32 count, u16 data)
 {
+#ifdef GPU_UNAI_SIMD
+	gpuFlatSpanSimd<CF>(pDst, count, data);
+	if (!count) return;
+#endif
+
 	if (!CF_MASKCHECK && !CF_BLEND) {
 		if (CF_MASKSET) { data = data | 0x8000; }
 		do { *pDst++ = data; } while (--count);
@@ -331,9 +337,44 @@ const PT gpuTileSpanDrivers[32] = {
 ///////////////////////////////////////////////////////////////////////////////
 //  GPU Sprites innerloops generator
 
+// 16bpp sprite span without lighting or blending. Texels are copied in
+//  runs that end where U wraps around the texture window, each run reads
+//  consecutive texels. 'u0' is a byte offset, as in gpuSpriteSpanFn().
+template<int CF>
+GPU_INLINE void gpuSpriteCopySpan(u16 *pDst, u32 count, const u8* pTxt, u32 u0)
+{
+	// Texture window masks are always (2^n)-1
+	const u32 u_msk = gpu_unai.TextureWindow[2];
+	u32 u = u0 >> 1;
+
+	do {
+		u32 run = u_msk + 1 - (u & u_msk);
+		if (run > count) run = count;
+		const u16 *pSrc = (const u16*)pTxt + (u & u_msk);
+		count -= run;
+		u += run;
+
+#ifdef GPU_UNAI_SIMD
+		gpuCopySpanSimd<CF>(pDst, run, pSrc);
+#endif
+		for (; run; --run, ++pDst) {
+			u16 uSrc = *pSrc++;
+			if (!uSrc) continue;
+			if (CF_MASKCHECK) if (*pDst&0x8000) continue;
+			if (CF_MASKSET) { *pDst = uSrc | 0x8000; }
+			else            { *pDst = uSrc;          }
+		}
+	} while (count);
+}
+
 template<int CF>
 static void gpuSpriteSpanFn(u16 *pDst, u32 count, u8* pTxt, u32 u0)
 {
+	if (CF_TEXTMODE==3 && !CF_LIGHT && !CF_BLEND) {
+		gpuSpriteCopySpan<CF>(pDst, count, pTxt, u0);
+		return;
+	}
+
 	// Blend func can save an operation if it knows uSrc MSB is unset.
 	//  Untextured prims can always skip (source color always comes with MSB=0).
 	//  For textured prims, lighting funcs always return it unset. (bonus!)
@@ -451,15 +492,21 @@ const PS gpuSpriteSpanDrivers[256] = {
 //             adaptations. An example would be the sky in NFS3. Now, they are
 //             stored in separate ints, using separate masks.
 //           * Function is no longer INLINE, as it was always called
-//             through a function pointer.
+//             through a function pointer. (Body is now gpuPolySpan(), which
+//             whole-triangle rasterizers in gpu_raster_polygon.h inline)
 //           * Function now ensures the mask bit of source texture is preserved
 //             across calls to blending functions (Silent Hill rectangles fix)
 //           * November 2016: Large refactoring of blending/lighting when
 //             JohnnyF added dithering. See gpu_inner_quantization.h and
 //             relevant blend/light headers.
 // (see README_senquack.txt)
+#ifdef GPU_UNAI_USE_BANDS
+// Poly span drivers are passed the state of the calling band thread
+#undef gpu_unai
+#endif
+
 template<int CF>
-static void gpuPolySpanFn(const gpu_unai_t &gpu_unai, u16 *pDst, u32 count)
+GPU_INLINE void gpuPolySpan(const gpu_unai_t &gpu_unai, u16 *pDst, u32 count)
 {
 	// Blend func can save an operation if it knows uSrc MSB is unset.
 	//  Untextured prims can always skip this (src color MSB is always 0).
@@ -473,6 +520,10 @@ static void gpuPolySpanFn(const gpu_unai_t &gpu_unai, u16 *pDst, u32 count)
 		{
 			// UNTEXTURED, NO GOURAUD
 			const u16 pix15 = gpu_unai.PixelData;
+#ifdef GPU_UNAI_SIMD
+			gpuFlatSpanSimd<CF>(pDst, count, pix15);
+			if (!count) return;
+#endif
 			do {
 				u16 uSrc, uDst;
 
@@ -501,6 +552,11 @@ endpolynotextnogou:
 			// UNTEXTURED, GOURAUD
 			u32 l_gCol = gpu_unai.gCol;
 			u32 l_gInc = gpu_unai.gInc;
+#ifdef GPU_UNAI_SIMD
+			gpuGouraudSpanSimd<CF>(pDst, count, l_gCol, l_gInc,
+			                       gpu_unai.vram, gpu_unai.DitherMatrix);
+			if (!count) return;
+#endif
 
 			do {
 				u16 uDst, uSrc;
@@ -645,6 +701,12 @@ endpolytext:
 	}
 }
 
+template<int CF>
+static void gpuPolySpanFn(const gpu_unai_t &gpu_unai, u16 *pDst, u32 count)
+{
+	gpuPolySpan<CF>(gpu_unai, pDst, count);
+}
+
 static void PolyNULL(const gpu_unai_t &gpu_unai, u16 *pDst, u32 count)
 {
 	#ifdef ENABLE_GPU_LOG_SUPPORT
@@ -656,6 +718,10 @@ static void PolyNULL(const gpu_unai_t &gpu_unai, u16 *pDst, u32 count)
 //  Polygon innerloops driver
 typedef void (*PP)(const gpu_unai_t &gpu_unai, u16 *pDst, u32 count);
 
+#ifdef GPU_UNAI_USE_BANDS
+#define gpu_unai (*gpu_unai_cur)
+#endif
+
 // Template instantiation helper macros
 #define TI(cf) gpuPolySpanFn<(cf)>
 #define TN     PolyNULL
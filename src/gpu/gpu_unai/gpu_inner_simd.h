@@ -0,0 +1,301 @@
+/***************************************************************************
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 2 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+*   You should have received a copy of the GNU General Public License     *
+*   along with this program; if not, write to the                         *
+*   Free Software Foundation, Inc.,                                       *
+*   51 Franklin Street, Fifth Floor, Boston, MA 02111-1307 USA.           *
+***************************************************************************/
+
+#ifndef _OP_SIMD_H_
+#define _OP_SIMD_H_
+
+//  Vector versions of untextured span inner loops
+//
+//  Flat, Gouraud-shaded and tile spans are drawn 8 pixels at a time, the
+//  remaining pixels by the scalar loops in gpu_inner.h. Written with GCC
+//  vector extensions, so the same code is SSE2 on x86 and NEON on ARM.
+//  Results are bit-exact with the scalar loops: the functions below are
+//  the same bitwise operations as their scalar counterparts in
+//  gpu_inner_blend.h, gpu_inner_light.h and gpu_inner_quantization.h,
+//  done on vector lanes.
+#if !defined(GPU_UNAI_NO_SIMD) && (defined(__clang__) || __GNUC__ >= 9) && \
+    (defined(__SSE2__) || defined(__ARM_NEON) || defined(__ARM_NEON__))
+#define GPU_UNAI_SIMD
+
+#define GPU_SIMD_PIXELS 8
+
+typedef u16 gpu_v16  __attribute__((vector_size(16)));  // 8 pixels
+typedef s16 gpu_vs16 __attribute__((vector_size(16)));
+typedef u32 gpu_v32  __attribute__((vector_size(16)));  // 4 padded colors
+
+// Lanes of 'lo' and 'hi' are zero-extended pixels of 'v'
+GPU_INLINE void gpuWidenV(gpu_v16 v, gpu_v32 &lo, gpu_v32 &hi)
+{
+	const gpu_v16 z = {};
+#ifdef __clang__
+	lo = (gpu_v32)__builtin_shufflevector(v, z, 0, 8, 1, 9, 2, 10, 3, 11);
+	hi = (gpu_v32)__builtin_shufflevector(v, z, 4, 12, 5, 13, 6, 14, 7, 15);
+#else
+	lo = (gpu_v32)__builtin_shuffle(v, z, (gpu_v16){ 0, 8, 1, 9, 2, 10, 3, 11 });
+	hi = (gpu_v32)__builtin_shuffle(v, z, (gpu_v16){ 4, 12, 5, 13, 6, 14, 7, 15 });
+#endif
+}
+
+// Pixels from lanes of 'lo' and 'hi' (values must fit 16 bits)
+GPU_INLINE gpu_v16 gpuNarrowV(gpu_v32 lo, gpu_v32 hi)
+{
+#ifdef __clang__
+	return __builtin_shufflevector((gpu_v16)lo, (gpu_v16)hi, 0, 2, 4, 6, 8, 10, 12, 14);
+#else
+	return __builtin_shuffle((gpu_v16)lo, (gpu_v16)hi, (gpu_v16){ 0, 2, 4, 6, 8, 10, 12, 14 });
+#endif
+}
+
+// Keep pixels of 'uDst' with mask bit set, others from 'uSrc'
+GPU_INLINE gpu_v16 gpuMaskCheckV(gpu_v16 uSrc, gpu_v16 uDst)
+{
+	gpu_v16 keep = (gpu_v16)((gpu_vs16)uDst >> 15);
+	return (uSrc & ~keep) | (uDst & keep);
+}
+
+// gpuBlending(), see gpu_inner_blend.h. Intermediate values of scalar
+//  version exceed 16 bits only in mode 2, where the bits above are
+//  truncated from the result.
+template <int BLENDMODE, bool SKIP_USRC_MSB_MASK>
+GPU_INLINE gpu_v16 gpuBlendingV(gpu_v16 uSrc, gpu_v16 uDst)
+{
+	gpu_v16 mix;
+
+	if (BLENDMODE==0) {
+#ifdef GPU_UNAI_USE_ACCURATE_BLENDING
+		uDst &= 0x7fff;
+		if (!SKIP_USRC_MSB_MASK)
+			uSrc &= 0x7fff;
+		mix = ((uSrc + uDst) - ((uSrc ^ uDst) & 0x0421)) >> 1;
+#else
+		mix = ((uDst & 0x7bde) + (uSrc & 0x7bde)) >> 1;
+#endif
+	}
+
+	if (BLENDMODE==1 || BLENDMODE==3) {
+		uDst &= 0x7fff;
+		if (BLENDMODE==3)
+			uSrc = ((uSrc >> 2) & 0x1ce7);
+		else if (!SKIP_USRC_MSB_MASK)
+			uSrc &= 0x7fff;
+		gpu_v16 sum      = uSrc + uDst;
+		gpu_v16 low_bits = (uSrc ^ uDst) & 0x0421;
+		gpu_v16 carries  = (sum - low_bits) & 0x8420;
+		gpu_v16 modulo   = sum - carries;
+		gpu_v16 clamp    = carries - (carries >> 5);
+		mix = modulo | clamp;
+	}
+
+	if (BLENDMODE==2) {
+		uDst &= 0x7fff;
+		if (!SKIP_USRC_MSB_MASK)
+			uSrc &= 0x7fff;
+		gpu_v16 diff     = uDst - uSrc + 0x8420;
+		gpu_v16 low_bits = (uDst ^ uSrc) & 0x8420;
+		gpu_v16 borrows  = (diff - low_bits) & 0x8420;
+		gpu_v16 modulo   = diff - borrows;
+		gpu_v16 clamp    = borrows - (borrows >> 5);
+		mix = modulo & clamp;
+	}
+
+	return mix;
+}
+
+// gpuBlending24(), see gpu_inner_blend.h
+template <int BLENDMODE>
+GPU_INLINE gpu_v32 gpuBlending24V(gpu_v32 uSrc24, gpu_v32 uDst)
+{
+	gpu_v32 uDst24 = ((uDst & 0x7C00)<<14)
+	               | ((uDst & 0x03E0)<< 9)
+	               | ((uDst & 0x001F)<< 4);
+	gpu_v32 mix;
+
+	if (BLENDMODE==0) {
+		mix = (uDst24 + (uSrc24 & 0x1FE7F9FE)) >> 1;
+	}
+
+	if (BLENDMODE==1 || BLENDMODE==3) {
+		if (BLENDMODE==3)
+			uSrc24 = (uSrc24 & 0x1FC7F1FC) >> 2;
+		gpu_v32 sum     = uSrc24 + uDst24;
+		gpu_v32 carries = sum & 0x20080200;
+		gpu_v32 modulo  = sum - carries;
+		gpu_v32 clamp   = carries - (carries >> 9);
+		mix = modulo | clamp;
+	}
+
+	if (BLENDMODE==2) {
+		uDst24 |= 0x20080200;
+		gpu_v32 diff    = uDst24 - uSrc24;
+		gpu_v32 borrows = diff & 0x20080200;
+		gpu_v32 clamp   = borrows - (borrows >> 9);
+		mix = diff & clamp;
+	}
+
+	return mix;
+}
+
+// gpuLightingRGB(), gpuLightingRGB24(), see gpu_inner_light.h
+GPU_INLINE gpu_v32 gpuLightingRGBV(gpu_v32 gCol)
+{
+	return ((gCol<< 5)&0x7C00) |
+	       ((gCol>>11)&0x03E0) |
+	        (gCol>>27);
+}
+
+GPU_INLINE gpu_v32 gpuLightingRGB24V(gpu_v32 gCol)
+{
+	return ((gCol<<19) & (0x1FF<<20)) |
+	       ((gCol>> 2) & (0x1FF<<10)) |
+	        (gCol>>23);
+}
+
+// gpuColorQuantization24(), see gpu_inner_quantization.h. 'dither' holds
+//  DitherMatrix[] entries of the lanes' pixels.
+template <int DITHER>
+GPU_INLINE gpu_v32 gpuColorQuantization24V(gpu_v32 uSrc24, gpu_v32 dither)
+{
+	if (DITHER)
+	{
+		uSrc24 = (uSrc24 & 0x1FF7FDFF) + dither;
+
+		// Saturate components that overflowed into their padding bit
+		gpu_v32 ovf = (uSrc24 >> 9) & 0x00100401;
+		uSrc24 |= (ovf << 9) - ovf;
+	}
+
+	return ((uSrc24>> 4) & (0x1F    ))
+	     | ((uSrc24>> 9) & (0x1F<<5 ))
+	     | ((uSrc24>>14) & (0x1F<<10));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Draw untextured span of flat color 'data', as gpuTileSpanFn() and
+//  untextured flat-shaded gpuPolySpanFn(). Draws all but the last
+//  (count % GPU_SIMD_PIXELS) pixels, advancing 'pDst' and 'count'.
+////////////////////////////////////////////////////////////////////////////////
+template<int CF>
+GPU_INLINE void gpuFlatSpanSimd(u16 *&pDst, u32 &count, u16 data)
+{
+	const gpu_v16 uSrc = (gpu_v16){} + data;
+
+	for (; count >= GPU_SIMD_PIXELS; count -= GPU_SIMD_PIXELS, pDst += GPU_SIMD_PIXELS) {
+		gpu_v16 uDst, mix = uSrc;
+		if (CF_BLEND || CF_MASKCHECK) memcpy(&uDst, pDst, sizeof(uDst));
+
+		if (CF_BLEND)
+			mix = gpuBlendingV<CF_BLENDMODE, true>(uSrc, uDst);
+		if (CF_MASKSET)
+			mix |= 0x8000;
+		if (CF_MASKCHECK)
+			mix = gpuMaskCheckV(mix, uDst);
+
+		memcpy(pDst, &mix, sizeof(mix));
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Draw untextured Gouraud-shaded span, as untextured gpuPolySpanFn().
+//  Draws all but the last (count % GPU_SIMD_PIXELS) pixels, advancing
+//  'pDst', 'count' and Gouraud color 'gCol'. 'vram' and 'ditherMatrix'
+//  are those of the calling band's gpu_unai_t.
+////////////////////////////////////////////////////////////////////////////////
+template<int CF>
+GPU_INLINE void gpuGouraudSpanSimd(u16 *&pDst, u32 &count, u32 &gCol, u32 gInc,
+                                   const u16 *vram, const u32 *ditherMatrix)
+{
+	if (count < GPU_SIMD_PIXELS)
+		return;
+
+	// Colors of 8 consecutive pixels, wrapping like the scalar sums
+	gpu_v32 gLo = gCol + (gpu_v32){ 0, 1, 2, 3 } * gInc;
+	gpu_v32 gHi = gLo + gInc * 4;
+	const u32 gStep = gInc * GPU_SIMD_PIXELS;
+
+	// Matrix entries repeat every 8 pixels of the row
+	gpu_v32 dLo, dHi;
+	if (CF_DITHER) {
+		u32 fbpos = (u32)(pDst - vram);
+		const u32 *row = &ditherMatrix[(fbpos >> 7) & (0x7 << 3)];
+		for (int i = 0; i < 4; i++) {
+			dLo[i] = row[(fbpos + i) & 7];
+			dHi[i] = row[(fbpos + i + 4) & 7];
+		}
+	}
+
+	for (; count >= GPU_SIMD_PIXELS; count -= GPU_SIMD_PIXELS, pDst += GPU_SIMD_PIXELS) {
+		gpu_v16 uDst, uSrc;
+		if (CF_BLEND || CF_MASKCHECK) memcpy(&uDst, pDst, sizeof(uDst));
+
+		if (CF_DITHER) {
+			gpu_v32 lo = gpuLightingRGB24V(gLo);
+			gpu_v32 hi = gpuLightingRGB24V(gHi);
+			if (CF_BLEND) {
+				gpu_v32 dstLo, dstHi;
+				gpuWidenV(uDst, dstLo, dstHi);
+				lo = gpuBlending24V<CF_BLENDMODE>(lo, dstLo);
+				hi = gpuBlending24V<CF_BLENDMODE>(hi, dstHi);
+			}
+			uSrc = gpuNarrowV(gpuColorQuantization24V<CF_DITHER>(lo, dLo),
+			                  gpuColorQuantization24V<CF_DITHER>(hi, dHi));
+		} else {
+			uSrc = gpuNarrowV(gpuLightingRGBV(gLo), gpuLightingRGBV(gHi));
+			if (CF_BLEND)
+				uSrc = gpuBlendingV<CF_BLENDMODE, true>(uSrc, uDst);
+		}
+
+		if (CF_MASKSET)
+			uSrc |= 0x8000;
+		if (CF_MASKCHECK)
+			uSrc = gpuMaskCheckV(uSrc, uDst);
+
+		memcpy(pDst, &uSrc, sizeof(uSrc));
+		gLo += gStep;
+		gHi += gStep;
+	}
+
+	gCol = gLo[0];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Draw span of 16bpp texels 'pSrc' without lighting or blending, as
+//  gpuSpriteSpanFn(). Zero texels are transparent. Draws all but the last
+//  (count % GPU_SIMD_PIXELS) pixels, advancing 'pDst', 'count' and 'pSrc'.
+////////////////////////////////////////////////////////////////////////////////
+template<int CF>
+GPU_INLINE void gpuCopySpanSimd(u16 *&pDst, u32 &count, const u16 *&pSrc)
+{
+	for (; count >= GPU_SIMD_PIXELS; count -= GPU_SIMD_PIXELS,
+	     pDst += GPU_SIMD_PIXELS, pSrc += GPU_SIMD_PIXELS) {
+		gpu_v16 uSrc, uDst;
+		memcpy(&uSrc, pSrc, sizeof(uSrc));
+		memcpy(&uDst, pDst, sizeof(uDst));
+
+		gpu_v16 keep = (gpu_v16)(uSrc == 0);
+		if (CF_MASKCHECK)
+			keep |= (gpu_v16)((gpu_vs16)uDst >> 15);
+		if (CF_MASKSET)
+			uSrc |= 0x8000;
+		uSrc = (uSrc & ~keep) | (uDst & keep);
+
+		memcpy(pDst, &uSrc, sizeof(uSrc));
+	}
+}
+
+#endif // GPU_UNAI_SIMD
+
+#endif //_OP_SIMD_H_
@@ -98,6 +98,20 @@ void gpuMoveImage(PtrUnion packet)
 		  psxVuw [(1024*((y1+j)&511))+((x1+i)&0x3ff)]=
 		   psxVuw[(1024*((y0+j)&511))+((x0+i)&0x3ff)];
 	}
+	else if (y0 != y1 || (x0 + w0) <= x1 || (x1 + w0) <= x0)
+	{
+		// Source and destination of a row never overlap, so whole rows
+		//  can be block copied (top to bottom, same as loops below)
+		u16 *lpDst, *lpSrc;
+		lpDst = lpSrc = (u16*)gpu_unai.vram;
+		lpSrc += FRAME_OFFSET(x0, y0);
+		lpDst += FRAME_OFFSET(x1, y1);
+		do {
+			memcpy(lpDst, lpSrc, w0 * 2);
+			lpDst += FRAME_WIDTH;
+			lpSrc += FRAME_WIDTH;
+		} while (--h0);
+	}
 	else if ((x0&1)||(x1&1))
 	{
 		u16 *lpDst, *lpSrc;
@@ -174,6 +188,17 @@ void gpuClearImage(PtrUnion packet)
 		fprintf(stdout,"gpuClearImage(x0=%d,y0=%d,w0=%d,h0=%d)\n",x0,y0,w0,h0);
 	#endif
 	
+#ifdef GPU_UNAI_SIMD
+	// Vector stores, see gpuTileSpanFn()
+	{
+		u16* pixel = (u16*)gpu_unai.vram + FRAME_OFFSET(x0, y0);
+		u16 rgb = GPU_RGB16(packet.U4[0]);
+		do {
+			gpuTileSpanFn<0>(pixel, w0, rgb);
+			pixel += FRAME_WIDTH;
+		} while (--h0);
+	}
+#else
 	if (x0&1)
 	{
 		u16* pixel = (u16*)gpu_unai.vram + FRAME_OFFSET(x0, y0);
@@ -212,4 +237,5 @@ void gpuClearImage(PtrUnion packet)
 			} while (--h0);
 		}
 	}
+#endif
 }
@@ -205,14 +205,33 @@ static bool polyUseTriangle(const PolyVertex *vbuf, int tri_num, const PolyVerte
 	return true;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// polyDrawSpan()
+//  Draws one row of a poly. Rasterizers instantiated for a fixed CF (see
+//  gpuDrawPolyF() etc. below) inline the inner driver, so no call is made
+//  per row and the row's interpolants don't have to leave registers.
+//  CF of POLY_CF_ANY calls the gpuPolySpanDrivers[] entry passed instead.
+///////////////////////////////////////////////////////////////////////////////
+#define POLY_CF_ANY (-1)
+
+template<int CF>
+GPU_INLINE void polyDrawSpan(const PP gpuPolySpanDriver, u16 *pDst, u32 count)
+{
+	if (CF == POLY_CF_ANY)
+		gpuPolySpanDriver(gpu_unai, pDst, count);
+	else
+		gpuPolySpan<(CF == POLY_CF_ANY) ? 0 : CF>(gpu_unai, pDst, count);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 //  GPU internal polygon drawing functions
 ///////////////////////////////////////////////////////////////////////////////
 
 /*----------------------------------------------------------------------
-gpuDrawPolyF - Flat-shaded, untextured poly
+gpuRasterPolyF - Flat-shaded, untextured poly
 ----------------------------------------------------------------------*/
-void gpuDrawPolyF(const PtrUnion packet, const PP gpuPolySpanDriver, u32 is_quad)
+template<int CF>
+static void gpuRasterPolyF(const PtrUnion packet, const PP gpuPolySpanDriver, u32 is_quad)
 {
 	// Set up bgr555 color to be used across calls in inner driver
 	gpu_unai.PixelData = GPU_RGB16(packet.U4[0]);
@@ -354,16 +373,17 @@ void gpuDrawPolyF(const PtrUnion packet, const PP gpuPolySpanDriver, u32 is_quad
 				if ((xmin - xa) > 0) xa = xmin;
 				if (xb > xmax) xb = xmax;
 				if ((xb - xa) > 0)
-					gpuPolySpanDriver(gpu_unai, PixelBase + xa, (xb - xa));
+					polyDrawSpan<CF>(gpuPolySpanDriver, PixelBase + xa, (xb - xa));
 			}
 		}
 	} while (++cur_pass < total_passes);
 }
 
 /*----------------------------------------------------------------------
-gpuDrawPolyFT - Flat-shaded, textured poly
+gpuRasterPolyFT - Flat-shaded, textured poly
 ----------------------------------------------------------------------*/
-void gpuDrawPolyFT(const PtrUnion packet, const PP gpuPolySpanDriver, u32 is_quad)
+template<int CF>
+static void gpuRasterPolyFT(const PtrUnion packet, const PP gpuPolySpanDriver, u32 is_quad)
 {
 	// r8/g8/b8 used if texture-blending & dithering is applied (24-bit light)
 	gpu_unai.r8 = packet.U1[0];
@@ -687,16 +707,17 @@ void gpuDrawPolyFT(const PtrUnion packet, const PP gpuPolySpanDriver, u32 is_qua
 
 				if (xb > xmax) xb = xmax;
 				if ((xb - xa) > 0)
-					gpuPolySpanDriver(gpu_unai, PixelBase + xa, (xb - xa));
+					polyDrawSpan<CF>(gpuPolySpanDriver, PixelBase + xa, (xb - xa));
 			}
 		}
 	} while (++cur_pass < total_passes);
 }
 
 /*----------------------------------------------------------------------
-gpuDrawPolyG - Gouraud-shaded, untextured poly
+gpuRasterPolyG - Gouraud-shaded, untextured poly
 ----------------------------------------------------------------------*/
-void gpuDrawPolyG(const PtrUnion packet, const PP gpuPolySpanDriver, u32 is_quad)
+template<int CF>
+static void gpuRasterPolyG(const PtrUnion packet, const PP gpuPolySpanDriver, u32 is_quad)
 {
 	PolyVertex vbuf[4];
 	polyInitVertexBuffer(vbuf, packet, POLYTYPE_G, is_quad);
@@ -1035,16 +1056,17 @@ void gpuDrawPolyG(const PtrUnion packet, const PP gpuPolySpanDriver, u32 is_quad
 
 				if (xb > xmax) xb = xmax;
 				if ((xb - xa) > 0)
-					gpuPolySpanDriver(gpu_unai, PixelBase + xa, (xb - xa));
+					polyDrawSpan<CF>(gpuPolySpanDriver, PixelBase + xa, (xb - xa));
 			}
 		}
 	} while (++cur_pass < total_passes);
 }
 
 /*----------------------------------------------------------------------
-gpuDrawPolyGT - Gouraud-shaded, textured poly
+gpuRasterPolyGT - Gouraud-shaded, textured poly
 ----------------------------------------------------------------------*/
-void gpuDrawPolyGT(const PtrUnion packet, const PP gpuPolySpanDriver, u32 is_quad)
+template<int CF>
+static void gpuRasterPolyGT(const PtrUnion packet, const PP gpuPolySpanDriver, u32 is_quad)
 {
 	PolyVertex vbuf[4];
 	polyInitVertexBuffer(vbuf, packet, POLYTYPE_GT, is_quad);
@@ -1441,8 +1463,61 @@ void gpuDrawPolyGT(const PtrUnion packet, const PP gpuPolySpanDriver, u32 is_qua
 
 				if (xb > xmax) xb = xmax;
 				if ((xb - xa) > 0)
-					gpuPolySpanDriver(gpu_unai, PixelBase + xa, (xb - xa));
+					polyDrawSpan<CF>(gpuPolySpanDriver, PixelBase + xa, (xb - xa));
 			}
 		}
 	} while (++cur_pass < total_passes);
 }
+
+///////////////////////////////////////////////////////////////////////////////
+//  Poly drawing entry points
+//   Inner driver combinations most games draw with (no dithering, mask
+//   bit or blit-mask) get whole-triangle rasterizers with the driver
+//   inlined, others draw each row through gpuPolySpanDriver. Keep lists
+//   short, every entry is another copy of a rasterizer.
+///////////////////////////////////////////////////////////////////////////////
+#ifndef GPU_UNAI_NO_INLINE_POLY
+#define POLY_INLINE_DRIVER(raster, cf) \
+	if (gpuPolySpanDriver == gpuPolySpanFn<(cf)>) { \
+		raster<(cf)>(packet, gpuPolySpanDriver, is_quad); \
+		return; \
+	}
+#else
+#define POLY_INLINE_DRIVER(raster, cf)
+#endif
+
+void gpuDrawPolyF(const PtrUnion packet, const PP gpuPolySpanDriver, u32 is_quad)
+{
+	POLY_INLINE_DRIVER(gpuRasterPolyF, 0x00);  // Opaque
+	POLY_INLINE_DRIVER(gpuRasterPolyF, 0x02);  // Semi-transparent, B/2+F/2
+	POLY_INLINE_DRIVER(gpuRasterPolyF, 0x0a);  // Semi-transparent, B+F
+	gpuRasterPolyF<POLY_CF_ANY>(packet, gpuPolySpanDriver, is_quad);
+}
+
+void gpuDrawPolyFT(const PtrUnion packet, const PP gpuPolySpanDriver, u32 is_quad)
+{
+	POLY_INLINE_DRIVER(gpuRasterPolyFT, 0x20);  // 4bpp
+	POLY_INLINE_DRIVER(gpuRasterPolyFT, 0x21);  // 4bpp, lit
+	POLY_INLINE_DRIVER(gpuRasterPolyFT, 0x40);  // 8bpp
+	POLY_INLINE_DRIVER(gpuRasterPolyFT, 0x41);  // 8bpp, lit
+	POLY_INLINE_DRIVER(gpuRasterPolyFT, 0x60);  // 16bpp (and decoded pages
+	POLY_INLINE_DRIVER(gpuRasterPolyFT, 0x61);  //  of gpu_texcache.h)
+	gpuRasterPolyFT<POLY_CF_ANY>(packet, gpuPolySpanDriver, is_quad);
+}
+
+void gpuDrawPolyG(const PtrUnion packet, const PP gpuPolySpanDriver, u32 is_quad)
+{
+	POLY_INLINE_DRIVER(gpuRasterPolyG, 0x81);  // Opaque
+	POLY_INLINE_DRIVER(gpuRasterPolyG, 0x83);  // Semi-transparent, B/2+F/2
+	gpuRasterPolyG<POLY_CF_ANY>(packet, gpuPolySpanDriver, is_quad);
+}
+
+void gpuDrawPolyGT(const PtrUnion packet, const PP gpuPolySpanDriver, u32 is_quad)
+{
+	POLY_INLINE_DRIVER(gpuRasterPolyGT, 0xa1);  // 4bpp, lit
+	POLY_INLINE_DRIVER(gpuRasterPolyGT, 0xc1);  // 8bpp, lit
+	POLY_INLINE_DRIVER(gpuRasterPolyGT, 0xe1);  // 16bpp, lit
+	gpuRasterPolyGT<POLY_CF_ANY>(packet, gpuPolySpanDriver, is_quad);
+}
+
+#undef POLY_INLINE_DRIVER
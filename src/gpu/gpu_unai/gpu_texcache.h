@@ -0,0 +1,304 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02111-1307 USA.           *
+ ***************************************************************************/
+
+#ifndef GPU_UNAI_TEXCACHE_H
+#define GPU_UNAI_TEXCACHE_H
+
+///////////////////////////////////////////////////////////////////////////////
+//  Decoded texture page cache (gpulib only, 'tex_cache' config option)
+//
+//  4bpp/8bpp texture pages are expanded through their CLUT to 16bpp once,
+//  and primitives using them are drawn by the 16bpp span drivers, reading
+//  one texel instead of texel, nibble/byte and CLUT entry.
+//
+//  Decoded pages have the same row stride as VRAM, so that TBA can point
+//  into them. A page is 256 texels wide, so each buffer row holds the same
+//  row of four pages. Rows are decoded in blocks when a primitive needs
+//  them.
+//
+//  Entries are dropped when VRAM under their texture or CLUT is written:
+//  by transfers (renderer_update_caches()), fills and VRAM copies.
+//  Primitives only write inside the drawing area, so textures overlapping
+//  it are never cached, and entries under a new drawing area are dropped.
+//  Banded rendering doesn't use the cache.
+
+#ifdef GPU_UNAI_USE_TEXCACHE
+
+#define TEXCACHE_ENTRIES   8      // Four per 1024x256 buffer
+#define TEXCACHE_BLOCK     8      // Rows decoded at a time
+
+struct TexCacheEntry {
+	u16 *texels;      // Row 0, texel 0 of page, row stride FRAME_WIDTH
+	u32 lru;          // Last use, 0: unused
+	u32 blocks;       // Decoded row blocks (bit per TEXCACHE_BLOCK rows)
+	u16 tpage;        // Texture page (tx, ty, depth bits), CLUT
+	u16 clut;
+	s16 tex[4];       // VRAM rects read: texture, CLUT (x0,y0,x1,y1)
+	s16 cba[4];
+};
+
+static struct {
+	bool enabled;
+	u16 *buf;                          // TEXCACHE_ENTRIES / 4 buffers
+	u32 lru;
+	TexCacheEntry entry[TEXCACHE_ENTRIES];
+
+	// Drawing state replaced while a primitive uses an entry
+	bool active;
+	u16 *TBA;
+	u8  TEXT_MODE;
+
+	// Statistics, printed by texCacheStats()
+	u32 hits, misses, invalidations, blocks_decoded, bypassed;
+} texcache;
+
+static void texCacheFlush(void)
+{
+	for (int i = 0; i < TEXCACHE_ENTRIES; i++)
+		texcache.entry[i].lru = 0;
+}
+
+// Cache is only used by the caller thread, not with banded rendering
+static void texCacheEnable(bool enable)
+{
+	texCacheFlush();
+	if (!enable) {
+		free(texcache.buf);
+		texcache.buf = NULL;
+	} else if (!texcache.buf) {
+		texcache.buf = (u16*)malloc(TEXCACHE_ENTRIES / 4 * FRAME_WIDTH * 256 * 2);
+		if (!texcache.buf) {
+			printf("gpu_unai: no memory for texture cache\n");
+			enable = false;
+		}
+	}
+	texcache.enabled = enable;
+	for (int i = 0; i < TEXCACHE_ENTRIES; i++)
+		texcache.entry[i].texels = texcache.buf ?
+			texcache.buf + (i / 4) * FRAME_WIDTH * 256 + (i % 4) * 256 : NULL;
+}
+
+static void texCacheStats(void)
+{
+	if (texcache.hits + texcache.misses + texcache.bypassed == 0)
+		return;
+	printf("gpu_unai: texture cache: %u hits, %u misses, %u invalidations, "
+	       "%u rows decoded, %u bypassed\n",
+	       texcache.hits, texcache.misses, texcache.invalidations,
+	       texcache.blocks_decoded * TEXCACHE_BLOCK, texcache.bypassed);
+	texcache.hits = texcache.misses = texcache.invalidations = 0;
+	texcache.blocks_decoded = texcache.bypassed = 0;
+}
+
+// Set 'r' to VRAM rect x,y,w,h. Reads past the right edge continue on the
+// next row, take whole rows then.
+static void texCacheRect(s16 *r, s32 x, s32 y, s32 w, s32 h)
+{
+	if (x + w > FRAME_WIDTH) { x = 0; w = FRAME_WIDTH; h++; }
+	r[0] = x; r[1] = y; r[2] = x + w; r[3] = y + h;
+}
+
+static inline bool texCacheOverlap(const s16 *r, s32 x0, s32 y0, s32 x1, s32 y1)
+{
+	return r[0] < x1 && x0 < r[2] && r[1] < y1 && y0 < r[3];
+}
+
+// VRAM rect x,y,w,h was written. Rects wrap around VRAM edges.
+static void texCacheInvalidate(s32 x, s32 y, s32 w, s32 h)
+{
+	if (!texcache.enabled)
+		return;
+	if (x + w > FRAME_WIDTH)  { x = 0; w = FRAME_WIDTH; }
+	if (y + h > FRAME_HEIGHT) { y = 0; h = FRAME_HEIGHT; }
+	for (int i = 0; i < TEXCACHE_ENTRIES; i++) {
+		TexCacheEntry *e = &texcache.entry[i];
+		if (e->lru && (texCacheOverlap(e->tex, x, y, x + w, y + h) ||
+		               texCacheOverlap(e->cba, x, y, x + w, y + h))) {
+			e->lru = 0;
+			texcache.invalidations++;
+		}
+	}
+}
+
+// Drawing area changed: primitives may now write there
+static void texCacheSetArea(void)
+{
+#ifdef GPU_UNAI_USE_BANDS
+	const u16 *a = gpu_unai.DrawingAreaFull;
+#else
+	const u16 *a = gpu_unai.DrawingArea;
+#endif
+	texCacheInvalidate(a[0], a[1], a[2] - a[0], a[3] - a[1]);
+}
+
+static void texCacheDecode(TexCacheEntry *e, int block)
+{
+	const u16 *clut = &gpu_unai.vram[(e->clut & 0x7FFF) << 4];
+	u32 tx = (e->tpage & 0x0F) << 6;
+	u32 ty = (e->tpage & 0x10) << 4;
+	for (int v = block * TEXCACHE_BLOCK; v < (block + 1) * TEXCACHE_BLOCK; v++) {
+		const u8 *src = (const u8*)&gpu_unai.vram[FRAME_OFFSET(tx, ty + v)];
+		u16 *dst = e->texels + FRAME_OFFSET(0, v);
+		if ((e->tpage & 0x180) == 0) {
+			for (int u = 0; u < 256; u += 2, src++) {
+				dst[u]     = clut[*src & 0xf];
+				dst[u + 1] = clut[*src >> 4];
+			}
+		} else {
+			for (int u = 0; u < 256; u++)
+				dst[u] = clut[src[u]];
+		}
+	}
+	e->blocks |= 1u << block;
+	texcache.blocks_decoded++;
+}
+
+// Rows v0..v1 (page rows, before texture window) must be decoded
+static void texCacheDecodeRows(TexCacheEntry *e, s32 v0, s32 v1)
+{
+	const s32 mask = gpu_unai.TextureWindow[3];
+	const s32 ofs = gpu_unai.TextureWindow[1];
+	u32 need;
+	if (v1 - v0 >= mask) {
+		v0 = 0;
+		v1 = mask;
+	} else {
+		v0 &= mask;
+		v1 &= mask;
+		if (v1 < v0) {  // wraps inside window
+			v0 = 0;
+			v1 = mask;
+		}
+	}
+	v0 = (v0 + ofs) / TEXCACHE_BLOCK;
+	v1 = (v1 + ofs) / TEXCACHE_BLOCK;
+	need = ((2u << v1) - 1) & ~((1u << v0) - 1) & ~e->blocks;
+	while (need) {
+		int block = __builtin_ctz(need);
+		texCacheDecode(e, block);
+		need &= need - 1;
+	}
+}
+
+// Draw current primitive from a decoded page, if 4/8bpp. Texture rows
+// v0..v1 are used. Call texCacheEnd() after drawing.
+static void texCacheBegin(s32 v0, s32 v1)
+{
+	// Only 4bpp and 8bpp pages are cached (TEXT_MODE 1 and 2)
+	u32 tmode = gpu_unai.TEXT_MODE >> 5;
+	if (!texcache.enabled || (tmode != 1 && tmode != 2))
+		return;
+
+	u16 tpage = gpu_unai.GPU_GP1 & 0x19F;
+	u16 clut = (gpu_unai.CBA - gpu_unai.vram) >> 4;
+	TexCacheEntry *e = NULL, *victim = &texcache.entry[0];
+	for (int i = 0; i < TEXCACHE_ENTRIES; i++) {
+		TexCacheEntry *t = &texcache.entry[i];
+		if (t->lru && t->tpage == tpage && t->clut == clut) {
+			e = t;
+			break;
+		}
+		if (t->lru < victim->lru)
+			victim = t;
+	}
+
+	if (e) {
+		texcache.hits++;
+	} else {
+		// Self-texturing: primitives may write the texture while using it
+		s16 tex[4], cba[4];
+		texCacheRect(tex, (tpage & 0x0F) << 6, (tpage & 0x10) << 4, 64 << (tmode - 1), 256);
+		texCacheRect(cba, (clut & 0x3F) << 4, (clut >> 6) & 0x1FF, 16 << ((tmode - 1) * 4), 1);
+#ifdef GPU_UNAI_USE_BANDS
+		const u16 *a = gpu_unai.DrawingAreaFull;
+#else
+		const u16 *a = gpu_unai.DrawingArea;
+#endif
+		if (texCacheOverlap(tex, a[0], a[1], a[2], a[3]) ||
+		    texCacheOverlap(cba, a[0], a[1], a[2], a[3])) {
+			texcache.bypassed++;
+			return;
+		}
+		texcache.misses++;
+		e = victim;
+		e->tpage = tpage;
+		e->clut = clut;
+		e->blocks = 0;
+		memcpy(e->tex, tex, sizeof(tex));
+		memcpy(e->cba, cba, sizeof(cba));
+	}
+	e->lru = ++texcache.lru;
+	if (texcache.lru == 0) {
+		// Wrapped, keep entries valid
+		for (int i = 0; i < TEXCACHE_ENTRIES; i++)
+			if (texcache.entry[i].lru)
+				texcache.entry[i].lru = 1;
+		e->lru = texcache.lru = 2;
+	}
+
+	texCacheDecodeRows(e, v0, v1);
+
+	texcache.active = true;
+	texcache.TBA = gpu_unai.TBA;
+	texcache.TEXT_MODE = gpu_unai.TEXT_MODE;
+	gpu_unai.TBA = e->texels + FRAME_OFFSET(gpu_unai.TextureWindow[0], gpu_unai.TextureWindow[1]);
+	gpu_unai.TEXT_MODE = 3 << 5;
+}
+
+static inline void texCacheEnd(void)
+{
+	if (texcache.active) {
+		texcache.active = false;
+		gpu_unai.TBA = texcache.TBA;
+		gpu_unai.TEXT_MODE = texcache.TEXT_MODE;
+	}
+}
+
+// Texture rows used by polygon: min..max of vertex V coords. Interpolated
+// coords may step slightly outside, allow for it.
+static void texCacheBeginPoly(const u8 *v, int n, int stride)
+{
+	s32 v0 = 255, v1 = 0;
+	for (int i = 0; i < n; i++, v += stride) {
+		if (*v < v0) v0 = *v;
+		if (*v > v1) v1 = *v;
+	}
+	texCacheBegin(v0 - 2, v1 + 2);
+}
+
+static void texCacheBeginSprite(PtrUnion packet)
+{
+	s32 v0 = packet.U1[9];
+	s32 h = packet.U2[7] & 0x1ff;
+	if (h)
+		texCacheBegin(v0, v0 + h - 1);
+}
+
+#else
+
+static inline void texCacheFlush(void) {}
+static inline void texCacheEnable(bool enable) {}
+static inline void texCacheStats(void) {}
+static inline void texCacheInvalidate(s32 x, s32 y, s32 w, s32 h) {}
+static inline void texCacheSetArea(void) {}
+static inline void texCacheEnd(void) {}
+static inline void texCacheBeginPoly(const u8 *v, int n, int stride) {}
+static inline void texCacheBeginSprite(PtrUnion packet) {}
+
+#endif // GPU_UNAI_USE_TEXCACHE
+
+#endif // GPU_UNAI_TEXCACHE_H
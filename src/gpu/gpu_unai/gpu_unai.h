@@ -42,6 +42,22 @@
                                          //  use multiply-by-inverse for division
 //#define GPU_UNAI_USE_INT_DIV_MULTINV   // If GPU_UNAI_USE_FLOATMATH is *not*
                                          //  defined, use old inaccurate division
+//#define GPU_UNAI_NO_INLINE_POLY        // Draw all poly rows through
+                                         //  gpuPolySpanDrivers[] pointers,
+                                         //  smaller but slower code
+
+//#define GPU_UNAI_USE_BANDS             // Allow rendering in horizontal bands
+                                         //  on worker threads (gpulib only,
+                                         //  see 'bands' config option)
+//#define GPU_UNAI_USE_TEXCACHE          // Allow drawing 4bpp/8bpp textures
+                                         //  from pages decoded to 16bpp
+                                         //  (gpulib only, see 'tex_cache'
+                                         //  config option)
+
+#ifndef USE_GPULIB
+#undef GPU_UNAI_USE_BANDS
+#undef GPU_UNAI_USE_TEXCACHE
+#endif
 
 
 #define u8  uint8_t
@@ -160,7 +176,7 @@ struct gpu_unai_t {
 		s32  px,py;
 		s32  x_end,y_end;
 		u16* pvram;
-		u32 *last_dma;     // Last dma pointer
+		u32  last_dma;     // Last dma chain start (RAM word index), ~0: none
 		bool FrameToRead;  // Load image in progress
 		bool FrameToWrite; // Store image in progress
 	} dma;
@@ -248,9 +264,27 @@ struct gpu_unai_t {
 
 	u8  LightLUT[32*32];    // 5-bit lighting LUT (gpu_inner_light.h)
 	u32 DitherMatrix[64];   // Matrix of dither coefficients
+
+#ifdef GPU_UNAI_USE_BANDS
+	// Banded rendering (see gpulib_if.cpp). Every band thread walks the same
+	//  command list with its own copy of this struct, and DrawingArea[]
+	//  is clipped to the rows the thread owns.
+	u8  band_count;         // Number of bands, 0/1 when not rendering a band
+	u8  band_index;         // Band drawn by this thread, 0 is caller thread
+	u16 DrawingAreaFull[4]; // Unclipped drawing area, as set by E3h/E4h
+	u16 BandDirty[4];       // VRAM rect written by clears since last sync
+	u16 BandRead[4];        // VRAM rect read by textures since last sync
+#endif
 };
 
+#ifdef GPU_UNAI_USE_BANDS
+// Band worker threads point gpu_unai_cur at their own state
+static gpu_unai_t gpu_unai_main;
+static __thread gpu_unai_t *gpu_unai_cur = &gpu_unai_main;
+#define gpu_unai (*gpu_unai_cur)
+#else
 static gpu_unai_t gpu_unai;
+#endif
 
 // Global config that frontend can alter.. Values are read in GPU_init().
 // TODO: if frontend menu modifies a setting, add a function that can notify
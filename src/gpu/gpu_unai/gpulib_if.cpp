@@ -24,6 +24,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#ifdef GPU_UNAI_USE_BANDS
+#include <pthread.h>
+#endif
 #include "gpu/gpulib/gpu.h"
 #include "port.h"
 #include "gpu_unai.h"
@@ -51,10 +54,319 @@
 // GPU command buffer execution/store
 #include "gpu_command.h"
 
+// Decoded texture page cache
+#include "gpu_texcache.h"
+
+/////////////////////////////////////////////////////////////////////////////
+
+#ifdef GPU_UNAI_USE_BANDS
+///////////////////////////////////////////////////////////////////////////////
+//  Banded rendering
+//
+//  The drawing area is split into horizontal bands. Band 0 is drawn by the
+//  caller thread as usual, the others by band threads: every command list
+//  is copied to a ring that each band thread walks with its own copy of
+//  gpu_unai, drawing only into rows of its band. Each row is drawn by one
+//  thread in list order, so results are the same as drawing on a single
+//  thread. All threads take the same decisions from the same lists, and
+//  sync at the same points:
+//   - Drawing area changes (rows change owner)
+//   - Primitives that can't be split between bands: VRAM moves, lines
+//     crossing bands, textures read from the drawing area. Band 0 draws
+//     them alone between two syncs.
+//   - Textures read from VRAM cleared since the last sync, and clears of
+//     VRAM read as texture since the last sync
+//  Between syncs threads run ahead or behind each other. The caller thread
+//  waits for band threads only when gpulib flushes renderer queues, which
+//  it does before VRAM uploads/downloads and display.
+
+#define BANDS_MAX      8
+#define BANDS_RING     (128 * 1024)  // Ring size in words, power of two
+#define BANDS_MAX_ITEM (16 * 1024)   // Longer lists are drawn unbanded
+
+static struct {
+  int  count;                   // Band threads + caller thread, 0: disabled
+  bool quit;
+  u32 *ring;                    // Queued lists: length word, list words
+  u32  head;                    // Words queued, written by caller thread
+  u32  tail[BANDS_MAX];         // Words done by each band thread
+  int  idle;                    // Band threads waiting for lists
+  int  waiting;                 // Caller thread waiting for band threads
+  int  arrived;                 // Threads waiting in bandSync()
+  u32  gen;                     // Incremented when all threads arrived
+  pthread_mutex_t lock;
+  pthread_cond_t  cond_list;    // Lists queued, or quit
+  pthread_cond_t  cond_done;    // Band thread advanced its tail
+  pthread_cond_t  cond_sync;    // All threads arrived in bandSync()
+  pthread_t  thread[BANDS_MAX];
+  gpu_unai_t state[BANDS_MAX];  // [0] unused, band 0 uses gpu_unai_main
+} bands;
+
+static void bandsStart(int count);
+static void bandsStop(void);
+static void bandsFlush(void);
+static void bandsResync(void);
+
+static void bandSync(void)
+{
+  gpu_unai.BandDirty[0] = gpu_unai.BandDirty[2] = 0;
+  gpu_unai.BandRead[0]  = gpu_unai.BandRead[2]  = 0;
+
+  pthread_mutex_lock(&bands.lock);
+  if (++bands.arrived == bands.count) {
+    bands.arrived = 0;
+    bands.gen++;
+    pthread_cond_broadcast(&bands.cond_sync);
+  } else {
+    u32 gen = bands.gen;
+    while (gen == bands.gen)
+      pthread_cond_wait(&bands.cond_sync, &bands.lock);
+  }
+  pthread_mutex_unlock(&bands.lock);
+}
+
+// VRAM rows owned by a band. Drawing area is split evenly, first and last
+//  bands also own the rows above and below it (for clears).
+static void bandRows(const gpu_unai_t &s, int band, int *top, int *bot)
+{
+  int ymin = s.DrawingAreaFull[1];
+  int h = Max2(s.DrawingAreaFull[3] - ymin, 0);
+  int n = s.band_count;
+  *top = band ? ymin + h * band / n : 0;
+  *bot = (band < n - 1) ? ymin + h * (band + 1) / n : FRAME_HEIGHT;
+}
+
+static int bandOfRow(int y)
+{
+  int top, bot;
+  for (int band = gpu_unai.band_count - 1; band > 0; band--) {
+    bandRows(gpu_unai, band, &top, &bot);
+    if (y >= top)
+      return band;
+  }
+  return 0;
+}
+
+static void bandClipArea(gpu_unai_t &s)
+{
+  memcpy(s.DrawingArea, s.DrawingAreaFull, sizeof(s.DrawingArea));
+  if (s.band_count > 1) {
+    int top, bot;
+    bandRows(s, s.band_index, &top, &bot);
+    s.DrawingArea[1] = Max2((int)s.DrawingArea[1], top);
+    s.DrawingArea[3] = Min2((int)s.DrawingArea[3], bot);
+  }
+}
+
+// Set drawing area corner (0: top left, 2: bottom right)
+static void bandSetArea(int corner, u16 x, u16 y)
+{
+  if (gpu_unai.band_count > 1 &&
+      (gpu_unai.DrawingAreaFull[corner] != x || gpu_unai.DrawingAreaFull[corner + 1] != y))
+    bandSync();
+  gpu_unai.DrawingAreaFull[corner]     = x;
+  gpu_unai.DrawingAreaFull[corner + 1] = y;
+  bandClipArea(gpu_unai);
+}
+
+static bool bandRectsOverlap(const s32 *a, const s32 *b)
+{
+  return a[0] < b[2] && b[0] < a[2] && a[1] < b[3] && b[1] < a[3];
+}
+
+static bool bandRectsOverlap(const s32 *a, const u16 *b)
+{
+  s32 r[4] = { b[0], b[1], b[2], b[3] };
+  return bandRectsOverlap(a, r);
+}
+
+// Grow bounding rect 'r' (empty when r[2] <= r[0]) to include 'a'
+static void bandRectAdd(u16 *r, const s32 *a)
+{
+  if (a[2] <= a[0])
+    return;
+  if (r[2] <= r[0]) {
+    r[0] = a[0];  r[1] = a[1];  r[2] = a[2];  r[3] = a[3];
+  } else {
+    r[0] = Min2((s32)r[0], a[0]);  r[1] = Min2((s32)r[1], a[1]);
+    r[2] = Max2((s32)r[2], a[2]);  r[3] = Max2((s32)r[3], a[3]);
+  }
+}
+
+// Rect of VRAM read by a texture page or CLUT. Reads past the right edge
+//  of VRAM continue on the next line.
+static void bandTexRect(s32 *r, s32 x, s32 y, s32 w, s32 h)
+{
+  if (x + w > FRAME_WIDTH) {
+    x = 0;  w = FRAME_WIDTH;  h++;
+  }
+  r[0] = x;  r[1] = y;  r[2] = x + w;  r[3] = y + h;
+}
+
+// Returns true if textured primitive must be drawn by band 0 alone.
+//  Bands run ahead of each other between syncs, so textures must not be
+//  written by clears of other bands, before or after being read.
+static bool bandTexHazard(u32 tpage, u32 clut)
+{
+  u32 tmode = (tpage >> 7) & 3;
+  if (tmode == 3) tmode = 2;
+
+  s32 tex[4], cba[4], area[4];
+  bandTexRect(tex, (tpage & 0x0F) << 6, (tpage & 0x10) << 4, 64 << tmode, 256);
+  if (tmode < 2)
+    bandTexRect(cba, (clut & 0x3F) << 4, (clut >> 6) & 0x1FF, 16 << (tmode * 4), 1);
+  else
+    cba[0] = cba[1] = cba[2] = cba[3] = 0;
+  for (int i = 0; i < 4; i++)
+    area[i] = gpu_unai.DrawingAreaFull[i];
+
+  if (bandRectsOverlap(tex, area) || bandRectsOverlap(cba, area))
+    return true;
+  if (bandRectsOverlap(tex, gpu_unai.BandDirty) || bandRectsOverlap(cba, gpu_unai.BandDirty))
+    bandSync();
+  bandRectAdd(gpu_unai.BandRead, tex);
+  bandRectAdd(gpu_unai.BandRead, cba);
+  return false;
+}
+
+// Returns true if primitive must be drawn by band 0 alone
+static bool bandSerialPrim(u32 cmd)
+{
+  const u32 *p = gpu_unai.PacketBuffer.U4;
+  switch (cmd) {
+    case 0x24 ... 0x27:
+    case 0x2C ... 0x2F:
+      return bandTexHazard(p[4] >> 16, p[2] >> 16);
+    case 0x34 ... 0x37:
+    case 0x3C ... 0x3F:
+      return bandTexHazard(p[5] >> 16, p[2] >> 16);
+    case 0x64 ... 0x67:
+    case 0x74 ... 0x77:
+    case 0x7C ... 0x7F:
+      return bandTexHazard(gpu_unai.GPU_GP1, p[2] >> 16);
+    case 0x80:
+      return true;
+  }
+  return false;
+}
+
+// Keep state changes made by a primitive that band 0 draws alone
+static void bandSkipPrim(u32 cmd)
+{
+  const u32 *p = gpu_unai.PacketBuffer.U4;
+  switch (cmd) {
+    case 0x24 ... 0x27:
+    case 0x2C ... 0x2F:
+      gpuSetCLUT   (p[2] >> 16);
+      gpuSetTexture(p[4] >> 16);
+      break;
+    case 0x34 ... 0x37:
+    case 0x3C ... 0x3F:
+      gpuSetCLUT   (p[2] >> 16);
+      gpuSetTexture(p[5] >> 16);
+      break;
+    case 0x64 ... 0x67:
+    case 0x74 ... 0x77:
+    case 0x7C ... 0x7F:
+      gpuSetCLUT   (p[2] >> 16);
+      break;
+  }
+}
+
+// Clears ignore the drawing area, clip them to band rows instead.
+//  Returns false if nothing is left to clear.
+static bool bandClipClear(PtrUnion packet)
+{
+  s32 x0 = packet.S2[2];
+  s32 y0 = packet.S2[3];
+  s32 x1 = Min2(x0 + (packet.S2[4] & 0x3ff), FRAME_WIDTH);
+  s32 y1 = Min2(y0 + (packet.S2[5] & 0x3ff), FRAME_HEIGHT);
+  x0 = Max2(x0, 0);
+  y0 = Max2(y0, 0);
+  if (x1 <= x0 || y1 <= y0)
+    return false;
+
+  s32 rect[4] = { x0, y0, x1, y1 };
+  if (bandRectsOverlap(rect, gpu_unai.BandRead))
+    bandSync();
+  bandRectAdd(gpu_unai.BandDirty, rect);
+
+  int top, bot;
+  bandRows(gpu_unai, gpu_unai.band_index, &top, &bot);
+  y0 = Max2(y0, top);
+  y1 = Min2(y1, bot);
+  if (y1 <= y0)
+    return false;
+  packet.S2[3] = y0;
+  packet.S2[5] = y1 - y0;
+  return true;
+}
+
+// Lines are clipped by moving their end points, so a line clipped to a
+//  band wouldn't have the same pixels. Lines are drawn whole by the band
+//  holding all their rows, or by band 0 alone when crossing bands.
+static void bandDrawLine(PtrUnion packet, const PSD driver, bool gouraud)
+{
+  s32 y0 = GPU_EXPANDSIGN(packet.S2[3]) + gpu_unai.DrawingOffset[1];
+  s32 y1 = GPU_EXPANDSIGN(packet.S2[gouraud ? 7 : 5]) + gpu_unai.DrawingOffset[1];
+  if (y0 > y1) SwapValues(y0, y1);
+
+  const s32 ymin = gpu_unai.DrawingAreaFull[1];
+  const s32 ymax = gpu_unai.DrawingAreaFull[3] - 1;
+  bool serial = true;
+  if (ymin <= ymax) {
+    if (y0 > ymax || y1 < ymin)
+      return;
+    int band = bandOfRow(Max2(y0, ymin));
+    if (band == bandOfRow(Min2(y1, ymax))) {
+      if (band != gpu_unai.band_index)
+        return;
+      serial = false;
+    }
+  }
+
+  if (serial) bandSync();
+  if (gpu_unai.band_index == 0 || !serial) {
+    memcpy(gpu_unai.DrawingArea, gpu_unai.DrawingAreaFull, sizeof(gpu_unai.DrawingArea));
+    if (gouraud)
+      gpuDrawLineG(packet, driver);
+    else
+      gpuDrawLineF(packet, driver);
+    bandClipArea(gpu_unai);
+  }
+  if (serial) bandSync();
+}
+#endif // GPU_UNAI_USE_BANDS
+
+static inline void drawLineF(PtrUnion packet, const PSD driver)
+{
+#ifdef GPU_UNAI_USE_BANDS
+  if (gpu_unai.band_count > 1) {
+    bandDrawLine(packet, driver, false);
+    return;
+  }
+#endif
+  gpuDrawLineF(packet, driver);
+}
+
+static inline void drawLineG(PtrUnion packet, const PSD driver)
+{
+#ifdef GPU_UNAI_USE_BANDS
+  if (gpu_unai.band_count > 1) {
+    bandDrawLine(packet, driver, true);
+    return;
+  }
+#endif
+  gpuDrawLineG(packet, driver);
+}
+
 /////////////////////////////////////////////////////////////////////////////
 
 int renderer_init(void)
 {
+#ifdef GPU_UNAI_USE_BANDS
+  bandsStop();
+#endif
   memset((void*)&gpu_unai, 0, sizeof(gpu_unai));
   gpu_unai.vram = (u16*)gpu.vram;
 
@@ -96,15 +408,31 @@ int renderer_init(void)
   SetupLightLUT();
   SetupDitheringConstants();
 
+#ifdef GPU_UNAI_USE_BANDS
+  bandsStart(gpu_unai.config.bands);
+  texCacheEnable(gpu_unai.config.tex_cache && bands.count <= 1);
+#else
+  texCacheEnable(gpu_unai.config.tex_cache);
+#endif
+
   return 0;
 }
 
 void renderer_finish(void)
 {
+#ifdef GPU_UNAI_USE_BANDS
+  bandsStop();
+#endif
+  texCacheStats();
+  texCacheEnable(false);
 }
 
 void renderer_notify_res_change(void)
 {
+#ifdef GPU_UNAI_USE_BANDS
+  bandsFlush();
+#endif
+
   if (PixelSkipEnabled()) {
     // Set blit_mask for high horizontal resolutions. This allows skipping
     //  rendering pixels that would never get displayed on low-resolution
@@ -143,14 +471,19 @@ void renderer_notify_res_change(void)
       gpu.screen.hres, gpu.screen.vres, gpu.status.rgb24 ? 24 : 15,
       gpu_unai.ilace_mask);
   */
+
+#ifdef GPU_UNAI_USE_BANDS
+  if (bands.count > 1)
+    bandsResync();
+#endif
 }
 
 // Handles GP0 draw settings commands 0xE1...0xE6
-static void gpuGP0Cmd_0xEx(gpu_unai_t &gpu_unai, u32 cmd_word)
+static void gpuGP0Cmd_0xEx(uint32_t *ex_regs, u32 cmd_word)
 {
   // Assume incoming GP0 command is 0xE1..0xE6, convert to 1..6
   u8 num = (cmd_word >> 24) & 7;
-  gpu.ex_regs[num] = cmd_word; // Update gpulib register
+  ex_regs[num] = cmd_word; // Update gpulib register
   switch (num) {
     case 1: {
       // GP0(E1h) - Draw Mode setting (aka "Texpage")
@@ -188,14 +521,24 @@ static void gpuGP0Cmd_0xEx(gpu_unai_t &gpu_unai, u32 cmd_word)
 
     case 3: {
       // GP0(E3h) - Set Drawing Area top left (X1,Y1)
+#ifdef GPU_UNAI_USE_BANDS
+      bandSetArea(0, cmd_word & 0x3FF, (cmd_word >> 10) & 0x3FF);
+#else
       gpu_unai.DrawingArea[0] = cmd_word         & 0x3FF;
       gpu_unai.DrawingArea[1] = (cmd_word >> 10) & 0x3FF;
+#endif
+      texCacheSetArea();
     } break;
 
     case 4: {
       // GP0(E4h) - Set Drawing Area bottom right (X2,Y2)
+#ifdef GPU_UNAI_USE_BANDS
+      bandSetArea(2, (cmd_word & 0x3FF) + 1, ((cmd_word >> 10) & 0x3FF) + 1);
+#else
       gpu_unai.DrawingArea[2] = (cmd_word         & 0x3FF) + 1;
       gpu_unai.DrawingArea[3] = ((cmd_word >> 10) & 0x3FF) + 1;
+#endif
+      texCacheSetArea();
     } break;
 
     case 5: {
@@ -214,7 +557,7 @@ static void gpuGP0Cmd_0xEx(gpu_unai_t &gpu_unai, u32 cmd_word)
 
 extern const unsigned char cmd_lengths[256];
 
-int do_cmd_list(unsigned int *list, int list_len, int *last_cmd)
+static int gpu_cmd_list(uint32_t *ex_regs, unsigned int *list, int list_len, int *last_cmd)
 {
   unsigned int cmd = 0, len, i;
   unsigned int *list_start = list;
@@ -244,9 +587,28 @@ int do_cmd_list(unsigned int *list, int list_len, int *last_cmd)
 
     PtrUnion packet = { .ptr = (void*)&gpu_unai.PacketBuffer };
 
+#ifdef GPU_UNAI_USE_BANDS
+    bool band_serial = false;
+    if (gpu_unai.band_count > 1 && bandSerialPrim(cmd)) {
+      band_serial = true;
+      bandSync();
+      if (gpu_unai.band_index != 0) {
+        bandSkipPrim(cmd);
+        bandSync();
+        continue;
+      }
+      memcpy(gpu_unai.DrawingArea, gpu_unai.DrawingAreaFull, sizeof(gpu_unai.DrawingArea));
+    }
+#endif
+
     switch (cmd)
     {
       case 0x02:
+#ifdef GPU_UNAI_USE_BANDS
+        if (gpu_unai.band_count > 1 && !bandClipClear(packet))
+          break;
+#endif
+        texCacheInvalidate(packet.S2[2], packet.S2[3], packet.S2[4] & 0x3ff, packet.S2[5] & 0x3ff);
         gpuClearImage(packet);
         break;
 
@@ -268,6 +630,7 @@ int do_cmd_list(unsigned int *list, int list_len, int *last_cmd)
       case 0x27: {          // Textured 3-pt poly
         gpuSetCLUT   (gpu_unai.PacketBuffer.U4[2] >> 16);
         gpuSetTexture(gpu_unai.PacketBuffer.U4[4] >> 16);
+        texCacheBeginPoly(&gpu_unai.PacketBuffer.U1[9], (cmd & 8) ? 4 : 3, 8);
 
         u32 driver_idx =
           (gpu_unai.blit_mask?1024:0) |
@@ -304,6 +667,7 @@ int do_cmd_list(unsigned int *list, int list_len, int *last_cmd)
       case 0x2F: {          // Textured 4-pt poly
         gpuSetCLUT   (gpu_unai.PacketBuffer.U4[2] >> 16);
         gpuSetTexture(gpu_unai.PacketBuffer.U4[4] >> 16);
+        texCacheBeginPoly(&gpu_unai.PacketBuffer.U1[9], (cmd & 8) ? 4 : 3, 8);
 
         u32 driver_idx =
           (gpu_unai.blit_mask?1024:0) |
@@ -345,6 +709,7 @@ int do_cmd_list(unsigned int *list, int list_len, int *last_cmd)
       case 0x37: {          // Gouraud-shaded, textured 3-pt poly
         gpuSetCLUT    (gpu_unai.PacketBuffer.U4[2] >> 16);
         gpuSetTexture (gpu_unai.PacketBuffer.U4[5] >> 16);
+        texCacheBeginPoly(&gpu_unai.PacketBuffer.U1[9], (cmd & 8) ? 4 : 3, 12);
         PP driver = gpuPolySpanDrivers[
           (gpu_unai.blit_mask?1024:0) |
           Dithering |
@@ -374,6 +739,7 @@ int do_cmd_list(unsigned int *list, int list_len, int *last_cmd)
       case 0x3F: {          // Gouraud-shaded, textured 4-pt poly
         gpuSetCLUT    (gpu_unai.PacketBuffer.U4[2] >> 16);
         gpuSetTexture (gpu_unai.PacketBuffer.U4[5] >> 16);
+        texCacheBeginPoly(&gpu_unai.PacketBuffer.U1[9], (cmd & 8) ? 4 : 3, 12);
         PP driver = gpuPolySpanDrivers[
           (gpu_unai.blit_mask?1024:0) |
           Dithering |
@@ -390,7 +756,7 @@ int do_cmd_list(unsigned int *list, int list_len, int *last_cmd)
         // Shift index right by one, as untextured prims don't use lighting
         u32 driver_idx = (Blending_Mode | gpu_unai.Masking | Blending | (gpu_unai.PixelMSB>>3)) >> 1;
         PSD driver = gpuPixelSpanDrivers[driver_idx];
-        gpuDrawLineF(packet, driver);
+        drawLineF(packet, driver);
       } break;
 
       case 0x48 ... 0x4F: { // Monochrome line strip
@@ -400,13 +766,13 @@ int do_cmd_list(unsigned int *list, int list_len, int *last_cmd)
         // Shift index right by one, as untextured prims don't use lighting
         u32 driver_idx = (Blending_Mode | gpu_unai.Masking | Blending | (gpu_unai.PixelMSB>>3)) >> 1;
         PSD driver = gpuPixelSpanDrivers[driver_idx];
-        gpuDrawLineF(packet, driver);
+        drawLineF(packet, driver);
 
         while(1)
         {
           gpu_unai.PacketBuffer.U4[1] = gpu_unai.PacketBuffer.U4[2];
           gpu_unai.PacketBuffer.U4[2] = *list_position++;
-          gpuDrawLineF(packet, driver);
+          drawLineF(packet, driver);
 
           num_vertexes++;
           if(list_position >= list_end) {
@@ -429,7 +795,7 @@ int do_cmd_list(unsigned int *list, int list_len, int *last_cmd)
         // Index MSB selects Gouraud-shaded PixelSpanDriver:
         driver_idx |= (1 << 5);
         PSD driver = gpuPixelSpanDrivers[driver_idx];
-        gpuDrawLineG(packet, driver);
+        drawLineG(packet, driver);
       } break;
 
       case 0x58 ... 0x5F: { // Gouraud-shaded line strip
@@ -441,7 +807,7 @@ int do_cmd_list(unsigned int *list, int list_len, int *last_cmd)
         // Index MSB selects Gouraud-shaded PixelSpanDriver:
         driver_idx |= (1 << 5);
         PSD driver = gpuPixelSpanDrivers[driver_idx];
-        gpuDrawLineG(packet, driver);
+        drawLineG(packet, driver);
 
         while(1)
         {
@@ -449,7 +815,7 @@ int do_cmd_list(unsigned int *list, int list_len, int *last_cmd)
           gpu_unai.PacketBuffer.U4[1] = gpu_unai.PacketBuffer.U4[3];
           gpu_unai.PacketBuffer.U4[2] = *list_position++;
           gpu_unai.PacketBuffer.U4[3] = *list_position++;
-          gpuDrawLineG(packet, driver);
+          drawLineG(packet, driver);
 
           num_vertexes++;
           if(list_position >= list_end) {
@@ -476,6 +842,7 @@ int do_cmd_list(unsigned int *list, int list_len, int *last_cmd)
       case 0x66:
       case 0x67: {          // Textured rectangle (variable size)
         gpuSetCLUT    (gpu_unai.PacketBuffer.U4[2] >> 16);
+        texCacheBeginSprite(packet);
         u32 driver_idx = Blending_Mode | gpu_unai.TEXT_MODE | gpu_unai.Masking | Blending | (gpu_unai.PixelMSB>>1);
 
         //senquack - Only color 808080h-878787h allows skipping lighting calculation:
@@ -522,6 +889,7 @@ int do_cmd_list(unsigned int *list, int list_len, int *last_cmd)
       case 0x77: {          // Textured rectangle (8x8)
         gpu_unai.PacketBuffer.U4[3] = 0x00080008;
         gpuSetCLUT    (gpu_unai.PacketBuffer.U4[2] >> 16);
+        texCacheBeginSprite(packet);
         u32 driver_idx = Blending_Mode | gpu_unai.TEXT_MODE | gpu_unai.Masking | Blending | (gpu_unai.PixelMSB>>1);
 
         //senquack - Only color 808080h-878787h allows skipping lighting calculation:
@@ -557,6 +925,7 @@ int do_cmd_list(unsigned int *list, int list_len, int *last_cmd)
       case 0x7F: {          // Textured rectangle (16x16)
         gpu_unai.PacketBuffer.U4[3] = 0x00100010;
         gpuSetCLUT    (gpu_unai.PacketBuffer.U4[2] >> 16);
+        texCacheBeginSprite(packet);
         u32 driver_idx = Blending_Mode | gpu_unai.TEXT_MODE | gpu_unai.Masking | Blending | (gpu_unai.PixelMSB>>1);
         //senquack - Only color 808080h-878787h allows skipping lighting calculation:
         //if ((gpu_unai.PacketBuffer.U1[0]>0x5F) && (gpu_unai.PacketBuffer.U1[1]>0x5F) && (gpu_unai.PacketBuffer.U1[2]>0x5F))
@@ -568,6 +937,7 @@ int do_cmd_list(unsigned int *list, int list_len, int *last_cmd)
       } break;
 
       case 0x80:          //  vid -> vid
+        texCacheInvalidate(packet.U2[4] & 1023, packet.U2[5] & 511, packet.U2[6], packet.U2[7]);
         gpuMoveImage(packet);
         break;
 
@@ -590,19 +960,276 @@ int do_cmd_list(unsigned int *list, int list_len, int *last_cmd)
         goto breakloop;
 #endif
       case 0xE1 ... 0xE6: { // Draw settings
-        gpuGP0Cmd_0xEx(gpu_unai, gpu_unai.PacketBuffer.U4[0]);
+        gpuGP0Cmd_0xEx(ex_regs, gpu_unai.PacketBuffer.U4[0]);
       } break;
     }
+
+    // Restore texture state replaced by texCacheBegin*()
+    texCacheEnd();
+
+#ifdef GPU_UNAI_USE_BANDS
+    if (band_serial) {
+      bandClipArea(gpu_unai);
+      bandSync();
+    }
+#endif
   }
 
 breakloop:
-  gpu.ex_regs[1] &= ~0x1ff;
-  gpu.ex_regs[1] |= gpu_unai.GPU_GP1 & 0x1ff;
+  ex_regs[1] &= ~0x1ff;
+  ex_regs[1] |= gpu_unai.GPU_GP1 & 0x1ff;
 
   *last_cmd = cmd;
   return list - list_start;
 }
 
+#ifdef GPU_UNAI_USE_BANDS
+// Returns number of words of list to queue for band threads: all words
+//  gpu_cmd_list() would consume, or whole list if it ends in an incomplete
+//  command (gpu_cmd_list() may have drawn part of a poly-line then).
+static int bandScanList(const u32 *list, int list_len)
+{
+  const u32 *p = list, *list_end = list + list_len;
+  for (; p < list_end; ) {
+    u32 cmd = *p >> 24;
+    u32 len = cmd_lengths[cmd];
+    if (p + 1 + len > list_end)
+      return list_len;
+
+    if (cmd == 0xA0 || cmd == 0xC0)
+      break;
+
+    if (cmd >= 0x48 && cmd <= 0x5F && (cmd & 8)) {
+      // Poly-line, same walk as in gpu_cmd_list()
+      u32 step = (cmd & 0x10) ? 2 : 1;
+      const u32 *pos = p + 2;
+      u32 num_vertexes = 1;
+      do {
+        pos += step;
+        num_vertexes++;
+        if (pos >= list_end)
+          return list_len;
+      } while ((*pos & 0xf000f000) != 0x50005000);
+      len += (num_vertexes - 2) * step;
+    }
+    p += 1 + len;
+  }
+  return p - list;
+}
+
+static void bandThreadTail(int band, u32 tail)
+{
+  __atomic_store_n(&bands.tail[band], tail, __ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&bands.waiting, __ATOMIC_SEQ_CST)) {
+    pthread_mutex_lock(&bands.lock);
+    pthread_cond_broadcast(&bands.cond_done);
+    pthread_mutex_unlock(&bands.lock);
+  }
+}
+
+static void *bandThread(void *arg)
+{
+  int band = (intptr_t)arg;
+  gpu_unai_cur = &bands.state[band];
+
+  uint32_t ex_regs[8];
+  int dummy;
+  u32 tail = bands.tail[band];
+  for (;;) {
+    u32 head = __atomic_load_n(&bands.head, __ATOMIC_SEQ_CST);
+    if (tail == head) {
+      pthread_mutex_lock(&bands.lock);
+      __atomic_add_fetch(&bands.idle, 1, __ATOMIC_SEQ_CST);
+      while ((head = __atomic_load_n(&bands.head, __ATOMIC_SEQ_CST)) == tail &&
+             !bands.quit)
+        pthread_cond_wait(&bands.cond_list, &bands.lock);
+      __atomic_sub_fetch(&bands.idle, 1, __ATOMIC_SEQ_CST);
+      pthread_mutex_unlock(&bands.lock);
+      if (tail == head)
+        break;
+    }
+
+    while (tail != head) {
+      u32 pos = tail & (BANDS_RING - 1);
+      u32 len = bands.ring[pos];
+      if (len == 0) {
+        tail += BANDS_RING - pos;  // Wrap marker
+        continue;
+      }
+      gpu_cmd_list(ex_regs, &bands.ring[pos + 1], len, &dummy);
+      tail += 1 + len;
+    }
+    bandThreadTail(band, tail);
+  }
+  return NULL;
+}
+
+// Wait until band threads are done with all words but 'left'
+static void bandsWait(u32 left)
+{
+  u32 head = bands.head;
+  for (int i = 1; i < bands.count; i++) {
+    if (head - __atomic_load_n(&bands.tail[i], __ATOMIC_SEQ_CST) <= left)
+      continue;
+    pthread_mutex_lock(&bands.lock);
+    __atomic_store_n(&bands.waiting, 1, __ATOMIC_SEQ_CST);
+    while (head - __atomic_load_n(&bands.tail[i], __ATOMIC_SEQ_CST) > left)
+      pthread_cond_wait(&bands.cond_done, &bands.lock);
+    __atomic_store_n(&bands.waiting, 0, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&bands.lock);
+  }
+}
+
+static void bandsFlush(void)
+{
+  if (bands.count > 1)
+    bandsWait(0);
+}
+
+// Copy caller thread state to idle band threads
+static void bandsResync(void)
+{
+  gpu_unai.band_count = bands.count;
+  gpu_unai.band_index = 0;
+  bandClipArea(gpu_unai);
+  for (int i = 1; i < bands.count; i++) {
+    bands.state[i] = gpu_unai;
+    bands.state[i].band_index = i;
+    bandClipArea(bands.state[i]);
+  }
+}
+
+static void bandsQueue(const u32 *list, u32 len)
+{
+  u32 pos = bands.head & (BANDS_RING - 1);
+  u32 skip = (pos + 1 + len > BANDS_RING) ? BANDS_RING - pos : 0;
+  bandsWait(BANDS_RING - skip - 1 - len);
+
+  u32 head = bands.head;
+  if (skip) {
+    bands.ring[pos] = 0;
+    head += skip;
+    pos = 0;
+  }
+  bands.ring[pos] = len;
+  memcpy(&bands.ring[pos + 1], list, len * 4);
+  head += 1 + len;
+
+  __atomic_store_n(&bands.head, head, __ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&bands.idle, __ATOMIC_SEQ_CST)) {
+    pthread_mutex_lock(&bands.lock);
+    pthread_cond_broadcast(&bands.cond_list);
+    pthread_mutex_unlock(&bands.lock);
+  }
+}
+
+static void bandsStart(int count)
+{
+  if (count > BANDS_MAX)
+    count = BANDS_MAX;
+  if (count <= 1)
+    return;
+
+  bands.ring = (u32 *)malloc(BANDS_RING * 4);
+  if (bands.ring == NULL)
+    goto fail_ring;
+  if (pthread_mutex_init(&bands.lock, NULL))
+    goto fail_mutex;
+  if (pthread_cond_init(&bands.cond_list, NULL))
+    goto fail_cond_list;
+  if (pthread_cond_init(&bands.cond_done, NULL))
+    goto fail_cond_done;
+  if (pthread_cond_init(&bands.cond_sync, NULL))
+    goto fail_cond_sync;
+
+  bands.quit = false;
+  bands.head = 0;
+  bands.idle = bands.waiting = bands.arrived = 0;
+  memset(bands.tail, 0, sizeof(bands.tail));
+
+  // Band threads don't touch their state before lists are queued
+  int i;
+  for (i = 1; i < count; i++)
+    if (pthread_create(&bands.thread[i], NULL, bandThread, (void *)(intptr_t)i))
+      break;
+  bands.count = i;
+  bandsResync();
+
+  if (i < count)
+    printf("GPU: failed to start band thread %d\n", i);
+  if (i > 1) {
+    printf("GPU: rendering in %d bands\n", i);
+    return;
+  }
+
+  bands.count = 0;
+  bandsResync();
+  pthread_cond_destroy(&bands.cond_sync);
+fail_cond_sync:
+  pthread_cond_destroy(&bands.cond_done);
+fail_cond_done:
+  pthread_cond_destroy(&bands.cond_list);
+fail_cond_list:
+  pthread_mutex_destroy(&bands.lock);
+fail_mutex:
+  free(bands.ring);
+  bands.ring = NULL;
+fail_ring:
+  printf("GPU: banded rendering disabled\n");
+}
+
+static void bandsStop(void)
+{
+  if (bands.count <= 1)
+    return;
+
+  bandsWait(0);
+  pthread_mutex_lock(&bands.lock);
+  bands.quit = true;
+  pthread_cond_broadcast(&bands.cond_list);
+  pthread_mutex_unlock(&bands.lock);
+  for (int i = 1; i < bands.count; i++)
+    pthread_join(bands.thread[i], NULL);
+
+  pthread_cond_destroy(&bands.cond_sync);
+  pthread_cond_destroy(&bands.cond_done);
+  pthread_cond_destroy(&bands.cond_list);
+  pthread_mutex_destroy(&bands.lock);
+  free(bands.ring);
+  bands.ring = NULL;
+
+  bands.count = 0;
+  bandsResync();
+}
+
+static int bandsCmdList(unsigned int *list, int list_len, int *last_cmd)
+{
+  int len = bandScanList(list, list_len);
+  if (len > BANDS_MAX_ITEM) {
+    // Huge list, draw it unbanded
+    bandsWait(0);
+    gpu_unai.band_count = 0;
+    bandClipArea(gpu_unai);
+    int ret = gpu_cmd_list(gpu.state.renderer_ex_regs, list, list_len, last_cmd);
+    bandsResync();
+    return ret;
+  }
+
+  if (len > 0)
+    bandsQueue(list, len);
+  return gpu_cmd_list(gpu.state.renderer_ex_regs, list, list_len, last_cmd);
+}
+#endif // GPU_UNAI_USE_BANDS
+
+int do_cmd_list(unsigned int *list, int list_len, int *last_cmd)
+{
+#ifdef GPU_UNAI_USE_BANDS
+  if (bands.count > 1)
+    return bandsCmdList(list, list_len, last_cmd);
+#endif
+  return gpu_cmd_list(gpu.state.renderer_ex_regs, list, list_len, last_cmd);
+}
+
 void renderer_sync_ecmds(uint32_t *ecmds)
 {
   int dummy;
@@ -611,10 +1238,14 @@ void renderer_sync_ecmds(uint32_t *ecmds)
 
 void renderer_update_caches(int x, int y, int w, int h)
 {
+  texCacheInvalidate(x, y, w, h);
 }
 
 void renderer_flush_queues(void)
 {
+#ifdef GPU_UNAI_USE_BANDS
+  bandsFlush();
+#endif
 }
 
 void renderer_set_interlace(int enable, int is_odd)
@@ -624,7 +1255,15 @@ void renderer_set_interlace(int enable, int is_odd)
 // Handle any gpulib settings applicable to gpu_unai:
 void renderer_set_config(const gpulib_config_t *config)
 {
+#ifdef GPU_UNAI_USE_BANDS
+  bandsFlush();
+#endif
   gpu_unai.vram = (u16*)gpu.vram;
+  texCacheFlush();
+#ifdef GPU_UNAI_USE_BANDS
+  if (bands.count > 1)
+    bandsResync();
+#endif
 }
 
 // vim:shiftwidth=2:expandtab
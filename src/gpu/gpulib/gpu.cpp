@@ -11,8 +11,11 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <pthread.h>
+#include <zlib.h>
 #include "plugins.h"    // For GPUFreeze_t, GPUScreenInfo_t
 #include "gpu.h"
+#include "gpu_capture.h"
 #include "plugin_lib.h"
 
 #define ARRAY_SIZE(x) (sizeof(x) / sizeof((x)[0]))
@@ -39,6 +42,360 @@ gpulib_config_t gpulib_config;
 
 static noinline int do_cmd_buffer(uint32_t *data, int count);
 static void finish_vram_transfer(int is_read);
+static void mark_rows(int y, int h);
+static void mark_cmd_rows(const uint32_t *data, int count, const uint32_t *ex_regs);
+
+/* Threaded rendering (Config.GpuThread)
+ *
+ * Commands are still parsed here on the emulation thread, which keeps all
+ * state the CPU can see (status, E-regs, GPUREAD, DMA transfers, frameskip).
+ * Only the renderer calls are deferred: complete commands, VRAM write lines
+ * and other renderer_*() calls are copied into a single-producer/single-
+ * consumer ring and executed in order by a worker. The emulation thread
+ * waits for the worker only when something reads VRAM: VRAM-to-CPU
+ * transfers, savestates, screen info and vout_update().
+ */
+#define RING_SIZE      (128 * 1024)  // words, power of two
+#define RING_MASK      (RING_SIZE - 1)
+#define RING_MAX_ITEM  (16 * 1024)   // command lists are split to this size
+#define RING_KICK      2048          // wake worker every this many words
+
+enum {
+  RING_CMDS = 1,       // complete commands for do_cmd_list()
+  RING_VRAM_LINE,      // x, y | len << 16, pixels
+  RING_SYNC_ECMDS,     // ex_regs[0..7]
+  RING_UPDATE_CACHES,  // x, y, w, h
+  RING_FLUSH_QUEUES,
+  RING_SET_INTERLACE,  // enable, is_odd
+  RING_WRAP            // rest of ring unused, continue from start
+};
+
+static struct {
+  uint32_t *ring;
+  uint32_t head;          // published write position, emu thread only
+  uint32_t tail;          // read position, worker only
+  uint32_t wr;            // unpublished write position
+  int worker_idle;        // worker sleeps (or is about to) on cond_work
+  int emu_waiting;        // emu thread sleeps (or is about to) on cond_done
+  int quit;
+  int active;
+  uint32_t tpage;         // texpage bits renderer will leave in ex_regs[1]
+  uint32_t ex_regs[8];    // renderer's own E-reg writes go here
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t cond_work;
+  pthread_cond_t cond_done;
+} gpu_thread;
+
+#define ring_load(p)     __atomic_load_n((p), __ATOMIC_SEQ_CST)
+#define ring_store(p, v) __atomic_store_n((p), (v), __ATOMIC_SEQ_CST)
+
+static void gpu_thread_exec(int type, uint32_t *item, int len)
+{
+  int dummy;
+
+  switch (type) {
+    case RING_CMDS:
+      do_cmd_list(item, len, &dummy);
+      break;
+    case RING_VRAM_LINE:
+      memcpy(&gpu.vram[(item[1] & 0xffff) * 1024 + item[0]], item + 2,
+             (item[1] >> 16) * 2);
+      break;
+    case RING_SYNC_ECMDS:
+      renderer_sync_ecmds(item);
+      break;
+    case RING_UPDATE_CACHES:
+      renderer_update_caches(item[0], item[1], item[2], item[3]);
+      break;
+    case RING_FLUSH_QUEUES:
+      renderer_flush_queues();
+      break;
+    case RING_SET_INTERLACE:
+      renderer_set_interlace(item[0], item[1]);
+      break;
+  }
+}
+
+static void *gpu_thread_main(void *arg)
+{
+  uint32_t tail = gpu_thread.tail;
+
+  for (;;) {
+    if (tail == ring_load(&gpu_thread.head)) {
+      pthread_mutex_lock(&gpu_thread.lock);
+      ring_store(&gpu_thread.worker_idle, 1);
+      while (tail == ring_load(&gpu_thread.head) && !gpu_thread.quit)
+        pthread_cond_wait(&gpu_thread.cond_work, &gpu_thread.lock);
+      ring_store(&gpu_thread.worker_idle, 0);
+      pthread_mutex_unlock(&gpu_thread.lock);
+      if (tail == ring_load(&gpu_thread.head))
+        break; // quit, and everything is drawn
+      continue;
+    }
+
+    uint32_t *item = &gpu_thread.ring[tail & RING_MASK];
+    int type = item[0] >> 24;
+    int len = item[0] & 0xffffff;
+    if (type == RING_WRAP)
+      tail += RING_SIZE - (tail & RING_MASK);
+    else {
+      gpu_thread_exec(type, item + 1, len);
+      tail += 1 + len;
+    }
+
+    ring_store(&gpu_thread.tail, tail);
+    if (ring_load(&gpu_thread.emu_waiting)) {
+      pthread_mutex_lock(&gpu_thread.lock);
+      pthread_cond_signal(&gpu_thread.cond_done);
+      pthread_mutex_unlock(&gpu_thread.lock);
+    }
+  }
+
+  return NULL;
+}
+
+// Publish everything written so far to the worker
+static void gpu_thread_kick(void)
+{
+  if (gpu_thread.wr == gpu_thread.head)
+    return;
+  ring_store(&gpu_thread.head, gpu_thread.wr);
+  if (ring_load(&gpu_thread.worker_idle)) {
+    pthread_mutex_lock(&gpu_thread.lock);
+    pthread_cond_signal(&gpu_thread.cond_work);
+    pthread_mutex_unlock(&gpu_thread.lock);
+  }
+}
+
+// Wait until there are at least 'space' free words in ring
+static void gpu_thread_wait(uint32_t space)
+{
+  if (RING_SIZE - (gpu_thread.wr - ring_load(&gpu_thread.tail)) >= space)
+    return;
+
+  gpu_thread_kick();
+  pthread_mutex_lock(&gpu_thread.lock);
+  ring_store(&gpu_thread.emu_waiting, 1);
+  while (RING_SIZE - (gpu_thread.wr - ring_load(&gpu_thread.tail)) < space)
+    pthread_cond_wait(&gpu_thread.cond_done, &gpu_thread.lock);
+  ring_store(&gpu_thread.emu_waiting, 0);
+  pthread_mutex_unlock(&gpu_thread.lock);
+}
+
+// Wait for worker to finish everything queued, before touching VRAM or
+//  renderer state from emu thread
+static void gpu_thread_sync(void)
+{
+  if (gpu_thread.active)
+    gpu_thread_wait(RING_SIZE);
+}
+
+static uint32_t *ring_alloc(int type, int len)
+{
+  uint32_t pos = gpu_thread.wr & RING_MASK;
+
+  if (pos + 1 + len > RING_SIZE) {
+    gpu_thread_wait(RING_SIZE - pos + 1 + len);
+    gpu_thread.ring[pos] = RING_WRAP << 24;
+    gpu_thread.wr += RING_SIZE - pos;
+    pos = 0;
+  }
+  else
+    gpu_thread_wait(1 + len);
+
+  gpu_thread.ring[pos] = (type << 24) | len;
+  return &gpu_thread.ring[pos + 1];
+}
+
+static void ring_commit(int len)
+{
+  gpu_thread.wr += 1 + len;
+  if (gpu_thread.wr - gpu_thread.head >= RING_KICK)
+    gpu_thread_kick();
+}
+
+// Parse a command list the way renderer's do_cmd_list() does and queue the
+//  complete commands. Updates gpulib state like the renderer would.
+static noinline int gpu_thread_cmd_list(uint32_t *list, int count, int *last_cmd)
+{
+  int cmd = 0, pos = 0, len, v;
+
+  while (pos < count) {
+    uint32_t *p = list + pos;
+    cmd = p[0] >> 24;
+    if (cmd == 0xa0 || cmd == 0xc0)
+      break; // image i/o, handled by do_cmd_buffer()
+
+    len = 1 + cmd_lengths[cmd];
+    if (pos + len > count) {
+      cmd = -1;
+      break;
+    }
+
+    if ((cmd & 0xf8) == 0x48 || (cmd & 0xf8) == 0x58) {
+      // poly-line, ends with a terminator word
+      for (v = len - 1; pos + v < count; v += 1 + ((cmd >> 4) & 1))
+        if ((p[v] & 0xf000f000) == 0x50005000)
+          break;
+      if (pos + v >= count) {
+        cmd = -1;
+        break;
+      }
+      len = v + 1;
+    }
+
+    if (pos > 0 && pos + len > RING_MAX_ITEM)
+      break; // rest goes to next item
+
+    if ((cmd & 0xe4) == 0x24) // textured polys
+      gpu_thread.tpage = (p[4 + ((cmd >> 4) & 1)] >> 16) & 0x1ff;
+    else if (cmd >= 0xe1 && cmd <= 0xe6) {
+      gpu.ex_regs[cmd & 7] = p[0];
+      if (cmd == 0xe1)
+        gpu_thread.tpage = p[0] & 0x1ff;
+    }
+
+    pos += len;
+  }
+
+  gpu.ex_regs[1] &= ~0x1ff;
+  gpu.ex_regs[1] |= gpu_thread.tpage;
+
+  if (pos > RING_MAX_ITEM) {
+    // one huge poly-line, draw it here
+    int dummy;
+    gpu_thread_sync();
+    do_cmd_list(list, pos, &dummy);
+  }
+  else if (pos > 0) {
+    memcpy(ring_alloc(RING_CMDS, pos), list, pos * 4);
+    ring_commit(pos);
+  }
+
+  *last_cmd = cmd;
+  return pos;
+}
+
+static void gpu_thread_start(void)
+{
+  if (gpu_thread.active)
+    return;
+
+  gpu_thread.ring = (uint32_t *)malloc(RING_SIZE * 4);
+  if (gpu_thread.ring == NULL)
+    goto fail;
+  gpu_thread.head = gpu_thread.tail = gpu_thread.wr = 0;
+  gpu_thread.worker_idle = gpu_thread.emu_waiting = gpu_thread.quit = 0;
+  gpu_thread.tpage = gpu.ex_regs[1] & 0x1ff;
+
+  if (pthread_mutex_init(&gpu_thread.lock, NULL))
+    goto fail_mutex;
+  if (pthread_cond_init(&gpu_thread.cond_work, NULL))
+    goto fail_cond_work;
+  if (pthread_cond_init(&gpu_thread.cond_done, NULL))
+    goto fail_cond_done;
+  if (pthread_create(&gpu_thread.thread, NULL, gpu_thread_main, NULL))
+    goto fail_thread;
+
+  gpu.state.renderer_ex_regs = gpu_thread.ex_regs;
+  gpu_thread.active = 1;
+  printf("GPU: rendering on worker thread\n");
+  return;
+
+fail_thread:
+  pthread_cond_destroy(&gpu_thread.cond_done);
+fail_cond_done:
+  pthread_cond_destroy(&gpu_thread.cond_work);
+fail_cond_work:
+  pthread_mutex_destroy(&gpu_thread.lock);
+fail_mutex:
+  free(gpu_thread.ring);
+  gpu_thread.ring = NULL;
+fail:
+  printf("GPU: failed to start worker thread, rendering synchronously\n");
+}
+
+static void gpu_thread_stop(void)
+{
+  if (!gpu_thread.active)
+    return;
+
+  gpu_thread_kick();
+  pthread_mutex_lock(&gpu_thread.lock);
+  gpu_thread.quit = 1;
+  pthread_cond_signal(&gpu_thread.cond_work);
+  pthread_mutex_unlock(&gpu_thread.lock);
+  pthread_join(gpu_thread.thread, NULL);
+
+  pthread_cond_destroy(&gpu_thread.cond_done);
+  pthread_cond_destroy(&gpu_thread.cond_work);
+  pthread_mutex_destroy(&gpu_thread.lock);
+  free(gpu_thread.ring);
+  gpu_thread.ring = NULL;
+
+  gpu.state.renderer_ex_regs = gpu.ex_regs;
+  gpu_thread.active = 0;
+}
+
+// Renderer entry points used by gpulib, queued when threaded
+
+static int gpu_cmd_list(uint32_t *list, int count, int *last_cmd)
+{
+  uint32_t ex_regs[8];
+  int done;
+
+  memcpy(ex_regs, gpu.ex_regs, sizeof(ex_regs));
+  if (gpu_thread.active)
+    done = gpu_thread_cmd_list(list, count, last_cmd);
+  else
+    done = do_cmd_list(list, count, last_cmd);
+  mark_cmd_rows(list, done, ex_regs);
+  return done;
+}
+
+static void gpu_sync_ecmds(void)
+{
+  if (gpu_thread.active) {
+    memcpy(ring_alloc(RING_SYNC_ECMDS, 8), gpu.ex_regs, sizeof(gpu.ex_regs));
+    ring_commit(8);
+    gpu_thread.tpage = gpu.ex_regs[1] & 0x1ff;
+  }
+  else
+    renderer_sync_ecmds(gpu.ex_regs);
+}
+
+static void gpu_update_caches(int x, int y, int w, int h)
+{
+  if (gpu_thread.active) {
+    uint32_t *item = ring_alloc(RING_UPDATE_CACHES, 4);
+    item[0] = x; item[1] = y; item[2] = w; item[3] = h;
+    ring_commit(4);
+  }
+  else
+    renderer_update_caches(x, y, w, h);
+}
+
+static void gpu_flush_queues(void)
+{
+  if (gpu_thread.active) {
+    ring_alloc(RING_FLUSH_QUEUES, 0);
+    ring_commit(0);
+  }
+  else
+    renderer_flush_queues();
+}
+
+static void gpu_set_interlace(int enable, int is_odd)
+{
+  if (gpu_thread.active) {
+    uint32_t *item = ring_alloc(RING_SET_INTERLACE, 2);
+    item[0] = enable; item[1] = is_odd;
+    ring_commit(2);
+  }
+  else
+    renderer_set_interlace(enable, is_odd);
+}
 
 static noinline void do_cmd_reset(void)
 {
@@ -120,7 +477,7 @@ static noinline void decide_frameskip(void)
 
   if (!gpu.frameskip.active && gpu.frameskip.pending_fill[0] != 0) {
     int dummy;
-    do_cmd_list(gpu.frameskip.pending_fill, 3, &dummy);
+    gpu_cmd_list(gpu.frameskip.pending_fill, 3, &dummy);
     gpu.frameskip.pending_fill[0] = 0;
   }
 }
@@ -207,6 +564,147 @@ static int allocate_vram(void)
 }
 #endif
 
+/* Command stream capture (gpulib_capture_start(), see gpu_capture.h)
+ *
+ * Plugin calls are recorded as the emulator makes them, before anything is
+ * parsed: DMA chains and GPU_writeData() can leave partial commands that
+ * are later discarded or completed, so the raw calls are what replays
+ * exactly. Capture starts from a savestate image, a VRAM transfer that is
+ * in progress at that moment is not recorded.
+ */
+#define CAPTURE_BUF_LEN  (16 * 1024)  // words
+
+static struct {
+  gzFile f;
+  int paused;     // GPU_freeze() load, state is recorded instead
+  int len;        // words in buf
+  int last;       // last record in buf, -1 if buf was written out since
+  uint32_t frames;
+  uint32_t buf[CAPTURE_BUF_LEN];
+} capture;
+
+#define capturing() unlikely(capture.f != NULL && !capture.paused)
+
+static void capture_write(const void *data, int count)
+{
+  if (capture.f == NULL || count == 0)
+    return;
+  if (gzwrite(capture.f, data, count * 4) != count * 4) {
+    printf("ERROR: GPU capture write failed, capture stopped\n");
+    gzclose(capture.f);
+    capture.f = NULL;
+  }
+}
+
+static void capture_flush(void)
+{
+  capture_write(capture.buf, capture.len);
+  capture.len = 0;
+  capture.last = -1;
+}
+
+// Record 'count' words of 'type' (GPU_CAP_READ: 'count' words were read)
+static noinline void capture_cmd(int type, const uint32_t *data, int count)
+{
+  uint32_t *last = capture.last >= 0 ? &capture.buf[capture.last] : NULL;
+  uint32_t n;
+
+  if (type == GPU_CAP_READ) {
+    if (last && GPU_CAP_TYPE(*last) == GPU_CAP_READ) {
+      last[1] += count;
+      return;
+    }
+    n = count;
+    data = &n;
+    count = 1;
+  }
+  else if ((type == GPU_CAP_GP0 || type == GPU_CAP_GP1) && last
+           && GPU_CAP_TYPE(*last) == type
+           && capture.len + count <= CAPTURE_BUF_LEN) {
+    memcpy(capture.buf + capture.len, data, count * 4);
+    capture.len += count;
+    *last += count;
+    return;
+  }
+
+  if (capture.len + 1 + count > CAPTURE_BUF_LEN)
+    capture_flush();
+  if (1 + count > CAPTURE_BUF_LEN) {
+    n = GPU_CAP_HEADER(type, count);
+    capture_write(&n, 1);
+    capture_write(data, count);
+    return;
+  }
+  capture.last = capture.len;
+  capture.buf[capture.len++] = GPU_CAP_HEADER(type, count);
+  if (count)
+    memcpy(capture.buf + capture.len, data, count * 4);
+  capture.len += count;
+}
+
+static void capture_state(const GPUFreeze_t *freeze)
+{
+  uint32_t hdr = GPU_CAP_HEADER(GPU_CAP_STATE, GPU_CAP_STATE_LEN);
+
+  capture_flush();
+  capture_write(&hdr, 1);
+  capture_write(&freeze->ulStatus, 1);
+  capture_write(freeze->ulControl, 256);
+  capture_write(freeze->psxVRam, 1024 * 512 / 2);
+}
+
+int gpulib_capture_start(const char *path)
+{
+  static const uint32_t header[2] = { GPU_CAPTURE_MAGIC, GPU_CAPTURE_VERSION };
+  GPUFreeze_t *freeze;
+
+  gpulib_capture_stop();
+
+  freeze = (GPUFreeze_t*)malloc(sizeof(*freeze));
+  if (freeze == NULL)
+    return -1;
+  GPU_freeze(1, freeze);
+
+  // zlib's fastest level, emulation must keep running at full speed
+  capture.f = gzopen(path, "wb1");
+  if (capture.f == NULL) {
+    printf("ERROR: could not open GPU capture file %s\n", path);
+    free(freeze);
+    return -1;
+  }
+  capture.paused = 0;
+  capture.len = 0;
+  capture.last = -1;
+  capture.frames = 0;
+
+  capture_write(header, 2);
+  capture_state(freeze);
+  free(freeze);
+
+  // partial command still waiting in cmd_buffer
+  if (gpu.cmd_len > 0)
+    capture_cmd(GPU_CAP_GP0, gpu.cmd_buffer, gpu.cmd_len);
+
+  if (capture.f == NULL)
+    return -1;
+  printf("GPU capture: recording to %s\n", path);
+  return 0;
+}
+
+void gpulib_capture_stop(void)
+{
+  if (capture.f == NULL)
+    return;
+  capture_flush();
+  if (capture.f == NULL)
+    return;
+  if (gzclose(capture.f) != Z_OK)
+    printf("ERROR: GPU capture write failed\n");
+  else
+    printf("GPU capture: %u frames recorded\n", capture.frames);
+  capture.f = NULL;
+}
+
 long GPU_init(void)
 {
 #ifndef GPULIB_USE_MMAP
@@ -222,6 +720,7 @@ long GPU_init(void)
   extern uint32_t frame_counter;      // in psxcounters.cpp
   gpu.state.hcnt = &hSyncCount;
   gpu.state.frame_count = &frame_counter;
+  gpu.state.renderer_ex_regs = gpu.ex_regs;
 
   gpulib_frameskip_prepare();
 
@@ -233,11 +732,16 @@ long GPU_init(void)
   gpu.cmd_len = 0;
   do_reset();
 
+  if (Config.GpuThread)
+    gpu_thread_start();
+
   return ret;
 }
 
 long GPU_shutdown(void)
 {
+  gpulib_capture_stop();
+  gpu_thread_stop();
   renderer_finish();
   long ret = vout_finish();
 
@@ -264,6 +768,9 @@ void GPU_writeStatus(uint32_t data)
   static const short vres[4] = { 240, 480, 256, 480 };
   uint32_t cmd = data >> 24;
 
+  if (capturing())
+    capture_cmd(GPU_CAP_GP1, &data, 1);
+
   if (cmd < ARRAY_SIZE(gpu.regs)) {
     if (cmd > 1 && cmd != 5 && gpu.regs[cmd] == data)
       return;
@@ -314,6 +821,8 @@ void GPU_writeStatus(uint32_t data)
       update_width();
       update_height();
       update_window_size(gpu.screen.hres, gpu.screen.vres, Config.PsxType == PSX_TYPE_NTSC);
+      mark_rows(0, 512); // window was cleared
+      gpu_thread_sync();
       renderer_notify_res_change();
       break;
     default:
@@ -351,6 +860,18 @@ const unsigned char cmd_lengths[256] =
 
 static inline void do_vram_line(int x, int y, uint16_t *mem, int l, int is_read)
 {
+  if (!is_read)
+    mark_rows(y, 1);
+
+  if (gpu_thread.active && !is_read) {
+    uint32_t *item = ring_alloc(RING_VRAM_LINE, 2 + (l + 1) / 2);
+    item[0] = x;
+    item[1] = y | (l << 16);
+    memcpy(item + 2, mem, l * 2);
+    ring_commit(2 + (l + 1) / 2);
+    return;
+  }
+
   uint16_t *vram = VRAM_MEM_XY(x, y);
   if (is_read)
     memcpy(mem, vram, l * 2);
@@ -368,6 +889,9 @@ static int do_vram_io(uint32_t *data, int count, int is_read)
   int l;
   count *= 2; // operate in 16bpp pixels
 
+  if (is_read)
+    gpu_thread_sync();
+
   if (gpu.dma.offset) {
     l = w - gpu.dma.offset;
     if (count < l)
@@ -421,8 +945,9 @@ static void start_vram_transfer(uint32_t pos_word, uint32_t size_word, int is_re
   gpu.dma.is_read = is_read;
   gpu.dma_start = gpu.dma;
 
-  renderer_flush_queues();
+  gpu_flush_queues();
   if (is_read) {
+    gpu_thread_sync();
     gpu.status.img = 1;
     // XXX: wrong for width 1
     memcpy(&gpu.gp0, VRAM_MEM_XY(gpu.dma.x, gpu.dma.y), 4);
@@ -438,7 +963,7 @@ static void finish_vram_transfer(int is_read)
   if (is_read)
     gpu.status.img = 0;
   else
-    renderer_update_caches(gpu.dma_start.x, gpu.dma_start.y,
+    gpu_update_caches(gpu.dma_start.x, gpu.dma_start.y,
                            gpu.dma_start.w, gpu.dma_start.h);
 }
 
@@ -458,7 +983,7 @@ static noinline int do_cmd_list_skip(uint32_t *data, int count, int *last_cmd)
       case 0x02:
         if ((int)(list[2] & 0x3ff) > gpu.screen.w || (int)((list[2] >> 16) & 0x1ff) > gpu.screen.h)
           // clearing something large, don't skip
-          do_cmd_list(list, 3, &dummy);
+          gpu_cmd_list(list, 3, &dummy);
         else
           memcpy(gpu.frameskip.pending_fill, list, 3 * 4);
         break;
@@ -503,11 +1028,220 @@ static noinline int do_cmd_list_skip(uint32_t *data, int count, int *last_cmd)
     pos += len;
   }
 
-  renderer_sync_ecmds(gpu.ex_regs);
+  gpu_sync_ecmds();
   *last_cmd = cmd;
   return pos;
 }
 
+/* Estimated CPU cycles the GPU spends drawing a list of complete commands,
+ * from primitive sizes. Used by the core to emulate the GPUSTAT busy bit,
+ * so doesn't depend on frameskip. Very rough: ~2 pixels per cycle for
+ * untextured, 1 per cycle for textured/blended primitives. */
+static inline int tri_area2(uint32_t v0, uint32_t v1, uint32_t v2)
+{
+  int x0 = (int16_t)(v0 << 5) >> 5, y0 = (int16_t)(v0 >> 11) >> 5;
+  int x1 = (int16_t)(v1 << 5) >> 5, y1 = (int16_t)(v1 >> 11) >> 5;
+  int x2 = (int16_t)(v2 << 5) >> 5, y2 = (int16_t)(v2 >> 11) >> 5;
+  int a = (x1 - x0) * (y2 - y0) - (x2 - x0) * (y1 - y0);
+  return a < 0 ? -a : a;
+}
+
+static inline int line_len(uint32_t v0, uint32_t v1)
+{
+  int dx = ((int16_t)(v1 << 5) >> 5) - ((int16_t)(v0 << 5) >> 5);
+  int dy = ((int16_t)(v1 >> 11) >> 5) - ((int16_t)(v0 >> 11) >> 5);
+  if (dx < 0) dx = -dx;
+  if (dy < 0) dy = -dy;
+  return dx > dy ? dx : dy;
+}
+
+static uint32_t estimate_draw_cycles(const uint32_t *data, int count)
+{
+  uint32_t cycles = 0;
+  int pos, len, v, w, h, pixels;
+
+  for (pos = 0; pos < count; pos += len) {
+    const uint32_t *list = data + pos;
+    int cmd = list[0] >> 24;
+    int slow = (cmd & 0x06) != 0; // textured and/or semi-transparent
+    len = 1 + cmd_lengths[cmd];
+    pixels = 0;
+
+    switch (cmd) {
+      case 0x02:
+        w = list[2] & 0x3ff;
+        h = (list[2] >> 16) & 0x1ff;
+        cycles += 23 + (4 + w / 16) * h;
+        break;
+      case 0x20 ... 0x3f: {
+        int stride = 1 + ((cmd >> 2) & 1) + ((cmd >> 4) & 1);
+        pixels = tri_area2(list[1], list[1 + stride], list[1 + 2 * stride]);
+        if (cmd & 0x08)
+          pixels += tri_area2(list[1 + stride], list[1 + 2 * stride], list[1 + 3 * stride]);
+        pixels /= 2;
+        cycles += (cmd & 0x10) ? 90 : 30;
+        break;
+      }
+      case 0x40 ... 0x47:
+        pixels = line_len(list[1], list[2]);
+        slow = 1;
+        cycles += 16;
+        break;
+      case 0x50 ... 0x57:
+        pixels = line_len(list[1], list[3]);
+        slow = 1;
+        cycles += 16;
+        break;
+      case 0x48 ... 0x4f:
+        pixels = line_len(list[1], list[2]);
+        for (v = 3; pos + v < count && (list[v] & 0xf000f000) != 0x50005000; v++)
+          pixels += line_len(list[v - 1], list[v]);
+        len += v - 3;
+        slow = 1;
+        cycles += 16;
+        break;
+      case 0x58 ... 0x5f:
+        pixels = line_len(list[1], list[3]);
+        for (v = 4; pos + v + 1 < count && (list[v] & 0xf000f000) != 0x50005000; v += 2)
+          pixels += line_len(list[v - 1], list[v + 1]);
+        len += v - 4;
+        slow = 1;
+        cycles += 16;
+        break;
+      case 0x60 ... 0x7f:
+        switch ((cmd >> 3) & 3) {
+          case 0: v = list[2 + ((cmd >> 2) & 1)]; w = v & 0x3ff; h = (v >> 16) & 0x1ff; break;
+          case 1: w = h = 1; break;
+          case 2: w = h = 8; break;
+          default: w = h = 16; break;
+        }
+        pixels = w * h;
+        cycles += 8;
+        break;
+      case 0x80 ... 0x9f:
+        w = list[3] & 0x3ff;
+        h = (list[3] >> 16) & 0x1ff;
+        cycles += (w ? w : 0x400) * (h ? h : 0x200);
+        break;
+      default:
+        break;
+    }
+
+    if (pixels > 1024 * 512)
+      pixels = 1024 * 512;
+    cycles += slow ? pixels : pixels / 2;
+  }
+
+  return cycles;
+}
+
+/* VRAM dirty rows, so vout_update() only converts rows that changed.
+ * Marked from the commands themselves, which works the same for any
+ * renderer and in threaded mode. Rows are a superset of what's drawn:
+ * primitives mark their vertical extent clipped to the drawing area. */
+static void mark_rows(int y, int h)
+{
+  if (h >= 512) {
+    memset(gpu.state.dirty_rows, 0xff, sizeof(gpu.state.dirty_rows));
+    return;
+  }
+  for (y &= 511; h > 0; h--, y = (y + 1) & 511)
+    gpu.state.dirty_rows[y >> 5] |= 1u << (y & 31);
+}
+
+static void mark_prim_rows(int ymin, int ymax, int area_y0, int area_y1)
+{
+  if (ymin < area_y0) ymin = area_y0;
+  if (ymax > area_y1) ymax = area_y1;
+  if (ymin <= ymax)
+    mark_rows(ymin, ymax - ymin + 1);
+}
+
+static inline int vertex_y(uint32_t v)
+{
+  return (int16_t)(v >> 11) >> 5;
+}
+
+static void mark_cmd_rows(const uint32_t *data, int count, const uint32_t *ex_regs)
+{
+  int area_y0 = (ex_regs[3] >> 10) & 0x3ff;
+  int area_y1 = (ex_regs[4] >> 10) & 0x3ff;
+  int offs_y  = (int32_t)(ex_regs[5] << 10) >> 21;
+  int pos, len, v, y, ymin, ymax, h;
+
+  if (area_y1 > 511) area_y1 = 511;
+
+  for (pos = 0; pos < count; pos += len) {
+    const uint32_t *list = data + pos;
+    int cmd = list[0] >> 24;
+    len = 1 + cmd_lengths[cmd];
+
+    switch (cmd) {
+      case 0x02:
+        mark_rows(list[1] >> 16, (list[2] >> 16) & 0x3ff);
+        break;
+      case 0x20 ... 0x3f: {
+        int stride = 1 + ((cmd >> 2) & 1) + ((cmd >> 4) & 1);
+        int verts = (cmd & 0x08) ? 4 : 3;
+        ymin = ymax = vertex_y(list[1]);
+        for (v = 1; v < verts; v++) {
+          y = vertex_y(list[1 + v * stride]);
+          if (y < ymin) ymin = y;
+          if (y > ymax) ymax = y;
+        }
+        mark_prim_rows(ymin + offs_y, ymax + offs_y, area_y0, area_y1);
+        break;
+      }
+      case 0x40 ... 0x5f: {
+        // gouraud lines have a color word before each vertex after the first
+        int step = 1 + ((cmd >> 4) & 1);
+        ymin = ymax = vertex_y(list[1]);
+        for (v = 1 + step; pos + v - step + 1 < count; v += step) {
+          if (v > 1 + step) {
+            if (!(cmd & 0x08))
+              break;
+            if ((list[v - step + 1] & 0xf000f000) == 0x50005000) {
+              len = v - step + 2; // poly-line, ends with a terminator word
+              break;
+            }
+          }
+          if (pos + v >= count)
+            break;
+          y = vertex_y(list[v]);
+          if (y < ymin) ymin = y;
+          if (y > ymax) ymax = y;
+        }
+        mark_prim_rows(ymin + offs_y, ymax + offs_y, area_y0, area_y1);
+        break;
+      }
+      case 0x60 ... 0x7f:
+        switch ((cmd >> 3) & 3) {
+          case 0: h = (list[2 + ((cmd >> 2) & 1)] >> 16) & 0x1ff; break;
+          case 1: h = 1; break;
+          case 2: h = 8; break;
+          default: h = 16; break;
+        }
+        y = vertex_y(list[1]) + offs_y;
+        mark_prim_rows(y, y + h - 1, area_y0, area_y1);
+        break;
+      case 0x80 ... 0x9f:
+        h = (list[3] >> 16) & 0x1ff;
+        mark_rows(list[2] >> 16, h ? h : 512);
+        break;
+      case 0xe3:
+        area_y0 = (list[0] >> 10) & 0x3ff;
+        break;
+      case 0xe4:
+        area_y1 = (list[0] >> 10) & 0x3ff;
+        if (area_y1 > 511) area_y1 = 511;
+        break;
+      case 0xe5:
+        offs_y = (int32_t)(list[0] << 10) >> 21;
+        break;
+    }
+  }
+}
+
 static noinline int do_cmd_buffer(uint32_t *data, int count)
 {
   int cmd, pos;
@@ -533,12 +1267,15 @@ static noinline int do_cmd_buffer(uint32_t *data, int count)
     }
 
     // 0xex cmds might affect frameskip.allow, so pass to do_cmd_list_skip
+    int done;
     if (gpu.frameskip.active && (gpu.frameskip.allow || ((data[pos] >> 24) & 0xf0) == 0xe0))
-      pos += do_cmd_list_skip(data + pos, count - pos, &cmd);
+      done = do_cmd_list_skip(data + pos, count - pos, &cmd);
     else {
-      pos += do_cmd_list(data + pos, count - pos, &cmd);
+      done = gpu_cmd_list(data + pos, count - pos, &cmd);
       vram_dirty = 1;
     }
+    gpu.state.draw_cycles += estimate_draw_cycles(data + pos, done);
+    pos += done;
 
     if (cmd == -1)
       // incomplete cmd
@@ -563,6 +1300,7 @@ static void flush_cmd_buffer(void)
   if (left > 0)
     memmove(gpu.cmd_buffer, gpu.cmd_buffer + gpu.cmd_len - left, left * 4);
   gpu.cmd_len = left;
+  gpu_thread_kick();
 }
 
 void GPU_writeDataMem(uint32_t *mem, int count)
@@ -571,41 +1309,203 @@ void GPU_writeDataMem(uint32_t *mem, int count)
 
   log_io("gpu_dma_write %p %d\n", mem, count);
 
+  if (capturing())
+    capture_cmd(GPU_CAP_GP0_MEM, mem, count);
+
   if (unlikely(gpu.cmd_len > 0))
     flush_cmd_buffer();
 
   left = do_cmd_buffer(mem, count);
   if (left)
     log_anomaly("GPUwriteDataMem: discarded %d/%d words\n", left, count);
+  gpu_thread_kick();
 }
 
 void GPU_writeData(uint32_t data)
 {
   log_io("gpu_write %08x\n", data);
+  if (capturing())
+    capture_cmd(GPU_CAP_GP0, &data, 1);
   gpu.cmd_buffer[gpu.cmd_len++] = data;
   if (gpu.cmd_len >= CMD_BUFFER_LEN)
     flush_cmd_buffer();
 }
 
+/* DMA chain walking
+ *
+ * Most of an ordering table is empty entries, each linking to its
+ * neighbour. Tables seen by earlier walks are remembered, and inside them
+ * runs of empty entries are skipped in bulk: checking that entries are
+ * still empty is a sequential read of RAM instead of a chain of dependent
+ * loads. The tables are only hints, every skipped entry is checked.
+ */
+#define DMA_TABLES     4
+#define DMA_TABLE_MIN  16    // fewer entries are not remembered
+#define LD_THRESHOLD   (8*1024)
+
+struct dma_table {
+  uint32_t first, last;  // entry addresses, in walk order
+  int step;              // +-4, address of next entry
+  int count;
+};
+
+static struct dma_table dma_tables[DMA_TABLES];
+static int dma_table_replace;
+
+// visited entries, for loop detection after LD_THRESHOLD entries
+static uint8_t dma_visited[0x200000 / 4 / 8];
+
+// entry after 'addr' is its neighbour in RAM too (no 2MB wrap)
+static inline int dma_next_adjacent(uint32_t addr, int step)
+{
+  return ((addr + step) & 0x1fffff) == (addr & 0x1fffff) + step;
+}
+
+// entries left in a remembered table, starting from 'addr', or 0
+static int dma_table_find(uint32_t addr, int *step)
+{
+  const struct dma_table *t;
+  int left;
+
+  for (t = dma_tables; t < dma_tables + DMA_TABLES; t++) {
+    if (t->count == 0 || ((addr ^ t->first) & 3))
+      continue;
+    left = (int)((t->step > 0 ? t->last - addr : addr - t->last) / 4) + 1;
+    if (left > 0 && left <= t->count) {
+      *step = t->step;
+      return left;
+    }
+  }
+  return 0;
+}
+
+static void dma_table_store(const struct dma_table *cur)
+{
+  struct dma_table *t;
+  int i;
+
+  if (cur->count < DMA_TABLE_MIN)
+    return;
+  // replace a table this one overlaps, or the oldest
+  for (i = 0; i < DMA_TABLES; i++) {
+    t = &dma_tables[i];
+    uint32_t lo = t->step > 0 ? t->first : t->last;
+    uint32_t hi = t->step > 0 ? t->last : t->first;
+    if (t->count && cur->first >= lo && cur->first <= hi)
+      break;
+  }
+  if (i == DMA_TABLES) {
+    i = dma_table_replace;
+    dma_table_replace = (i + 1) % DMA_TABLES;
+  }
+  dma_tables[i] = *cur;
+}
+
+// 'count' entries starting at 'addr' were walked in 'step' direction.
+// step == 0: an entry holding packets, or a packet itself.
+static void dma_table_track(struct dma_table *cur, uint32_t addr, int step, int count)
+{
+  int next = cur->count > 0 && addr == cur->last + cur->step
+             && dma_next_adjacent(cur->last, cur->step);
+  if (step == 0) {
+    // only entries are counted, packets are in between
+    if (next) {
+      cur->last = addr;
+      cur->count++;
+    }
+    return;
+  }
+  if (next && step == cur->step) {
+    cur->last = addr + (count - 1) * step;
+    cur->count += count;
+    return;
+  }
+  dma_table_store(cur);
+  cur->first = addr;
+  cur->last = addr + (count - 1) * step;
+  cur->step = step;
+  cur->count = count;
+}
+
+// how many entries, up to 'max', are empty and link to their neighbour
+static int dma_run_check(const uint32_t *rambase, uint32_t addr, int step, int max)
+{
+  const uint32_t *list = rambase + (addr & 0x1fffff) / 4;
+  uint32_t link = addr + step;
+  int i = 0, j;
+
+  // blocks of 8 entries, read in ascending order whatever the direction
+  for (; i + 8 <= max; i += 8) {
+    const uint32_t *b = step > 0 ? list + i : list - i - 7;
+    uint32_t expect = step > 0 ? link + i * 4 : link - (i + 7) * 4;
+    uint32_t diff = 0;
+    for (j = 0; j < 8; j++)
+      diff |= b[j] ^ (expect + j * 4);
+    if (diff)
+      break;
+  }
+  for (; i < max; i++)
+    if (list[i * step / 4] != link + i * step)
+      break;
+  return i;
+}
+
 long GPU_dmaChain(uint32_t *rambase, uint32_t start_addr)
 {
-  uint32_t addr, *list, ld_addr = 0;
-  int len, left, count;
+  uint32_t addr, next, *list;
+  struct dma_table table = { 0, 0, 0, 0 };
+  int len, left, count, step, n, visited = 0;
   long cpu_cycles = 0;
 
   preload(rambase + (start_addr & 0x1fffff) / 4);
 
-  if (unlikely(gpu.cmd_len > 0))
+  if (unlikely(gpu.cmd_len > 0)) {
+    if (capturing())
+      capture_cmd(GPU_CAP_FLUSH, NULL, 0);
     flush_cmd_buffer();
+  }
 
   log_io("gpu_dma_chain\n");
   addr = start_addr & 0xffffff;
-  for (count = 0; (addr & 0x800000) == 0; count++)
+  for (count = 0; (addr & 0x800000) == 0; )
   {
+    if (count >= LD_THRESHOLD) {
+      // (a real machine would loop forever)
+      uint32_t w = (addr & 0x1fffff) / 4;
+      if (dma_visited[w / 8] & (1 << (w & 7))) {
+        log_anomaly("GPUdmaChain: loop at %06x\n", addr);
+        break;
+      }
+      dma_visited[w / 8] |= 1 << (w & 7);
+      visited = 1;
+    }
+
     list = rambase + (addr & 0x1fffff) / 4;
     len = list[0] >> 24;
-    addr = list[0] & 0xffffff;
-    preload(rambase + (addr & 0x1fffff) / 4);
+    next = list[0] & 0xffffff;
+
+    // empty entry linking to its neighbour
+    step = next - addr;
+    if (len != 0 || (step != 4 && step != -4) || !dma_next_adjacent(addr, step))
+      step = 0;
+
+    if (step != 0 && count < LD_THRESHOLD) {
+      int table_step;
+      n = dma_table_find(addr, &table_step);
+      if (n > 1 && table_step == step) {
+        if (n > LD_THRESHOLD - count)
+          n = LD_THRESHOLD - count;
+        n = dma_run_check(rambase, addr, step, n);
+        dma_table_track(&table, addr, step, n);
+        addr += n * step;
+        preload(rambase + (addr & 0x1fffff) / 4);
+        cpu_cycles += 10 * n;
+        count += n;
+        continue;
+      }
+    }
+
+    preload(rambase + (next & 0x1fffff) / 4);
 
     cpu_cycles += 10;
     if (len > 0)
@@ -614,40 +1514,27 @@ long GPU_dmaChain(uint32_t *rambase, uint32_t start_addr)
     log_io(".chain %08x #%d\n", (list - rambase) * 4, len);
 
     if (len) {
+      if (capturing())
+        capture_cmd(GPU_CAP_GP0_MEM, list + 1, len);
       left = do_cmd_buffer(list + 1, len);
       if (left)
         log_anomaly("GPUdmaChain: discarded %d/%d words\n", left, len);
     }
 
-    #define LD_THRESHOLD (8*1024)
-    if (count >= LD_THRESHOLD) {
-      if (count == LD_THRESHOLD) {
-        ld_addr = addr;
-        continue;
-      }
-
-      // loop detection marker
-      // (bit23 set causes DMA error on real machine, so
-      //  unlikely to be ever set by the game)
-      list[0] |= 0x800000;
-    }
+    dma_table_track(&table, addr, step, 1);
+    addr = next;
+    count++;
   }
+  dma_table_store(&table);
 
-  if (ld_addr != 0) {
-    // remove loop detection markers
-    count -= LD_THRESHOLD + 2;
-    addr = ld_addr & 0x1fffff;
-    while (count-- > 0) {
-      list = rambase + addr / 4;
-      addr = list[0] & 0x1fffff;
-      list[0] &= ~0x800000;
-    }
-  }
+  if (visited)
+    memset(dma_visited, 0, sizeof(dma_visited));
 
   gpu.state.last_list.frame = *gpu.state.frame_count;
   gpu.state.last_list.hcnt = *gpu.state.hcnt;
   gpu.state.last_list.cycles = cpu_cycles;
   gpu.state.last_list.addr = start_addr;
+  gpu_thread_kick();
 
   return cpu_cycles;
 }
@@ -656,6 +1543,9 @@ void GPU_readDataMem(uint32_t *mem, int count)
 {
   log_io("gpu_dma_read  %p %d\n", mem, count);
 
+  if (capturing())
+    capture_cmd(GPU_CAP_READ, NULL, count);
+
   if (unlikely(gpu.cmd_len > 0))
     flush_cmd_buffer();
 
@@ -667,6 +1557,9 @@ uint32_t GPU_readData(void)
 {
   uint32_t ret;
 
+  if (capturing())
+    capture_cmd(GPU_CAP_READ, NULL, 1);
+
   if (unlikely(gpu.cmd_len > 0))
     flush_cmd_buffer();
 
@@ -678,12 +1571,25 @@ uint32_t GPU_readData(void)
   return ret;
 }
 
+// Returns estimated cycles of drawing done since last call (see
+//  estimate_draw_cycles()) and resets the count. Core uses this to keep
+//  GPUSTAT busy bit clear while GPU would still be drawing.
+uint32_t GPU_drawCycles(void)
+{
+  uint32_t ret = gpu.state.draw_cycles;
+  gpu.state.draw_cycles = 0;
+  return ret;
+}
+
 uint32_t GPU_readStatus(void)
 {
   uint32_t ret;
 
-  if (unlikely(gpu.cmd_len > 0))
+  if (unlikely(gpu.cmd_len > 0)) {
+    if (capturing())
+      capture_cmd(GPU_CAP_FLUSH, NULL, 0);
     flush_cmd_buffer();
+  }
 
   ret = gpu.status.reg;
   log_io("gpu_read_status %08x\n", ret);
@@ -694,17 +1600,27 @@ long GPU_freeze(uint32_t type, GPUFreeze_t *freeze)
 {
   int i;
 
+  if (type == 1 && gpu.cmd_len > 0) {
+    if (capturing())
+      capture_cmd(GPU_CAP_FLUSH, NULL, 0);
+    flush_cmd_buffer();
+  }
+  gpu_flush_queues();
+  gpu_thread_sync();
+
   switch (type) {
     case 1: // save
-      if (gpu.cmd_len > 0)
-        flush_cmd_buffer();
       memcpy(freeze->psxVRam, gpu.vram, 1024 * 512 * 2);
       memcpy(freeze->ulControl, gpu.regs, sizeof(gpu.regs));
       memcpy(freeze->ulControl + 0xe0, gpu.ex_regs, sizeof(gpu.ex_regs));
       freeze->ulStatus = gpu.status.reg;
       break;
     case 0: // load
+      if (capturing())
+        capture_state(freeze);
+      capture.paused++;
       memcpy(gpu.vram, freeze->psxVRam, 1024 * 512 * 2);
+      mark_rows(0, 512);
       memcpy(gpu.regs, freeze->ulControl, sizeof(gpu.regs));
       memcpy(gpu.ex_regs, freeze->ulControl + 0xe0, sizeof(gpu.ex_regs));
       gpu.status.reg = freeze->ulStatus;
@@ -713,8 +1629,9 @@ long GPU_freeze(uint32_t type, GPUFreeze_t *freeze)
         gpu.regs[i] ^= 1; // avoid reg change detection
         GPU_writeStatus((i << 24) | (gpu.regs[i] ^ 1));
       }
-      renderer_sync_ecmds(gpu.ex_regs);
-      renderer_update_caches(0, 0, 1024, 512);
+      gpu_sync_ecmds();
+      gpu_update_caches(0, 0, 1024, 512);
+      capture.paused--;
       break;
   }
 
@@ -723,9 +1640,22 @@ long GPU_freeze(uint32_t type, GPUFreeze_t *freeze)
 
 void GPU_updateLace(void)
 {
+  if (capturing()) {
+    capture_cmd(GPU_CAP_FRAME, NULL, 0);
+    capture.frames++;
+  }
+
+  if (gpu_thread.active != !!Config.GpuThread) {
+    // toggled in menu
+    if (Config.GpuThread)
+      gpu_thread_start();
+    else
+      gpu_thread_stop();
+  }
+
   if (gpu.cmd_len > 0)
     flush_cmd_buffer();
-  renderer_flush_queues();
+  gpu_flush_queues();
 
   if (gpu.status.blanking) {
     if (!gpu.state.blanked) {
@@ -748,6 +1678,7 @@ void GPU_updateLace(void)
     gpu.frameskip.frame_ready = 0;
   }
 
+  gpu_thread_sync();
   vout_update();
   gpu.state.fb_dirty = 0;
   gpu.state.blanked = 0;
@@ -755,6 +1686,11 @@ void GPU_updateLace(void)
 
 void GPU_vBlank(int is_vblank, int lcf)
 {
+  if (capturing()) {
+    uint32_t args[2] = { (uint32_t)is_vblank, (uint32_t)lcf };
+    capture_cmd(GPU_CAP_VBLANK, args, 2);
+  }
+
   int interlace = gpu.state.allow_interlace
     && gpu.status.interlace && gpu.status.dheight;
   // interlace doesn't look nice on progressive displays,
@@ -769,8 +1705,9 @@ void GPU_vBlank(int is_vblank, int lcf)
 
     if (gpu.cmd_len > 0)
       flush_cmd_buffer();
-    renderer_flush_queues();
-    renderer_set_interlace(interlace, !lcf);
+    gpu_flush_queues();
+    gpu_set_interlace(interlace, !lcf);
+    gpu_thread_kick();
   }
 }
 
@@ -778,11 +1715,14 @@ void GPU_vBlank(int is_vblank, int lcf)
 void GPU_requestScreenRedraw()
 {
 	gpu.state.fb_dirty = 1;
+	mark_rows(0, 512);
 	pl_clear_borders();
 }
 
 void GPU_getScreenInfo(GPUScreenInfo_t *sinfo)
 {
+	gpu_flush_queues();
+	gpu_thread_sync();
 	sinfo->vram    = (uint8_t*)gpu.vram;
 	sinfo->x       = (uint16_t)gpu.screen.x;
 	sinfo->y       = (uint16_t)gpu.screen.y;
@@ -813,6 +1753,7 @@ void gpulib_set_config(const gpulib_config_t *config)
     map_vram();
 #endif
 
+  gpu_thread_sync();
   renderer_set_config(config);
   vout_set_config(config);
 }
@@ -80,6 +80,10 @@ struct psx_gpu {
       uint32_t hcnt;
     } last_list;
     uint32_t last_vram_read_frame;
+    uint32_t draw_cycles; /* estimated drawing cost, see GPU_drawCycles() */
+    uint32_t *renderer_ex_regs; /* renderer reports E1-E6 state here, gpu.ex_regs
+                                   unless rendering is threaded */
+    uint32_t dirty_rows[512 / 32]; /* VRAM rows written since vout_update() */
   } state;
   struct {
     int32_t set:3; /* -1 auto, 0 off, 1-3 fixed */
@@ -129,6 +133,10 @@ extern gpulib_config_t gpulib_config;
 void gpulib_frameskip_prepare(void);
 void gpulib_set_config(const gpulib_config_t *config);
 
+// Record GPU plugin calls to a file for the gpureplay tool (gpu_replay.cpp)
+int  gpulib_capture_start(const char *path);
+void gpulib_capture_stop(void);
+
 int  renderer_init(void);
 void renderer_finish(void);
 void renderer_sync_ecmds(uint32_t * ecmds);
@@ -142,5 +150,6 @@ int  vout_init(void);
 int  vout_finish(void);
 void vout_update(void);
 void vout_blank(void);
+void vout_redraw(void);
 void vout_set_config(const gpulib_config_t *config);
 #endif // GPULIB_GPU_H
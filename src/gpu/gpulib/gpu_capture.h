@@ -0,0 +1,46 @@
+/*
+ * GPU command stream capture format, written by gpulib_capture_start()
+ * (gpu.cpp) and replayed by the gpureplay tool (gpu_replay.cpp).
+ *
+ * This work is licensed under the terms of any of these licenses
+ * (at your option):
+ *  - GNU GPL, version 2 or later.
+ *  - GNU LGPL, version 2.1 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#ifndef GPULIB_GPU_CAPTURE_H
+#define GPULIB_GPU_CAPTURE_H
+
+/* A capture is a gzip compressed stream of 32-bit words (host byte order):
+ *
+ *   GPU_CAPTURE_MAGIC, GPU_CAPTURE_VERSION
+ *   records: header word (type << 24 | length), then 'length' words
+ *
+ * Records follow the GPU plugin API calls the emulator made, so replaying
+ * them through the same calls reproduces the renderer work exactly. The
+ * first record is always GPU_CAP_STATE. Consecutive GPU_CAP_GP0/GP1 words
+ * are merged into one record, and consecutive reads are summed.
+ */
+#define GPU_CAPTURE_MAGIC    0x43555047  // "GPUC"
+#define GPU_CAPTURE_VERSION  1
+
+#define GPU_CAP_HEADER(type, len)  (((uint32_t)(type) << 24) | (len))
+#define GPU_CAP_TYPE(hdr)          ((hdr) >> 24)
+#define GPU_CAP_LEN(hdr)           ((hdr) & 0xffffff)
+
+enum {
+  GPU_CAP_STATE = 1, // GPU_freeze() image: ulStatus, ulControl[256], VRAM
+  GPU_CAP_GP1,       // GPU_writeStatus() words
+  GPU_CAP_GP0_MEM,   // one GPU_writeDataMem() call, or one DMA chain packet
+  GPU_CAP_GP0,       // GPU_writeData() words
+  GPU_CAP_READ,      // 1 word: count of words read by GPU_readData(Mem)()
+  GPU_CAP_FLUSH,     // buffered GPU_writeData() words were processed
+                     //  (GPU_readStatus(), savestate)
+  GPU_CAP_VBLANK,    // GPU_vBlank() arguments: is_vblank, lcf
+  GPU_CAP_FRAME      // GPU_updateLace(), end of frame
+};
+
+#define GPU_CAP_STATE_LEN  (1 + 256 + 1024 * 512 / 2)
+
+#endif // GPULIB_GPU_CAPTURE_H
@@ -0,0 +1,273 @@
+/*
+ * gpureplay: replays a GPU command capture (see gpu_capture.h) through the
+ * GPU plugin API as fast as possible, without CPU emulation or video output.
+ * Reports render time per frame and a hash of the final VRAM contents, so
+ * renderer changes can be benchmarked and checked for identical output.
+ *
+ * This work is licensed under the terms of any of these licenses
+ * (at your option):
+ *  - GNU GPL, version 2 or later.
+ *  - GNU LGPL, version 2.1 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <zlib.h>
+#include "psxcommon.h"
+#include "plugins.h"
+#include "plugin_lib.h"
+#include "gpu.h"
+#include "gpu_capture.h"
+
+// Emulator symbols gpulib and renderers use
+PcsxConfig Config;
+struct pl_data_t pl_data;
+uint32_t hSyncCount, frame_counter;
+
+void pl_clear_borders() {}
+void update_window_size(int w, int h, bool ntsc_fix) {}
+
+// No video output, frames stay in VRAM
+int  vout_init(void) { return 0; }
+int  vout_finish(void) { return 0; }
+void vout_update(void) {}
+void vout_blank(void) {}
+void vout_redraw(void) {}
+void vout_set_config(const gpulib_config_t *config) {}
+
+static uint32_t *words;       // whole capture, loaded before replay starts
+static size_t    words_len;
+
+static int load_capture(const char *path)
+{
+  size_t size = 0;
+  gzFile f;
+  int n;
+
+  f = gzopen(path, "rb");
+  if (f == NULL) {
+    printf("ERROR: could not open %s\n", path);
+    return -1;
+  }
+  for (;;) {
+    if (words_len == size) {
+      size = size ? size * 2 : 1024 * 1024;
+      words = (uint32_t*)realloc(words, size * 4);
+      if (words == NULL) {
+        printf("ERROR: out of memory loading %s\n", path);
+        gzclose(f);
+        return -1;
+      }
+    }
+    n = gzread(f, words + words_len, (size - words_len) * 4);
+    if (n <= 0)
+      break;
+    words_len += n / 4;
+  }
+  gzclose(f);
+
+  // emulator didn't exit cleanly, replay what was written
+  if (n < 0)
+    printf("WARNING: %s is truncated\n", path);
+  if (words_len < 2 || words[0] != GPU_CAPTURE_MAGIC) {
+    printf("ERROR: %s is not a GPU capture\n", path);
+    return -1;
+  }
+  if (words[1] != GPU_CAPTURE_VERSION) {
+    printf("ERROR: %s has unsupported capture version %u\n", path, words[1]);
+    return -1;
+  }
+  return 0;
+}
+
+static double now_ms(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+  double x = *(const double*)a, y = *(const double*)b;
+  return x < y ? -1 : x > y;
+}
+
+static void usage(const char *name)
+{
+  printf("Usage: %s [options] capture_file\n"
+         "  -frames N     stop after N frames\n"
+         "  -perframe     print render time of every frame\n"
+         "  -gputhread    render on a worker thread\n"
+#ifdef GPU_UNAI
+         "  -gpubands N   render in N bands on worker threads (gpu_unai)\n"
+         "  -gputexcache  cache decoded 4bpp/8bpp textures (gpu_unai)\n"
+         "  -dither       enable dithering (gpu_unai)\n"
+         "  -pixelskip    skip pixels not shown in hi-res modes (gpu_unai)\n"
+#endif
+         , name);
+}
+
+int main(int argc, char *argv[])
+{
+  static GPUFreeze_t freeze;
+  static uint32_t read_buf[1024];
+  const char *path = NULL;
+  GPUScreenInfo_t sinfo;
+  double *times = NULL, t, t_start, total = 0;
+  uint32_t max_frames = 0, frames = 0, hash;
+  int per_frame = 0;
+  size_t pos, len, j;
+
+#ifdef GPU_UNAI
+  gpu_unai_config_ext.ilace_force = 0;
+  gpu_unai_config_ext.pixel_skip = 0;
+  gpu_unai_config_ext.lighting = 1;
+  gpu_unai_config_ext.fast_lighting = 1;
+  gpu_unai_config_ext.blending = 1;
+  gpu_unai_config_ext.dithering = 0;
+  gpu_unai_config_ext.ntsc_fix = 1;
+  gpu_unai_config_ext.bands = 0;
+  gpu_unai_config_ext.tex_cache = 0;
+#endif
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i],"-frames") == 0 && i+1 < argc)
+      max_frames = atoi(argv[++i]);
+    else if (strcmp(argv[i],"-perframe") == 0)
+      per_frame = 1;
+    else if (strcmp(argv[i],"-gputhread") == 0)
+      Config.GpuThread = 1;
+#ifdef GPU_UNAI
+    else if (strcmp(argv[i],"-gpubands") == 0 && i+1 < argc) {
+      gpu_unai_config_ext.bands = atoi(argv[++i]);
+#ifndef GPU_UNAI_USE_BANDS
+      if (gpu_unai_config_ext.bands > 0)
+        printf("WARNING: -gpubands ignored, build with USE_GPU_BANDS=1\n");
+#endif
+    }
+    else if (strcmp(argv[i],"-gputexcache") == 0)
+      gpu_unai_config_ext.tex_cache = 1;
+    else if (strcmp(argv[i],"-dither") == 0)
+      gpu_unai_config_ext.dithering = 1;
+    else if (strcmp(argv[i],"-pixelskip") == 0)
+      gpu_unai_config_ext.pixel_skip = 1;
+#endif
+    else if (argv[i][0] != '-' && path == NULL)
+      path = argv[i];
+    else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (path == NULL) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  if (load_capture(path) != 0)
+    return 1;
+
+  // Frameskip would make timing meaningless and VRAM differ
+  Config.FrameSkip = 0;
+  if (GPU_init() != 0) {
+    printf("ERROR: GPU_init() failed\n");
+    return 1;
+  }
+#ifdef USE_GPULIB
+  gpulib_set_config(&gpulib_config);
+#endif
+
+  t_start = now_ms();
+  for (pos = 2; pos < words_len; pos += len) {
+    uint32_t hdr = words[pos++];
+    uint32_t *data = words + pos;
+
+    len = GPU_CAP_LEN(hdr);
+    if (pos + len > words_len) {
+      printf("WARNING: capture truncated\n");
+      break;
+    }
+
+    switch (GPU_CAP_TYPE(hdr)) {
+      case GPU_CAP_STATE:
+        if (len != GPU_CAP_STATE_LEN)
+          break;
+        freeze.ulFreezeVersion = 1;
+        freeze.ulStatus = data[0];
+        memcpy(freeze.ulControl, data + 1, sizeof(freeze.ulControl));
+        memcpy(freeze.psxVRam, data + 257, sizeof(freeze.psxVRam));
+        GPU_freeze(0, &freeze);
+        break;
+      case GPU_CAP_GP1:
+        for (j = 0; j < len; j++)
+          GPU_writeStatus(data[j]);
+        break;
+      case GPU_CAP_GP0_MEM:
+        GPU_writeDataMem(data, len);
+        break;
+      case GPU_CAP_GP0:
+        for (j = 0; j < len; j++)
+          GPU_writeData(data[j]);
+        break;
+      case GPU_CAP_READ:
+        for (int left = data[0]; left > 0; left -= 1024)
+          GPU_readDataMem(read_buf, left < 1024 ? left : 1024);
+        break;
+      case GPU_CAP_FLUSH:
+        GPU_readStatus();
+        break;
+#ifdef USE_GPULIB
+      case GPU_CAP_VBLANK:
+        GPU_vBlank(data[0], data[1]);
+        break;
+#endif
+      case GPU_CAP_FRAME:
+        GPU_updateLace();
+        GPU_getScreenInfo(&sinfo); // waits for worker threads
+        t = now_ms();
+        if ((frames & 1023) == 0) {
+          times = (double*)realloc(times, (frames + 1024) * sizeof(*times));
+          if (times == NULL) {
+            printf("ERROR: out of memory\n");
+            return 1;
+          }
+        }
+        times[frames] = t - t_start;
+        total += times[frames];
+        if (per_frame)
+          printf("frame %5u: %8.3f ms\n", frames, times[frames]);
+        frames++;
+        frame_counter++;
+        t_start = now_ms();
+        break;
+      default:
+        printf("WARNING: unknown record type %u\n", GPU_CAP_TYPE(hdr));
+        break;
+    }
+    if (max_frames && frames == max_frames)
+      break;
+  }
+
+  // FNV-1a of final VRAM contents, identical for identical rendering
+  GPU_getScreenInfo(&sinfo);
+  hash = 2166136261u;
+  for (j = 0; j < 1024 * 512 * 2; j++)
+    hash = (hash ^ sinfo.vram[j]) * 16777619u;
+
+  if (frames) {
+    qsort(times, frames, sizeof(*times), cmp_double);
+    printf("frames: %u  total: %.1f ms  avg: %.3f ms  median: %.3f ms  "
+           "min: %.3f ms  max: %.3f ms\n", frames, total, total / frames,
+           times[frames / 2], times[0], times[frames - 1]);
+  }
+  printf("VRAM hash: %08x\n", hash);
+
+  GPU_shutdown();
+  free(times);
+  free(words);
+  return 0;
+}
@@ -0,0 +1,177 @@
+/*
+ * voutbench: checks that every vector line blitter of vout_port.cpp (see
+ * vout_simd.h) usable on this CPU gives the same output as the scalar one,
+ * for 15bpp and 24bpp sources, then times them. Output past the end of each
+ * line is checked too. Exits with status 1 on any mismatch. Reports best
+ * time per line over several runs.
+ *
+ * This work is licensed under the terms of any of these licenses
+ * (at your option):
+ *  - GNU GPL, version 2 or later.
+ *  - GNU LGPL, version 2.1 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include "vout_blit.h"
+
+#define SRC_LEN  4096   // u16 units, enough for a 640 pixel 24bpp line
+#define DST_LEN  1024   // u16 units, 640 pixels plus room to catch overruns
+#define CANARY   0xdead
+
+enum { F_WW, F_WWSWWSWS, F_WWWWWS, F_WWWWWWWWS, F_WWDWW, F_WS, F_COPY, F_COUNT };
+static const char *fnames[F_COUNT] = { "320", "512", "384", "368", "256", "640", "copy" };
+
+static u16 src[SRC_LEN + 8];
+static u16 dst[2][DST_LEN];
+static u32 rng_state = 1;
+
+static u32 rng(void)
+{
+  rng_state = rng_state * 1103515245 + 12345;
+  return rng_state >> 8;
+}
+
+static double now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// 'arg' is clip for 368 blitter, width for copy blitter
+static void blit(const vout_blitters *b, int f, const u16 *s, u16 *d, bool rgb24, int arg)
+{
+  switch (f) {
+    case F_WW:        b->ww(s, d, rgb24); break;
+    case F_WWSWWSWS:  b->wwswwsws(s, d, rgb24); break;
+    case F_WWWWWS:    b->wwwwws(s, d, rgb24); break;
+    case F_WWWWWWWWS: b->wwwwwwwws(s, d, rgb24, arg); break;
+    case F_WWDWW:     b->wwdww(s, d, rgb24); break;
+    case F_WS:        b->ws(s, d, rgb24); break;
+    case F_COPY:      b->copy(s, d, arg, rgb24); break;
+  }
+}
+
+// Compare 'b' against scalar blitters on random lines. Source offsets
+//  cover the alignments vout_update() can pass, args the values it can.
+//  Scalar copy blitter needs a width of at least 2.
+static int check(const vout_blitters *b)
+{
+  static const int copy_w[] = { 2, 3, 7, 16, 31, 256, 317, 320, 368, 512, 639, 640 };
+  int errors = 0;
+
+  for (int rgb24 = 0; rgb24 < 2; rgb24++) {
+    for (int f = 0; f < F_COUNT; f++) {
+      int nargs = f == F_COPY ? sizeof(copy_w) / sizeof(copy_w[0]) :
+                  f == F_WWWWWWWWS ? 8 : 1;
+      for (int a = 0; a < nargs; a++) {
+        int arg = f == F_COPY ? copy_w[a] : a;
+        // vout_update() aligns source to 32 bits for these two
+        int offs_step = f == F_WW || f == F_COPY ? 2 : 1;
+        for (int offs = 0; offs < 4; offs += offs_step) {
+          for (int n = 0; n < 16; n++) {
+            for (int i = 0; i < SRC_LEN + 8; i++)
+              src[i] = rng() >> 4;
+            for (int k = 0; k < 2; k++)
+              for (int i = 0; i < DST_LEN; i++)
+                dst[k][i] = CANARY;
+            blit(&vout_blitters_scalar, f, src + offs, dst[0], rgb24, arg);
+            blit(b, f, src + offs, dst[1], rgb24, arg);
+            if (memcmp(dst[0], dst[1], sizeof(dst[0])) != 0) {
+              int i = 0;
+              while (dst[0][i] == dst[1][i]) i++;
+              if (errors++ < 10)
+                printf("MISMATCH: %s %-4s %s arg %d src offset %d: "
+                       "pixel %d is %04x, scalar %04x\n", b->name, fnames[f],
+                       rgb24 ? "24bpp" : "15bpp", arg, offs, i, dst[1][i], dst[0][i]);
+              break;
+            }
+          }
+        }
+      }
+    }
+  }
+  return errors;
+}
+
+// Best time of 'runs' runs of 'iters' calls, in ns per line
+static double bench(const vout_blitters *b, int f, bool rgb24, int iters, int runs)
+{
+  int arg = f == F_COPY ? 320 : 4;
+  double best = 0;
+  for (int run = 0; run < runs; run++) {
+    double t = now_ns();
+    for (int n = 0; n < iters; n++)
+      blit(b, f, src, dst[0], rgb24, arg);
+    t = (now_ns() - t) / iters;
+    if (run == 0 || t < best)
+      best = t;
+  }
+  return best;
+}
+
+static void usage(const char *name)
+{
+  printf("Usage: %s [options]\n"
+         "  -iters N   timed calls of each blitter per run (default 20000)\n"
+         "  -runs N    timed runs, best one is reported (default 5)\n", name);
+}
+
+int main(int argc, char *argv[])
+{
+  const vout_blitters *sets[3];
+  int num_sets = 0, iters = 20000, runs = 5, errors = 0;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-iters") == 0 && i+1 < argc)
+      iters = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-runs") == 0 && i+1 < argc)
+      runs = atoi(argv[++i]);
+    else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (iters <= 0 || runs <= 0) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  sets[num_sets++] = &vout_blitters_scalar;
+#ifdef VOUT_SIMD
+  sets[num_sets++] = &vout_blitters_simd128;
+#if defined(__x86_64__) || defined(__i386__)
+  if (__builtin_cpu_supports("avx2"))
+    sets[num_sets++] = &vout_blitters_avx2;
+  else
+    printf("CPU lacks AVX2, avx2 blitters not checked\n");
+#endif
+#else
+  printf("No vector blitters on this target, nothing to check\n");
+#endif
+
+  for (int s = 1; s < num_sets; s++) {
+    int e = check(sets[s]);
+    printf("%s: %s\n", sets[s]->name, e ? "MISMATCH" : "bit-exact with scalar");
+    errors += e;
+  }
+
+  printf("ns per line, best of %d:\n                 ", runs);
+  for (int s = 0; s < num_sets; s++)
+    printf(" %9s", sets[s]->name);
+  printf("\n");
+  for (int rgb24 = 0; rgb24 < 2; rgb24++) {
+    for (int f = 0; f < F_COUNT; f++) {
+      printf("  %-4s %s:     ", fnames[f], rgb24 ? "24bpp" : "15bpp");
+      for (int s = 0; s < num_sets; s++)
+        printf(" %9.1f", bench(sets[s], f, rgb24, iters, runs));
+      printf("\n");
+    }
+  }
+
+  return errors ? 1 : 0;
+}
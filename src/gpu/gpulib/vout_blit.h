@@ -0,0 +1,454 @@
+/*
+ * (C) Gražvydas "notaz" Ignotas, 2011
+ *   Copyright (C) 2016 PCSX4ALL Team
+ *   Copyright (C) 2016 Senquack (dansilsby <AT> gmail <DOT> com)
+ *   Copyright (C) 2010 Unai
+ *
+ * This work is licensed under the terms of any of these licenses
+ * (at your option):
+ *  - GNU GPL, version 2 or later.
+ *  - GNU LGPL, version 2.1 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+// Line blitters of vout_port.cpp, also built into voutbench (vout_bench.cpp)
+
+#ifndef VOUT_BLIT_H
+#define VOUT_BLIT_H
+
+#include <stdint.h>
+#include <string.h>
+
+///////////////////////////////////////////////////////////////////////////////
+// BLITTERS TAKEN FROM gpu_unai/gpu_blit.h
+// GPU Blitting code with rescale and interlace support.
+///////////////////////////////////////////////////////////////////////////////
+#ifndef USE_BGR15
+#define RGB24(R,G,B)	(((((R)&0xF8)<<8)|(((G)&0xFC)<<3)|(((B)&0xF8)>>3)))
+#define RGB16X2(C)		(((C)&(0x1f001f<<10))>>10) | (((C)&(0x1f001f<<5))<<1) | (((C)&(0x1f001f<<0))<<11)
+#define RGB16(C)		(((C)&(0x1f<<10))>>10) | (((C)&(0x1f<<5))<<1) | (((C)&(0x1f<<0))<<11)
+#else
+#define RGB24(R,G,B)  	((((R)&0xF8)>>3)|(((G)&0xF8)<<2)|(((B)&0xF8)<<7))
+#endif
+
+#define u8 uint8_t
+#define s8 int8_t
+#define u16 uint16_t
+#define s16 int16_t
+#define u32 uint32_t
+#define s32 int32_t
+#define s64 int64_t
+
+#ifdef USE_MEMCPY32
+static inline void *memcpy32 (void *__restrict__ dest, const void *__restrict__ src, size_t len)
+{
+	u32 *__restrict__ d = (u32*__restrict__)dest;
+	const u32 *__restrict__ s = (const u32*__restrict__)src;
+	while (len--) {
+		*d++ = *s++;
+	}
+	return dest;
+}
+#define MEMCPY(d, s, l) memcpy32((d), (s), (l) >> 2)
+#else
+#define MEMCPY memcpy
+#endif
+
+static inline void GPU_BlitWW(const void*__restrict__ src, u16*__restrict__ dst16, bool isRGB24)
+{
+	u32 uCount;
+	if (!isRGB24)
+	{
+#ifndef USE_BGR15
+		uCount = 20;
+		const u32*__restrict__ src32 = (const u32*__restrict__) src;
+		u32*__restrict__ dst32 = (u32*__restrict__)(void*) dst16;
+		do {
+			dst32[0] = RGB16X2(src32[0]);
+			dst32[1] = RGB16X2(src32[1]);
+			dst32[2] = RGB16X2(src32[2]);
+			dst32[3] = RGB16X2(src32[3]);
+			dst32[4] = RGB16X2(src32[4]);
+			dst32[5] = RGB16X2(src32[5]);
+			dst32[6] = RGB16X2(src32[6]);
+			dst32[7] = RGB16X2(src32[7]);
+			dst32 += 8;
+			src32 += 8;
+		} while(--uCount);
+#else
+		MEMCPY(dst16, src, 640);
+#endif
+	} else
+	{
+		uCount = 20;
+		const u8*__restrict__ src8 = (const u8*__restrict__)src;
+		do{
+			dst16[ 0] = RGB24(src8[ 0], src8[ 1], src8[ 2] );
+			dst16[ 1] = RGB24(src8[ 3], src8[ 4], src8[ 5] );
+			dst16[ 2] = RGB24(src8[ 6], src8[ 7], src8[ 8] );
+			dst16[ 3] = RGB24(src8[ 9], src8[10], src8[11] );
+			dst16[ 4] = RGB24(src8[12], src8[13], src8[14] );
+			dst16[ 5] = RGB24(src8[15], src8[16], src8[17] );
+			dst16[ 6] = RGB24(src8[18], src8[19], src8[20] );
+			dst16[ 7] = RGB24(src8[21], src8[22], src8[23] );
+
+			dst16[ 8] = RGB24(src8[24], src8[25], src8[26] );
+			dst16[ 9] = RGB24(src8[27], src8[28], src8[29] );
+			dst16[10] = RGB24(src8[30], src8[31], src8[32] );
+			dst16[11] = RGB24(src8[33], src8[34], src8[35] );
+			dst16[12] = RGB24(src8[36], src8[37], src8[38] );
+			dst16[13] = RGB24(src8[39], src8[40], src8[41] );
+			dst16[14] = RGB24(src8[42], src8[43], src8[44] );
+			dst16[15] = RGB24(src8[45], src8[46], src8[47] );
+			dst16 += 16;
+			src8  += 48;
+		} while (--uCount);
+	}
+}
+
+static inline void GPU_BlitWWSWWSWS(const void*__restrict__ src, u16*__restrict__ dst16, bool isRGB24)
+{
+	u32 uCount;
+	if (!isRGB24)
+	{
+#ifndef USE_BGR15
+		uCount = 64;
+		const u16*__restrict__ src16 = (const u16*__restrict__) src;
+		do {
+			dst16[0] = RGB16(src16[0]);
+			dst16[1] = RGB16(src16[1]);
+			dst16[2] = RGB16(src16[3]);
+			dst16[3] = RGB16(src16[4]);
+			dst16[4] = RGB16(src16[6]);
+			dst16 += 5;
+			src16 += 8;
+		} while (--uCount);
+#else
+		uCount = 64;
+		const u16*__restrict__ src16 = (const u16*__restrict__) src;
+		do {
+			dst16[0] = src16[0];
+			dst16[1] = src16[1];
+			dst16[2] = src16[3];
+			dst16[3] = src16[4];
+			dst16[4] = src16[6];
+			dst16 += 5;
+			src16 += 8;
+		} while (--uCount);
+#endif
+	} else
+	{
+		uCount = 32;
+		const u8*__restrict__ src8 = (const u8*__restrict__)src;
+		do {
+			dst16[ 0] = RGB24(src8[ 0], src8[ 1], src8[ 2] );
+			dst16[ 1] = RGB24(src8[ 3], src8[ 4], src8[ 5] );
+			dst16[ 2] = RGB24(src8[ 9], src8[10], src8[11] );
+			dst16[ 3] = RGB24(src8[12], src8[13], src8[14] );
+			dst16[ 4] = RGB24(src8[18], src8[19], src8[20] );
+
+			dst16[ 5] = RGB24(src8[24], src8[25], src8[26] );
+			dst16[ 6] = RGB24(src8[27], src8[28], src8[29] );
+			dst16[ 7] = RGB24(src8[33], src8[34], src8[35] );
+			dst16[ 8] = RGB24(src8[36], src8[37], src8[38] );
+			dst16[ 9] = RGB24(src8[42], src8[43], src8[44] );
+
+			dst16 += 10;
+			src8  += 48;
+		} while (--uCount);
+	}
+}
+
+static inline void GPU_BlitWWWWWS(const void*__restrict__ src, u16*__restrict__ dst16, bool isRGB24)
+{
+	u32 uCount;
+	if (!isRGB24)
+	{
+#ifndef USE_BGR15
+		uCount = 32;
+		const u16*__restrict__ src16 = (const u16*__restrict__) src;
+		do {
+			dst16[ 0] = RGB16(src16[0]);
+			dst16[ 1] = RGB16(src16[1]);
+			dst16[ 2] = RGB16(src16[2]);
+			dst16[ 3] = RGB16(src16[3]);
+			dst16[ 4] = RGB16(src16[4]);
+			dst16[ 5] = RGB16(src16[6]);
+			dst16[ 6] = RGB16(src16[7]);
+			dst16[ 7] = RGB16(src16[8]);
+			dst16[ 8] = RGB16(src16[9]);
+			dst16[ 9] = RGB16(src16[10]);
+			dst16 += 10;
+			src16 += 12;
+		} while (--uCount);
+#else
+		uCount = 64;
+		const u16*__restrict__ src16 = (const u16*__restrict__) src;
+		do {
+			MEMCPY(dst16, src16, 2 * 5);
+			dst16 += 5;
+			src16 += 6;
+		} while (--uCount);
+#endif
+	} else
+	{
+		uCount = 32;
+		const u8*__restrict__ src8 = (const u8*__restrict__)src;
+		do {
+			dst16[0] = RGB24(src8[ 0], src8[ 1], src8[ 2] );
+			dst16[1] = RGB24(src8[ 3], src8[ 4], src8[ 5] );
+			dst16[2] = RGB24(src8[ 6], src8[ 7], src8[ 8] );
+			dst16[3] = RGB24(src8[ 9], src8[10], src8[11] );
+			dst16[4] = RGB24(src8[12], src8[13], src8[14] );
+			dst16[5] = RGB24(src8[18], src8[19], src8[20] );
+			dst16[6] = RGB24(src8[21], src8[22], src8[23] );
+			dst16[7] = RGB24(src8[24], src8[25], src8[26] );
+			dst16[8] = RGB24(src8[27], src8[28], src8[29] );
+			dst16[9] = RGB24(src8[30], src8[31], src8[32] );
+			dst16 += 10;
+			src8  += 36;
+		} while (--uCount);
+	}
+}
+
+static inline void GPU_BlitWWWWWWWWS(const void*__restrict__ src, u16*__restrict__ dst16, bool isRGB24, u32 uClip_src)
+{
+	u32 uCount;
+	if (!isRGB24)
+	{
+#ifndef USE_BGR15
+		uCount = 20;
+		const u16*__restrict__ src16 = ((const u16*__restrict__) src) + uClip_src;
+		do {
+			dst16[ 0] = RGB16(src16[0]);
+			dst16[ 1] = RGB16(src16[1]);
+			dst16[ 2] = RGB16(src16[2]);
+			dst16[ 3] = RGB16(src16[3]);
+			dst16[ 4] = RGB16(src16[4]);
+			dst16[ 5] = RGB16(src16[5]);
+			dst16[ 6] = RGB16(src16[6]);
+			dst16[ 7] = RGB16(src16[7]);
+
+			dst16[ 8] = RGB16(src16[9]);
+			dst16[ 9] = RGB16(src16[10]);
+			dst16[10] = RGB16(src16[11]);
+			dst16[11] = RGB16(src16[12]);
+			dst16[12] = RGB16(src16[13]);
+			dst16[13] = RGB16(src16[14]);
+			dst16[14] = RGB16(src16[15]);
+			dst16[15] = RGB16(src16[16]);
+			dst16 += 16;
+			src16 += 18;
+		} while (--uCount);
+#else
+		uCount = 40;
+		const u16*__restrict__ src16 = ((const u16*__restrict__) src) + uClip_src;
+		do {
+			MEMCPY(dst16, src16, 2 * 8);
+			dst16 += 8;
+			src16 += 9;
+		} while (--uCount);
+#endif
+	} else
+	{
+		uCount = 20;
+		const u8*__restrict__ src8 = (const u8*__restrict__)src + (uClip_src<<1) + uClip_src;
+		do {
+			dst16[ 0] = RGB24(src8[ 0], src8[ 1], src8[ 2] );
+			dst16[ 1] = RGB24(src8[ 3], src8[ 4], src8[ 5] );
+			dst16[ 2] = RGB24(src8[ 6], src8[ 7], src8[ 8] );
+			dst16[ 3] = RGB24(src8[ 9], src8[10], src8[11] );
+			dst16[ 4] = RGB24(src8[12], src8[13], src8[14] );
+			dst16[ 5] = RGB24(src8[15], src8[16], src8[17] );
+			dst16[ 6] = RGB24(src8[18], src8[19], src8[20] );
+			dst16[ 7] = RGB24(src8[21], src8[22], src8[23] );
+
+			dst16[ 8] = RGB24(src8[27], src8[28], src8[29] );
+			dst16[ 9] = RGB24(src8[30], src8[31], src8[32] );
+			dst16[10] = RGB24(src8[33], src8[34], src8[35] );
+			dst16[11] = RGB24(src8[36], src8[37], src8[38] );
+			dst16[12] = RGB24(src8[39], src8[40], src8[41] );
+			dst16[13] = RGB24(src8[42], src8[43], src8[44] );
+			dst16[14] = RGB24(src8[45], src8[46], src8[47] );
+			dst16[15] = RGB24(src8[48], src8[49], src8[50] );
+			dst16 += 16;
+			src8  += 54;
+		} while (--uCount);
+	}
+}
+
+static inline void GPU_BlitWWDWW(const void*__restrict__ src, u16*__restrict__ dst16, bool isRGB24)
+{
+	u32 uCount;
+	if (!isRGB24)
+	{
+#ifndef USE_BGR15
+		uCount = 32;
+		const u16*__restrict__ src16 = (const u16*__restrict__) src;
+		do {
+			dst16[ 0] = RGB16(src16[0]);
+			dst16[ 1] = RGB16(src16[1]);
+			dst16[ 2] = dst16[1];
+			dst16[ 3] = RGB16(src16[2]);
+			dst16[ 4] = RGB16(src16[3]);
+			dst16[ 5] = RGB16(src16[4]);
+			dst16[ 6] = RGB16(src16[5]);
+			dst16[ 7] = dst16[6];
+			dst16[ 8] = RGB16(src16[6]);
+			dst16[ 9] = RGB16(src16[7]);
+			dst16 += 10;
+			src16 +=  8;
+		} while (--uCount);
+#else
+		uCount = 64;
+		const u16*__restrict__ src16 = (const u16*__restrict__) src;
+		do {
+			*dst16++ = *src16++;
+			*dst16++ = *src16;
+			*dst16++ = *src16++;
+			*dst16++ = *src16++;
+			*dst16++ = *src16++;
+		} while (--uCount);
+#endif
+	} else
+	{
+		uCount = 32;
+		const u8*__restrict__ src8 = (const u8*__restrict__)src;
+		do {
+			dst16[ 0] = RGB24(src8[0], src8[ 1], src8[ 2] );
+			dst16[ 1] = RGB24(src8[3], src8[ 4], src8[ 5] );
+			dst16[ 2] = dst16[1];
+			dst16[ 3] = RGB24(src8[6], src8[ 7], src8[ 8] );
+			dst16[ 4] = RGB24(src8[9], src8[10], src8[11] );
+
+			dst16[ 5] = RGB24(src8[12], src8[13], src8[14] );
+			dst16[ 6] = RGB24(src8[15], src8[16], src8[17] );
+			dst16[ 7] = dst16[6];
+			dst16[ 8] = RGB24(src8[18], src8[19], src8[20] );
+			dst16[ 9] = RGB24(src8[21], src8[22], src8[23] );
+			dst16 += 10;
+			src8  += 24;
+		} while (--uCount);
+	}
+}
+
+
+static inline void GPU_BlitWS(const void*__restrict__ src, u16*__restrict__ dst16, bool isRGB24)
+{
+	u32 uCount;
+	if (!isRGB24) {
+#ifndef USE_BGR15
+		uCount = 20;
+		const u16*__restrict__ src16 = (const u16*__restrict__) src;
+		do {
+			dst16[ 0] = RGB16(src16[0]);
+			dst16[ 1] = RGB16(src16[2]);
+			dst16[ 2] = RGB16(src16[4]);
+			dst16[ 3] = RGB16(src16[6]);
+
+			dst16[ 4] = RGB16(src16[8]);
+			dst16[ 5] = RGB16(src16[10]);
+			dst16[ 6] = RGB16(src16[12]);
+			dst16[ 7] = RGB16(src16[14]);
+
+			dst16[ 8] = RGB16(src16[16]);
+			dst16[ 9] = RGB16(src16[18]);
+			dst16[10] = RGB16(src16[20]);
+			dst16[11] = RGB16(src16[22]);
+
+			dst16[12] = RGB16(src16[24]);
+			dst16[13] = RGB16(src16[26]);
+			dst16[14] = RGB16(src16[28]);
+			dst16[15] = RGB16(src16[30]);
+
+			dst16 += 16;
+			src16 += 32;
+		} while (--uCount);
+#else
+		uCount = 320;
+		const u16*__restrict__ src16 = (const u16*__restrict__) src;
+		do {
+			*dst16++ = *src16;
+			src16 += 2;
+		} while (--uCount);
+#endif
+	} else
+	{
+		uCount = 20;
+		const u8*__restrict__ src8 = (const u8*__restrict__) src;
+		do {
+			dst16[ 0] = RGB24(src8[ 0], src8[ 1], src8[ 2] );
+			dst16[ 1] = RGB24(src8[ 6], src8[ 7], src8[ 8] );
+			dst16[ 2] = RGB24(src8[12], src8[13], src8[14] );
+			dst16[ 3] = RGB24(src8[18], src8[19], src8[20] );
+
+			dst16[ 4] = RGB24(src8[24], src8[25], src8[26] );
+			dst16[ 5] = RGB24(src8[30], src8[31], src8[32] );
+			dst16[ 6] = RGB24(src8[36], src8[37], src8[38] );
+			dst16[ 7] = RGB24(src8[42], src8[43], src8[44] );
+
+			dst16[ 8] = RGB24(src8[48], src8[49], src8[50] );
+			dst16[ 9] = RGB24(src8[54], src8[55], src8[56] );
+			dst16[10] = RGB24(src8[60], src8[61], src8[62] );
+			dst16[11] = RGB24(src8[66], src8[67], src8[68] );
+
+			dst16[12] = RGB24(src8[72], src8[73], src8[74] );
+			dst16[13] = RGB24(src8[78], src8[79], src8[80] );
+			dst16[14] = RGB24(src8[84], src8[85], src8[86] );
+			dst16[15] = RGB24(src8[90], src8[91], src8[92] );
+
+			dst16 += 16;
+			src8  += 96;
+		} while(--uCount);
+	}
+}
+
+
+static inline void GPU_BlitCopy(const void*__restrict__ src, u16*__restrict__ dst16, int w, bool isRGB24)
+{
+	u32 uCount;
+	if (!isRGB24)
+	{
+#ifndef USE_BGR15
+		uCount = w / 2;
+		const u32*__restrict__ src32 = (const u32*__restrict__) src;
+		u32*__restrict__ dst32 = (u32*__restrict__)(void*) dst16;
+		do {
+			uint32_t s = *src32++;
+			*dst32++ = RGB16X2(s);
+		} while(--uCount);
+#else
+		MEMCPY(dst16, src, w * 2);
+#endif
+	} else
+	{
+		uCount = w;
+		const u8*__restrict__ src8 = (const u8*__restrict__)src;
+		do{
+			*dst16++ = RGB24(src8[ 0], src8[ 1], src8[ 2] );
+			src8  += 3;
+		} while (--uCount);
+	}
+}
+
+
+// Line blitters used by vout_update(), scalar ones above or vector ones
+//  from vout_simd.h, picked by vout_init()
+struct vout_blitters {
+	const char *name;
+	void (*ww)(const void *src, u16 *dst16, bool isRGB24);          // 320
+	void (*wwswwsws)(const void *src, u16 *dst16, bool isRGB24);    // 512
+	void (*wwwwws)(const void *src, u16 *dst16, bool isRGB24);      // 384
+	void (*wwwwwwwws)(const void *src, u16 *dst16, bool isRGB24, u32 uClip_src); // 368
+	void (*wwdww)(const void *src, u16 *dst16, bool isRGB24);       // 256
+	void (*ws)(const void *src, u16 *dst16, bool isRGB24);          // 640
+	void (*copy)(const void *src, u16 *dst16, int w, bool isRGB24); // unscaled
+};
+
+static const vout_blitters vout_blitters_scalar = { "scalar",
+	GPU_BlitWW, GPU_BlitWWSWWSWS, GPU_BlitWWWWWS, GPU_BlitWWWWWWWWS,
+	GPU_BlitWWDWW, GPU_BlitWS, GPU_BlitCopy };
+
+#include "vout_simd.h"
+
+#endif // VOUT_BLIT_H
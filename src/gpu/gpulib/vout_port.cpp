@@ -16,422 +16,55 @@
 #include "port.h"
 #include "gpu.h"
 
-///////////////////////////////////////////////////////////////////////////////
-// BLITTERS TAKEN FROM gpu_unai/gpu_blit.h
-// GPU Blitting code with rescale and interlace support.
-///////////////////////////////////////////////////////////////////////////////
-#ifndef USE_BGR15
-#define RGB24(R,G,B)	(((((R)&0xF8)<<8)|(((G)&0xFC)<<3)|(((B)&0xF8)>>3)))
-#define RGB16X2(C)		(((C)&(0x1f001f<<10))>>10) | (((C)&(0x1f001f<<5))<<1) | (((C)&(0x1f001f<<0))<<11)
-#define RGB16(C)		(((C)&(0x1f<<10))>>10) | (((C)&(0x1f<<5))<<1) | (((C)&(0x1f<<0))<<11)
-#else
-#define RGB24(R,G,B)  	((((R)&0xF8)>>3)|(((G)&0xF8)<<2)|(((B)&0xF8)<<7))
-#endif
-
-#define u8 uint8_t
-#define s8 int8_t
-#define u16 uint16_t
-#define s16 int16_t
-#define u32 uint32_t
-#define s32 int32_t
-#define s64 int64_t
-
-#ifdef USE_MEMCPY32
-static inline void *memcpy32 (void *__restrict__ dest, const void *__restrict__ src, size_t len)
-{
-	u32 *__restrict__ d = (u32*__restrict__)dest;
-	const u32 *__restrict__ s = (const u32*__restrict__)src;
-	while (len--) {
-		*d++ = *s++;
-	}
-	return dest;
-}
-#define MEMCPY(d, s, l) memcpy32((d), (s), (l) >> 2)
-#else
-#define MEMCPY memcpy
-#endif
+#include "vout_blit.h"
 
 template<typename T>
 INLINE  T Min2 (const T _a, const T _b) { return (_a<_b)?_a:_b; }
 
-static inline void GPU_BlitWW(const void*__restrict__ src, u16*__restrict__ dst16, bool isRGB24)
-{
-	u32 uCount;
-	if (!isRGB24)
-	{
-#ifndef USE_BGR15
-		uCount = 20;
-		const u32*__restrict__ src32 = (const u32*__restrict__) src;
-		u32*__restrict__ dst32 = (u32*__restrict__)(void*) dst16;
-		do {
-			dst32[0] = RGB16X2(src32[0]);
-			dst32[1] = RGB16X2(src32[1]);
-			dst32[2] = RGB16X2(src32[2]);
-			dst32[3] = RGB16X2(src32[3]);
-			dst32[4] = RGB16X2(src32[4]);
-			dst32[5] = RGB16X2(src32[5]);
-			dst32[6] = RGB16X2(src32[6]);
-			dst32[7] = RGB16X2(src32[7]);
-			dst32 += 8;
-			src32 += 8;
-		} while(--uCount);
-#else
-		MEMCPY(dst16, src, 640);
-#endif
-	} else
-	{
-		uCount = 20;
-		const u8*__restrict__ src8 = (const u8*__restrict__)src;
-		do{
-			dst16[ 0] = RGB24(src8[ 0], src8[ 1], src8[ 2] );
-			dst16[ 1] = RGB24(src8[ 3], src8[ 4], src8[ 5] );
-			dst16[ 2] = RGB24(src8[ 6], src8[ 7], src8[ 8] );
-			dst16[ 3] = RGB24(src8[ 9], src8[10], src8[11] );
-			dst16[ 4] = RGB24(src8[12], src8[13], src8[14] );
-			dst16[ 5] = RGB24(src8[15], src8[16], src8[17] );
-			dst16[ 6] = RGB24(src8[18], src8[19], src8[20] );
-			dst16[ 7] = RGB24(src8[21], src8[22], src8[23] );
-
-			dst16[ 8] = RGB24(src8[24], src8[25], src8[26] );
-			dst16[ 9] = RGB24(src8[27], src8[28], src8[29] );
-			dst16[10] = RGB24(src8[30], src8[31], src8[32] );
-			dst16[11] = RGB24(src8[33], src8[34], src8[35] );
-			dst16[12] = RGB24(src8[36], src8[37], src8[38] );
-			dst16[13] = RGB24(src8[39], src8[40], src8[41] );
-			dst16[14] = RGB24(src8[42], src8[43], src8[44] );
-			dst16[15] = RGB24(src8[45], src8[46], src8[47] );
-			dst16 += 16;
-			src8  += 48;
-		} while (--uCount);
-	}
-}
-
-static inline void GPU_BlitWWSWWSWS(const void*__restrict__ src, u16*__restrict__ dst16, bool isRGB24)
-{
-	u32 uCount;
-	if (!isRGB24)
-	{
-#ifndef USE_BGR15
-		uCount = 64;
-		const u16*__restrict__ src16 = (const u16*__restrict__) src;
-		do {
-			dst16[0] = RGB16(src16[0]);
-			dst16[1] = RGB16(src16[1]);
-			dst16[2] = RGB16(src16[3]);
-			dst16[3] = RGB16(src16[4]);
-			dst16[4] = RGB16(src16[6]);
-			dst16 += 5;
-			src16 += 8;
-		} while (--uCount);
-#else
-		uCount = 64;
-		const u16*__restrict__ src16 = (const u16*__restrict__) src;
-		do {
-			dst16[0] = src16[0];
-			dst16[1] = src16[1];
-			dst16[2] = src16[3];
-			dst16[3] = src16[4];
-			dst16[4] = src16[6];
-			dst16 += 5;
-			src16 += 8;
-		} while (--uCount);
-#endif
-	} else
-	{
-		uCount = 32;
-		const u8*__restrict__ src8 = (const u8*__restrict__)src;
-		do {
-			dst16[ 0] = RGB24(src8[ 0], src8[ 1], src8[ 2] );
-			dst16[ 1] = RGB24(src8[ 3], src8[ 4], src8[ 5] );
-			dst16[ 2] = RGB24(src8[ 9], src8[10], src8[11] );
-			dst16[ 3] = RGB24(src8[12], src8[13], src8[14] );
-			dst16[ 4] = RGB24(src8[18], src8[19], src8[20] );
-
-			dst16[ 5] = RGB24(src8[24], src8[25], src8[26] );
-			dst16[ 6] = RGB24(src8[27], src8[28], src8[29] );
-			dst16[ 7] = RGB24(src8[33], src8[34], src8[35] );
-			dst16[ 8] = RGB24(src8[36], src8[37], src8[38] );
-			dst16[ 9] = RGB24(src8[42], src8[43], src8[44] );
+static vout_blitters vout_blit = vout_blitters_scalar;
 
-			dst16 += 10;
-			src8  += 48;
-		} while (--uCount);
-	}
-}
-
-static inline void GPU_BlitWWWWWS(const void*__restrict__ src, u16*__restrict__ dst16, bool isRGB24)
-{
-	u32 uCount;
-	if (!isRGB24)
-	{
-#ifndef USE_BGR15
-		uCount = 32;
-		const u16*__restrict__ src16 = (const u16*__restrict__) src;
-		do {
-			dst16[ 0] = RGB16(src16[0]);
-			dst16[ 1] = RGB16(src16[1]);
-			dst16[ 2] = RGB16(src16[2]);
-			dst16[ 3] = RGB16(src16[3]);
-			dst16[ 4] = RGB16(src16[4]);
-			dst16[ 5] = RGB16(src16[6]);
-			dst16[ 6] = RGB16(src16[7]);
-			dst16[ 7] = RGB16(src16[8]);
-			dst16[ 8] = RGB16(src16[9]);
-			dst16[ 9] = RGB16(src16[10]);
-			dst16 += 10;
-			src16 += 12;
-		} while (--uCount);
+// Times each VRAM row must still be converted: SCREEN moves to the next
+//  video buffer on every flip, so a changed row is converted once for each.
+#ifdef SDL_TRIPLEBUF
+#define VOUT_BUFFERS 3
 #else
-		uCount = 64;
-		const u16*__restrict__ src16 = (const u16*__restrict__) src;
-		do {
-			MEMCPY(dst16, src16, 2 * 5);
-			dst16 += 5;
-			src16 += 6;
-		} while (--uCount);
+#define VOUT_BUFFERS 2
 #endif
-	} else
-	{
-		uCount = 32;
-		const u8*__restrict__ src8 = (const u8*__restrict__)src;
-		do {
-			dst16[0] = RGB24(src8[ 0], src8[ 1], src8[ 2] );
-			dst16[1] = RGB24(src8[ 3], src8[ 4], src8[ 5] );
-			dst16[2] = RGB24(src8[ 6], src8[ 7], src8[ 8] );
-			dst16[3] = RGB24(src8[ 9], src8[10], src8[11] );
-			dst16[4] = RGB24(src8[12], src8[13], src8[14] );
-			dst16[5] = RGB24(src8[18], src8[19], src8[20] );
-			dst16[6] = RGB24(src8[21], src8[22], src8[23] );
-			dst16[7] = RGB24(src8[24], src8[25], src8[26] );
-			dst16[8] = RGB24(src8[27], src8[28], src8[29] );
-			dst16[9] = RGB24(src8[30], src8[31], src8[32] );
-			dst16 += 10;
-			src8  += 36;
-		} while (--uCount);
-	}
-}
-
-static inline void GPU_BlitWWWWWWWWS(const void*__restrict__ src, u16*__restrict__ dst16, bool isRGB24, u32 uClip_src)
+static u8 vout_row_redraws[512];
+static int vout_layout[10];
+static bool vout_blitted;
+static bool vout_redraw_all;
+
+// Take rows gpulib marked as written. Everything is redrawn when the
+//  displayed area or output changes, 'full' is set or vout_redraw() was called.
+static void vout_take_dirty_rows(const int *layout, bool full)
 {
-	u32 uCount;
-	if (!isRGB24)
-	{
-#ifndef USE_BGR15
-		uCount = 20;
-		const u16*__restrict__ src16 = ((const u16*__restrict__) src) + uClip_src;
-		do {
-			dst16[ 0] = RGB16(src16[0]);
-			dst16[ 1] = RGB16(src16[1]);
-			dst16[ 2] = RGB16(src16[2]);
-			dst16[ 3] = RGB16(src16[3]);
-			dst16[ 4] = RGB16(src16[4]);
-			dst16[ 5] = RGB16(src16[5]);
-			dst16[ 6] = RGB16(src16[6]);
-			dst16[ 7] = RGB16(src16[7]);
-
-			dst16[ 8] = RGB16(src16[9]);
-			dst16[ 9] = RGB16(src16[10]);
-			dst16[10] = RGB16(src16[11]);
-			dst16[11] = RGB16(src16[12]);
-			dst16[12] = RGB16(src16[13]);
-			dst16[13] = RGB16(src16[14]);
-			dst16[14] = RGB16(src16[15]);
-			dst16[15] = RGB16(src16[16]);
-			dst16 += 16;
-			src16 += 18;
-		} while (--uCount);
-#else
-		uCount = 40;
-		const u16*__restrict__ src16 = ((const u16*__restrict__) src) + uClip_src;
-		do {
-			MEMCPY(dst16, src16, 2 * 8);
-			dst16 += 8;
-			src16 += 9;
-		} while (--uCount);
-#endif
-	} else
-	{
-		uCount = 20;
-		const u8*__restrict__ src8 = (const u8*__restrict__)src + (uClip_src<<1) + uClip_src;
-		do {
-			dst16[ 0] = RGB24(src8[ 0], src8[ 1], src8[ 2] );
-			dst16[ 1] = RGB24(src8[ 3], src8[ 4], src8[ 5] );
-			dst16[ 2] = RGB24(src8[ 6], src8[ 7], src8[ 8] );
-			dst16[ 3] = RGB24(src8[ 9], src8[10], src8[11] );
-			dst16[ 4] = RGB24(src8[12], src8[13], src8[14] );
-			dst16[ 5] = RGB24(src8[15], src8[16], src8[17] );
-			dst16[ 6] = RGB24(src8[18], src8[19], src8[20] );
-			dst16[ 7] = RGB24(src8[21], src8[22], src8[23] );
-
-			dst16[ 8] = RGB24(src8[27], src8[28], src8[29] );
-			dst16[ 9] = RGB24(src8[30], src8[31], src8[32] );
-			dst16[10] = RGB24(src8[33], src8[34], src8[35] );
-			dst16[11] = RGB24(src8[36], src8[37], src8[38] );
-			dst16[12] = RGB24(src8[39], src8[40], src8[41] );
-			dst16[13] = RGB24(src8[42], src8[43], src8[44] );
-			dst16[14] = RGB24(src8[45], src8[46], src8[47] );
-			dst16[15] = RGB24(src8[48], src8[49], src8[50] );
-			dst16 += 16;
-			src8  += 54;
-		} while (--uCount);
-	}
-}
-
-static inline void GPU_BlitWWDWW(const void*__restrict__ src, u16*__restrict__ dst16, bool isRGB24)
-{
-	u32 uCount;
-	if (!isRGB24)
-	{
-#ifndef USE_BGR15
-		uCount = 32;
-		const u16*__restrict__ src16 = (const u16*__restrict__) src;
-		do {
-			dst16[ 0] = RGB16(src16[0]);
-			dst16[ 1] = RGB16(src16[1]);
-			dst16[ 2] = dst16[1];
-			dst16[ 3] = RGB16(src16[2]);
-			dst16[ 4] = RGB16(src16[3]);
-			dst16[ 5] = RGB16(src16[4]);
-			dst16[ 6] = RGB16(src16[5]);
-			dst16[ 7] = dst16[6];
-			dst16[ 8] = RGB16(src16[6]);
-			dst16[ 9] = RGB16(src16[7]);
-			dst16 += 10;
-			src16 +=  8;
-		} while (--uCount);
-#else
-		uCount = 64;
-		const u16*__restrict__ src16 = (const u16*__restrict__) src;
-		do {
-			*dst16++ = *src16++;
-			*dst16++ = *src16;
-			*dst16++ = *src16++;
-			*dst16++ = *src16++;
-			*dst16++ = *src16++;
-		} while (--uCount);
-#endif
-	} else
-	{
-		uCount = 32;
-		const u8*__restrict__ src8 = (const u8*__restrict__)src;
-		do {
-			dst16[ 0] = RGB24(src8[0], src8[ 1], src8[ 2] );
-			dst16[ 1] = RGB24(src8[3], src8[ 4], src8[ 5] );
-			dst16[ 2] = dst16[1];
-			dst16[ 3] = RGB24(src8[6], src8[ 7], src8[ 8] );
-			dst16[ 4] = RGB24(src8[9], src8[10], src8[11] );
-
-			dst16[ 5] = RGB24(src8[12], src8[13], src8[14] );
-			dst16[ 6] = RGB24(src8[15], src8[16], src8[17] );
-			dst16[ 7] = dst16[6];
-			dst16[ 8] = RGB24(src8[18], src8[19], src8[20] );
-			dst16[ 9] = RGB24(src8[21], src8[22], src8[23] );
-			dst16 += 10;
-			src8  += 24;
-		} while (--uCount);
-	}
-}
-
-
-static inline void GPU_BlitWS(const void*__restrict__ src, u16*__restrict__ dst16, bool isRGB24)
-{
-	u32 uCount;
-	if (!isRGB24) {
-#ifndef USE_BGR15
-		uCount = 20;
-		const u16*__restrict__ src16 = (const u16*__restrict__) src;
-		do {
-			dst16[ 0] = RGB16(src16[0]);
-			dst16[ 1] = RGB16(src16[2]);
-			dst16[ 2] = RGB16(src16[4]);
-			dst16[ 3] = RGB16(src16[6]);
-
-			dst16[ 4] = RGB16(src16[8]);
-			dst16[ 5] = RGB16(src16[10]);
-			dst16[ 6] = RGB16(src16[12]);
-			dst16[ 7] = RGB16(src16[14]);
-
-			dst16[ 8] = RGB16(src16[16]);
-			dst16[ 9] = RGB16(src16[18]);
-			dst16[10] = RGB16(src16[20]);
-			dst16[11] = RGB16(src16[22]);
-
-			dst16[12] = RGB16(src16[24]);
-			dst16[13] = RGB16(src16[26]);
-			dst16[14] = RGB16(src16[28]);
-			dst16[15] = RGB16(src16[30]);
-
-			dst16 += 16;
-			src16 += 32;
-		} while (--uCount);
-#else
-		uCount = 320;
-		const u16*__restrict__ src16 = (const u16*__restrict__) src;
-		do {
-			*dst16++ = *src16;
-			src16 += 2;
-		} while (--uCount);
-#endif
-	} else
-	{
-		uCount = 20;
-		const u8*__restrict__ src8 = (const u8*__restrict__) src;
-		do {
-			dst16[ 0] = RGB24(src8[ 0], src8[ 1], src8[ 2] );
-			dst16[ 1] = RGB24(src8[ 6], src8[ 7], src8[ 8] );
-			dst16[ 2] = RGB24(src8[12], src8[13], src8[14] );
-			dst16[ 3] = RGB24(src8[18], src8[19], src8[20] );
-
-			dst16[ 4] = RGB24(src8[24], src8[25], src8[26] );
-			dst16[ 5] = RGB24(src8[30], src8[31], src8[32] );
-			dst16[ 6] = RGB24(src8[36], src8[37], src8[38] );
-			dst16[ 7] = RGB24(src8[42], src8[43], src8[44] );
-
-			dst16[ 8] = RGB24(src8[48], src8[49], src8[50] );
-			dst16[ 9] = RGB24(src8[54], src8[55], src8[56] );
-			dst16[10] = RGB24(src8[60], src8[61], src8[62] );
-			dst16[11] = RGB24(src8[66], src8[67], src8[68] );
-
-			dst16[12] = RGB24(src8[72], src8[73], src8[74] );
-			dst16[13] = RGB24(src8[78], src8[79], src8[80] );
-			dst16[14] = RGB24(src8[84], src8[85], src8[86] );
-			dst16[15] = RGB24(src8[90], src8[91], src8[92] );
-
-			dst16 += 16;
-			src8  += 96;
-		} while(--uCount);
+	if (full || vout_redraw_all || memcmp(layout, vout_layout, sizeof(vout_layout))) {
+		memcpy(vout_layout, layout, sizeof(vout_layout));
+		vout_redraw_all = false;
+		memset(vout_row_redraws, VOUT_BUFFERS, sizeof(vout_row_redraws));
+	} else {
+		for (int i = 0; i < 512 / 32; i++) {
+			u32 bits = gpu.state.dirty_rows[i];
+			for (int y = i * 32; bits; bits >>= 1, y++)
+				if (bits & 1)
+					vout_row_redraws[y] = VOUT_BUFFERS;
+		}
 	}
+	memset(gpu.state.dirty_rows, 0, sizeof(gpu.state.dirty_rows));
+	vout_blitted = false;
 }
 
-
-static inline void GPU_BlitCopy(const void*__restrict__ src, u16*__restrict__ dst16, int w, bool isRGB24)
+static inline bool vout_row_dirty(unsigned int src16_offs)
 {
-	u32 uCount;
-	if (!isRGB24)
-	{
-#ifndef USE_BGR15
-		uCount = w / 2;
-		const u32*__restrict__ src32 = (const u32*__restrict__) src;
-		u32*__restrict__ dst32 = (u32*__restrict__)(void*) dst16;
-		do {
-			uint32_t s = *src32++;
-			*dst32++ = RGB16X2(s);
-		} while(--uCount);
-#else
-		MEMCPY(dst16, src, w * 2);
-#endif
-	} else
-	{
-		uCount = w;
-		const u8*__restrict__ src8 = (const u8*__restrict__)src;
-		do{
-			*dst16++ = RGB24(src8[ 0], src8[ 1], src8[ 2] );
-			src8  += 3;
-		} while (--uCount);
-	}
+	u8 *redraws = &vout_row_redraws[src16_offs >> 10];
+	if (!*redraws)
+		return false;
+	(*redraws)--;
+	vout_blitted = true;
+	return true;
 }
 
-
 // Basically an adaption of old gpu_unai/gpu.cpp's gpuVideoOutput() that
 //  assumes 320x240 destination resolution (for now)
 // TODO: clean up / improve / add HW scaling support
@@ -459,6 +92,13 @@ void vout_update(void)
 		return;
 
 	bool isRGB24 = gpu.status.rgb24;
+
+	const int layout[10] = { x0, y0, w0, w1, h0, h1, isRGB24, Config.VideoScaling,
+	                         SCREEN_WIDTH, SCREEN_HEIGHT };
+	// FPS overlay is drawn on top of the frame, and lines read past the
+	//  right edge of VRAM continue on the next row: redraw all for those
+	int x_end = x0 + (isRGB24 ? w0 * 3 / 2 : w0);
+	vout_take_dirty_rows(layout, Config.ShowFps || x_end > 1024);
 	u16* dst16 = SCREEN;
 	u16* src16 = (u16*)gpu.vram;
 
@@ -490,7 +130,8 @@ void vout_update(void)
 		switch (w0) {
 			case 256: {
 				for (int y1 = y0 + h1; y0 < y1; y0 += incY) {
-					GPU_BlitWWDWW(src16 + src16_offs, dst16, isRGB24);
+					if (vout_row_dirty(src16_offs))
+						vout_blit.wwdww(src16 + src16_offs, dst16, isRGB24);
 					dst16 += SCREEN_WIDTH;
 					src16_offs = (src16_offs + h0) & src16_offs_msk;
 				}
@@ -499,7 +140,8 @@ void vout_update(void)
 
 			case 368: {
 				for (int y1 = y0 + h1; y0 < y1; y0 += incY) {
-					GPU_BlitWWWWWWWWS(src16 + src16_offs, dst16, isRGB24, 4);
+					if (vout_row_dirty(src16_offs))
+						vout_blit.wwwwwwwws(src16 + src16_offs, dst16, isRGB24, 4);
 					dst16 += SCREEN_WIDTH;
 					src16_offs = (src16_offs + h0) & src16_offs_msk;
 				}
@@ -510,7 +152,8 @@ void vout_update(void)
 				// Ensure 32-bit alignment for GPU_BlitWW() blitter:
 				src16_offs &= ~1;
 				for (int y1 = y0 + h1; y0 < y1; y0 += incY) {
-					GPU_BlitWW(src16 + src16_offs, dst16, isRGB24);
+					if (vout_row_dirty(src16_offs))
+						vout_blit.ww(src16 + src16_offs, dst16, isRGB24);
 					dst16 += SCREEN_WIDTH;
 					src16_offs = (src16_offs + h0) & src16_offs_msk;
 				}
@@ -519,7 +162,8 @@ void vout_update(void)
 
 			case 384: {
 				for (int y1 = y0 + h1; y0 < y1; y0 += incY) {
-					GPU_BlitWWWWWS(src16 + src16_offs, dst16, isRGB24);
+					if (vout_row_dirty(src16_offs))
+						vout_blit.wwwwws(src16 + src16_offs, dst16, isRGB24);
 					dst16 += SCREEN_WIDTH;
 					src16_offs = (src16_offs + h0) & src16_offs_msk;
 				}
@@ -528,7 +172,8 @@ void vout_update(void)
 
 			case 512: {
 				for (int y1 = y0 + h1; y0 < y1; y0 += incY) {
-					GPU_BlitWWSWWSWS(src16 + src16_offs, dst16, isRGB24);
+					if (vout_row_dirty(src16_offs))
+						vout_blit.wwswwsws(src16 + src16_offs, dst16, isRGB24);
 					dst16 += SCREEN_WIDTH;
 					src16_offs = (src16_offs + h0) & src16_offs_msk;
 				}
@@ -537,7 +182,8 @@ void vout_update(void)
 
 			case 640: {
 				for (int y1 = y0 + h1; y0 < y1; y0 += incY) {
-					GPU_BlitWS(src16 + src16_offs, dst16, isRGB24);
+					if (vout_row_dirty(src16_offs))
+						vout_blit.ws(src16 + src16_offs, dst16, isRGB24);
 					dst16 += SCREEN_WIDTH;
 					src16_offs = (src16_offs + h0) & src16_offs_msk;
 				}
@@ -559,16 +205,29 @@ void vout_update(void)
 
 		src16_offs &= ~1u;
 		for (int y1 = y0+h1; y0<y1; y0++) {
-			GPU_BlitCopy(src16+src16_offs, dst16, w1, isRGB24);
+			if (vout_row_dirty(src16_offs))
+				vout_blit.copy(src16+src16_offs, dst16, w1, isRGB24);
 			dst16 += SCREEN_WIDTH;
 			src16_offs = (src16_offs+1024) & src16_offs_msk;
 		}
 	}
-	video_flip();
+
+	// Nothing changed on screen, keep showing the last frame
+	if (vout_blitted)
+		video_flip();
 }
 
 int vout_init(void)
 {
+	vout_blit = vout_blitters_scalar;
+#ifdef VOUT_SIMD
+	vout_blit = vout_blitters_simd128;
+#if defined(__x86_64__) || defined(__i386__)
+	if (__builtin_cpu_supports("avx2"))
+		vout_blit = vout_blitters_avx2;
+#endif
+	printf("vout: using %s blitters\n", vout_blit.name);
+#endif
 	return 0;
 }
 
@@ -577,6 +236,13 @@ int vout_finish(void)
 	return 0;
 }
 
+// SCREEN was changed behind vout's back (e.g. cleared by plugin_lib):
+//  redraw every row into all video buffers on the next updates
+void vout_redraw(void)
+{
+	vout_redraw_all = true;
+}
+
 //senquack - Handles PSX display disabling (TODO: implement?)
 void vout_blank(void)
 {
@@ -0,0 +1,284 @@
+/*
+ * Vector versions of vout_port.cpp line blitters
+ *
+ * This work is licensed under the terms of any of these licenses
+ * (at your option):
+ *  - GNU GPL, version 2 or later.
+ *  - GNU LGPL, version 2.1 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#ifndef VOUT_SIMD_H
+#define VOUT_SIMD_H
+
+// Written with GCC vector extensions, so the same code is SSE2 (or AVX2,
+//  picked at runtime) on x86 and NEON on ARM. Targets without a vector
+//  unit keep the scalar blitters. Results are bit-exact with the scalar
+//  blitters, both convert pixels with the RGB16()/RGB24() macros.
+#if !defined(NO_VOUT_SIMD) && (defined(__clang__) || __GNUC__ >= 9) && \
+    (defined(__SSE2__) || defined(__ARM_NEON) || defined(__ARM_NEON__))
+#define VOUT_SIMD
+
+#ifndef USE_BGR15
+#define VOUT_RGB16(C) RGB16(C)
+#else
+#define VOUT_RGB16(C) (C)
+#endif
+
+#define VOUT_INLINE static inline __attribute__((always_inline))
+
+// N: vector size in bytes
+template <int N> struct VoutVec {
+	typedef u16 v16 __attribute__((vector_size(N)));
+	typedef u32 v32 __attribute__((vector_size(N)));
+	typedef u16 h16 __attribute__((vector_size(N / 2)));  // Narrowed v32
+};
+
+// 'n' 15bpp pixels
+template <int N> VOUT_INLINE void vout_conv15(const u16 *src, u16 *dst, int n)
+{
+	typedef typename VoutVec<N>::v16 v16;
+	for (; n >= N / 2; n -= N / 2, src += N / 2, dst += N / 2) {
+		v16 v;
+		memcpy(&v, src, N);
+		v = VOUT_RGB16(v);
+		memcpy(dst, &v, N);
+	}
+	for (; n > 0; n--, src++)
+		*dst++ = VOUT_RGB16(*src);
+}
+
+// 'n' 15bpp pixels, from every other source pixel
+template <int N> VOUT_INLINE void vout_conv15_even(const u16 *src, u16 *dst, int n)
+{
+#ifndef __clang__
+	// Convert two vectors and pick even lanes, plain SSE2 has no cheap
+	//  u32 -> u16 narrowing for the variant below
+	typedef typename VoutVec<N>::v16 v16;
+	v16 even;
+	for (int i = 0; i < N / 2; i++)
+		even[i] = 2 * i;
+	for (; n >= N / 2; n -= N / 2, src += N, dst += N / 2) {
+		v16 a, b;
+		memcpy(&a, src, N);
+		memcpy(&b, src + N / 2, N);
+		a = VOUT_RGB16(a);
+		b = VOUT_RGB16(b);
+		a = __builtin_shuffle(a, b, even);
+		memcpy(dst, &a, N);
+	}
+#else
+	typedef typename VoutVec<N>::v32 v32;
+	typedef typename VoutVec<N>::h16 h16;
+	for (; n >= N / 4; n -= N / 4, src += N / 2, dst += N / 4) {
+		v32 v;
+		memcpy(&v, src, N);
+		v &= 0xffff;
+		v = VOUT_RGB16(v);
+		h16 h = __builtin_convertvector(v, h16);
+		memcpy(dst, &h, N / 2);
+	}
+#endif
+	for (; n > 0; n--, src += 2)
+		*dst++ = VOUT_RGB16(*src);
+}
+
+// 24bpp pixels are gathered into vector lanes with one load each, which
+//  costs more than the conversion. 4 lanes at a time, wider vectors
+//  don't help there.
+#define VOUT_CONV24_LANES 4
+typedef u32 vout_v32x4 __attribute__((vector_size(16)));
+typedef u16 vout_v16x4 __attribute__((vector_size(8)));
+
+VOUT_INLINE vout_v16x4 vout_conv24_lanes(const u8 *src, const int *offs)
+{
+	vout_v32x4 v;
+	for (int i = 0; i < VOUT_CONV24_LANES; i++) {
+		u32 px;
+		memcpy(&px, src + offs[i], 4);
+		v[i] = px;
+	}
+	vout_v32x4 r = v & 0xff, g = (v >> 8) & 0xff, b = (v >> 16) & 0xff;
+	v = RGB24(r, g, b);
+	return __builtin_convertvector(v, vout_v16x4);
+}
+
+// 'n' 24bpp pixels, from every 'step'th source pixel. Reads one byte past
+//  the last pixel, VRAM buffer is larger than VRAM.
+VOUT_INLINE void vout_conv24(const u8 *src, u16 *dst, int n, int step)
+{
+	const int stride = 3 * step;
+	const int offs[VOUT_CONV24_LANES] = { 0, stride, stride * 2, stride * 3 };
+	for (; n >= VOUT_CONV24_LANES; n -= VOUT_CONV24_LANES) {
+		vout_v16x4 h = vout_conv24_lanes(src, offs);
+		memcpy(dst, &h, sizeof(h));
+		src += stride * VOUT_CONV24_LANES;
+		dst += VOUT_CONV24_LANES;
+	}
+	for (; n > 0; n--, src += stride)
+		*dst++ = RGB24(src[0], src[1], src[2]);
+}
+
+template <int N> VOUT_INLINE void vout_conv_line(const void *src, u16 *dst, int n, bool isRGB24)
+{
+	if (!isRGB24)
+		vout_conv15<N>((const u16 *)src, dst, n);
+	else
+		vout_conv24((const u8 *)src, dst, n, 1);
+}
+
+// Vector versions are only used where voutbench shows them beating the
+//  scalar ones. GCC vectorises the scalar 15bpp 320 and 640 scalers' pair
+//  conversion by itself, 16-byte vectors are no faster there.
+
+template <int N> VOUT_INLINE void vout_blit_ww(const void *src, u16 *dst16, bool isRGB24)
+{
+#ifndef USE_BGR15
+	if (N == 16 && !isRGB24) {
+		GPU_BlitWW(src, dst16, isRGB24);
+		return;
+	}
+#endif
+	vout_conv_line<N>(src, dst16, 320, isRGB24);
+}
+
+// Uneven scalers: with USE_BGR15 there's nothing to convert and the scalar
+//  versions pick 15bpp pixels straight from the source, so they are used
+//  as they are (see VOUT_SIMD_UNEVEN). Gathering 24bpp pixels into lanes
+//  is no faster than scalar either, so only 15bpp lines needing RGB16()
+//  are converted with vectors, then pixels are picked from the result.
+#ifndef USE_BGR15
+template <int N> VOUT_INLINE void vout_blit_wwswwsws(const void *src, u16 *dst16, bool isRGB24)
+{
+	if (isRGB24) {
+		GPU_BlitWWSWWSWS(src, dst16, isRGB24);
+		return;
+	}
+	u16 line[512];
+	vout_conv15<N>((const u16 *)src, line, 512);
+	for (const u16 *s = line; s < line + 512; s += 8, dst16 += 5) {
+		dst16[0] = s[0];
+		dst16[1] = s[1];
+		dst16[2] = s[3];
+		dst16[3] = s[4];
+		dst16[4] = s[6];
+	}
+}
+
+template <int N> VOUT_INLINE void vout_blit_wwwwws(const void *src, u16 *dst16, bool isRGB24)
+{
+	if (isRGB24) {
+		GPU_BlitWWWWWS(src, dst16, isRGB24);
+		return;
+	}
+	u16 line[384];
+	vout_conv15<N>((const u16 *)src, line, 384);
+	for (const u16 *s = line; s < line + 384; s += 6, dst16 += 5)
+		memcpy(dst16, s, 2 * 5);
+}
+
+template <int N> VOUT_INLINE void vout_blit_wwdww(const void *src, u16 *dst16, bool isRGB24)
+{
+	if (isRGB24) {
+		GPU_BlitWWDWW(src, dst16, isRGB24);
+		return;
+	}
+	u16 line[256];
+	vout_conv15<N>((const u16 *)src, line, 256);
+	for (const u16 *s = line; s < line + 256; s += 8, dst16 += 10) {
+		dst16[0] = s[0];
+		dst16[1] = s[1];
+		dst16[2] = s[1];
+		dst16[3] = s[2];
+		dst16[4] = s[3];
+		dst16[5] = s[4];
+		dst16[6] = s[5];
+		dst16[7] = s[5];
+		dst16[8] = s[6];
+		dst16[9] = s[7];
+	}
+}
+#endif // USE_BGR15
+
+// 8 of every 9 source pixels are consecutive, convert them in place
+template <int N> VOUT_INLINE void vout_blit_wwwwwwwws(const void *src, u16 *dst16, bool isRGB24, u32 uClip_src)
+{
+	if (!isRGB24) {
+		const u16 *src16 = (const u16 *)src + uClip_src;
+		for (int i = 0; i < 40; i++, src16 += 9, dst16 += 8)
+			vout_conv15<16>(src16, dst16, 8);
+	} else {
+		const u8 *src8 = (const u8 *)src + uClip_src * 3;
+		for (int i = 0; i < 40; i++, src8 += 9 * 3, dst16 += 8)
+			vout_conv24(src8, dst16, 8, 1);
+	}
+}
+
+template <int N> VOUT_INLINE void vout_blit_ws(const void *src, u16 *dst16, bool isRGB24)
+{
+#ifndef USE_BGR15
+	if (N == 16 && !isRGB24) {
+		GPU_BlitWS(src, dst16, isRGB24);
+		return;
+	}
+#endif
+	if (!isRGB24)
+		vout_conv15_even<N>((const u16 *)src, dst16, 320);
+	else
+		vout_conv24((const u8 *)src, dst16, 320, 2);
+}
+
+// Scalar version converts 15bpp pixels in pairs
+template <int N> VOUT_INLINE void vout_blit_copy(const void *src, u16 *dst16, int w, bool isRGB24)
+{
+#ifdef USE_BGR15
+	if (!isRGB24) {
+		memcpy(dst16, src, w * 2);
+		return;
+	}
+#endif
+	vout_conv_line<N>(src, dst16, isRGB24 ? w : w & ~1, isRGB24);
+}
+
+#ifndef USE_BGR15
+#define VOUT_SIMD_UNEVEN(N, name, attr) \
+attr static void vout_wwswwsws_##name(const void *src, u16 *dst16, bool isRGB24) \
+	{ vout_blit_wwswwsws<N>(src, dst16, isRGB24); } \
+attr static void vout_wwwwws_##name(const void *src, u16 *dst16, bool isRGB24) \
+	{ vout_blit_wwwwws<N>(src, dst16, isRGB24); } \
+attr static void vout_wwdww_##name(const void *src, u16 *dst16, bool isRGB24) \
+	{ vout_blit_wwdww<N>(src, dst16, isRGB24); }
+#define VOUT_UNEVEN(fn, scalar, name) fn##_##name
+#else
+#define VOUT_SIMD_UNEVEN(N, name, attr)
+#define VOUT_UNEVEN(fn, scalar, name) scalar
+#endif
+
+// Instantiate a vout_blitters table 'vout_blitters_<name>', functions are
+//  compiled with 'attr' (target ISA)
+#define VOUT_SIMD_BLITTERS(N, name, attr) \
+VOUT_SIMD_UNEVEN(N, name, attr) \
+attr static void vout_ww_##name(const void *src, u16 *dst16, bool isRGB24) \
+	{ vout_blit_ww<N>(src, dst16, isRGB24); } \
+attr static void vout_wwwwwwwws_##name(const void *src, u16 *dst16, bool isRGB24, u32 uClip_src) \
+	{ vout_blit_wwwwwwwws<N>(src, dst16, isRGB24, uClip_src); } \
+attr static void vout_ws_##name(const void *src, u16 *dst16, bool isRGB24) \
+	{ vout_blit_ws<N>(src, dst16, isRGB24); } \
+attr static void vout_copy_##name(const void *src, u16 *dst16, int w, bool isRGB24) \
+	{ vout_blit_copy<N>(src, dst16, w, isRGB24); } \
+static const vout_blitters vout_blitters_##name = { #name, \
+	vout_ww_##name, \
+	VOUT_UNEVEN(vout_wwswwsws, GPU_BlitWWSWWSWS, name), \
+	VOUT_UNEVEN(vout_wwwwws, GPU_BlitWWWWWS, name), \
+	vout_wwwwwwwws_##name, \
+	VOUT_UNEVEN(vout_wwdww, GPU_BlitWWDWW, name), \
+	vout_ws_##name, vout_copy_##name };
+
+VOUT_SIMD_BLITTERS(16, simd128, )
+#if defined(__x86_64__) || defined(__i386__)
+VOUT_SIMD_BLITTERS(32, avx2, __attribute__((target("avx2"))))
+#endif
+
+#endif // VOUT_SIMD
+
+#endif // VOUT_SIMD_H
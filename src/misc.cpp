@@ -32,6 +32,7 @@
 #include "plugin_lib.h"
 #include "ppf.h"
 #include "psxevents.h"
+#include "psxhle.h"
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -195,6 +196,7 @@ int LoadCdrom() {
 	u8 time[4], *buf;
 	u8 mdir[4096];
 	char exename[256];
+	u32 exe_addr, exe_size;
 
 	// not the best place to do it, but since BIOS boot logo killer
 	// is just below, do it here
@@ -266,6 +268,9 @@ int LoadCdrom() {
 	psxCpu->Clear(tmpHead.t_addr, tmpHead.t_size / 4);
 #endif
 
+	exe_addr = tmpHead.t_addr;
+	exe_size = tmpHead.t_size & ~2047;
+
 	// Read the rest of the main executable
 	while (tmpHead.t_size & ~2047) {
 		void *ptr = (void *)PSXM(tmpHead.t_addr);
@@ -279,6 +284,8 @@ int LoadCdrom() {
 		tmpHead.t_addr += 2048;
 	}
 
+	psxHLELibcScan(exe_addr, exe_size);
+
 	return 0;
 }
 
@@ -310,6 +317,7 @@ int LoadCdromFile(const char *filename, EXE_HEADER *head) {
 	memcpy(head, buf + 12, sizeof(EXE_HEADER));
 	size = head->t_size;
 	addr = head->t_addr;
+	const u32 exe_addr = addr, exe_size = size & ~2047;
 
 #ifdef PSXREC
 	psxCpu->Clear(addr, size / 4);
@@ -327,6 +335,8 @@ int LoadCdromFile(const char *filename, EXE_HEADER *head) {
 		addr += 2048;
 	}
 
+	psxHLELibcScan(exe_addr, exe_size);
+
 	return 0;
 }
 
@@ -343,12 +353,12 @@ int CheckCdrom() {
 	time[1] = itob(2);
 	time[2] = itob(0x10);
 
-	READTRACK();
-
 	memset(CdromLabel, 0, sizeof(CdromLabel));
 	memset(CdromId, 0, sizeof(CdromId));
 	memset(exename, 0, sizeof(exename));
 
+	READTRACK();
+
 	strncpy(CdromLabel, (char*)buf + 52, 32);
 
 	// skip head and sub, and go to the root directory record
@@ -489,6 +499,7 @@ int Load(const char *ExePath) {
 #ifdef PSXREC
 					psxCpu->Clear(section_address, section_size / 4);
 #endif
+					psxHLELibcScan(section_address, section_size);
 				}
 				psxRegs.pc = SWAP32(tmpHead.pc0);
 				psxRegs.GPR.n.gp = SWAP32(tmpHead.gp0);
@@ -536,6 +547,7 @@ int Load(const char *ExePath) {
 #ifdef PSXREC
 								psxCpu->Clear(section_address, section_size / 4);
 #endif
+								psxHLELibcScan(section_address, section_size);
 							}
 							break;
 						case 3: /* register loading (PC only?) */
@@ -918,6 +930,79 @@ error:
 	return -1;
 }
 
+/////////////////////////////
+// BIOS boot snapshot cache //
+/////////////////////////////
+
+// Booting a real BIOS up to its hand-off to the shell at 0x80030000 (see
+//  psxExecuteBios()) takes seconds on slow devices, and always ends in the
+//  same machine state for a given BIOS, region and disc. That state is saved
+//  as a regular savestate the first time, and restored on later boots.
+//  Since it includes CD-ROM state, snapshots are kept per disc, and none is
+//  used for discs without a proper ID.
+
+#define BOOT_SNAPSHOT_PATH_LEN  (MAXPATHLEN + 48)
+
+// Returns false if no snapshot should be used for this boot
+static bool BootSnapshotPath(char *path, size_t size)
+{
+	const char *disc = "nodisc";
+	u32 crc;
+
+	if (Config.BootSnapshotDir[0] == '\0')
+		return false;
+
+	if (UsingIso()) {
+		// CheckCdrom() failed, or disc has no ID of its own
+		if (CdromId[0] == '\0' || strcmp(CdromId, "SLUS99999") == 0)
+			return false;
+		disc = CdromId;
+	}
+
+	crc = crc32(0L, (const Bytef*)psxR, 0x80000);
+	snprintf(path, size, "%s/bios_%08x_%s_%.9s.boot", Config.BootSnapshotDir, crc,
+	         Config.PsxType == PSX_TYPE_PAL ? "pal" : "ntsc", disc);
+	return true;
+}
+
+// Returns 0: state restored
+//         1: no usable snapshot, state untouched
+//        -1: restore failed, state must be reset
+int BootSnapshotLoad(void)
+{
+	char path[BOOT_SNAPSHOT_PATH_LEN];
+	bool hle;
+
+	if (!BootSnapshotPath(path, sizeof(path)) || !FileExists(path))
+		return 1;
+
+	if (CheckState(path, &hle, false, NULL) != CHECKSTATE_SUCCESS || hle) {
+		printf("Ignoring unusable BIOS boot snapshot %s\n", path);
+		remove(path);
+		return 1;
+	}
+
+	if (LoadState(path) != 0) {
+		printf("Failed restoring BIOS boot snapshot %s\n", path);
+		remove(path);
+		return -1;
+	}
+
+	printf("Restored BIOS boot snapshot %s\n", path);
+	return 0;
+}
+
+void BootSnapshotSave(void)
+{
+	char path[BOOT_SNAPSHOT_PATH_LEN];
+
+	if (!BootSnapshotPath(path, sizeof(path)))
+		return;
+
+	if (SaveState(path) != 0)
+		remove(path);
+}
+
 // Checks if sstate 'file' contains a valid header and version.
 // If 'get_sshot' is true, it will check if it contains screenshot data.
 // If 'get_sshot' is true and 'sshot_image' is not NULL, it will copy
@@ -73,6 +73,9 @@ int SaveState(const char *file);
 int LoadState(const char *file);
 int CheckState(const char *file, bool *uses_hle, bool get_sshot, u16 *sshot_image);
 
+int BootSnapshotLoad(void);
+void BootSnapshotSave(void);
+
 enum {
 	CHECKSTATE_SUCCESS        = 0,
 	CHECKSTATE_ERR_OPEN       = -1,
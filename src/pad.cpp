@@ -245,6 +245,25 @@ unsigned char PAD1_poll(unsigned char value) {
 	return buf[g.CurByte1++];
 }
 
+// Returns true if, after command byte 'cmd', the pad's reply doesn't depend
+//  on the bytes sent to it. SIO can then fetch the whole reply at once.
+bool PAD1_pollIsStatic(unsigned char cmd)
+{
+	// Digital pad: command is always treated as CMD_READ_DATA_AND_VIBRATE
+	if (player_controller[0].pad_controllertype == 0)
+		return true;
+
+	// DualShock read with no vibration motors mapped to reply bytes
+	return cmd == CMD_READ_DATA_AND_VIBRATE &&
+	       player_controller[0].Vib[0] == 0 &&
+	       player_controller[0].Vib[1] == 0;
+}
+
+bool PAD2_pollIsStatic(unsigned char cmd)
+{
+	return true;
+}
+
 unsigned char PAD2_poll(unsigned char value) {
 	static uint8_t buf[8] = {0xFF, 0x5A, 0xFF, 0xFF, 0x80, 0x80, 0x80, 0x80};
 
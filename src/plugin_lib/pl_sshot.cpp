@@ -34,6 +34,11 @@
 void pl_screenshot_160x120_rgb565(uint16_t *dst)
 {
 	memset((void*)dst, 0, 160*120*2);
+
+	// Wait for GPU to finish drawing commands queued since last frame, and
+	//  get current display area: VRAM is read directly below
+	GPU_getScreenInfo(&pl_data.sinfo);
+
 	int x = pl_data.sinfo.x;
 	int y = pl_data.sinfo.y;
 	int w = pl_data.sinfo.w;
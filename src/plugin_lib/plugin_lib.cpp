@@ -51,6 +51,10 @@ void pl_clear_screen()
 {
 	u16 *dst = SCREEN;
 	memset((void*)dst, 0, SCREEN_WIDTH*SCREEN_HEIGHT*2);
+#ifdef USE_GPULIB
+	// vout only redraws changed rows, make it fill the cleared buffers again
+	vout_redraw();
+#endif
 }
 
 void pl_clear_borders()
@@ -70,6 +70,10 @@ void GPU_getScreenInfo(GPUScreenInfo_t *sinfo);
 
 #ifdef USE_GPULIB
 void GPU_vBlank(int is_vblank, int lcf);
+uint32_t GPU_drawCycles(void);
+#else
+// Other GPU plugins don't estimate drawing time
+#define GPU_drawCycles() 0
 #endif
 
 // CDROM structures
@@ -189,6 +193,8 @@ unsigned char PAD1_startPoll(void);
 unsigned char PAD2_startPoll(void);
 unsigned char PAD1_poll(unsigned char);
 unsigned char PAD2_poll(unsigned char);
+bool PAD1_pollIsStatic(unsigned char);
+bool PAD2_pollIsStatic(unsigned char);
 
 // ISO functions
 
@@ -1462,6 +1462,24 @@ static void videoscaling_hint() {
 		break;
 	}
 }
+
+static int gputhread_alter(u32 keys)
+{
+	if (keys & KEY_RIGHT) {
+		if (Config.GpuThread == false) Config.GpuThread = true;
+	} else if (keys & KEY_LEFT) {
+		if (Config.GpuThread == true) Config.GpuThread = false;
+	}
+
+	return 0;
+}
+
+static char *gputhread_show()
+{
+	static char buf[16] = "\0";
+	sprintf(buf, "%s", Config.GpuThread == true ? "on" : "off");
+	return buf;
+}
 #endif //USE_GPULIB
 
 #ifdef GPU_UNAI
@@ -1485,6 +1503,40 @@ static char *ntsc_fix_show()
 	return buf;
 }
 
+#ifdef GPU_UNAI_USE_BANDS
+static int bands_alter(u32 keys)
+{
+	if (keys & KEY_RIGHT) {
+		if (gpu_unai_config_ext.bands < 2)
+			gpu_unai_config_ext.bands = 2;
+		else if (gpu_unai_config_ext.bands < 4)
+			gpu_unai_config_ext.bands++;
+	} else if (keys & KEY_LEFT) {
+		if (gpu_unai_config_ext.bands > 2)
+			gpu_unai_config_ext.bands--;
+		else
+			gpu_unai_config_ext.bands = 0;
+	}
+
+	return 0;
+}
+
+static char *bands_show()
+{
+	static char buf[16] = "\0";
+	if (gpu_unai_config_ext.bands > 1)
+		sprintf(buf, "%d", gpu_unai_config_ext.bands);
+	else
+		sprintf(buf, "off");
+	return buf;
+}
+
+static void bands_hint()
+{
+	port_printf(6 * 8, 10 * 8, "Applied after emulator restart");
+}
+#endif
+
 static int interlace_alter(u32 keys)
 {
 	if (keys & KEY_RIGHT) {
@@ -1613,6 +1665,7 @@ static int gpu_settings_defaults()
 	Config.ShowFps = 0;
 	Config.FrameLimit = true;
 	Config.FrameSkip = FRAMESKIP_OFF;
+	Config.GpuThread = 0;
 
 #ifdef GPU_UNAI
 #ifndef USE_GPULIB
@@ -1624,6 +1677,7 @@ static int gpu_settings_defaults()
 	gpu_unai_config_ext.fast_lighting = 1;
 	gpu_unai_config_ext.blending = 1;
 	gpu_unai_config_ext.dithering = 0;
+	gpu_unai_config_ext.bands = 0;
 #endif
 
 	return 0;
@@ -1637,6 +1691,7 @@ static MENUITEM gui_GPUSettingsItems[] = {
 	/* Only working with gpulib */
 	{(char *)"Frame skip           ", NULL, &frameskip_alter, &frameskip_show, NULL},
 	{(char *)"Video Scaling        ", NULL, &videoscaling_alter, &videoscaling_show, videoscaling_hint},
+	{(char *)"Threaded rendering   ", NULL, &gputhread_alter, &gputhread_show, NULL},
 #endif
 #ifdef GPU_UNAI
 	{(char *)"NTSC Resolution Fix  ", NULL, &ntsc_fix_alter, &ntsc_fix_show, NULL},
@@ -1645,6 +1700,9 @@ static MENUITEM gui_GPUSettingsItems[] = {
 	{(char *)"Lighting             ", NULL, &lighting_alter, &lighting_show, NULL},
 	{(char *)"Fast lighting        ", NULL, &fast_lighting_alter, &fast_lighting_show, NULL},
 	{(char *)"Blending             ", NULL, &blending_alter, &blending_show, NULL},
+#ifdef GPU_UNAI_USE_BANDS
+	{(char *)"Render bands         ", NULL, &bands_alter, &bands_show, bands_hint},
+#endif
 	// {(char *)"Pixel skip           ", NULL, &pixel_skip_alter, &pixel_skip_show, NULL},
 #endif
 	{(char *)"Restore defaults     ", &gpu_settings_defaults, NULL, NULL, NULL},
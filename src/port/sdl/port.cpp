@@ -9,6 +9,7 @@
 #include "plugin_lib.h"
 #include "perfmon.h"
 #include "cheat.h"
+#include "psxprofiler.h"
 #include <SDL.h>
 
 /* PATH_MAX inclusion */
@@ -317,6 +318,9 @@ void config_load()
 		} else if (!strcmp(line, "VideoScaling")) {
 			sscanf(arg, "%d", &value);
 			Config.VideoScaling = value;
+		} else if (!strcmp(line, "GpuThread")) {
+			sscanf(arg, "%d", &value);
+			Config.GpuThread = value;
 		}
 #ifdef SPU_PCSXREARMED
 		else if (!strcmp(line, "SpuUseInterpolation")) {
@@ -356,6 +360,18 @@ void config_load()
 			}
 
 			strcpy(Config.BiosDir, arg);
+		} else if (!strcmp(line, "LibcOptOut")) {
+			int len = strlen(arg);
+
+			if (len == 0 || len > sizeof(Config.LibcOptOut) - 1) {
+				continue;
+			}
+
+			if (arg[len-1] == '\n') {
+				arg[len-1] = '\0';
+			}
+
+			strcpy(Config.LibcOptOut, arg);
 		} else if (!strcmp(line, "Bios")) {
 			int len = strlen(arg);
 
@@ -398,6 +414,12 @@ void config_load()
 		} else if (!strcmp(line, "ntsc_fix")) {
 			sscanf(arg, "%d", &value);
 			gpu_unai_config_ext.ntsc_fix = value;
+		} else if (!strcmp(line, "bands")) {
+			sscanf(arg, "%d", &value);
+			gpu_unai_config_ext.bands = value;
+		} else if (!strcmp(line, "tex_cache")) {
+			sscanf(arg, "%d", &value);
+			gpu_unai_config_ext.tex_cache = value;
 		}
 #endif
 #ifdef GCW_ZERO
@@ -447,13 +469,15 @@ void config_save()
 		   "ShowFps %d\n"
 		   "FrameLimit %d\n"
 		   "FrameSkip %d\n"
-		   "VideoScaling %d\n",
+		   "VideoScaling %d\n"
+		   "GpuThread %d\n",
 		   CONFIG_VERSION, Config.Xa, Config.Mdec, Config.PsxAuto, Config.Cdda,
 		   Config.HLE, Config.SlowBoot, Config.AnalogArrow, Config.AnalogMode,
 		   Config.RCntFix, Config.VSyncWA, Config.Cpu, Config.PsxType,
 		   Config.McdSlot1, Config.McdSlot2, Config.SpuIrq, Config.SyncAudio,
 		   Config.SpuUpdateFreq, Config.ForcedXAUpdates, Config.ShowFps,
-		   Config.FrameLimit, Config.FrameSkip, Config.VideoScaling);
+		   Config.FrameLimit, Config.FrameSkip, Config.VideoScaling,
+		   Config.GpuThread);
 
 #ifdef SPU_PCSXREARMED
 	fprintf(f, "SpuUseInterpolation %d\n", spu_config.iUseInterpolation);
@@ -472,14 +496,18 @@ void config_save()
 		   "fast_lighting %d\n"
 		   "blending %d\n"
 		   "dithering %d\n"
-		   "ntsc_fix %d\n",
+		   "ntsc_fix %d\n"
+		   "bands %d\n"
+		   "tex_cache %d\n",
 		   gpu_unai_config_ext.ilace_force,
 		   gpu_unai_config_ext.pixel_skip,
 		   gpu_unai_config_ext.lighting,
 		   gpu_unai_config_ext.fast_lighting,
 		   gpu_unai_config_ext.blending,
 		   gpu_unai_config_ext.dithering,
-		   gpu_unai_config_ext.ntsc_fix);
+		   gpu_unai_config_ext.ntsc_fix,
+		   gpu_unai_config_ext.bands,
+		   gpu_unai_config_ext.tex_cache);
 #endif
 
 #ifdef GCW_ZERO
@@ -499,6 +527,10 @@ void config_save()
 		fprintf(f, "Bios %s\n", Config.Bios);
 	}
 
+	if (Config.LibcOptOut[0]) {
+		fprintf(f, "LibcOptOut %s\n", Config.LibcOptOut);
+	}
+
 	fclose(f);
 }
 
@@ -746,10 +778,9 @@ void pad_update()
 
 	// popup main menu
 	if (popup_menu) {
-		//Sync and close any memcard files opened for writing
-		//TODO: Disallow entering menu until they are synced/closed
-		// automatically, displaying message that write is in progress.
-		sioSyncMcds();
+		// Get memcards on disk: menu may change their paths, or quit
+		FlushMcd(MCD1, true);
+		FlushMcd(MCD2, true);
 
 		emu_running = false;
 		pl_pause();    // Tell plugin_lib we're pausing emu
@@ -833,6 +864,10 @@ const char *GetMemcardPath(int slot) {
 }
 
 void update_memcards(int load_mcd) {
+	// Loaded memcards use these paths until ejected: write out their
+	//  changes to the old files before the paths are changed
+	FlushMcd(MCD1, true);
+	FlushMcd(MCD2, true);
 	sprintf(McdPath1, "%s/mcd%03d.mcr", memcardsdir, (int) Config.McdSlot1);
 	sprintf(McdPath2, "%s/mcd%03d.mcr", memcardsdir, (int) Config.McdSlot2);
 	if (load_mcd & 1)
@@ -976,6 +1011,7 @@ int main (int argc, char **argv)
 	Config.McdSlot2 = 2;
 	update_memcards(0);
 	strcpy(Config.PatchesDir, patchesdir);
+	strcpy(Config.BootSnapshotDir, sstatesdir);
 	strcpy(Config.BiosDir, biosdir);
 	strcpy(Config.Bios, "scph1001.bin");
 
@@ -1011,6 +1047,7 @@ int main (int argc, char **argv)
 	Config.ShowFps=0;    // 0=don't show FPS
 	Config.FrameLimit = true;
 	Config.FrameSkip = FRAMESKIP_OFF;
+	Config.GpuThread = 0; // 1=render on a worker thread (gpulib only)
 
 	//zear - Added option to store the last visited directory.
 	strncpy(Config.LastDir, home, MAXPATHLEN); /* Defaults to home directory. */
@@ -1096,6 +1133,8 @@ int main (int argc, char **argv)
 	gpu_unai_config_ext.blending = 1;
 	gpu_unai_config_ext.dithering = 0;
 	gpu_unai_config_ext.ntsc_fix = 1;
+	gpu_unai_config_ext.bands = 0; // 2..7=render in bands on worker threads
+	gpu_unai_config_ext.tex_cache = 0; // 1=draw 4/8bpp textures from decoded pages
 #endif
 
 	// Load config from file.
@@ -1106,6 +1145,8 @@ int main (int argc, char **argv)
 
 	// command line options
 	bool param_parse_error = 0;
+	const char *profile_file = NULL, *profile_syms = NULL;
+	const char *gpu_capture_file = NULL;
 	for (int i = 1; i < argc; i++) {
 		// PCSX
 		// XA audio disabled
@@ -1221,6 +1262,17 @@ int main (int argc, char **argv)
 			Config.PerfmonDetailedStats = true;
 		}
 
+		// Emulated-CPU profiler: print hottest guest functions on exit and
+		//  write folded stacks (for flame graphs) to given file
+		if (strcmp(argv[i],"-profile") == 0 && i+1 < argc) {
+			profile_file = argv[++i];
+		}
+
+		// Symbol map (address name) used by profiler report
+		if (strcmp(argv[i],"-profsyms") == 0 && i+1 < argc) {
+			profile_syms = argv[++i];
+		}
+
 		// GPU
 		// show FPS
 		if (strcmp(argv[i],"-showfps") == 0) {
@@ -1251,6 +1303,19 @@ int main (int argc, char **argv)
 			}
 		}
 
+		// Render GPU commands on a worker thread (gpulib only)
+		if (strcmp(argv[i],"-gputhread") == 0) {
+			Config.GpuThread = 1;
+		}
+
+#ifdef USE_GPULIB
+		// Record GPU commands to given file, for offline replay and
+		//  benchmarking with 'gpureplay' tool
+		if (strcmp(argv[i],"-gpucapture") == 0 && i+1 < argc) {
+			gpu_capture_file = argv[++i];
+		}
+#endif
+
 #ifdef GPU_UNAI
 		// Render only every other line (looks ugly but faster)
 		if (strcmp(argv[i],"-interlace") == 0) {
@@ -1266,6 +1331,28 @@ int main (int argc, char **argv)
 			gpu_unai_config_ext.ntsc_fix = 1;
 		}
 
+		// Render in N horizontal bands on worker threads (gpulib only)
+		if (strcmp(argv[i],"-gpubands") == 0) {
+			if (++i < argc) {
+				int val = atoi(argv[i]);
+				if (val >= 0 && val <= 7)
+					gpu_unai_config_ext.bands = val;
+				else
+					printf("ERROR: -gpubands value must be 0..7\n");
+#ifndef GPU_UNAI_USE_BANDS
+				if (val > 0)
+					printf("WARNING: -gpubands ignored, build with USE_GPU_BANDS=1\n");
+#endif
+			} else {
+				printf("ERROR: missing value for -gpubands\n");
+			}
+		}
+
+		// Draw 4bpp/8bpp textures from pages decoded to 16bpp (gpulib only)
+		if (strcmp(argv[i],"-gputexcache") == 0) {
+			gpu_unai_config_ext.tex_cache = 1;
+		}
+
 		if (strcmp(argv[i],"-nolight") == 0) {
 			gpu_unai_config_ext.lighting = 0;
 		}
@@ -1466,6 +1553,9 @@ int main (int argc, char **argv)
 
 	Rumble_Init();
 
+	if (profile_file)
+		psxProfilerEnable(profile_file, profile_syms);
+
 	if (psxInit() == -1) {
 		printf("PSX emulator couldn't be initialized.\n");
 		exit(1);
@@ -1482,6 +1572,11 @@ int main (int argc, char **argv)
 	// Initialize plugin_lib, gpulib
 	pl_init();
 
+#ifdef USE_GPULIB
+	if (gpu_capture_file)
+		gpulib_capture_start(gpu_capture_file);
+#endif
+
 	if (cdrfilename[0] != '\0') {
 		if (CheckCdrom() == -1) {
 			psxReset();
@@ -125,6 +125,7 @@ typedef struct {
 	char BiosDir[MAXPATHLEN];
 	char LastDir[MAXPATHLEN];
 	char PatchesDir[MAXPATHLEN];  // PPF patch files
+	char BootSnapshotDir[MAXPATHLEN];  // BIOS boot snapshots, empty: disabled
 	boolean Xa; /* 0=XA enabled, 1=XA disabled */
 	boolean Mdec; /* 0=Black&White Mdecs Only Disabled, 1=Black&White Mdecs Only Enabled */
 	boolean PsxAuto; /* 1=autodetect system (pal or ntsc) */
@@ -161,11 +162,16 @@ typedef struct {
 
 	s8      FrameSkip;	// -1: AUTO  0: OFF  1-3: FIXED
 	s8      VideoScaling; // 0: Hardware  1: Software Nearest
+	boolean GpuThread;    // 1: gpulib renders on a worker thread
 
 	// Options for performance monitor
 	boolean PerfmonConsoleOutput;
 	boolean PerfmonDetailedStats;
 
+	// Comma-separated names of libc routines whose native fast paths are
+	//  disabled, "all" disables them all (see psxhle.cpp)
+	char    LibcOptOut[64];
+
 } PcsxConfig;
 
 extern PcsxConfig Config;
@@ -28,6 +28,9 @@
 // * VBlank root counter (counter 3) is triggered only as often as needed,
 //   not every HSync.
 // * SPU updates occur using new event queue (psxevents.cpp)
+// * Counters 0-2 are only scheduled while they can raise an IRQ. Others
+//   are brought up to date from psxRegs.cycle when accessed, see
+//   psxRcntCatchUp().
 // * Some optimizations, more accurate calculation of timer updates.
 //
 // TODO : Implement direct rootcounter mem access of Rearmed dynarec?
@@ -219,6 +222,14 @@ static void _psxRcntWmode( u32 index, u32 value )
     }
 }
 
+// Can counter raise an IRQ when it next reaches its target or overflows?
+//  Only these need a scheduled PSXINT_RCNT event.
+static inline bool rcntIrqEnabled( u32 index )
+{
+    return (rcnts[index].mode & (RcIrqOnTarget | RcIrqOnOverflow)) &&
+           ((rcnts[index].mode & RcIrqRegenerate) || !rcnts[index].irqState);
+}
+
 /******************************************************************************/
 
 static void psxRcntSet(void)
@@ -231,6 +242,10 @@ static void psxRcntSet(void)
 
     for( i = 0; i < CounterQuantity; ++i )
     {
+        // rcnt base (VBlank) is always scheduled
+        if( i < 3 && !rcntIrqEnabled( i ) )
+            continue;
+
         countToUpdate = rcnts[i].cycle - (psxNextsCounter - rcnts[i].cycleStart);
 
         if( countToUpdate < 0 )
@@ -251,7 +266,8 @@ static void psxRcntSet(void)
 
 /******************************************************************************/
 
-static void psxRcntReset( u32 index )
+// Handle counter reaching its target or overflowing, as seen at 'cycle'
+static void psxRcntReset( u32 index, u32 cycle )
 {
     u32 rcycles;
 
@@ -259,11 +275,11 @@ static void psxRcntReset( u32 index )
 
     if( rcnts[index].counterState == CountToTarget )
     {
-        rcycles = psxRegs.cycle - rcnts[index].cycleStart;
+        rcycles = cycle - rcnts[index].cycleStart;
         if( rcnts[index].mode & RcCountToTarget )
         {
             rcycles -= rcnts[index].target * rcnts[index].rate;
-            rcnts[index].cycleStart = psxRegs.cycle - rcycles;
+            rcnts[index].cycleStart = cycle - rcycles;
         }
         else
         {
@@ -289,10 +305,10 @@ static void psxRcntReset( u32 index )
 
     if( rcnts[index].counterState == CountToOverflow )
     {
-        rcycles = psxRegs.cycle - rcnts[index].cycleStart;
+        rcycles = cycle - rcnts[index].cycleStart;
         rcycles -= 0x10000 * rcnts[index].rate;
 
-        rcnts[index].cycleStart = psxRegs.cycle - rcycles;
+        rcnts[index].cycleStart = cycle - rcycles;
 
         if( rcycles < rcnts[index].target * rcnts[index].rate )
         {
@@ -314,6 +330,39 @@ static void psxRcntReset( u32 index )
     }
 }
 
+/* Counters that can't raise an IRQ are not scheduled (see psxRcntSet()),
+ *  so their count, state and mode flags are brought up to date here before
+ *  being accessed. Targets/overflows passed since the last access are
+ *  handled at the exact cycles they occurred, skipping whole wrap periods
+ *  at once so long gaps between accesses stay cheap.
+ */
+static void psxRcntCatchUp( u32 index )
+{
+    u32 elapsed, period, periods;
+
+    // Also skip counters not yet set up by psxRcntInit()
+    if( rcntIrqEnabled( index ) || !rcnts[index].rate )
+        return;
+
+    while( (elapsed = psxRegs.cycle - rcnts[index].cycleStart) >= rcnts[index].cycle )
+    {
+        // Counter is periodic from here on, unless it's about to overflow
+        //  and then start wrapping at its target.
+        if( (rcnts[index].mode & RcCountToTarget) && rcnts[index].counterState == CountToTarget )
+            period = rcnts[index].target * rcnts[index].rate;
+        else if( rcnts[index].counterState == CountToTarget || !rcnts[index].target ||
+                 !(rcnts[index].mode & RcCountToTarget) )
+            period = 0x10000 * rcnts[index].rate;
+        else
+            period = 0;
+
+        if( period && (periods = elapsed / period) > 1 )
+            rcnts[index].cycleStart += (periods - 1) * period;
+
+        psxRcntReset( index, rcnts[index].cycleStart + rcnts[index].cycle );
+    }
+}
+
 void psxRcntUpdate()
 {
     u32 cycle;
@@ -321,21 +370,21 @@ void psxRcntUpdate()
     cycle = psxRegs.cycle;
 
     // rcnt 0.
-    if( cycle - rcnts[0].cycleStart >= rcnts[0].cycle )
+    if( rcntIrqEnabled( 0 ) && cycle - rcnts[0].cycleStart >= rcnts[0].cycle )
     {
-        psxRcntReset( 0 );
+        psxRcntReset( 0, cycle );
     }
 
     // rcnt 1.
-    if( cycle - rcnts[1].cycleStart >= rcnts[1].cycle )
+    if( rcntIrqEnabled( 1 ) && cycle - rcnts[1].cycleStart >= rcnts[1].cycle )
     {
-        psxRcntReset( 1 );
+        psxRcntReset( 1, cycle );
     }
 
     // rcnt 2.
-    if( cycle - rcnts[2].cycleStart >= rcnts[2].cycle )
+    if( rcntIrqEnabled( 2 ) && cycle - rcnts[2].cycleStart >= rcnts[2].cycle )
     {
-        psxRcntReset( 2 );
+        psxRcntReset( 2, cycle );
     }
 
     // rcnt base.
@@ -360,6 +409,10 @@ void psxRcntUpdate()
             // NOTE: this is point of control transfer to frontend menu
             EmuUpdate();
 
+            // Return from psxRunFrame() once this VBlank is handled
+            if (psxExitAtVBlank)
+                psxRequestExit();
+
             // If frontend called LoadState(), loading a savestate, do not
             //  proceed further: Rootcounter state has been altered.
             if (rcntFreezeLoaded) {
@@ -419,6 +472,7 @@ void psxRcntWcount( u32 index, u32 value )
 {
     verboseLog( 2, "[RCNT %i] wcount: %x\n", index, value );
 
+    psxRcntCatchUp( index );
     _psxRcntWcount( index, value );
     psxRcntSet();
 }
@@ -438,6 +492,7 @@ void psxRcntWtarget( u32 index, u32 value )
 {
     verboseLog( 1, "[RCNT %i] wtarget: %x\n", index, value );
 
+    psxRcntCatchUp( index );
     rcnts[index].target = value;
 
     _psxRcntWcount( index, _psxRcntRcount( index ) );
@@ -450,6 +505,7 @@ u32 psxRcntRcount( u32 index )
 {
     u32 count;
 
+    psxRcntCatchUp( index );
     count = _psxRcntRcount( index );
 
     // Parasite Eve 2 fix.
@@ -469,6 +525,7 @@ u32 psxRcntRmode( u32 index )
 {
     u16 mode;
 
+    psxRcntCatchUp( index );
     mode = rcnts[index].mode;
     rcnts[index].mode &= 0xe7ff;
 
@@ -526,6 +583,10 @@ int psxRcntFreeze(void *f, FreezeMode mode)
     //  now this is 0 placeholder to maintain savestate compatibilty
     u32 spuSyncCount = 0;
 
+    if (mode == FREEZE_SAVE)
+        for (u32 i = 0; i < 3; ++i)
+            psxRcntCatchUp( i );
+
     if (    freeze_rw(f, mode, &rcnts, sizeof(rcnts))
          || freeze_rw(f, mode, &hSyncCount, sizeof(hSyncCount))
          || freeze_rw(f, mode, &spuSyncCount, sizeof(spuSyncCount))
@@ -566,6 +627,10 @@ void psxRcntInitFromFreeze(void)
 //  by PSXINT_RESET_CYCLE_VAL event in psxevents.cpp
 void psxRcntAdjustTimestamps(const uint32_t prev_cycle_val)
 {
+	// Unscheduled counters must not fall more than 2^32 cycles behind
+	for (int i=0; i < 3; ++i)
+		psxRcntCatchUp(i);
+
 	for (int i=0; i < CounterQuantity; ++i) {
 		rcnts[i].cycleStart -= prev_cycle_val;
 	}
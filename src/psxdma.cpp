@@ -96,46 +96,6 @@ void psxDma4(u32 madr, u32 bcr, u32 chcr) { // SPU
 	DMA_INTERRUPT(4);
 }
 
-// Taken from PEOPS SOFTGPU
-static inline boolean CheckForEndlessLoop(u32 laddr, u32 *lUsedAddr) {
-	if (laddr == lUsedAddr[1]) return TRUE;
-	if (laddr == lUsedAddr[2]) return TRUE;
-
-	if (laddr < lUsedAddr[0]) lUsedAddr[1] = laddr;
-	else lUsedAddr[2] = laddr;
-
-	lUsedAddr[0] = laddr;
-
-	return FALSE;
-}
-
-static u32 gpuDmaChainSize(u32 addr) {
-	u32 size;
-	u32 DMACommandCounter = 0;
-	u32 lUsedAddr[3];
-
-	lUsedAddr[0] = lUsedAddr[1] = lUsedAddr[2] = 0xffffff;
-
-	// initial linked list ptr (word)
-	size = 1;
-
-	do {
-		addr &= 0x1ffffc;
-
-		if (DMACommandCounter++ > 2000000) break;
-		if (CheckForEndlessLoop(addr, lUsedAddr)) break;
-
-		// # 32-bit blocks to transfer
-		size += psxMu8( addr + 3 );
-
-		// next 32-bit pointer
-		addr = psxMu32( addr & ~0x3 ) & 0xffffff;
-		size += 1;
-	} while (addr != 0xffffff);
-
-	return size;
-}
-
 //senquack - updated to match PCSX Rearmed:
 void psxDma2(u32 madr, u32 bcr, u32 chcr) { // GPU
 	u32 *ptr;
@@ -186,15 +146,17 @@ void psxDma2(u32 madr, u32 bcr, u32 chcr) { // GPU
 
 			// already 32-bit word size ((size * 4) / 4)
 			GPUDMA_INT(words / 4);
+			gpuBusyAdd(words / 4);
 			return;
 
 		case 0x01000401: // dma chain
 #ifdef PSXDMA_LOG
 			PSXDMA_LOG("*** DMA 2 - GPU dma chain *** %x addr = %x size = %x\n", chcr, madr, bcr);
 #endif
+			// Plugin walks the list once, rendering it and returning its size
 			size = GPU_dmaChain((u32 *)psxM, madr & 0x1fffff);
 			if ((int)size <= 0)
-				size = gpuDmaChainSize(madr);
+				size = 1;
 			HW_GPU_STATUS &= ~PSXGPU_nBUSY;
 
 			// we don't emulate progress, just busy flag and end irq,
@@ -208,6 +170,7 @@ void psxDma2(u32 madr, u32 bcr, u32 chcr) { // GPU
 			// Rebel Assault 2 = parse linked list in pieces (todo)
 			// Vampire Hunter D = allow edits to linked list (todo)
 			GPUDMA_INT(size);
+			gpuBusyAdd(size);
 			return;
 
 #ifdef PSXDMA_LOG
@@ -228,7 +191,37 @@ void gpuInterrupt() {
 		HW_DMA2_CHCR &= SWAP32(~0x01000000);
 		DMA_INTERRUPT(2);
 	}
-	HW_GPU_STATUS |= PSXGPU_nBUSY; // GPU no longer busy
+	// GPU no longer busy, unless still drawing
+	if (!(psxRegs.interrupt & (1 << PSXINT_GPUBUSY)))
+		HW_GPU_STATUS |= PSXGPU_nBUSY;
+}
+
+// PSXINT_GPUBUSY event: GPU has finished drawing
+void gpuBusyInterrupt(void)
+{
+	if (!(psxRegs.interrupt & (1 << PSXINT_GPUDMA)))
+		HW_GPU_STATUS |= PSXGPU_nBUSY;
+}
+
+// Keep GPUSTAT busy bit clear while GPU would be drawing commands it was
+//  sent since last call, as estimated by GPU plugin. Drawing starts once
+//  'cycles_before' have passed (transfer of commands) or GPU finishes
+//  drawing what it was given earlier, whichever is later.
+void gpuBusyAdd(u32 cycles_before)
+{
+	u32 draw_cycles = GPU_drawCycles();
+	if (draw_cycles == 0)
+		return;
+
+	if (psxRegs.interrupt & (1 << PSXINT_GPUBUSY)) {
+		u32 left = psxRegs.intCycle[PSXINT_GPUBUSY].sCycle +
+		           psxRegs.intCycle[PSXINT_GPUBUSY].cycle - psxRegs.cycle;
+		if ((s32)left > (s32)cycles_before)
+			cycles_before = left;
+	}
+
+	HW_GPU_STATUS &= ~PSXGPU_nBUSY;
+	psxEvqueueAdd(PSXINT_GPUBUSY, cycles_before + draw_cycles);
 }
 
 void psxDma6(u32 madr, u32 bcr, u32 chcr) {
@@ -59,6 +59,8 @@ void psxDma3(u32 madr, u32 bcr, u32 chcr);
 void psxDma4(u32 madr, u32 bcr, u32 chcr);
 void psxDma6(u32 madr, u32 bcr, u32 chcr);
 void gpuInterrupt(void);
+void gpuBusyInterrupt(void);
+void gpuBusyAdd(u32 cycles_before);
 void spuInterrupt(void);
 void gpuotcInterrupt();
 
@@ -20,10 +20,13 @@
  *
  * Added July 2016 by senquack (Daniel Silsby)
  *
- * Queue is an array sorted by event imminency. It can have spare capacity
- * both at the front and at the back. If an event is removed from the front
- * of the queue and a new event enqueued that ends up back at front of queue,
- * the operation is O(1).
+ * Queue is a bitmask of queued events plus each event's sort key, with the
+ * most imminent event cached for O(1) lookup. Adding, rescheduling or
+ * removing an event is O(1), unless it was the front event: then the at
+ * most PSXINT_COUNT queued keys are scanned for the new front. With so few
+ * events, that scan is cheaper than keeping a sorted array or a heap in
+ * order (see psxevents_bench.cpp). Events equal in imminency are dispatched
+ * in the order they were added, using a sequence number as tie-breaker.
  *
  * We also handle a small bit of SPU update logic here
  *
@@ -38,6 +41,7 @@
 #include "plugins.h"
 #include "psxdma.h"
 #include "mdec.h"
+#include "psxprofiler.h"
 
 // When psxRegs.cycle is >= this figure, it gets reset to 0:
 static const u32 reset_cycle_val_at = 2000000000;
@@ -64,10 +68,14 @@ static const int EVQUEUE_CAPACITY = PSXINT_COUNT;
 typedef void (*EventFunc)(void);
 
 static struct {
-	u8 useBeginIdx;             // Idx of first used element of queue[]
-	u8 useEndIdx;               // Idx one past last used element of queue[], or
-	                            //  same val as useBeginIdx when queue is empty.
-	u8 queue[EVQUEUE_CAPACITY];
+	u32 mask;                   // Bit (1 << ev) is set for each queued event
+	u8 front;                   // Most imminent queued event
+	u64 key[EVQUEUE_CAPACITY];  // Sort key of each queued event: timestamp
+	                            //  (psxRegs.intCycle[].sCycle + .cycle) in
+	                            //  upper 32 bits, sequence number in lower 32
+	                            //  bits, breaking ties between equally-imminent
+	                            //  events
+	u32 nextSeq;
 	EventFunc funcs[EVQUEUE_CAPACITY];
 	u32 spuUpdateInterval;      // Cycles between SPU plugin updates
 } evqueue;
@@ -82,15 +90,12 @@ static inline void evqueueClear(void);
 static inline size_t evqueueSize(void);
 static inline bool evqueueEmpty(void);
 static inline u8 evqueueFront(void);
-static inline u8* evqueueFrontPtr(void);
-static inline u8* evqueueEndPtr(void);
 static inline void evqueueAdd(u8 ev);
-static inline bool evqueueRemove(u8 ev);
+static inline void evqueueUpdate(u8 ev);
+static inline void evqueueRemove(u8 ev);
 static inline void evqueueRemoveFront(void);
-static inline void evqueueMoveTowardsFront(u8 *start, u8 *end);
-static inline void evqueueMoveTowardsBack(u8 *start, u8 *end);
-static inline void evqueueInsertFront(u8 *pos, u8 ev);
-static inline void evqueueInsertBack(u8 *pos, u8 ev);
+static inline void evqueueSetKey(u8 ev);
+static inline void evqueueFindFront(void);
 #ifdef DEBUG_EVENTS
 static bool evqueueConsistencyCheck(void);
 static void evqueuePrintQueue(void);
@@ -104,7 +109,7 @@ void psxEvqueueInit(void)
 	evqueue.funcs[PSXINT_GPUDMA]          = gpuInterrupt;
 	evqueue.funcs[PSXINT_MDECOUTDMA]      = mdec1Interrupt;
 	evqueue.funcs[PSXINT_SPUDMA]          = spuInterrupt;
-	evqueue.funcs[PSXINT_GPUBUSY]         = EventStubFunc;         // STUB-UNIMPLEMENTED (TODO?)
+	evqueue.funcs[PSXINT_GPUBUSY]         = gpuBusyInterrupt;
 	evqueue.funcs[PSXINT_MDECINDMA]       = mdec0Interrupt;
 	evqueue.funcs[PSXINT_GPUOTCDMA]       = gpuotcInterrupt;
 	evqueue.funcs[PSXINT_CDRDMA]          = cdrDmaInterrupt;
@@ -116,6 +121,8 @@ void psxEvqueueInit(void)
 	evqueue.funcs[PSXINT_SPU_UPDATE]      = SPU_update;
 	evqueue.funcs[PSXINT_RESET_CYCLE_VAL] = psxEvqueueResetCycleVal;
 	evqueue.funcs[PSXINT_SIO_SYNC_MCD]    = sioSyncMcds;
+	evqueue.funcs[PSXINT_CPU_EXIT]        = psxRequestExit;
+	evqueue.funcs[PSXINT_PROFILE]         = psxProfilerSample;
 
 	evqueueClear();
 	psxEvqueueSchedulePersistentEvents();
@@ -124,6 +131,17 @@ void psxEvqueueInit(void)
 // Rebuild event queue afresh from psxRegs.intCycle[] contents
 void psxEvqueueInitFromFreeze(void)
 {
+	// psxRunCycles() exit event isn't machine state: never restore it. If
+	//  one is pending now, its budget is lost with the old queue, so end
+	//  the run right away instead.
+	bool exit_pending = evqueue.mask & (1 << PSXINT_CPU_EXIT);
+	psxRegs.interrupt &= ~(1 << PSXINT_CPU_EXIT);
+
+	// Neither are profiler samples: a freeze made while profiling has one
+	//  pending. Whether profiling is on is up to this session, and
+	//  psxEvqueueSchedulePersistentEvents() below schedules them if so.
+	psxRegs.interrupt &= ~(1 << PSXINT_PROFILE);
+
 	evqueueClear();
 	for (int ev=0; ev < PSXINT_COUNT; ++ev)
 		if (psxRegs.interrupt & (1 << ev))
@@ -135,6 +153,9 @@ void psxEvqueueInitFromFreeze(void)
 	// Don't trust io_cycle_counter from a freeze, as older savestate versions
 	//  from before event queue implementation may have invalid value.
 	psxRegs.io_cycle_counter = 0;
+
+	if (exit_pending)
+		psxRequestExit();
 }
 
 // Function called when PSXINT_RESET_CYCLE_VAL event occurs:
@@ -178,6 +199,9 @@ static void psxEvqueueSchedulePersistentEvents(void)
 
 	// Must schedule initial SPU update.. it will reschedule itself thereafter
 	SPU_resetUpdateInterval();
+
+	// Profiler samples, if enabled, also reschedule themselves
+	psxProfilerSchedule();
 }
 
 // At very intermittent intervals, psxRegs.cycle is reset to 0 to prevent
@@ -185,8 +209,11 @@ static void psxEvqueueSchedulePersistentEvents(void)
 //  This function fixes up timestamps of all queued events when this occurs.
 static void psxEvqueueAdjustTimestamps(u32 prev_cycle_val)
 {
-	for (u8 *ev = evqueueFrontPtr(); ev != evqueueEndPtr(); ++ev) {
-		psxRegs.intCycle[*ev].sCycle -= prev_cycle_val;
+	// Shifting all timestamps by the same amount leaves front event intact
+	for (u32 mask = evqueue.mask; mask; mask &= mask - 1) {
+		u8 ev = __builtin_ctz(mask);
+		psxRegs.intCycle[ev].sCycle -= prev_cycle_val;
+		evqueue.key[ev] -= (u64)prev_cycle_val << 32;
 	}
 
 	psxRegs.intCycle[PSXINT_NEXT_EVENT].sCycle -= prev_cycle_val;
@@ -194,14 +221,17 @@ static void psxEvqueueAdjustTimestamps(u32 prev_cycle_val)
 
 void psxEvqueueAdd(psxEventNum ev, u32 cycles_after)
 {
-	// Dequeue event if it already exists, to match original emu behavior
-	if (psxRegs.interrupt & (1 << ev))
-		evqueueRemove(ev);
-
-	psxRegs.interrupt |= (1 << ev);
 	psxRegs.intCycle[ev].sCycle = psxRegs.cycle;
 	psxRegs.intCycle[ev].cycle = cycles_after;
-	evqueueAdd(ev);
+
+	// If event already exists, reschedule it. Just like dequeueing it and
+	//  adding it anew, to match original emu behavior.
+	if (psxRegs.interrupt & (1 << ev)) {
+		evqueueUpdate(ev);
+	} else {
+		psxRegs.interrupt |= (1 << ev);
+		evqueueAdd(ev);
+	}
 	psxRegs.intCycle[PSXINT_NEXT_EVENT] = psxRegs.intCycle[evqueueFront()];
 
 	// io_cycle_counter is used to determine next time to call psxBranchTest()
@@ -315,106 +345,103 @@ static void SPU_handleIRQ(void)
 // Returns true if event 'lh_ev' is more imminent than 'rh_ev'.
 static inline bool EventMoreImminent(u8 lh_ev, u8 rh_ev)
 {
-	// Compare the two event timestamps, interpreting the result as a signed
-	//  integer in case one or both cross psxRegs.cycle overflow boundary.
-	int lh_tmp = psxRegs.intCycle[lh_ev].sCycle + psxRegs.intCycle[lh_ev].cycle
-	             - psxRegs.cycle;
-	int rh_tmp = psxRegs.intCycle[rh_ev].sCycle + psxRegs.intCycle[rh_ev].cycle
-	             - psxRegs.cycle;
-	return lh_tmp < rh_tmp;
+	// Compare the two event sort keys, interpreting their difference as a
+	//  signed integer in case one or both timestamps cross psxRegs.cycle
+	//  overflow boundary. Unlike comparing each timestamp against
+	//  psxRegs.cycle, the result does not change as time passes, which the
+	//  cached front event relies on. Equally imminent: event added first
+	//  goes first.
+	return (s64)(evqueue.key[lh_ev] - evqueue.key[rh_ev]) < 0;
 }
 
 static inline void evqueueClear(void)
 {
-	evqueue.useEndIdx = evqueue.useBeginIdx = 0;
+	evqueue.mask = 0;
 }
 
 static inline size_t evqueueSize(void)
 {
-	return evqueue.useEndIdx - evqueue.useBeginIdx;
+	return __builtin_popcount(evqueue.mask);
 }
 
 static inline bool evqueueEmpty(void)
 {
-	return evqueue.useEndIdx == evqueue.useBeginIdx;
+	return evqueue.mask == 0;
 }
 
 static inline u8 evqueueFront(void)
 {
-	return evqueue.queue[evqueue.useBeginIdx];
+	return evqueue.front;
 }
 
-// Returns pointer to first element in use
-static inline u8* evqueueFrontPtr(void)
+// Set sort key of event 'ev' from its timestamp in psxRegs.intCycle[]
+static inline void evqueueSetKey(u8 ev)
 {
-	return evqueue.queue + evqueue.useBeginIdx;
+	u32 ts = psxRegs.intCycle[ev].sCycle + psxRegs.intCycle[ev].cycle;
+	evqueue.key[ev] = ((u64)ts << 32) | evqueue.nextSeq++;
 }
 
-// Returns pointer to one past the last element in use,
-//  but when empty, points to same element as evqueueFrontPtr()
-static inline u8* evqueueEndPtr(void)
+// Scan queued events for the most imminent one. Queue must not be empty.
+static inline void evqueueFindFront(void)
 {
-	return evqueue.queue + evqueue.useEndIdx;
+	u32 mask = evqueue.mask;
+	u8 front = __builtin_ctz(mask);
+
+	for (mask &= mask - 1; mask; mask &= mask - 1) {
+		u8 ev = __builtin_ctz(mask);
+		if (EventMoreImminent(ev, front))
+			front = ev;
+	}
+	evqueue.front = front;
 }
 
-// Insert new element, keeping queue sorted by event imminency.
+// Insert new element, keeping track of most imminent event.
 //  Event's timestamp in psxRegs.intCycle[] must be set before call.
 //  Important: two elements equivalent in imminency keep their relative order,
-//  i.e., new events are inserted after existing equally-imminent events.
+//  i.e., new events go after existing equally-imminent events.
 static inline void evqueueAdd(u8 ev)
 {
-#ifdef DEBUG_EVENTS
-	if (evqueueSize() == EVQUEUE_CAPACITY) {
-		printf("ERROR: %s() could not find space in its array\n", __func__);
-		return;
-	}
+	evqueueSetKey(ev);
+	if (evqueueEmpty() || EventMoreImminent(ev, evqueue.front))
+		evqueue.front = ev;
+	evqueue.mask |= (1 << ev);
 
+#ifdef DEBUG_EVENTS
 	if (!evqueueConsistencyCheck()) {
 		printf("ERROR: Queue consistent ordering check failed in %s(),\n"
-	           "before adding event %u\n", __func__, ev);
+	           "after adding event %u\n", __func__, ev);
 		evqueuePrintQueue();
 	}
 #endif
+}
 
-	u8 *it = evqueueFrontPtr();  // iterator
-
-	while ((it != evqueueEndPtr()) && !EventMoreImminent(ev, *it))
-		++it;
-
-	// Rather than be fancy and compute position relative to front/end, to
-	//  decide how to insert, we choose evqueueInsertFront() when possible,
-	//  to keep object code size small. Our queue is usually pretty small.
-	if (evqueue.useBeginIdx > 0) {
-		// Insert before position 'it', move elements towards front to make room
-		evqueueInsertFront(it-1, ev);
-	} else {
-		// Insert at position 'it', move elements towards back to make room
-		evqueueInsertBack(it, ev);
-	}
+// Reschedule queued event 'ev', placing it after existing equally-imminent
+//  events. Event's new timestamp in psxRegs.intCycle[] must be set before call.
+static inline void evqueueUpdate(u8 ev)
+{
+	evqueueSetKey(ev);
+	if (ev == evqueue.front)
+		evqueueFindFront();
+	else if (EventMoreImminent(ev, evqueue.front))
+		evqueue.front = ev;
 
 #ifdef DEBUG_EVENTS
 	if (!evqueueConsistencyCheck()) {
 		printf("ERROR: Queue consistent ordering check failed in %s(),\n"
-	           "after adding event %u\n", __func__, ev);
+	           "after rescheduling event %u\n", __func__, ev);
 		evqueuePrintQueue();
 	}
 #endif
 }
 
-// Remove the first matching element, returning false if not found
-static bool evqueueRemove(u8 ev)
+// Remove queued event 'ev'. Caller checks that it is queued, using
+//  psxRegs.interrupt. Timestamp of 'ev' in psxRegs.intCycle[] may already
+//  have been changed, see psxRcntSet().
+static inline void evqueueRemove(u8 ev)
 {
-	u8 *it = evqueueFrontPtr();
-	while ((it != evqueueEndPtr()) && (*it != ev))
-		++it;
-
-	if (it == evqueueEndPtr())
-		return false;
-
-	// Rather than be fancy and compute position relative to front/end, we
-	//  always shrink array towards front, to keep object code size small.
-	--evqueue.useEndIdx;
-	evqueueMoveTowardsFront(it+1, evqueueEndPtr());
+	evqueue.mask &= ~(1 << ev);
+	if (ev == evqueue.front && !evqueueEmpty())
+		evqueueFindFront();
 
 #ifdef DEBUG_EVENTS
 	if (!evqueueConsistencyCheck()) {
@@ -423,8 +450,6 @@ static bool evqueueRemove(u8 ev)
 		evqueuePrintQueue();
 	}
 #endif
-
-	return true;
 }
 
 static inline void evqueueRemoveFront(void)
@@ -436,56 +461,23 @@ static inline void evqueueRemoveFront(void)
 	}
 #endif
 
-	++evqueue.useBeginIdx;
-}
-
-// Copy all elements between [start,end] to [start+1,end+1].
-//  If start address is greater than end, no copy will occur.
-static inline void evqueueMoveTowardsBack(u8 *start, u8 *end)
-{
-	for (u8 *ptr = end; ptr >= start; --ptr)
-		*(ptr+1) = *ptr;
-}
-
-// Copy all elements between [start,end] to [start-1,end-1].
-//  If start address is greater than end, no copy will occur.
-static inline void evqueueMoveTowardsFront(u8 *start, u8 *end)
-{
-	for (u8 *ptr = start; ptr <= end; ++ptr)
-		*(ptr-1) = *ptr;
-}
-
-// Insert new entry 'ev' at position 'pos'. Any existing elements at or
-//  before position will be moved towards the front to make room.
-static inline void evqueueInsertFront(u8 *pos, u8 ev)
-{
-	evqueueMoveTowardsFront(evqueueFrontPtr(), pos);
-	--evqueue.useBeginIdx;
-	*pos = ev;
-}
-
-// Insert new entry 'ev' at position 'pos'. Any existing elements at or
-//  after position will be moved towards the rear to make room.
-static inline void evqueueInsertBack(u8 *pos, u8 ev)
-{
-	evqueueMoveTowardsBack(pos, evqueueEndPtr()-1);
-	++evqueue.useEndIdx;
-	*pos = ev;
+	evqueueRemove(evqueueFront());
 }
 
 #ifdef DEBUG_EVENTS
 static bool evqueueConsistencyCheck(void)
 {
-	if (evqueueSize() < 2)
+	if (evqueueEmpty())
 		return true;
-
-	for (u8 *ev = evqueueFrontPtr(); ev < (evqueueEndPtr()-1); ++ev) {
-		if (!EventMoreImminent(*ev, *(ev+1))) {
-			if ((psxRegs.intCycle[*ev].sCycle + psxRegs.intCycle[*ev].cycle) !=
-			    (psxRegs.intCycle[*(ev+1)].sCycle + psxRegs.intCycle[*(ev+1)].cycle)) {
-				printf("ERROR: %s() failed: EV %u > EV %u\n", __func__, *ev, *(ev+1));
-				return false;
-			}
+	if (!(evqueue.mask & (1 << evqueue.front))) {
+		printf("ERROR: %s() failed: front EV %u not queued\n", __func__, evqueue.front);
+		return false;
+	}
+	for (u32 mask = evqueue.mask; mask; mask &= mask - 1) {
+		u8 ev = __builtin_ctz(mask);
+		if (EventMoreImminent(ev, evqueue.front)) {
+			printf("ERROR: %s() failed: EV %u > front EV %u\n", __func__, ev, evqueue.front);
+			return false;
 		}
 	}
 	return true;
@@ -493,11 +485,11 @@ static bool evqueueConsistencyCheck(void)
 
 static void evqueuePrintQueue(void)
 {
-	printf("Queue contains %zu events, useBeginIdx: %u  useEndIdx: %u\n",
-			evqueueSize(), evqueue.useBeginIdx, evqueue.useEndIdx);
-	for (u8 *ev = evqueueFrontPtr(); ev != evqueueEndPtr(); ++ev) {
-		printf("EV: %u SCYCLE: %u CYCLE: %u\n",
-		       *ev, psxRegs.intCycle[*ev].sCycle, psxRegs.intCycle[*ev].cycle);
+	printf("Queue contains %zu events\n", evqueueSize());
+	for (u32 mask = evqueue.mask; mask; mask &= mask - 1) {
+		u8 ev = __builtin_ctz(mask);
+		printf("EV: %u SCYCLE: %u CYCLE: %u SEQ: %u\n", ev,
+		       psxRegs.intCycle[ev].sCycle, psxRegs.intCycle[ev].cycle, (u32)evqueue.key[ev]);
 	}
 
 	if (evqueueConsistencyCheck())
@@ -36,7 +36,7 @@ enum psxEventNum {
 	PSXINT_GPUDMA,
 	PSXINT_MDECOUTDMA,
 	PSXINT_SPUDMA,
-	PSXINT_GPUBUSY,        //From PCSX Rearmed, but not implemented there nor here
+	PSXINT_GPUBUSY,        //GPU finished drawing (GPUSTAT busy bit cleared)
 	PSXINT_MDECINDMA,
 	PSXINT_GPUOTCDMA,
 	PSXINT_CDRDMA,
@@ -52,6 +52,8 @@ enum psxEventNum {
 	PSXINT_RESET_CYCLE_VAL,          // Reset psxRegs.cycle value to 0 to ensure
 	                                 //  it can never overflow
 	PSXINT_SIO_SYNC_MCD,             // Flush/sync/close memcards opened for writing
+	PSXINT_CPU_EXIT,                 // psxRunCycles() budget used up
+	PSXINT_PROFILE,                  // Take sample for psxprofiler.cpp
 	PSXINT_COUNT,
 	PSXINT_NEXT_EVENT = PSXINT_COUNT //The most imminent event's entry is
 	                                 // always copied to this slot in
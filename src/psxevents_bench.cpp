@@ -0,0 +1,195 @@
+/*
+ * evbench: micro-benchmark of the event queue in psxevents.cpp
+ *
+ * Drives psxEvqueueAdd()/psxEvqueueRemove()/psxEvqueueDispatchAndRemoveFront()
+ * the way psxBranchTest() and the HW emulation do, without any CPU or HW
+ * emulation behind them. Event handlers re-arm themselves like the real
+ * ones (root counters, SPU update, CD reads), and a random mix of the
+ * one-shot DMA/CD/SIO events is added, rescheduled and cancelled in
+ * between. The random steps are generated before timing starts. Reports
+ * best time per step over several runs and a hash of the dispatch order,
+ * which must not change between event queue implementations.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "psxcommon.h"
+#include "r3000a.h"
+#include "psxevents.h"
+#include "plugins.h"
+#include "plugin_lib.h"
+
+// Emulator symbols psxevents.cpp uses
+psxRegisters psxRegs;
+PcsxConfig Config;
+const u32 FrameRate[2] = { 60, 50 };
+struct pl_data_t pl_data;
+
+static u64 hash = 14695981039346656037ULL;
+static u32 rng_state = 1;
+
+static u32 rng(void)
+{
+	rng_state = rng_state * 1103515245 + 12345;
+	return rng_state >> 8;
+}
+
+// One step of the benchmark: advance time, then touch one event
+typedef struct {
+	u8  cycles;     // 'CPU' cycles run before the next psxBranchTest()
+	u8  remove;     // psxEvqueueRemove() instead of psxEvqueueAdd()
+	u8  ev;
+	u16 after;      // psxEvqueueAdd() cycles_after
+} bench_step_t;
+
+// FNV-1a of dispatched events and the cycle they ran at
+static void log_event(int ev)
+{
+	hash = (hash ^ (u64)ev ^ ((u64)psxRegs.cycle << 8)) * 1099511628211ULL;
+}
+
+#define EVENT_HANDLER(name, ev) void name(void) { log_event(ev); }
+EVENT_HANDLER(sioInterrupt,        PSXINT_SIO)
+EVENT_HANDLER(cdrInterrupt,        PSXINT_CDR)
+EVENT_HANDLER(gpuInterrupt,        PSXINT_GPUDMA)
+EVENT_HANDLER(mdec1Interrupt,      PSXINT_MDECOUTDMA)
+EVENT_HANDLER(spuInterrupt,        PSXINT_SPUDMA)
+EVENT_HANDLER(gpuBusyInterrupt,    PSXINT_GPUBUSY)
+EVENT_HANDLER(mdec0Interrupt,      PSXINT_MDECINDMA)
+EVENT_HANDLER(gpuotcInterrupt,     PSXINT_GPUOTCDMA)
+EVENT_HANDLER(cdrDmaInterrupt,     PSXINT_CDRDMA)
+EVENT_HANDLER(cdrLidSeekInterrupt, PSXINT_CDRLID)
+EVENT_HANDLER(cdrPlayInterrupt,    PSXINT_CDRPLAY)
+EVENT_HANDLER(sioSyncMcds,         PSXINT_SIO_SYNC_MCD)
+EVENT_HANDLER(psxRequestExit,      PSXINT_CPU_EXIT)
+EVENT_HANDLER(psxProfilerSample,   PSXINT_PROFILE)
+void psxProfilerSchedule(void) {}
+
+// CD sector reads re-arm themselves while a read is in progress
+void cdrReadInterrupt(void)
+{
+	log_event(PSXINT_CDREAD);
+	if (rng() & 1)
+		psxEvqueueAdd(PSXINT_CDREAD, 1000 + rng() % 5000);
+}
+
+// Root counters always have a next target, see psxRcntSet()
+void psxRcntUpdate(void)
+{
+	log_event(PSXINT_RCNT);
+	psxRegs.intCycle[PSXINT_RCNT].sCycle = psxRegs.cycle;
+	psxRegs.intCycle[PSXINT_RCNT].cycle = 500 + rng() % 3000;
+	psxEvqueueAdd(PSXINT_RCNT, psxRegs.intCycle[PSXINT_RCNT].cycle);
+}
+
+void psxRcntAdjustTimestamps(u32 prev_cycle_val) {}
+
+void CALLBACK SPUasync(uint32_t cycle, uint32_t flags)
+{
+	log_event(flags ? PSXINT_SPU_UPDATE : PSXINT_SPUIRQ);
+}
+
+static void usage(const char *name)
+{
+	printf("Usage: %s [options]\n"
+	       "  -steps N   emulated time steps (default 4000000)\n"
+	       "  -runs N    timed runs, best one is reported (default 5)\n"
+	       "  -seed N    random seed (default 1)\n", name);
+}
+
+int main(int argc, char *argv[])
+{
+	static const psxEventNum one_shot[] = {
+		PSXINT_SIO, PSXINT_CDR, PSXINT_CDREAD, PSXINT_GPUDMA,
+		PSXINT_MDECOUTDMA, PSXINT_SPUDMA, PSXINT_GPUBUSY, PSXINT_MDECINDMA,
+		PSXINT_GPUOTCDMA, PSXINT_CDRDMA, PSXINT_CDRLID, PSXINT_CDRPLAY,
+		PSXINT_SPUIRQ, PSXINT_SIO_SYNC_MCD };
+	const int num_one_shot = sizeof(one_shot) / sizeof(one_shot[0]);
+	long steps = 4000000, dispatched = 0;
+	int runs = 5;
+	u32 seed = 1;
+	bench_step_t *step;
+	double best = 0;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-steps") == 0 && i+1 < argc)
+			steps = atol(argv[++i]);
+		else if (strcmp(argv[i], "-runs") == 0 && i+1 < argc)
+			runs = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-seed") == 0 && i+1 < argc)
+			seed = atoi(argv[++i]);
+		else {
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (steps <= 0 || runs <= 0) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	step = (bench_step_t*)malloc(steps * sizeof(*step));
+	if (step == NULL) {
+		printf("ERROR: out of memory\n");
+		return 1;
+	}
+	rng_state = seed;
+	for (long i = 0; i < steps; i++) {
+		u32 r = rng();
+		step[i].cycles = 1 + rng() % 200;
+		step[i].ev = one_shot[r % num_one_shot];
+		step[i].remove = ((r >> 8) % 4 == 0);
+		step[i].after = ((r >> 12) & 1) ? 16 : ((r >> 13) % 20000);
+	}
+
+	Config.PsxType = PSX_TYPE_NTSC;
+	Config.SpuUpdateFreq = SPU_UPDATE_FREQ_4;  // flexible SPU update events
+
+	for (int run = 0; run < runs; run++) {
+		struct timespec t0, t1;
+		double ns;
+
+		// Same starting state and handler randomness every run
+		memset(&psxRegs, 0, sizeof(psxRegs));
+		hash = 14695981039346656037ULL;
+		rng_state = seed;
+		dispatched = 0;
+		psxEvqueueInit();
+		psxRcntUpdate();
+
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		for (long i = 0; i < steps; i++) {
+			// Run 'CPU' for a while, then dispatch what's due like psxBranchTest()
+			psxRegs.cycle += step[i].cycles;
+			while ((psxRegs.cycle - psxRegs.intCycle[PSXINT_NEXT_EVENT].sCycle) >=
+			       psxRegs.intCycle[PSXINT_NEXT_EVENT].cycle) {
+				psxEvqueueDispatchAndRemoveFront(&psxRegs);
+				dispatched++;
+			}
+
+			// HW register write: start, restart or cancel a one-shot event
+			if (step[i].remove)
+				psxEvqueueRemove((psxEventNum)step[i].ev);
+			else
+				psxEvqueueAdd((psxEventNum)step[i].ev, step[i].after);
+		}
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+
+		ns = (t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec);
+		if (run == 0 || ns < best)
+			best = ns;
+	}
+
+	printf("steps: %ld  dispatched: %ld  best of %d: %.1f ms  %.2f ns/step\n",
+	       steps, dispatched, runs, best / 1e6, best / steps);
+	printf("dispatch hash: %016llx\n", (unsigned long long)hash);
+	free(step);
+	return 0;
+}
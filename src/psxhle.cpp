@@ -88,8 +88,283 @@ static void hleExecRet(void) {
 	psxRegs.pc = psxRegs.GPR.n.ra;
 }
 
+/* Native fast paths for hot libc routines.
+ *  PsyQ's libc implements memcpy() and friends as three-opcode stubs that
+ *  jump to the BIOS A0 function table:
+ *     addiu t2, zero, 0xa0
+ *     jr    t2
+ *     addiu t1, zero, <A0 function #>
+ *  The real BIOS versions work a byte per loop iteration, so one call can
+ *  run for thousands of emulated instructions. psxHLELibcScan() replaces the
+ *  first opcode of stubs found in loaded code with HLE opcode 6, whose
+ *  handler below does the work natively and charges an estimate of the
+ *  cycles the BIOS would have taken. Calls it can't handle exactly (NULL or
+ *  non-RAM pointers, overlapping strings, len <= 0) go to the BIOS as usual.
+ *
+ *  Routines can be opted out by name in Config.LibcOptOut ("all" disables
+ *  the scanner and every routine), see psxHLELibcReset().
+ */
+
+#define LIBC_STUB_OP0    0x240a00a0   // addiu t2, zero, 0xa0
+#define LIBC_STUB_OP1    0x01400008   // jr    t2
+#define LIBC_STUB_OP2    0x24090000   // addiu t1, zero, 0 (function # masked)
+#define LIBC_HLE_OPCODE  ((0x3b << 26) | 6)
+
+// Host ptr to 'size' bytes of PS1 RAM at 'addr', or NULL if the range isn't
+//  entirely within RAM (or one of its mirrors)
+static u8 *libcRamPtr(u32 addr, u32 size)
+{
+	if (!PSXMEM_IS_RAM(addr))
+		return NULL;
+
+	addr &= 0x1fffff;
+	if (size > 0x200000 - addr)
+		return NULL;
+
+	return (u8 *)psxM + addr;
+}
+
+// Length of NUL-terminated string at 'addr', or -1 if it doesn't end in RAM
+static s32 libcStrlen(u32 addr)
+{
+	u8 *p = libcRamPtr(addr, 1);
+	if (!p || !addr)
+		return -1;
+
+	u8 *end = (u8 *)memchr(p, '\0', (u8 *)psxM + 0x200000 - p);
+	return end ? (s32)(end - p) : -1;
+}
+
+static void libcClearCode(u32 addr, u32 size)
+{
+#ifdef PSXREC
+	psxCpu->Clear(addr, (size + 3) / 4);
+#endif
+}
+
+// Each function returns false to leave the call to the BIOS, or true after
+//  doing its work, with '*units' set to bytes/chars processed.
+
+static bool libcMemcpy(u32 *units) { // A0:2a
+	u32 dst = psxRegs.GPR.n.a0, src = psxRegs.GPR.n.a1, len = psxRegs.GPR.n.a2;
+	u8 *pd = libcRamPtr(dst, len), *ps = libcRamPtr(src, len);
+
+	if (!dst || (s32)len <= 0 || !pd || !ps)
+		return false;
+
+	if (pd > ps && pd < ps + len) {
+		// BIOS copies forwards a byte at a time, replicating the overlap
+		for (u32 i = 0; i < len; i++)
+			pd[i] = ps[i];
+	} else {
+		memmove(pd, ps, len);
+	}
+	libcClearCode(dst, len);
+
+	psxRegs.GPR.n.v0 = dst;
+	*units = len;
+	return true;
+}
+
+static bool libcMemset(u32 *units) { // A0:2b
+	u32 dst = psxRegs.GPR.n.a0, len = psxRegs.GPR.n.a2;
+	u8 *pd = libcRamPtr(dst, len);
+
+	if (!dst || (s32)len <= 0 || !pd)
+		return false;
+
+	memset(pd, (u8)psxRegs.GPR.n.a1, len);
+	libcClearCode(dst, len);
+
+	psxRegs.GPR.n.v0 = dst;
+	*units = len;
+	return true;
+}
+
+static bool libcBzero(u32 *units) { // A0:28
+	u32 dst = psxRegs.GPR.n.a0, len = psxRegs.GPR.n.a1;
+	u8 *pd = libcRamPtr(dst, len);
+
+	if (!dst || (s32)len <= 0 || !pd)
+		return false;
+
+	memset(pd, 0, len);
+	libcClearCode(dst, len);
+
+	psxRegs.GPR.n.v0 = dst;
+	*units = len;
+	return true;
+}
+
+static bool libcStrcpy(u32 *units) { // A0:19
+	u32 dst = psxRegs.GPR.n.a0, src = psxRegs.GPR.n.a1;
+	s32 len = libcStrlen(src);
+	u8 *pd = libcRamPtr(dst, len + 1);
+
+	if (!dst || len < 0 || !pd)
+		return false;
+
+	u8 *ps = (u8 *)psxM + (src & 0x1fffff);
+	if (pd > ps && pd <= ps + len)
+		return false;
+
+	memmove(pd, ps, len + 1);
+	libcClearCode(dst, len + 1);
+
+	psxRegs.GPR.n.v0 = dst;
+	*units = len + 1;
+	return true;
+}
+
+static bool libcStrlenA0(u32 *units) { // A0:1b
+	s32 len = libcStrlen(psxRegs.GPR.n.a0);
+
+	if (len < 0)
+		return false;
+
+	psxRegs.GPR.n.v0 = len;
+	*units = len;
+	return true;
+}
+
+static bool libcRand(u32 *units) { // A0:2f
+	u32 s = psxMu32(0x9010) * 1103515245 + 12345;
+	psxMu32ref(0x9010) = SWAPu32(s);
+
+	psxRegs.GPR.n.v0 = (s >> 16) & 0x7fff;
+	*units = 0;
+	return true;
+}
+
+static bool libcSrand(u32 *units) { // A0:30
+	psxMu32ref(0x9010) = SWAPu32(psxRegs.GPR.n.a0);
+
+	*units = 0;
+	return true;
+}
+
+typedef struct {
+	const char *name;
+	u8   call;           // BIOS A0 function #
+	bool enabled;
+	u16  ops_per_call;   // Approx. # of opcodes BIOS executes per call..
+	u16  ops_per_unit;   //  ..and per byte/char processed
+	bool (*func)(u32 *units);
+	u32  hits;
+} LibcFunc;
+
+static LibcFunc libc_funcs[] = {
+	{ "memcpy", 0x2a, true, 16, 6, libcMemcpy   },
+	{ "memset", 0x2b, true, 16, 5, libcMemset   },
+	{ "bzero",  0x28, true, 16, 5, libcBzero    },
+	{ "strcpy", 0x19, true, 16, 6, libcStrcpy   },
+	{ "strlen", 0x1b, true, 14, 5, libcStrlenA0 },
+	{ "rand",   0x2f, true, 20, 0, libcRand     },
+	{ "srand",  0x30, true, 12, 0, libcSrand    },
+};
+
+static const int libc_num_funcs = sizeof(libc_funcs) / sizeof(libc_funcs[0]);
+static bool libc_scan_enabled = true;
+
+static LibcFunc *libcFind(u32 call)
+{
+	for (int i = 0; i < libc_num_funcs; i++)
+		if (libc_funcs[i].call == call)
+			return &libc_funcs[i];
+	return NULL;
+}
+
+static void hleLibc(void) {
+	// psxRegs.pc points past the HLE opcode, at stub's 'jr t2'
+	u32 call = PSXMu32(psxRegs.pc + 4) & 0xff;
+	LibcFunc *f = libcFind(call);
+	u32 units;
+
+	psxRegs.GPR.n.t2 = 0xa0;
+	psxRegs.GPR.n.t1 = call;
+
+	if (f && f->enabled && f->func(&units)) {
+		f->hits++;
+		psxRegs.cycle += (f->ops_per_call + f->ops_per_unit * units) * BIAS;
+		psxRegs.pc = psxRegs.GPR.n.ra;
+	} else {
+		psxRegs.pc = 0xa0;
+	}
+
+	psxBranchTest();
+}
+
+// Apply Config.LibcOptOut, a comma-separated list of routine names
+void psxHLELibcReset(void)
+{
+	char list[sizeof(Config.LibcOptOut)];
+	char *tok;
+
+	libc_scan_enabled = true;
+	for (int i = 0; i < libc_num_funcs; i++)
+		libc_funcs[i].enabled = true;
+
+	strcpy(list, Config.LibcOptOut);
+	for (tok = strtok(list, ", "); tok; tok = strtok(NULL, ", ")) {
+		bool all = !strcmp(tok, "all");
+		if (all)
+			libc_scan_enabled = false;
+		// Also catches stubs patched before, e.g. restored from a savestate
+		for (int i = 0; i < libc_num_funcs; i++)
+			if (all || !strcmp(tok, libc_funcs[i].name))
+				libc_funcs[i].enabled = false;
+	}
+}
+
+// Scan code just loaded to 'addr' for libc stubs and patch them
+void psxHLELibcScan(u32 addr, u32 size)
+{
+	u32 patched = 0;
+
+	if (!libc_scan_enabled)
+		return;
+
+	// Stub might straddle the start of the range and code loaded before it
+	addr &= ~3;
+	size = (size + 3) & ~3;
+	if ((addr & 0x1fffff) >= 8) {
+		addr -= 8;
+		size += 8;
+	}
+
+	u32 *p = (u32 *)libcRamPtr(addr, size);
+	if (!p || size < 12)
+		return;
+
+	for (u32 i = 0; i < size / 4 - 2; i++) {
+		if (SWAPu32(p[i]) != LIBC_STUB_OP0 || SWAPu32(p[i+1]) != LIBC_STUB_OP1 ||
+		    (SWAPu32(p[i+2]) & 0xffffff00) != LIBC_STUB_OP2)
+			continue;
+
+		LibcFunc *f = libcFind(SWAPu32(p[i+2]) & 0xff);
+		if (!f || !f->enabled)
+			continue;
+
+		p[i] = SWAPu32(LIBC_HLE_OPCODE);
+		libcClearCode(addr + i * 4, 4);
+		patched++;
+	}
+
+	if (patched)
+		printf("HLE libc: patched %u stub(s) at %08x..%08x\n", patched, addr, addr + size);
+}
+
+void psxHLELibcShutdown(void)
+{
+	for (int i = 0; i < libc_num_funcs; i++) {
+		if (libc_funcs[i].hits)
+			printf("HLE libc: %-7s %u calls\n", libc_funcs[i].name, libc_funcs[i].hits);
+		libc_funcs[i].hits = 0;
+	}
+}
+
 void (*psxHLEt[256])(void) = {
 	hleDummy, hleA0, hleB0, hleC0,
 	hleBootstrap, hleExecRet,
-	hleDummy, hleDummy
+	hleLibc, hleDummy
 };
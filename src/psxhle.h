@@ -27,4 +27,8 @@
 
 extern void (*psxHLEt[256])(void);
 
+void psxHLELibcReset(void);
+void psxHLELibcScan(u32 addr, u32 size);
+void psxHLELibcShutdown(void);
+
 #endif /* __PSXHLE_H__ */
@@ -52,6 +52,7 @@
 #include "mdec.h"
 #include "cdrom.h"
 #include "gpu.h"
+#include "psxdma.h"
 
 void psxHwReset() {
 	//senquack - added Config.SpuIrq option from PCSX Rearmed/Reloaded:
@@ -66,795 +67,600 @@ void psxHwReset() {
 	HW_GPU_STATUS = 0x14802000;
 }
 
-u8 psxHwRead8(u32 add)
-{
-	u8 hard = 0;
+///////////////////////////////////////////////////////////////////////////////
+// HW I/O page table:
+//  Page 0x1f80 is split into 4096 blocks of 16 bytes. Each entry of the
+//  tables below is either the host address of the block inside psxH[] (for
+//  scratchpad and registers without side effects, accessed directly), or
+//  the address of a handlers struct with PSXMEM_HANDLER_TAG set. Handlers
+//  get the full address and fall back to psxH[] for registers in their
+//  block that they don't handle themselves.
+///////////////////////////////////////////////////////////////////////////////
+static uptr hw_rlut[0x1000];
+static uptr hw_wlut[0x1000];
+
+#define HW_BLOCK(add) (((add) & 0xffff) >> 4)
+
+static u8  hwPlainRead8 (u32 add) { return psxHu8(add); }
+static u16 hwPlainRead16(u32 add) { return psxHu16(add); }
+static u32 hwPlainRead32(u32 add) { return psxHu32(add); }
+static void hwPlainWrite8 (u32 add, u8  value) { psxHu8ref(add) = value; }
+static void hwPlainWrite16(u32 add, u16 value) { psxHu16ref(add) = SWAPu16(value); }
+static void hwPlainWrite32(u32 add, u32 value) { psxHu32ref(add) = SWAPu32(value); }
 
-	if ((add & 0x0ff00000) == 0x0f800000)
-	{
-		switch (add) {
-		case 0x1f801040: hard = sioRead8();break; 
-		//  case 0x1f801050: hard = serial_read8(); break;//for use of serial port ignore for now
-		case 0x1f801800: hard = cdrRead0(); break;
-		case 0x1f801801: hard = cdrRead1(); break;
-		case 0x1f801802: hard = cdrRead2(); break;
-		case 0x1f801803: hard = cdrRead3(); break;
-		default:
-			hard = psxHu8(add); 
 #ifdef PSXHW_LOG
-			PSXHW_LOG("*Unkwnown 8bit read at address %x\n", add);
+// Logging builds route all HW registers through handlers
+static u8  hwLogRead8 (u32 add) { PSXHW_LOG("*Unknown 8bit read at address %x\n", add);  return psxHu8(add); }
+static u16 hwLogRead16(u32 add) { PSXHW_LOG("*Unknown 16bit read at address %x\n", add); return psxHu16(add); }
+static u32 hwLogRead32(u32 add) { PSXHW_LOG("*Unknown 32bit read at address %x\n", add); return psxHu32(add); }
+static void hwLogWrite8 (u32 add, u8  value) { PSXHW_LOG("*Unknown 8bit write at address %x value %x\n", add, value);  hwPlainWrite8(add, value); }
+static void hwLogWrite16(u32 add, u16 value) { PSXHW_LOG("*Unknown 16bit write at address %x value %x\n", add, value); hwPlainWrite16(add, value); }
+static void hwLogWrite32(u32 add, u32 value) { PSXHW_LOG("*Unknown 32bit write at address %x value %x\n", add, value); hwPlainWrite32(add, value); }
+
+static const psxMemReadHandlers  log_rhandlers = { hwLogRead8,  hwLogRead16,  hwLogRead32  };
+static const psxMemWriteHandlers log_whandlers = { hwLogWrite8, hwLogWrite16, hwLogWrite32 };
 #endif
-		}
-		return hard;
-	}
 
-#ifdef PSXREC
-	// See note at top of file regarding dynarecs needing added functionality.
-	if ((add & 0x0ff00000) == 0x0fc00000) {
-		// ROM access
-		return psxRu8(add);
-	} else {
-		// A non-32-bit read from cache control port and probably never encountered
-		return 0;
-	}
-#endif //PSXREC
 
-	return hard;
+/* SIO 0x1f801040..0x1f80104f */
+static u8 sioBlockRead8(u32 add)
+{
+	if (add == 0x1f801040)
+		return sioRead8();
+	return psxHu8(add);
 }
 
-u16 psxHwRead16(u32 add)
+static u16 sioBlockRead16(u32 add)
 {
-	u16 hard = 0;
-
-	if ((add & 0x0ff00000) == 0x0f800000)
-	{
-		switch (add) {
-#ifdef PSXHW_LOG
-		case 0x1f801070: PSXHW_LOG("IREG 16bit read %x\n", psxHu16(0x1070));
-			return psxHu16(0x1070);
-#endif
-#ifdef PSXHW_LOG
-		case 0x1f801074: PSXHW_LOG("IMASK 16bit read %x\n", psxHu16(0x1074));
-			return psxHu16(0x1074);
-#endif
+	u16 hard;
+
+	switch (add) {
+	case 0x1f801040: hard = sioRead16();     break;
+	case 0x1f801044: hard = sioReadStat16(); break;
+	case 0x1f801048: hard = sioReadMode16(); break;
+	case 0x1f80104a: hard = sioReadCtrl16(); break;
+	case 0x1f80104e: hard = sioReadBaud16(); break;
+	default:
+		return psxHu16(add);
+	}
 
-		case 0x1f801040:
-			hard = sioRead16();
 #ifdef PAD_LOG
-			PAD_LOG("sio read16 %x; ret = %x\n", add&0xf, hard);
+	PAD_LOG("sio read16 %x; ret = %x\n", add&0xf, hard);
 #endif
-			return hard;
-		case 0x1f801044:
-			hard = sioReadStat16();
-#ifdef PAD_LOG
-			PAD_LOG("sio read16 %x; ret = %x\n", add&0xf, hard);
-#endif
-			return hard;
-		case 0x1f801048:
-			hard = sioReadMode16();
+	return hard;
+}
+
+static u32 sioBlockRead32(u32 add)
+{
+	if (add == 0x1f801040) {
+		u32 hard = sioRead32();
 #ifdef PAD_LOG
-			PAD_LOG("sio read16 %x; ret = %x\n", add&0xf, hard);
+		PAD_LOG("sio read32 ;ret = %x\n", hard);
 #endif
-			return hard;
-		case 0x1f80104a:
-			hard = sioReadCtrl16();
+		return hard;
+	}
+	return psxHu32(add);
+}
+
+static void sioBlockWrite8(u32 add, u8 value)
+{
+	if (add == 0x1f801040)
+		sioWrite8(value);
+
+	// NOTE: Yes, the messy and uncommented original code writes to psxH[]
+	//       even when the port address is known. I won't change this behavior
+	//       because it's unknown what original intent was. -senquack Aug 2017
+	psxHu8ref(add) = value;
+}
+
+static void sioBlockWrite16(u32 add, u16 value)
+{
+	switch (add) {
+	case 0x1f801040: sioWrite16(value);     break;
+	case 0x1f801044: /* sioWriteStat16() is empty, disabled -senquack */ break;
+	case 0x1f801048: sioWriteMode16(value); break;
+	case 0x1f80104a: sioWriteCtrl16(value); break; // control register
+	case 0x1f80104e: sioWriteBaud16(value); break; // baudrate register
+	default:
+		psxHu16ref(add) = SWAPu16(value);
+		return;
+	}
+
 #ifdef PAD_LOG
-			PAD_LOG("sio read16 %x; ret = %x\n", add&0xf, hard);
+	PAD_LOG ("sio write16 %x, %x\n", add&0xf, value);
 #endif
-			return hard;
-		case 0x1f80104e:
-			hard = sioReadBaud16();
+}
+
+static void sioBlockWrite32(u32 add, u32 value)
+{
+	if (add == 0x1f801040) {
+		sioWrite32(value);
 #ifdef PAD_LOG
-			PAD_LOG("sio read16 %x; ret = %x\n", add&0xf, hard);
+		PAD_LOG("sio write32 %x\n", value);
 #endif
-			return hard;
+		return;
+	}
+	psxHu32ref(add) = SWAPu32(value);
+}
 
-		//Serial port stuff not support now ;P
-	 // case 0x1f801050: hard = serial_read16(); break;
-	 //	case 0x1f801054: hard = serial_status_read(); break;
-	 //	case 0x1f80105a: hard = serial_control_read(); break;
-	 //	case 0x1f80105e: hard = serial_baud_read(); break;
+static const psxMemReadHandlers  sio_rhandlers = { sioBlockRead8,  sioBlockRead16,  sioBlockRead32  };
+static const psxMemWriteHandlers sio_whandlers = { sioBlockWrite8, sioBlockWrite16, sioBlockWrite32 };
 
-		case 0x1f801100:
-			hard = psxRcntRcount(0);
-#ifdef PSXHW_LOG
-			PSXHW_LOG("T0 count read16: %x\n", hard);
-#endif
-			return hard;
-		case 0x1f801104:
-			hard = psxRcntRmode(0);
-#ifdef PSXHW_LOG
-			PSXHW_LOG("T0 mode read16: %x\n", hard);
-#endif
-			return hard;
-		case 0x1f801108:
-			hard = psxRcntRtarget(0);
-#ifdef PSXHW_LOG
-			PSXHW_LOG("T0 target read16: %x\n", hard);
-#endif
-			return hard;
-		case 0x1f801110:
-			hard = psxRcntRcount(1);
-#ifdef PSXHW_LOG
-			PSXHW_LOG("T1 count read16: %x\n", hard);
-#endif
-			return hard;
-		case 0x1f801114:
-			hard = psxRcntRmode(1);
-#ifdef PSXHW_LOG
-			PSXHW_LOG("T1 mode read16: %x\n", hard);
-#endif
-			return hard;
-		case 0x1f801118:
-			hard = psxRcntRtarget(1);
-#ifdef PSXHW_LOG
-			PSXHW_LOG("T1 target read16: %x\n", hard);
-#endif
-			return hard;
-		case 0x1f801120:
-			hard = psxRcntRcount(2);
-#ifdef PSXHW_LOG
-			PSXHW_LOG("T2 count read16: %x\n", hard);
-#endif
-			return hard;
-		case 0x1f801124:
-			hard = psxRcntRmode(2);
-#ifdef PSXHW_LOG
-			PSXHW_LOG("T2 mode read16: %x\n", hard);
-#endif
-			return hard;
-		case 0x1f801128:
-			hard = psxRcntRtarget(2);
+
+/* IRQ status/mask 0x1f801070..0x1f80107f */
+static void irqBlockWrite16(u32 add, u16 value)
+{
+	switch (add) {
+	case 0x1f801070:
 #ifdef PSXHW_LOG
-			PSXHW_LOG("T2 target read16: %x\n", hard);
+		PSXHW_LOG("IREG 16bit write %x\n", value);
 #endif
-			return hard;
+		//senquack - Strip all but bits 0:10, rest are 0 or garbage in docs
+		value &= 0x7ff;
+
+		//senquack - added Config.SpuIrq option from PCSX Rearmed/Reloaded:
+		if (Config.SpuIrq) psxHu16ref(0x1070) |= SWAPu16(0x200);
 
-		//case 0x1f802030: hard =   //int_2000????
-		//case 0x1f802040: hard =//dip switches...??
+		psxHu16ref(0x1070) &= SWAPu16(value);
+		break;
 
-		default:
-			if (add >= 0x1f801c00 && add < 0x1f801e00) {
-				hard = SPU_readRegister(add);
-			} else {
-				hard = psxHu16(add); 
+	case 0x1f801074:
 #ifdef PSXHW_LOG
-				PSXHW_LOG("*Unkwnown 16bit read at address %x\n", add);
+		PSXHW_LOG("IMASK 16bit write %x\n", value);
 #endif
-			}
-			return hard;
-		}
-	}
+		//senquack - Strip all but bits 0:10, rest are 0 or garbage in docs
+		value &= 0x7ff;
 
-#ifdef PSXREC
-	// See note at top of file regarding dynarecs needing added functionality.
-	if ((add & 0x0ff00000) == 0x0fc00000) {
-		// ROM access
-		return psxRu16(add);
-	} else {
-		// A non-32-bit read from cache control port and probably never encountered
-		return 0;
+		psxHu16ref(0x1074) = SWAPu16(value);
+		break;
+
+	default:
+		psxHu16ref(add) = SWAPu16(value);
+		return;
 	}
-#endif //PSXREC
 
-	return hard;
+	//senquack - When IRQ is pending and unmasked, ensure psxBranchTest()
+	// gets called as soon as possible, so HW IRQ exception gets handled
+	if (psxHu16(0x1070) & psxHu16(0x1074))
+		ResetIoCycle();
 }
 
-u32 psxHwRead32(u32 add)
+static void irqBlockWrite32(u32 add, u32 value)
 {
-	u32 hard = 0;
-
-	if ((add & 0x0ff00000) == 0x0f800000)
-	{
-		switch (add) {
-		case 0x1f801040:
-			hard = sioRead32();
-#ifdef PAD_LOG
-			PAD_LOG("sio read32 ;ret = %x\n", hard);
-#endif
-			return hard;
-			
-	//	case 0x1f801050: hard = serial_read32(); break;//serial port
+	switch (add) {
+	case 0x1f801070:
 #ifdef PSXHW_LOG
-		case 0x1f801060:
-			PSXHW_LOG("RAM size read %x\n", psxHu32(0x1060));
-			return psxHu32(0x1060);
-#endif
-#ifdef PSXHW_LOG
-		case 0x1f801070: PSXHW_LOG("IREG 32bit read %x\n", psxHu32(0x1070));
-			return psxHu32(0x1070);
-#endif
-#ifdef PSXHW_LOG
-		case 0x1f801074: PSXHW_LOG("IMASK 32bit read %x\n", psxHu32(0x1074));
-			return psxHu32(0x1074);
+		PSXHW_LOG("IREG 32bit write %x\n", value);
 #endif
+		//senquack - Strip all but bits 0:10, rest are 0 or garbage in docs
+		value &= 0x7ff;
 
-		case 0x1f801810:
-			hard = GPU_readData();
-#ifdef PSXHW_LOG
-			PSXHW_LOG("GPU DATA 32bit read %x\n", hard);
-#endif
-			return hard;
-		case 0x1f801814:
-			//senquack - updated to PCSX Rearmed:
-			gpuSyncPluginSR();
-			hard = HW_GPU_STATUS;
-			if (hSyncCount < 240 && (HW_GPU_STATUS & PSXGPU_ILACE_BITS) != PSXGPU_ILACE_BITS)
-				hard |= PSXGPU_LCF & (psxRegs.cycle << 20);
-#ifdef PSXHW_LOG
-			PSXHW_LOG("GPU STATUS 32bit read %x\n", hard);
-#endif
-			return hard;
+		//senquack - added Config.SpuIrq option from PCSX Rearmed/Reloaded:
+		if (Config.SpuIrq) psxHu32ref(0x1070) |= SWAPu32(0x200);
 
-		case 0x1f801820:
-			return mdecRead0();
-		case 0x1f801824:
-			return mdecRead1();
+		psxHu32ref(0x1070) &= SWAPu32(value);
+		break;
 
+	case 0x1f801074:
 #ifdef PSXHW_LOG
-		case 0x1f8010a0:
-			PSXHW_LOG("DMA2 MADR 32bit read %x\n", psxHu32(0x10a0));
-			return SWAPu32(HW_DMA2_MADR);
-		case 0x1f8010a4:
-			PSXHW_LOG("DMA2 BCR 32bit read %x\n", psxHu32(0x10a4));
-			return SWAPu32(HW_DMA2_BCR);
-		case 0x1f8010a8:
-			PSXHW_LOG("DMA2 CHCR 32bit read %x\n", psxHu32(0x10a8));
-			return SWAPu32(HW_DMA2_CHCR);
+		PSXHW_LOG("IMASK 32bit write %x\n", value);
 #endif
+		//senquack - Strip all but bits 0:10, rest are 0 or garbage in docs
+		value &= 0x7ff;
 
-#ifdef PSXHW_LOG
-		case 0x1f8010b0:
-			PSXHW_LOG("DMA3 MADR 32bit read %x\n", psxHu32(0x10b0));
-			return SWAPu32(HW_DMA3_MADR);
-		case 0x1f8010b4:
-			PSXHW_LOG("DMA3 BCR 32bit read %x\n", psxHu32(0x10b4));
-			return SWAPu32(HW_DMA3_BCR);
-		case 0x1f8010b8:
-			PSXHW_LOG("DMA3 CHCR 32bit read %x\n", psxHu32(0x10b8));
-			return SWAPu32(HW_DMA3_CHCR);
-#endif
+		psxHu32ref(0x1074) = SWAPu32(value);
+		break;
 
-		// time for rootcounters :)
-		case 0x1f801100:
-			hard = psxRcntRcount(0);
-#ifdef PSXHW_LOG
-			PSXHW_LOG("T0 count read32: %x\n", hard);
-#endif
-			return hard;
-		case 0x1f801104:
-			hard = psxRcntRmode(0);
-#ifdef PSXHW_LOG
-			PSXHW_LOG("T0 mode read32: %x\n", hard);
-#endif
-			return hard;
-		case 0x1f801108:
-			hard = psxRcntRtarget(0);
-#ifdef PSXHW_LOG
-			PSXHW_LOG("T0 target read32: %x\n", hard);
-#endif
-			return hard;
-		case 0x1f801110:
-			hard = psxRcntRcount(1);
-#ifdef PSXHW_LOG
-			PSXHW_LOG("T1 count read32: %x\n", hard);
-#endif
-			return hard;
-		case 0x1f801114:
-			hard = psxRcntRmode(1);
-#ifdef PSXHW_LOG
-			PSXHW_LOG("T1 mode read32: %x\n", hard);
-#endif
-			return hard;
-		case 0x1f801118:
-			hard = psxRcntRtarget(1);
-#ifdef PSXHW_LOG
-			PSXHW_LOG("T1 target read32: %x\n", hard);
-#endif
-			return hard;
-		case 0x1f801120:
-			hard = psxRcntRcount(2);
-#ifdef PSXHW_LOG
-			PSXHW_LOG("T2 count read32: %x\n", hard);
-#endif
-			return hard;
-		case 0x1f801124:
-			hard = psxRcntRmode(2);
-#ifdef PSXHW_LOG
-			PSXHW_LOG("T2 mode read32: %x\n", hard);
-#endif
-			return hard;
-		case 0x1f801128:
-			hard = psxRcntRtarget(2);
-#ifdef PSXHW_LOG
-			PSXHW_LOG("T2 target read32: %x\n", hard);
-#endif
-			return hard;
-
-		default:
-			hard = psxHu32(add); 
-#ifdef PSXHW_LOG
-			PSXHW_LOG("*Unkwnown 32bit read at address %x\n", add);
-#endif
-			return hard;
-		}
+	default:
+		psxHu32ref(add) = SWAPu32(value);
+		return;
 	}
 
-#ifdef PSXREC
-	// See note at top of file regarding dynarecs needing added functionality.
-	if ((add & 0x0ff00000) == 0x0fc00000) {
-		// ROM access
-		return psxRu32(add);
-	} else {
-		// Cache control port read - mimic original psxmem.cpp behavior and return 0
-		return 0;
-	}
-#endif //PSXREC
+	//senquack - When IRQ is pending and unmasked, ensure psxBranchTest()
+	// gets called as soon as possible, so HW IRQ exception gets handled
+	if (psxHu32(0x1070) & psxHu32(0x1074))
+		ResetIoCycle();
+}
 
-	return hard;
+static const psxMemWriteHandlers irq_whandlers = { hwPlainWrite8, irqBlockWrite16, irqBlockWrite32 };
+
+
+/* DMA channels 0x1f801080..0x1f8010ef, DMA control 0x1f8010f0..0x1f8010ff */
+#define DmaExec(n) { \
+	HW_DMA##n##_CHCR = SWAPu32(value); \
+\
+	if (SWAPu32(HW_DMA##n##_CHCR) & 0x01000000 && SWAPu32(HW_DMA_PCR) & (8 << (n * 4))) { \
+		psxDma##n(SWAPu32(HW_DMA##n##_MADR), SWAPu32(HW_DMA##n##_BCR), SWAPu32(HW_DMA##n##_CHCR)); \
+	} \
 }
 
-void psxHwWrite8(u32 add, u8 value)
+// Only writes to CHCR at offset 8 of a channel's block start a transfer
+#define DMA_BLOCK_HANDLERS(n) \
+static void dma##n##BlockWrite32(u32 add, u32 value) \
+{ \
+	if ((add & 0xf) == 0x8) \
+		DmaExec(n) \
+	else \
+		psxHu32ref(add) = SWAPu32(value); \
+} \
+static const psxMemWriteHandlers dma##n##_whandlers = { hwPlainWrite8, hwPlainWrite16, dma##n##BlockWrite32 };
+
+DMA_BLOCK_HANDLERS(0) // MDEC in DMA
+DMA_BLOCK_HANDLERS(1) // MDEC out DMA
+DMA_BLOCK_HANDLERS(2) // GPU DMA
+DMA_BLOCK_HANDLERS(3) // CDROM DMA
+DMA_BLOCK_HANDLERS(4) // SPU DMA
+DMA_BLOCK_HANDLERS(6) // GPU DMA (OT clear)
+
+static void dmaCtrlBlockWrite32(u32 add, u32 value)
 {
-	if ((add & 0x0ff00000) == 0x0f800000)
-	{
-		switch (add) {
-		case 0x1f801040: sioWrite8(value); break;
-	//	case 0x1f801050: serial_write8(value); break;//serial port
-		case 0x1f801800: cdrWrite0(value); break;
-		case 0x1f801801: cdrWrite1(value); break;
-		case 0x1f801802: cdrWrite2(value); break;
-		case 0x1f801803: cdrWrite3(value); break;
-
-		default:
-			psxHu8(add) = value;
+	if (add != 0x1f8010f4) {
+		psxHu32ref(add) = SWAPu32(value);
+		return;
+	}
+
 #ifdef PSXHW_LOG
-			PSXHW_LOG("*Unknown 8bit write at address %x value %x\n", add, value);
+	PSXHW_LOG("DMA ICR 32bit write %x\n", value);
 #endif
-			return;
-		}
+	u32 tmp = value & 0x00ff803f;
+	tmp |= (SWAPu32(HW_DMA_ICR) & ~value) & 0x7f000000;
+	if ((tmp & HW_DMA_ICR_GLOBAL_ENABLE && tmp & 0x7f000000)
+	    || tmp & HW_DMA_ICR_BUS_ERROR) {
+		if (!(SWAPu32(HW_DMA_ICR) & HW_DMA_ICR_IRQ_SENT))
+			psxHu32ref(0x1070) |= SWAP32(8);
+		tmp |= HW_DMA_ICR_IRQ_SENT;
+	}
+	HW_DMA_ICR = SWAPu32(tmp);
+}
+
+static const psxMemWriteHandlers dmactrl_whandlers = { hwPlainWrite8, hwPlainWrite16, dmaCtrlBlockWrite32 };
+
 
-		// NOTE: Yes, the messy and uncommented original code writes to psxH[]
-		//       even when the port address is known. I won't change this behavior
-		//       because it's unknown what original intent was. -senquack Aug 2017
+/* Root counters 0x1f801100..0x1f80112f, one block per counter */
+#define RCNT_INDEX(add) (((add) >> 4) & 3)
 
-		psxHu8(add) = value;
+static u32 rcntBlockRead32(u32 add)
+{
+	switch (add & 0xf) {
+	case 0x0: return psxRcntRcount(RCNT_INDEX(add));
+	case 0x4: return psxRcntRmode(RCNT_INDEX(add));
+	case 0x8: return psxRcntRtarget(RCNT_INDEX(add));
+	default:  return psxHu32(add);
 	}
-#ifdef PSXHW_LOG
-	PSXHW_LOG("*Known 8bit write at address %x value %x\n", add, value);
-#endif
 }
 
-void psxHwWrite16(u32 add, u16 value)
+static u16 rcntBlockRead16(u32 add)
 {
-	if ((add & 0x0ff00000) == 0x0f800000)
-	{
-		switch (add) {
-		case 0x1f801040:
-			sioWrite16(value);
-#ifdef PAD_LOG
-			PAD_LOG ("sio write16 %x, %x\n", add&0xf, value);
-#endif
-			return;
-		case 0x1f801044:
-			// Function is empty, disabled -senquack
-			//sioWriteStat16(value);
-#ifdef PAD_LOG
-			PAD_LOG ("sio write16 %x, %x\n", add&0xf, value);
-#endif
-			return;
-		case 0x1f801048:
-			sioWriteMode16(value);
-#ifdef PAD_LOG
-			PAD_LOG ("sio write16 %x, %x\n", add&0xf, value);
-#endif
-			return;
-		case 0x1f80104a: // control register
-			sioWriteCtrl16(value);
-#ifdef PAD_LOG
-			PAD_LOG ("sio write16 %x, %x\n", add&0xf, value);
-#endif
-			return;
-		case 0x1f80104e: // baudrate register
-			sioWriteBaud16(value);
-#ifdef PAD_LOG
-			PAD_LOG ("sio write16 %x, %x\n", add&0xf, value);
-#endif
-			return;
+	switch (add & 0xf) {
+	case 0x0: case 0x4: case 0x8:
+		return rcntBlockRead32(add);
+	default:
+		return psxHu16(add);
+	}
+}
 
-		//serial port ;P
-	//  case 0x1f801050: serial_write16(value); break;
-	//	case 0x1f80105a: serial_control_write(value);break;
-	//	case 0x1f80105e: serial_baud_write(value); break;
-	//	case 0x1f801054: serial_status_write(value); break;
+static void rcntBlockWrite16(u32 add, u16 value)
+{
+#ifdef PSXHW_LOG
+	PSXHW_LOG("COUNTER %u reg %x 16bit write %x\n", RCNT_INDEX(add), add & 0xf, value);
+#endif
+	switch (add & 0xf) {
+	case 0x0: psxRcntWcount(RCNT_INDEX(add), value);  break;
+	case 0x4: psxRcntWmode(RCNT_INDEX(add), value);   break;
+	case 0x8: psxRcntWtarget(RCNT_INDEX(add), value); break;
+	default:  psxHu16ref(add) = SWAPu16(value);       break;
+	}
+}
 
-		case 0x1f801070: 
+static void rcntBlockWrite32(u32 add, u32 value)
+{
 #ifdef PSXHW_LOG
-			PSXHW_LOG("IREG 16bit write %x\n", value);
+	PSXHW_LOG("COUNTER %u reg %x 32bit write %x\n", RCNT_INDEX(add), add & 0xf, value);
 #endif
-			//senquack - Strip all but bits 0:10, rest are 0 or garbage in docs
-			value &= 0x7ff;
+	switch (add & 0xf) {
+	case 0x0: psxRcntWcount(RCNT_INDEX(add), value & 0xffff);  break;
+	case 0x4: psxRcntWmode(RCNT_INDEX(add), value);            break;
+	case 0x8: psxRcntWtarget(RCNT_INDEX(add), value & 0xffff); break;
+	default:  psxHu32ref(add) = SWAPu32(value);                break;
+	}
+}
 
-			//senquack - added Config.SpuIrq option from PCSX Rearmed/Reloaded:
-			if (Config.SpuIrq) psxHu16ref(0x1070) |= SWAPu16(0x200);
+static const psxMemReadHandlers  rcnt_rhandlers = { hwPlainRead8,  rcntBlockRead16,  rcntBlockRead32  };
+static const psxMemWriteHandlers rcnt_whandlers = { hwPlainWrite8, rcntBlockWrite16, rcntBlockWrite32 };
 
-			psxHu16ref(0x1070) &= SWAPu16(value);
 
-			//senquack - When IRQ is pending and unmasked, ensure psxBranchTest()
-			// gets called as soon as possible, so HW IRQ exception gets handled
-			if (psxHu16(0x1070) & psxHu16(0x1074))
-				ResetIoCycle();
+/* CDROM 0x1f801800..0x1f80180f, 8-bit ports only */
+static u8 cdrBlockRead8(u32 add)
+{
+	switch (add) {
+	case 0x1f801800: return cdrRead0();
+	case 0x1f801801: return cdrRead1();
+	case 0x1f801802: return cdrRead2();
+	case 0x1f801803: return cdrRead3();
+	default:         return psxHu8(add);
+	}
+}
 
-			return;
+static void cdrBlockWrite8(u32 add, u8 value)
+{
+	switch (add) {
+	case 0x1f801800: cdrWrite0(value); break;
+	case 0x1f801801: cdrWrite1(value); break;
+	case 0x1f801802: cdrWrite2(value); break;
+	case 0x1f801803: cdrWrite3(value); break;
+	default: break;
+	}
 
-		case 0x1f801074:
-#ifdef PSXHW_LOG
-			PSXHW_LOG("IMASK 16bit write %x\n", value);
-#endif
-			//senquack - Strip all but bits 0:10, rest are 0 or garbage in docs
-			value &= 0x7ff;
+	// See note in sioBlockWrite8()
+	psxHu8ref(add) = value;
+}
 
-			psxHu16ref(0x1074) = SWAPu16(value);
+static const psxMemReadHandlers  cdr_rhandlers = { cdrBlockRead8,  hwPlainRead16,  hwPlainRead32  };
+static const psxMemWriteHandlers cdr_whandlers = { cdrBlockWrite8, hwPlainWrite16, hwPlainWrite32 };
 
-			//senquack - When IRQ is pending and unmasked, ensure psxBranchTest()
-			// gets called as soon as possible, so HW IRQ exception gets handled
-			if (psxHu16(0x1070) & psxHu16(0x1074))
-				ResetIoCycle();
 
-			return;
+/* GPU 0x1f801810..0x1f80181f, 32-bit ports only */
+static u32 gpuBlockRead32(u32 add)
+{
+	u32 hard;
 
-		case 0x1f801100:
+	switch (add) {
+	case 0x1f801810:
+		hard = GPU_readData();
 #ifdef PSXHW_LOG
-			PSXHW_LOG("COUNTER 0 COUNT 16bit write %x\n", value);
+		PSXHW_LOG("GPU DATA 32bit read %x\n", hard);
 #endif
-			psxRcntWcount(0, value);
-			return;
-		case 0x1f801104:
-#ifdef PSXHW_LOG
-			PSXHW_LOG("COUNTER 0 MODE 16bit write %x\n", value);
-#endif
-			psxRcntWmode(0, value);
-			return;
-		case 0x1f801108:
+		return hard;
+	case 0x1f801814:
+		//senquack - updated to PCSX Rearmed:
+		gpuSyncPluginSR();
+		// Plugin has now drawn any commands written to data port
+		gpuBusyAdd(0);
+		hard = HW_GPU_STATUS;
+		if (hSyncCount < 240 && (HW_GPU_STATUS & PSXGPU_ILACE_BITS) != PSXGPU_ILACE_BITS)
+			hard |= PSXGPU_LCF & (psxRegs.cycle << 20);
 #ifdef PSXHW_LOG
-			PSXHW_LOG("COUNTER 0 TARGET 16bit write %x\n", value);
+		PSXHW_LOG("GPU STATUS 32bit read %x\n", hard);
 #endif
-			psxRcntWtarget(0, value);
-			return;
+		return hard;
+	default:
+		return psxHu32(add);
+	}
+}
 
-		case 0x1f801110:
-#ifdef PSXHW_LOG
-			PSXHW_LOG("COUNTER 1 COUNT 16bit write %x\n", value);
-#endif
-			psxRcntWcount(1, value);
-			return;
-		case 0x1f801114:
+static void gpuBlockWrite32(u32 add, u32 value)
+{
+	switch (add) {
+	case 0x1f801810:
 #ifdef PSXHW_LOG
-			PSXHW_LOG("COUNTER 1 MODE 16bit write %x\n", value);
+		PSXHW_LOG("GPU DATA 32bit write %x\n", value);
 #endif
-			psxRcntWmode(1, value);
-			return;
-		case 0x1f801118:
+		GPU_writeData(value);
+		break;
+	case 0x1f801814:
+		//senquack - updated to PCSX Rearmed:
 #ifdef PSXHW_LOG
-			PSXHW_LOG("COUNTER 1 TARGET 16bit write %x\n", value);
+		PSXHW_LOG("GPU STATUS 32bit write %x\n", value);
 #endif
-			psxRcntWtarget(1, value);
-			return;
+		GPU_writeStatus(value);
+		gpuSyncPluginSR();
+		break;
+	default:
+		psxHu32ref(add) = SWAPu32(value);
+		break;
+	}
+}
 
-		case 0x1f801120:
-#ifdef PSXHW_LOG
-			PSXHW_LOG("COUNTER 2 COUNT 16bit write %x\n", value);
-#endif
-			psxRcntWcount(2, value);
-			return;
-		case 0x1f801124:
-#ifdef PSXHW_LOG
-			PSXHW_LOG("COUNTER 2 MODE 16bit write %x\n", value);
-#endif
-			psxRcntWmode(2, value);
-			return;
-		case 0x1f801128:
-#ifdef PSXHW_LOG
-			PSXHW_LOG("COUNTER 2 TARGET 16bit write %x\n", value);
-#endif
-			psxRcntWtarget(2, value); 
-			return;
+static const psxMemReadHandlers  gpu_rhandlers = { hwPlainRead8,  hwPlainRead16,  gpuBlockRead32  };
+static const psxMemWriteHandlers gpu_whandlers = { hwPlainWrite8, hwPlainWrite16, gpuBlockWrite32 };
 
-		default:
-			if (add>=0x1f801c00 && add<0x1f801e00) {
-				SPU_writeRegister(add, value, psxRegs.cycle);
-				return;
-			}
 
-			psxHu16ref(add) = SWAPu16(value);
-#ifdef PSXHW_LOG
-			PSXHW_LOG("*Unknown 16bit write at address %x value %x\n", add, value);
-#endif
-			return;
-		}
+/* MDEC 0x1f801820..0x1f80182f, 32-bit ports only */
+static u32 mdecBlockRead32(u32 add)
+{
+	switch (add) {
+	case 0x1f801820: return mdecRead0();
+	case 0x1f801824: return mdecRead1();
+	default:         return psxHu32(add);
 	}
 }
 
-#define DmaExec(n) { \
-	HW_DMA##n##_CHCR = SWAPu32(value); \
-\
-	if (SWAPu32(HW_DMA##n##_CHCR) & 0x01000000 && SWAPu32(HW_DMA_PCR) & (8 << (n * 4))) { \
-		psxDma##n(SWAPu32(HW_DMA##n##_MADR), SWAPu32(HW_DMA##n##_BCR), SWAPu32(HW_DMA##n##_CHCR)); \
-	} \
+static void mdecBlockWrite32(u32 add, u32 value)
+{
+	switch (add) {
+	case 0x1f801820: mdecWrite0(value); break;
+	case 0x1f801824: mdecWrite1(value); break;
+	default: psxHu32ref(add) = SWAPu32(value); break;
+	}
 }
 
-void psxHwWrite32(u32 add, u32 value)
+static const psxMemReadHandlers  mdec_rhandlers = { hwPlainRead8,  hwPlainRead16,  mdecBlockRead32  };
+static const psxMemWriteHandlers mdec_whandlers = { hwPlainWrite8, hwPlainWrite16, mdecBlockWrite32 };
+
+
+/* SPU 0x1f801c00..0x1f801dff, 16-bit ports */
+static u16 spuBlockRead16(u32 add)
 {
-	if ((add & 0x0ff00000) == 0x0f800000)
-	{
-		switch (add) {
-		case 0x1f801040:
-			sioWrite32(value);
-#ifdef PAD_LOG
-			PAD_LOG("sio write32 %x\n", value);
-#endif
-			return;
-	//	case 0x1f801050: serial_write32(value); break;//serial port
-#ifdef PSXHW_LOG
-		case 0x1f801060:
-			PSXHW_LOG("RAM size write %x\n", value);
-			psxHu32ref(add) = SWAPu32(value);
-			return; // Ram size
-#endif
+	return SPU_readRegister(add);
+}
 
-		case 0x1f801070: 
-#ifdef PSXHW_LOG
-			PSXHW_LOG("IREG 32bit write %x\n", value);
-#endif
-			//senquack - Strip all but bits 0:10, rest are 0 or garbage in docs
-			value &= 0x7ff;
+static void spuBlockWrite16(u32 add, u16 value)
+{
+	SPU_writeRegister(add, value, psxRegs.cycle);
+}
 
-			//senquack - added Config.SpuIrq option from PCSX Rearmed/Reloaded:
-			if (Config.SpuIrq) psxHu32ref(0x1070) |= SWAPu32(0x200);
+static void spuBlockWrite32(u32 add, u32 value)
+{
+	// Dukes of Hazard 2 - car engine noise
+	SPU_writeRegister(add, value&0xffff, psxRegs.cycle);
+	SPU_writeRegister(add + 2, value>>16, psxRegs.cycle);
+}
 
-			psxHu32ref(0x1070) &= SWAPu32(value);
+static const psxMemReadHandlers  spu_rhandlers = { hwPlainRead8,  spuBlockRead16,  hwPlainRead32   };
+static const psxMemWriteHandlers spu_whandlers = { hwPlainWrite8, spuBlockWrite16, spuBlockWrite32 };
 
-			//senquack - When IRQ is pending and unmasked, ensure psxBranchTest()
-			// gets called as soon as possible, so HW IRQ exception gets handled
-			if (psxHu32(0x1070) & psxHu32(0x1074))
-				ResetIoCycle();
 
-			return;
-		case 0x1f801074:
-#ifdef PSXHW_LOG
-			PSXHW_LOG("IMASK 32bit write %x\n", value);
-#endif
-			//senquack - Strip all but bits 0:10, rest are 0 or garbage in docs
-			value &= 0x7ff;
+/* Install handlers for 16-byte blocks 'first'..'last' (addresses in page
+ *  0x1f80). NULL leaves that direction as it was.
+ */
+static void hwMapBlocks(u32 first, u32 last,
+                        const psxMemReadHandlers *r, const psxMemWriteHandlers *w)
+{
+	for (u32 i = HW_BLOCK(first); i <= HW_BLOCK(last); i++) {
+		if (r) hw_rlut[i] = PSXMEM_HANDLER_ENTRY(r);
+		if (w) hw_wlut[i] = PSXMEM_HANDLER_ENTRY(w);
+	}
+}
 
-			psxHu32ref(0x1074) = SWAPu32(value);
+/* Build HW I/O page table. Called by psxMemInit() once psxH is allocated. */
+void psxHwInitLUT(void)
+{
+	// Scratchpad and registers without side effects live in psxH[]
+	for (int i = 0; i < 0x1000; i++)
+		hw_rlut[i] = hw_wlut[i] = (uptr)&psxH[i << 4];
+
+#ifdef PSXHW_LOG
+	hwMapBlocks(0x1000, 0x2fff, &log_rhandlers, &log_whandlers);
+#endif
+
+	hwMapBlocks(0x1040, 0x104f, &sio_rhandlers,  &sio_whandlers);
+	hwMapBlocks(0x1070, 0x107f, NULL,            &irq_whandlers);
+	hwMapBlocks(0x1080, 0x108f, NULL,            &dma0_whandlers);
+	hwMapBlocks(0x1090, 0x109f, NULL,            &dma1_whandlers);
+	hwMapBlocks(0x10a0, 0x10af, NULL,            &dma2_whandlers);
+	hwMapBlocks(0x10b0, 0x10bf, NULL,            &dma3_whandlers);
+	hwMapBlocks(0x10c0, 0x10cf, NULL,            &dma4_whandlers);
+	hwMapBlocks(0x10e0, 0x10ef, NULL,            &dma6_whandlers);
+	hwMapBlocks(0x10f0, 0x10ff, NULL,            &dmactrl_whandlers);
+	hwMapBlocks(0x1100, 0x112f, &rcnt_rhandlers, &rcnt_whandlers);
+	hwMapBlocks(0x1800, 0x180f, &cdr_rhandlers,  &cdr_whandlers);
+	hwMapBlocks(0x1810, 0x181f, &gpu_rhandlers,  &gpu_whandlers);
+	hwMapBlocks(0x1820, 0x182f, &mdec_rhandlers, &mdec_whandlers);
+	hwMapBlocks(0x1c00, 0x1dff, &spu_rhandlers,  &spu_whandlers);
+}
 
-			//senquack - When IRQ is pending and unmasked, ensure psxBranchTest()
-			// gets called as soon as possible, so HW IRQ exception gets handled
-			if (psxHu32(0x1070) & psxHu32(0x1074))
-				ResetIoCycle();
 
-			return;
+///////////////////////////////////////////////////////////////////////////////
+// Reads/writes to page 0x1f80 dispatch through the tables above. KSEG0/KSEG1
+//  mirrors 0x9f80/0xbf80 were never decoded as HW registers and remain plain
+//  psxH[] accesses.
+///////////////////////////////////////////////////////////////////////////////
+u8 psxHwRead8(u32 add)
+{
+	if ((add >> 16) == 0x1f80) {
+		uptr e = hw_rlut[HW_BLOCK(add)];
+		if (!PSXMEM_IS_HANDLER(e))
+			return *(u8 *)(e + (add & 0xf));
+		return PSXMEM_HANDLER(psxMemReadHandlers, e)->read8(add);
+	}
 
-#ifdef PSXHW_LOG
-		case 0x1f801080:
-			PSXHW_LOG("DMA0 MADR 32bit write %x\n", value);
-			HW_DMA0_MADR = SWAPu32(value); // DMA0 madr
-			return;
-		case 0x1f801084:
-			PSXHW_LOG("DMA0 BCR 32bit write %x\n", value);
-			HW_DMA0_BCR  = SWAPu32(value); // DMA0 bcr
-			return;
-#endif
-		case 0x1f801088:
-#ifdef PSXHW_LOG
-			PSXHW_LOG("DMA0 CHCR 32bit write %x\n", value);
-#endif
-			DmaExec(0);	                 // DMA0 chcr (MDEC in DMA)
-			return;
+	if ((add & 0x0ff00000) == 0x0f800000)
+		return psxHu8(add);
 
-#ifdef PSXHW_LOG
-		case 0x1f801090:
-			PSXHW_LOG("DMA1 MADR 32bit write %x\n", value);
-			HW_DMA1_MADR = SWAPu32(value); // DMA1 madr
-			return;
-		case 0x1f801094:
-			PSXHW_LOG("DMA1 BCR 32bit write %x\n", value);
-			HW_DMA1_BCR  = SWAPu32(value); // DMA1 bcr
-			return;
-#endif
-		case 0x1f801098:
-#ifdef PSXHW_LOG
-			PSXHW_LOG("DMA1 CHCR 32bit write %x\n", value);
-#endif
-			DmaExec(1);                  // DMA1 chcr (MDEC out DMA)
-			return;
+#ifdef PSXREC
+	// See note at top of file regarding dynarecs needing added functionality.
+	if ((add & 0x0ff00000) == 0x0fc00000) {
+		// ROM access
+		return psxRu8(add);
+	}
+	// A non-32-bit read from cache control port and probably never encountered
+#endif //PSXREC
 
-#ifdef PSXHW_LOG
-		case 0x1f8010a0:
-			PSXHW_LOG("DMA2 MADR 32bit write %x\n", value);
-			HW_DMA2_MADR = SWAPu32(value); // DMA2 madr
-			return;
-		case 0x1f8010a4:
-			PSXHW_LOG("DMA2 BCR 32bit write %x\n", value);
-			HW_DMA2_BCR  = SWAPu32(value); // DMA2 bcr
-			return;
-#endif
-		case 0x1f8010a8:
-#ifdef PSXHW_LOG
-			PSXHW_LOG("DMA2 CHCR 32bit write %x\n", value);
-#endif
-			DmaExec(2);                  // DMA2 chcr (GPU DMA)
-			return;
+	return 0;
+}
 
-#ifdef PSXHW_LOG
-		case 0x1f8010b0:
-			PSXHW_LOG("DMA3 MADR 32bit write %x\n", value);
-			HW_DMA3_MADR = SWAPu32(value); // DMA3 madr
-			return;
-		case 0x1f8010b4:
-			PSXHW_LOG("DMA3 BCR 32bit write %x\n", value);
-			HW_DMA3_BCR  = SWAPu32(value); // DMA3 bcr
-			return;
-#endif
-		case 0x1f8010b8:
-#ifdef PSXHW_LOG
-			PSXHW_LOG("DMA3 CHCR 32bit write %x\n", value);
-#endif
-			DmaExec(3);                  // DMA3 chcr (CDROM DMA)
-			
-			return;
+u16 psxHwRead16(u32 add)
+{
+	if ((add >> 16) == 0x1f80) {
+		uptr e = hw_rlut[HW_BLOCK(add)];
+		if (!PSXMEM_IS_HANDLER(e))
+			return SWAPu16(*(u16 *)(e + (add & 0xf)));
+		return PSXMEM_HANDLER(psxMemReadHandlers, e)->read16(add);
+	}
 
-#ifdef PSXHW_LOG
-		case 0x1f8010c0:
-			PSXHW_LOG("DMA4 MADR 32bit write %x\n", value);
-			HW_DMA4_MADR = SWAPu32(value); // DMA4 madr
-			return;
-		case 0x1f8010c4:
-			PSXHW_LOG("DMA4 BCR 32bit write %x\n", value);
-			HW_DMA4_BCR  = SWAPu32(value); // DMA4 bcr
-			return;
-#endif
-		case 0x1f8010c8:
-#ifdef PSXHW_LOG
-			PSXHW_LOG("DMA4 CHCR 32bit write %x\n", value);
-#endif
-			DmaExec(4);                  // DMA4 chcr (SPU DMA)
-			return;
+	if ((add & 0x0ff00000) == 0x0f800000)
+		return psxHu16(add);
 
-#ifdef PSXHW_LOG
-		case 0x1f8010e0:
-			PSXHW_LOG("DMA6 MADR 32bit write %x\n", value);
-			HW_DMA6_MADR = SWAPu32(value); // DMA6 bcr
-			return;
-		case 0x1f8010e4:
-			PSXHW_LOG("DMA6 BCR 32bit write %x\n", value);
-			HW_DMA6_BCR  = SWAPu32(value); // DMA6 bcr
-			return;
-#endif
-		case 0x1f8010e8:
-#ifdef PSXHW_LOG
-			PSXHW_LOG("DMA6 CHCR 32bit write %x\n", value);
-#endif
-			DmaExec(6);                   // DMA6 chcr (OT clear)
-			return;
+#ifdef PSXREC
+	// See note at top of file regarding dynarecs needing added functionality.
+	if ((add & 0x0ff00000) == 0x0fc00000) {
+		// ROM access
+		return psxRu16(add);
+	}
+	// A non-32-bit read from cache control port and probably never encountered
+#endif //PSXREC
 
-#ifdef PSXHW_LOG
-		case 0x1f8010f0:
-			PSXHW_LOG("DMA PCR 32bit write %x\n", value);
-			HW_DMA_PCR = SWAPu32(value);
-			return;
-#endif
+	return 0;
+}
 
-		case 0x1f8010f4:
-#ifdef PSXHW_LOG
-			PSXHW_LOG("DMA ICR 32bit write %x\n", value);
-#endif
-		{
-			u32 tmp = value & 0x00ff803f;
-			tmp |= (SWAPu32(HW_DMA_ICR) & ~value) & 0x7f000000;
-			if ((tmp & HW_DMA_ICR_GLOBAL_ENABLE && tmp & 0x7f000000)
-			    || tmp & HW_DMA_ICR_BUS_ERROR) {
-				if (!(SWAPu32(HW_DMA_ICR) & HW_DMA_ICR_IRQ_SENT))
-					psxHu32ref(0x1070) |= SWAP32(8);
-				tmp |= HW_DMA_ICR_IRQ_SENT;
-			}
-			HW_DMA_ICR = SWAPu32(tmp);
-			return;
-		}
-
-		case 0x1f801810:
-#ifdef PSXHW_LOG
-			PSXHW_LOG("GPU DATA 32bit write %x\n", value);
-#endif
-			GPU_writeData(value);
-			return;
-		case 0x1f801814:
-			//senquack - updated to PCSX Rearmed:
-#ifdef PSXHW_LOG
-			PSXHW_LOG("GPU STATUS 32bit write %x\n", value);
-#endif
-			GPU_writeStatus(value);
-			gpuSyncPluginSR();
+u32 psxHwRead32(u32 add)
+{
+	if ((add >> 16) == 0x1f80) {
+		uptr e = hw_rlut[HW_BLOCK(add)];
+		if (!PSXMEM_IS_HANDLER(e))
+			return SWAPu32(*(u32 *)(e + (add & 0xf)));
+		return PSXMEM_HANDLER(psxMemReadHandlers, e)->read32(add);
+	}
 
-			return;
+	if ((add & 0x0ff00000) == 0x0f800000)
+		return psxHu32(add);
 
-		case 0x1f801820:
-			mdecWrite0(value); break;
-		case 0x1f801824:
-			mdecWrite1(value); break;
+#ifdef PSXREC
+	// See note at top of file regarding dynarecs needing added functionality.
+	if ((add & 0x0ff00000) == 0x0fc00000) {
+		// ROM access
+		return psxRu32(add);
+	}
+	// Cache control port read - mimic original psxmem.cpp behavior and return 0
+#endif //PSXREC
 
-		case 0x1f801100:
-#ifdef PSXHW_LOG
-			PSXHW_LOG("COUNTER 0 COUNT 32bit write %x\n", value);
-#endif
-			psxRcntWcount(0, value & 0xffff);
-			return;
-		case 0x1f801104:
-#ifdef PSXHW_LOG
-			PSXHW_LOG("COUNTER 0 MODE 32bit write %x\n", value);
-#endif
-			psxRcntWmode(0, value);
-			return;
-		case 0x1f801108:
-#ifdef PSXHW_LOG
-			PSXHW_LOG("COUNTER 0 TARGET 32bit write %x\n", value);
-#endif
-			psxRcntWtarget(0, value & 0xffff); //  HW_DMA_ICR&= SWAP32((~value)&0xff000000);
-			return;
+	return 0;
+}
 
-		case 0x1f801110:
-#ifdef PSXHW_LOG
-			PSXHW_LOG("COUNTER 1 COUNT 32bit write %x\n", value);
-#endif
-			psxRcntWcount(1, value & 0xffff);
-			return;
-		case 0x1f801114:
-#ifdef PSXHW_LOG
-			PSXHW_LOG("COUNTER 1 MODE 32bit write %x\n", value);
-#endif
-			psxRcntWmode(1, value);
-			return;
-		case 0x1f801118:
-#ifdef PSXHW_LOG
-			PSXHW_LOG("COUNTER 1 TARGET 32bit write %x\n", value);
-#endif
-			psxRcntWtarget(1, value & 0xffff);
-			return;
+void psxHwWrite8(u32 add, u8 value)
+{
+	if ((add >> 16) == 0x1f80) {
+		uptr e = hw_wlut[HW_BLOCK(add)];
+		if (!PSXMEM_IS_HANDLER(e))
+			*(u8 *)(e + (add & 0xf)) = value;
+		else
+			PSXMEM_HANDLER(psxMemWriteHandlers, e)->write8(add, value);
+		return;
+	}
 
-		case 0x1f801120:
-#ifdef PSXHW_LOG
-			PSXHW_LOG("COUNTER 2 COUNT 32bit write %x\n", value);
-#endif
-			psxRcntWcount(2, value & 0xffff);
-			return;
-		case 0x1f801124:
-#ifdef PSXHW_LOG
-			PSXHW_LOG("COUNTER 2 MODE 32bit write %x\n", value);
-#endif
-			psxRcntWmode(2, value);
-			return;
-		case 0x1f801128:
-#ifdef PSXHW_LOG
-			PSXHW_LOG("COUNTER 2 TARGET 32bit write %x\n", value);
-#endif
-			psxRcntWtarget(2, value & 0xffff);
-			return;
-
-		default:
-			// Dukes of Hazard 2 - car engine noise
-			if (add>=0x1f801c00 && add<0x1f801e00) {
-				SPU_writeRegister(add, value&0xffff, psxRegs.cycle);
-				SPU_writeRegister(add + 2, value>>16, psxRegs.cycle);
-				return;
-			}
-
-			psxHu32ref(add) = SWAPu32(value);
-#ifdef PSXHW_LOG
-			PSXHW_LOG("*Unknown 32bit write at address %x value %x\n", add, value);
-#endif
-			return;
-		}
+	if ((add & 0x0ff00000) == 0x0f800000)
+		psxHu8ref(add) = value;
+}
+
+void psxHwWrite16(u32 add, u16 value)
+{
+	if ((add >> 16) == 0x1f80) {
+		uptr e = hw_wlut[HW_BLOCK(add)];
+		if (!PSXMEM_IS_HANDLER(e))
+			*(u16 *)(e + (add & 0xf)) = SWAPu16(value);
+		else
+			PSXMEM_HANDLER(psxMemWriteHandlers, e)->write16(add, value);
+		return;
+	}
+
+	if ((add & 0x0ff00000) == 0x0f800000)
+		psxHu16ref(add) = SWAPu16(value);
+}
+
+void psxHwWrite32(u32 add, u32 value)
+{
+	if ((add >> 16) == 0x1f80) {
+		uptr e = hw_wlut[HW_BLOCK(add)];
+		if (!PSXMEM_IS_HANDLER(e))
+			*(u32 *)(e + (add & 0xf)) = SWAPu32(value);
+		else
+			PSXMEM_HANDLER(psxMemWriteHandlers, e)->write32(add, value);
+		return;
+	}
+
+	if ((add & 0x0ff00000) == 0x0f800000) {
+		psxHu32ref(add) = SWAPu32(value);
+		return;
 	}
 
 #ifdef PSXREC
@@ -864,7 +670,6 @@ void psxHwWrite32(u32 add, u32 value)
 		return;
 	}
 #endif
-
 }
 
 int psxHwFreeze(void* f, FreezeMode mode) {
@@ -72,6 +72,7 @@
 }
 
 void psxHwReset(void);
+void psxHwInitLUT(void);
 u8   psxHwRead8 (u32 add);
 u16  psxHwRead16(u32 add);
 u32  psxHwRead32(u32 add);
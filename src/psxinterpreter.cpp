@@ -950,7 +950,7 @@ static void intReset(void) {
 }
 
 static void intExecute(void) {
-	for (;;)
+	while (!psxExitRequested)
 		execI();
 }
 
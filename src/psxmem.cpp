@@ -65,11 +65,61 @@ bool psxP_allocated;
 bool psxR_allocated;
 bool psxH_allocated;
 
-u8 **psxMemWLUT;
 u8 **psxMemRLUT;
+uptr *psxMemWLUT;
 
 static u8 *psxNULLread;
 
+/* Writes to ROM and unmapped space, or to RAM while cache is isolated */
+static void psxMemNullWrite8(u32 mem, u8 value)
+{
+	PSXMEM_LOG("%s(): err sb 0x%08x\n", __func__, mem);
+}
+
+static void psxMemNullWrite16(u32 mem, u16 value)
+{
+	PSXMEM_LOG("%s(): err sh 0x%08x\n", __func__, mem);
+}
+
+static void psxMemNullWrite32(u32 mem, u32 value)
+{
+#ifdef PSXREC
+	if (!psxRegs.writeok) psxCpu->Clear(mem, 1);
+#endif
+	if (psxRegs.writeok) { PSXMEM_LOG("%s(): err sw 0x%08x\n", __func__, mem); }
+}
+
+static void psxMemCacheCtrlWrite32(u32 mem, u32 value)
+{
+	if (mem == 0xfffe0130)
+		psxMemWrite32_CacheCtrlPort(value);
+	else
+		psxMemNullWrite32(mem, value);
+}
+
+static const psxMemWriteHandlers null_whandlers =
+	{ psxMemNullWrite8, psxMemNullWrite16, psxMemNullWrite32 };
+
+static const psxMemWriteHandlers cachectrl_whandlers =
+	{ psxMemNullWrite8, psxMemNullWrite16, psxMemCacheCtrlWrite32 };
+
+// Page 0x1f80 and its KSEG0/KSEG1 mirrors: psxHwWrite*() handles both.
+//  Stores to the mirrors stay plain psxH[] writes, without code invalidation.
+static const psxMemWriteHandlers hw_whandlers =
+	{ psxHwWrite8, psxHwWrite16, psxHwWrite32 };
+
+/* Make RAM pages in psxMemWLUT[] writable, or not (cache isolation) */
+static void psxMemMapRamW(bool writable)
+{
+	psxMemDirect = writable && psxMemMapped;
+
+	for (int i = 0; i < 0x80; i++) {
+		uptr e = writable ? (uptr)&psxM[(i & 0x1f) << 16]
+		                  : PSXMEM_HANDLER_ENTRY(&null_whandlers);
+		psxMemWLUT[i + 0x0000] = psxMemWLUT[i + 0x8000] = psxMemWLUT[i + 0xa000] = e;
+	}
+}
+
 /*  Playstation Memory Map (from Playstation doc by Joshua Walker)
 0x0000_0000-0x0000_ffff		Kernel (64K)	
 0x0001_0000-0x001f_ffff		User Memory (1.9 Meg)	
@@ -92,10 +142,15 @@ int psxMemInit()
 	int i;
 
 	if (psxMemRLUT == NULL) { psxMemRLUT = (u8 **)calloc(0x10000, sizeof(void *)); }
-	if (psxMemWLUT == NULL) { psxMemWLUT = (u8 **)calloc(0x10000, sizeof(void *)); }
+	if (psxMemWLUT == NULL) { psxMemWLUT = (uptr *)calloc(0x10000, sizeof(uptr)); }
 	if (psxNULLread == NULL) { psxNULLread = (u8*)calloc(0x10000, 1); }
 
-	// If a dynarec hasn't already mmap'd any of psxM,psxP,psxH,psxR, allocate
+	// Map/mirror psxM,psxP,psxH,psxR virtually, unless a dynarec already did.
+	//  Fails harmlessly if not supported on platform (see psxmem_mapping.cpp)
+	if (!psxMemMapped)
+		psxMemMapVirtual(false);
+
+	// If psxM,psxP,psxH,psxR haven't been mapped, allocate
 	//  them here. Always use booleans 'psxM_allocated' etc to check allocation
 	//  status: Dynarecs could choose to mmap 'psxM' pointer to address 0,
 	//  making a standard pointer NULLness check inappropriate.
@@ -127,7 +182,7 @@ int psxMemInit()
 	memcpy(psxMemRLUT + 0xa000, psxMemRLUT, 0x80 * sizeof(void *));
 
 	psxMemRLUT[0x1f00] = (u8 *)psxP;
-	psxMemRLUT[0x1f80] = (u8 *)psxH;
+	psxMemRLUT[0x1f80] = psxMemRLUT[0x9f80] = psxMemRLUT[0xbf80] = (u8 *)psxH;
 
 	for (i = 0; i < 0x08; i++) psxMemRLUT[i + 0x1fc0] = (u8 *)&psxR[i << 16];
 
@@ -135,12 +190,15 @@ int psxMemInit()
 	memcpy(psxMemRLUT + 0xbfc0, psxMemRLUT + 0x1fc0, 0x08 * sizeof(void *));
 
 // MemW
-	for (i = 0; i < 0x80; i++) psxMemWLUT[i + 0x0000] = (u8 *)&psxM[(i & 0x1f) << 16];
-	memcpy(psxMemWLUT + 0x8000, psxMemWLUT, 0x80 * sizeof(void *));
-	memcpy(psxMemWLUT + 0xa000, psxMemWLUT, 0x80 * sizeof(void *));
+	for (i = 0; i < 0x10000; i++) psxMemWLUT[i] = PSXMEM_HANDLER_ENTRY(&null_whandlers);
+	psxMemMapRamW(true);
 
-	psxMemWLUT[0x1f00] = (u8 *)psxP;
-	psxMemWLUT[0x1f80] = (u8 *)psxH;
+	psxMemWLUT[0x1f00] = (uptr)psxP;
+	psxMemWLUT[0x1f80] = psxMemWLUT[0x9f80] = psxMemWLUT[0xbf80] = PSXMEM_HANDLER_ENTRY(&hw_whandlers);
+	psxMemWLUT[0xfffe] = PSXMEM_HANDLER_ENTRY(&cachectrl_whandlers);
+
+// HW I/O register blocks of page 0x1f80
+	psxHwInitLUT();
 
 	return 0;
 }
@@ -212,6 +270,8 @@ void psxMemReset()
 
 void psxMemShutdown()
 {
+	psxMemUnmapVirtual();
+
 	if (psxM_allocated) { free(psxM);  psxM = NULL;  psxM_allocated = false; }
 	if (psxP_allocated) { free(psxP);  psxP = NULL;  psxP_allocated = false; }
 	if (psxH_allocated) { free(psxH);  psxH = NULL;  psxH_allocated = false; }
@@ -224,153 +284,113 @@ void psxMemShutdown()
 	memstats_print();
 }
 
+// True if PS1 address 'mem' is in a readable page, not the open bus
+//  page unmapped ones point at
+bool psxMemIsMapped(u32 mem)
+{
+	return psxMemRLUT[mem >> 16] != psxNULLread;
+}
+
 u8 psxMemRead8(u32 mem)
 {
 	memstats_add_read(mem, MEMSTAT_WIDTH_8);
-	u8 ret;
+	if (psxMemDirect && PSXMEM_IS_RAM(mem))
+		return *(u8*)(psxMemBase + (mem & 0x0fffffff));
+
 	u32 t = mem >> 16;
-	u32 m = mem & 0xffff;
-	if (t == 0x1f80 || t == 0x9f80 || t == 0xbf80) {
-		if (m < 0x400)
-			ret = psxHu8(mem);
-		else
-			ret = psxHwRead8(mem);
-	} else {
-		u8 *p = (u8*)(psxMemRLUT[t]);
-		if (p != NULL) {
-			return *(u8*)(p + m);
-		} else {
-			PSXMEM_LOG("%s(): err lb 0x%08x\n", __func__, mem);
-			ret = 0;
-		}
-	}
+	if (t == 0x1f80)
+		return psxHwRead8(mem);
 
-	return ret;
+	return *(u8*)(psxMemRLUT[t] + (mem & 0xffff));
 }
 
 u16 psxMemRead16(u32 mem)
 {
 	memstats_add_read(mem, MEMSTAT_WIDTH_16);
-	u16 ret;
+	if (psxMemDirect && PSXMEM_IS_RAM(mem))
+		return SWAPu16(*(u16*)(psxMemBase + (mem & 0x0fffffff)));
+
 	u32 t = mem >> 16;
-	u32 m = mem & 0xffff;
-	if (t == 0x1f80 || t == 0x9f80 || t == 0xbf80) {
-		if (m < 0x400)
-			ret = psxHu16(mem);
-		else
-			ret = psxHwRead16(mem);
-	} else {
-		u8 *p = (u8*)(psxMemRLUT[t]);
-		if (p != NULL) {
-			ret = SWAPu16(*(u16*)(p + m));
-		} else {
-			PSXMEM_LOG("%s(): err lh 0x%08x\n", __func__, mem);
-			ret = 0;
-		}
-	}
+	if (t == 0x1f80)
+		return psxHwRead16(mem);
 
-	return ret;
+	return SWAPu16(*(u16*)(psxMemRLUT[t] + (mem & 0xffff)));
 }
 
 u32 psxMemRead32(u32 mem)
 {
 	memstats_add_read(mem, MEMSTAT_WIDTH_32);
-	u32 ret;
+	if (psxMemDirect && PSXMEM_IS_RAM(mem))
+		return SWAPu32(*(u32*)(psxMemBase + (mem & 0x0fffffff)));
+
 	u32 t = mem >> 16;
-	u32 m = mem & 0xffff;
-	if (t == 0x1f80 || t == 0x9f80 || t == 0xbf80) {
-		if (m < 0x400)
-			ret = psxHu32(mem);
-		else
-			ret = psxHwRead32(mem);
-	} else {
-		u8 *p = (u8*)(psxMemRLUT[t]);
-		if (p != NULL) {
-			ret = SWAPu32(*(u32*)(p + m));
-		} else {
-			if (psxRegs.writeok) { PSXMEM_LOG("%s(): err lw 0x%08x\n", __func__, mem); }
-			ret = 0;
-		}
-	}
+	if (t == 0x1f80)
+		return psxHwRead32(mem);
 
-	return ret;
+	return SWAPu32(*(u32*)(psxMemRLUT[t] + (mem & 0xffff)));
 }
 
 void psxMemWrite8(u32 mem, u8 value)
 {
 	memstats_add_write(mem, MEMSTAT_WIDTH_8);
-	u32 t = mem >> 16;
-	u32 m = mem & 0xffff;
-	if (t == 0x1f80 || t == 0x9f80 || t == 0xbf80) {
-		if (m < 0x400)
-			psxHu8(mem) = value;
-		else
-			psxHwWrite8(mem, value);
+	u8 *p;
+	if (psxMemDirect && PSXMEM_IS_RAM(mem)) {
+		p = psxMemBase + (mem & 0x0fffffff);
 	} else {
-		u8 *p = (u8*)(psxMemWLUT[t]);
-		if (p != NULL) {
-			*(u8*)(p + m) = value;
-#ifdef PSXREC
-			psxCpu->Clear((mem & (~3)), 1);
-#endif
-		} else {
-			PSXMEM_LOG("%s(): err sb 0x%08x\n", __func__, mem);
+		uptr e = psxMemWLUT[mem >> 16];
+		if (PSXMEM_IS_HANDLER(e)) {
+			PSXMEM_HANDLER(psxMemWriteHandlers, e)->write8(mem, value);
+			return;
 		}
+		p = (u8*)e + (mem & 0xffff);
 	}
+
+	*(u8*)p = value;
+#ifdef PSXREC
+	psxCpu->Clear((mem & (~3)), 1);
+#endif
 }
 
 void psxMemWrite16(u32 mem, u16 value)
 {
 	memstats_add_write(mem, MEMSTAT_WIDTH_16);
-	u32 t = mem >> 16;
-	u32 m = mem & 0xffff;
-	if (t == 0x1f80 || t == 0x9f80 || t == 0xbf80) {
-		if (m < 0x400)
-			psxHu16ref(mem) = SWAPu16(value);
-		else
-			psxHwWrite16(mem, value);
+	u8 *p;
+	if (psxMemDirect && PSXMEM_IS_RAM(mem)) {
+		p = psxMemBase + (mem & 0x0fffffff);
 	} else {
-		u8 *p = (u8*)(psxMemWLUT[t]);
-		if (p != NULL) {
-			*(u16*)(p + m) = SWAPu16(value);
-#ifdef PSXREC
-			psxCpu->Clear((mem & (~3)), 1);
-#endif
-		} else {
-			PSXMEM_LOG("%s(): err sh 0x%08x\n", __func__, mem);
+		uptr e = psxMemWLUT[mem >> 16];
+		if (PSXMEM_IS_HANDLER(e)) {
+			PSXMEM_HANDLER(psxMemWriteHandlers, e)->write16(mem, value);
+			return;
 		}
+		p = (u8*)e + (mem & 0xffff);
 	}
+
+	*(u16*)p = SWAPu16(value);
+#ifdef PSXREC
+	psxCpu->Clear((mem & (~3)), 1);
+#endif
 }
 
 void psxMemWrite32(u32 mem, u32 value)
 {
 	memstats_add_write(mem, MEMSTAT_WIDTH_32);
-	u32 t = mem >> 16;
-	u32 m = mem & 0xffff;
-	if (t == 0x1f80 || t == 0x9f80 || t == 0xbf80) {
-		if (m < 0x400)
-			psxHu32ref(mem) = SWAPu32(value);
-		else
-			psxHwWrite32(mem, value);
+	u8 *p;
+	if (psxMemDirect && PSXMEM_IS_RAM(mem)) {
+		p = psxMemBase + (mem & 0x0fffffff);
 	} else {
-		u8 *p = (u8*)(psxMemWLUT[t]);
-		if (p != NULL) {
-			*(u32*)(p + m) = SWAPu32(value);
-#ifdef PSXREC
-			psxCpu->Clear(mem, 1);
-#endif
-		} else {
-			if (mem != 0xfffe0130) {
-#ifdef PSXREC
-				if (!psxRegs.writeok) psxCpu->Clear(mem, 1);
-#endif
-				if (psxRegs.writeok) { PSXMEM_LOG("%s(): err sw 0x%08x\n", __func__, mem); }
-			} else {
-				// Write to cache control port 0xfffe0130
-				psxMemWrite32_CacheCtrlPort(value);
-			}
+		uptr e = psxMemWLUT[mem >> 16];
+		if (PSXMEM_IS_HANDLER(e)) {
+			PSXMEM_HANDLER(psxMemWriteHandlers, e)->write32(mem, value);
+			return;
 		}
+		p = (u8*)e + (mem & 0xffff);
 	}
+
+	*(u32*)p = SWAPu32(value);
+#ifdef PSXREC
+	psxCpu->Clear(mem, 1);
+#endif
 }
 
 // Write to cache control port 0xfffe0130
@@ -411,9 +431,7 @@ void psxMemWrite32_CacheCtrlPort(u32 value)
 			psxRegs.writeok = 0;
 			PSXMEM_LOG("%s(): Icache is isolated.\n", __func__);
 
-			memset(psxMemWLUT + 0x0000, 0, 0x80 * sizeof(void *));
-			memset(psxMemWLUT + 0x8000, 0, 0x80 * sizeof(void *));
-			memset(psxMemWLUT + 0xa000, 0, 0x80 * sizeof(void *));
+			psxMemMapRamW(false);
 
 #ifdef PSXREC
 			/* Cache is now isolated, pending cache-flush sequence:
@@ -432,10 +450,7 @@ void psxMemWrite32_CacheCtrlPort(u32 value)
 			psxRegs.writeok = 1;
 			PSXMEM_LOG("%s(): Icache is unisolated.\n", __func__);
 
-			for (int i = 0; i < 0x80; i++)
-				psxMemWLUT[i + 0x0000] = (u8*)&psxM[(i & 0x1f) << 16];
-			memcpy(psxMemWLUT + 0x8000, psxMemWLUT, 0x80 * sizeof(void *));
-			memcpy(psxMemWLUT + 0xa000, psxMemWLUT, 0x80 * sizeof(void *));
+			psxMemMapRamW(true);
 
 #ifdef PSXREC
 			/* Cache is now unisolated:
@@ -58,8 +58,82 @@ extern bool psxP_allocated;
 extern bool psxR_allocated;
 extern bool psxH_allocated;
 
-extern u8 **psxMemWLUT;
+/* Page tables, one entry per 64KB page of PS1 address space (mem >> 16).
+ *
+ * psxMemRLUT[] holds host address of every readable page, for reads and for
+ *  PSXM(). Unmapped pages read as zero. Page 0x1f80 (scratchpad, HW I/O) is
+ *  dispatched further by psxHwRead*().
+ *
+ * psxMemWLUT[] entries are either host address of a writable page, or the
+ *  address of a psxMemWriteHandlers struct with PSXMEM_HANDLER_TAG set, for
+ *  pages needing special handling: HW I/O, cache control port, ROM, unmapped
+ *  space, RAM during cache isolation. Handler entries could also be used to
+ *  watch RAM pages for writes.
+ *
+ * psxhw.cpp applies the same scheme down to 16-byte register blocks of page
+ *  0x1f80: blocks without side effects are host addresses inside psxH[].
+ */
 extern u8 **psxMemRLUT;
+extern uptr *psxMemWLUT;
+
+#define PSXMEM_HANDLER_TAG       ((uptr)1)
+#define PSXMEM_IS_HANDLER(e)     ((e) & PSXMEM_HANDLER_TAG)
+#define PSXMEM_HANDLER(type, e)  ((const type *)((e) & ~PSXMEM_HANDLER_TAG))
+#define PSXMEM_HANDLER_ENTRY(h)  ((uptr)(h) | PSXMEM_HANDLER_TAG)
+
+typedef struct {
+	u8   (*read8) (u32 mem);
+	u16  (*read16)(u32 mem);
+	u32  (*read32)(u32 mem);
+} psxMemReadHandlers;
+
+typedef struct {
+	void (*write8) (u32 mem, u8  value);
+	void (*write16)(u32 mem, u16 value);
+	void (*write32)(u32 mem, u32 value);
+} psxMemWriteHandlers;
+
+/* Virtual mapping of PS1 address space (psxmem_mapping.cpp)
+ *
+ * When SHMEM_MIRRORING or TMPFS_MIRRORING is defined, psxM,psxP,psxH,psxR
+ *  are mapped into one host region starting at psxMemBase, at offsets given
+ *  by lower 28 bits of their PS1 address, with 2MB RAM mirrored 4X up to
+ *  0x7f_ffff. Host address of any RAM, scratchpad or BIOS address in
+ *  KUSEG/KSEG0/KSEG1 is then psxMemBase + (mem & 0x0fffffff).
+ *
+ * Dynarecs ask for a mapping at fixed address PSX_MEM_VADDR before
+ *  psxMemInit() is called, so they can generate host addresses with a LUI.
+ *  Otherwise psxMemInit() maps PS1 mem wherever the host has room for it.
+ *
+ * psxMemDirect is true while psxMemRead*()/psxMemWrite*() may access RAM
+ *  through psxMemBase, skipping page tables: PS1 mem is mapped and cache
+ *  is not isolated.
+ */
+/* Fixed address for dynarecs. Lower 28 bits of it should be zero! Offsets
+ *  between 0 and PSX_MEM_VSIZE from this address should be free for mapping.
+ */
+#ifdef MMAP_TO_ADDRESS_ZERO
+	// Allows address-conversion optimization in dynarecs.
+	#define PSX_MEM_VADDR 0ULL
+#else
+	// For development: null pointer dereferences will segfault as normal.
+	// Address conversions will need more instructions.
+	#define PSX_MEM_VADDR 0x10000000ULL
+#endif
+
+// Mapped region spans offsets 0x0000_0000..0x0fc7_ffff from psxMemBase
+#define PSX_MEM_VSIZE 0x0fc80000
+
+extern u8 *psxMemBase;
+extern bool psxMemMapped;
+extern bool psxMemDirect;
+
+int  psxMemMapVirtual(bool fixed);
+void psxMemUnmapVirtual(void);
+
+// RAM or a mirror of it in KUSEG, KSEG0 or KSEG1?
+#define PSXMEM_IS_RAM(mem) \
+	((((mem) & 0x1f800000) == 0) && ((0x31 >> ((mem) >> 29)) & 1))
 
 #define psxMs8(mem)		psxM[(mem) & 0x1fffff]
 #define psxMs16(mem)	(SWAP16(*(s16*)&psxM[(mem) & 0x1fffff]))
@@ -130,6 +204,7 @@ extern u8 **psxMemRLUT;
 int  psxMemInit(void);
 void psxMemReset(void);
 void psxMemShutdown(void);
+bool psxMemIsMapped(u32 mem);
 
 u8   psxMemRead8(u32 mem);
 u16  psxMemRead16(u32 mem);
@@ -0,0 +1,258 @@
+/*
+ * Virtual mapping of PS1 memory for pcsx4all
+ *
+ * Copyright (c) 2009 Ulrich Hecht
+ * Copyright (c) 2018 modified by Dmitry Smagin, Daniel Silsby
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* Maps PS1 RAM (mirrored), expansion ROM, scratchpad/HW I/O and BIOS into
+ *  one host virtual address region. Used by dynarecs for direct loads/stores,
+ *  and by psxMemRead*()/psxMemWrite*(). See notes in psxmem.h.
+ */
+
+#include <stdio.h>
+#include "psxmem.h"
+
+u8 *psxMemBase;
+bool psxMemMapped;
+bool psxMemDirect;
+
+#if defined(SHMEM_MIRRORING) || defined(TMPFS_MIRRORING)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#ifdef SHMEM_MIRRORING
+#include <sys/shm.h>   // For Posix shared mem
+#endif
+
+// Was region reserved by us, at an address of the host's choosing?
+static bool psx_mem_reserved;
+
+// Regions mapped so far, as offsets from psxMemBase
+static struct { u32 offset, size; } psx_mem_regions[6];
+static int psx_mem_num_regions;
+
+static bool map_region(u32 offset, u32 size, int flags, int fd)
+{
+	void* addr = (void*)(psxMemBase + offset);
+	void* mmap_retval = mmap(addr, size, PROT_READ|PROT_WRITE, flags|MAP_FIXED, fd, 0);
+	if (mmap_retval == MAP_FAILED) {
+		printf("Error: mmap() to %p of %uKB failed.\n", addr, size/1024);
+		return false;
+	}
+	psx_mem_regions[psx_mem_num_regions].offset = offset;
+	psx_mem_regions[psx_mem_num_regions].size = size;
+	psx_mem_num_regions++;
+	return true;
+}
+
+static void unmap_regions()
+{
+	if (psx_mem_reserved) {
+		// Unmaps everything mapped into the reserved region, too
+		munmap((void*)psxMemBase, PSX_MEM_VSIZE);
+	} else {
+		for (int i = 0; i < psx_mem_num_regions; i++)
+			munmap((void*)(psxMemBase + psx_mem_regions[i].offset), psx_mem_regions[i].size);
+	}
+	psx_mem_reserved = false;
+	psx_mem_num_regions = 0;
+}
+
+/* Map PSX RAM regions 0x0000_0000..0x007f_ffff, Expansion-ROM/HW-I/O
+ *  regions 0x1f00_0000..0x1f80_ffff and BIOS region 0x1fc0_0000..0x1fc7_ffff
+ *  to a virtual address region starting at psxMemBase, at offsets given by
+ *  lower 28 bits of their PSX address.
+ * Once mapped, we assign emu global ptr vars 'psxM' (RAM), 'psxP'
+ *  (Parallel port ROM expansion), 'psxH' (1KB scratchpad + HW I/O) and
+ *  'psxR' (BIOS).
+ *
+ *  If 'fixed' is true, psxMemBase is PSX_MEM_VADDR, typically 0x1000_0000,
+ *  as required by dynarecs. Otherwise, a region of PSX_MEM_VSIZE bytes is
+ *  reserved wherever the host has room for it, which works for 64-bit hosts
+ *  and for the interpreter.
+ *
+ *  This allows:
+ *   1.) 2MB RAM region is mirrored 4X just like on the real hardware.
+ *       Games like Einhander need the mirroring, where the effective addr
+ *       of a base reg + negative offset can cross into the prior region.
+ *   2.) 1KB scratchpad region access can be rolled into RAM accesses.
+ *   3.) Host addr of a KUSEG/KSEG0/KSEG1 address is psxMemBase plus lower
+ *       28 bits of the address. With a fixed mapping, these bits can just
+ *       be inserted after a single LUI().
+ *
+ *  NOTE: Dynarecs don't bother to access the BIOS region directly: analysis
+ *   shows that BIOS accesses account for only a tiny portion of total
+ *   accesses during gameplay. The rarely-accessed Expansion-ROM region (psxP)
+ *   is mapped because it lies between the RAM and scratchpad regions.
+ */
+int psxMemMapVirtual(bool fixed)
+{
+	bool  success = true;
+	int   memfd = -1;
+	void* mmap_retval = NULL;
+	const char* mem_fname = NULL;
+
+	if (psxMemMapped)
+		return (!fixed || psxMemBase == (u8*)PSX_MEM_VADDR) ? 0 : -1;
+
+	// Too late, psxMemInit() has already allocated PSX mem
+	if (psxM_allocated || psxP_allocated || psxH_allocated || psxR_allocated)
+		return -1;
+
+	// Everything done here with mmap() is with a granularity of 64KB, so
+	//  make sure the platform has a page size that will allow this
+	long page_size = sysconf(_SC_PAGESIZE);
+	if (page_size > 65536) {
+		printf("ERROR: %s expects system page size <= 65536 bytes\n"
+		       "       System reported page size: %ld bytes\n", __func__, page_size);
+		return -1;
+	}
+
+	if (fixed) {
+		psxMemBase = (u8*)PSX_MEM_VADDR;
+	} else {
+		// Reserve address space, regions are mapped into it below. Parts
+		//  not mapped stay inaccessible.
+		mmap_retval = mmap(NULL, PSX_MEM_VSIZE, PROT_NONE,
+				MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+		if (mmap_retval == MAP_FAILED) {
+			printf("Error: reserving %uMB of address space for PSX mem failed.\n",
+					PSX_MEM_VSIZE/(1024*1024));
+			perror(__func__);
+			return -1;
+		}
+		psxMemBase = (u8*)mmap_retval;
+		psx_mem_reserved = true;
+	}
+
+#ifdef SHMEM_MIRRORING
+	// Get a POSIX shared memory object fd
+	printf("Mapping/mirroring 2MB PSX RAM using POSIX shared mem\n");
+	mem_fname = "/pcsx4all_psxmem";
+	memfd = shm_open(mem_fname, O_RDWR|O_CREAT|O_TRUNC, S_IRUSR|S_IWUSR);
+#else
+	// Use tmpfs file - TMPFS_DIR string literal should be defined in Makefile
+	//  CFLAGS with escaped quotes (alter if needed): -DTMPFS_DIR=\"/tmp\"
+	mem_fname = TMPFS_DIR "/pcsx4all_psxmem";
+	printf("Mapping/mirroring 2MB PSX RAM using tmpfs file %s\n", mem_fname);
+	memfd = open(mem_fname, O_RDWR|O_CREAT|O_TRUNC, S_IRUSR|S_IWUSR);
+#endif
+
+	if (memfd < 0) {
+#ifdef SHMEM_MIRRORING
+		printf("Error acquiring POSIX shared memory file descriptor\n");
+#else
+		printf("Error creating tmpfs file: %s\n", mem_fname);
+#endif
+		success = false;
+		goto exit;
+	}
+
+	// We want 2MB of PSX RAM
+	if (ftruncate(memfd, 0x200000) < 0) {
+		printf("Error in call to ftruncate(), could not get 2MB of PSX RAM\n");
+		success = false;
+		goto exit;
+	}
+
+	// Map PSX RAM, then create three mirrors of it, all the way up to 0x7fffff
+	for (int i = 0; i < 4 && success; i++)
+		success = map_region(i * 0x200000, 0x200000, MAP_SHARED, memfd);
+	if (!success)
+		goto exit;
+	printf(" ..mapped to %p\n", (void*)psxMemBase);
+
+	printf("Mapping 8MB Expansion ROM + 64KB PSX HW I/O + 512KB BIOS regions using mmap\n");
+	// Map regions to start at offset past psxMemBase that matches PSX mapping,
+	//  i.e. if psxM starts at 0x1000_0000, expansion region will be at
+	//  0x1f00_0000, HW I/O region at 0x1f80_0000 and BIOS at 0x1fc0_0000
+	// NOTE: For 8MB Expansion region, we expect programs/BIOS to not write
+	//       to this region, thereby never actually allocating any pages
+	//       of real host RAM (or very few). It should be safe to assume this.
+	success = map_region(0x0f000000, 0x0f810000-0x0f000000, MAP_SHARED|MAP_ANONYMOUS, -1) &&
+	          map_region(0x0fc00000, 0x80000, MAP_PRIVATE|MAP_ANONYMOUS, -1);
+	if (!success)
+		goto exit;
+	printf(" ..mapped to %p\n", (void*)(psxMemBase+0x0f000000));
+
+	psxM = (s8*)psxMemBase;               // RAM
+	psxP = (s8*)(psxMemBase+0x0f000000);  // ROM expansion region (parallel port)
+	psxH = (s8*)(psxMemBase+0x0f800000);  // HW I/O region
+	psxR = (s8*)(psxMemBase+0x0fc00000);  // BIOS
+	psxM_allocated = psxP_allocated = psxH_allocated = psxR_allocated = true;
+	psxMemMapped = true;
+
+exit:
+	if (!success) {
+		// Oops, couldn't do everything we wanted to do
+		perror(__func__);
+		printf("ERROR: Failed to map/mirror PSX memory, falling back to malloc().\n"
+		       "Memory accesses will be slower.\n");
+
+		// Abandon any mappings that were created
+		unmap_regions();
+		psxMemBase = NULL;
+	}
+
+	// Close/unlink file: RAM is released when munmap()'ed or pid terminates
+	if (memfd >= 0)
+		close(memfd);
+#ifdef SHMEM_MIRRORING
+	if (mem_fname)
+		shm_unlink(mem_fname);
+#else
+	if (mem_fname)
+		unlink(mem_fname);
+#endif
+
+	return success ? 0 : -1;
+}
+
+void psxMemUnmapVirtual()
+{
+	if (!psxMemMapped)
+		return;
+
+	unmap_regions();
+	psxMemBase = NULL;
+	psxMemMapped = psxMemDirect = false;
+	psxM = psxP = psxH = psxR = NULL;
+	psxM_allocated = psxP_allocated = psxH_allocated = psxR_allocated = false;
+}
+
+#else
+
+/* Stub funcs to call when mmap/mirroring is not supported on a platform.
+ *  psxMemInit() will be left to allocate psxM,psxP,psxH,psxR on its own.
+ */
+int psxMemMapVirtual(bool fixed)
+{
+	return -1;
+}
+
+void psxMemUnmapVirtual()
+{
+}
+
+#endif // defined(SHMEM_MIRRORING) || defined(TMPFS_MIRRORING)
@@ -0,0 +1,377 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02111-1307 USA.           *
+ ***************************************************************************/
+
+/*
+ * Emulated-CPU hot-spot sampling profiler
+ *
+ * Samples psxRegs.pc and $ra at regular intervals of emulated time, using
+ * PSXINT_PROFILE event. Events are dispatched from psxBranchTest(), which
+ * both interpreter and recompilers call, so this works the same with all
+ * CPU cores. With recompilers, psxRegs.pc is that of the next block to run.
+ *
+ * $ra gives a (one level) caller for leaf functions. Non-leaf functions
+ * reuse $ra for their own calls, so their callers are less reliable.
+ *
+ * At shutdown, samples are grouped by function (or by address range, if
+ * no symbol map was given), and a report of the hottest ones is printed.
+ * Folded stacks ('caller;function count') can be written for flame graphs.
+ */
+
+#include "psxprofiler.h"
+#include "psxevents.h"
+#include <stdlib.h>
+#include <ctype.h>
+
+// Average emulated cycles between samples (~4000 samples per second).
+//  Jitter is added to each interval so periodic guest loops don't alias.
+#define PROF_INTERVAL     (PSXCLK / 4000)
+#define PROF_JITTER       (PROF_INTERVAL / 4)
+
+// Without symbols, samples are grouped in ranges of this many bytes
+#define PROF_RANGE_SHIFT  8
+
+// Samples further than this from nearest preceding symbol are not
+//  attributed to it (symbol maps are often incomplete)
+#define PROF_MAX_SYM_DIST 0x10000
+
+// Number of entries listed in report
+#define PROF_REPORT_LINES 40
+
+struct ProfSample {
+	u32 pc, ra;        // Normalized addresses
+	u32 count;         // 0 if entry unused
+};
+
+struct ProfSymbol {
+	u32  addr;
+	char *name;
+};
+
+// Aggregated samples of a function, or a caller/function pair
+struct ProfFunc {
+	u32 addr, caller;
+	u32 count;
+};
+
+static struct {
+	bool enabled;
+	char *folded_file;
+
+	ProfSample *table; // Open-addressing hash table
+	u32 size;          // Power of 2
+	u32 used;
+	u32 total;
+	u32 rng;
+
+	ProfSymbol *syms;  // Sorted by address
+	u32 num_syms;
+} prof;
+
+// Map mirrors of RAM to their KSEG0 address, as used by symbol maps
+static inline u32 prof_normalize(u32 addr)
+{
+	if ((addr & 0x1fe00000) == 0)
+		return 0x80000000 | (addr & 0x1fffff);
+	return addr;
+}
+
+static inline u32 prof_hash(u32 pc, u32 ra)
+{
+	return ((pc >> 2) * 2654435761u) ^ ((ra >> 2) * 0x9e3779b1u);
+}
+
+static bool prof_table_grow(void)
+{
+	u32 new_size = prof.size ? prof.size * 2 : 4096;
+	ProfSample *new_table = (ProfSample *)calloc(new_size, sizeof(ProfSample));
+	if (!new_table) {
+		printf("Error allocating profiler sample table\n");
+		return false;
+	}
+
+	for (u32 i = 0; i < prof.size; i++) {
+		ProfSample *s = &prof.table[i];
+		if (!s->count)
+			continue;
+		u32 j = prof_hash(s->pc, s->ra) & (new_size - 1);
+		while (new_table[j].count)
+			j = (j + 1) & (new_size - 1);
+		new_table[j] = *s;
+	}
+
+	free(prof.table);
+	prof.table = new_table;
+	prof.size = new_size;
+	return true;
+}
+
+static void prof_record(u32 pc, u32 ra)
+{
+	if (prof.used * 2 >= prof.size && !prof_table_grow())
+		return;
+
+	u32 i = prof_hash(pc, ra) & (prof.size - 1);
+	while (prof.table[i].count) {
+		if (prof.table[i].pc == pc && prof.table[i].ra == ra) {
+			prof.table[i].count++;
+			prof.total++;
+			return;
+		}
+		i = (i + 1) & (prof.size - 1);
+	}
+
+	prof.table[i].pc = pc;
+	prof.table[i].ra = ra;
+	prof.table[i].count = 1;
+	prof.used++;
+	prof.total++;
+}
+
+static int prof_sym_cmp(const void *a, const void *b)
+{
+	u32 aa = ((const ProfSymbol *)a)->addr, ba = ((const ProfSymbol *)b)->addr;
+	return (aa > ba) - (aa < ba);
+}
+
+// Load symbol map. Accepts lines like '80012345 name', '0x80012345 name'
+//  or 'nm' output '80012345 T name'. Other lines are ignored.
+static void prof_load_symbols(const char *filename)
+{
+	FILE *f = fopen(filename, "r");
+	if (!f) {
+		printf("Error opening profiler symbol map %s\n", filename);
+		return;
+	}
+
+	u32 cap = 0;
+	char line[512];
+	while (fgets(line, sizeof(line), f)) {
+		char *p = line, *end;
+		while (isspace((unsigned char)*p)) p++;
+		u32 addr = strtoul(p, &end, 16);
+		if (end == p || !isspace((unsigned char)*end))
+			continue;
+		p = end;
+		while (isspace((unsigned char)*p)) p++;
+		// Skip 'nm' symbol type
+		if (p[0] && isspace((unsigned char)p[1])) {
+			p++;
+			while (isspace((unsigned char)*p)) p++;
+		}
+		end = p;
+		while (*end && !isspace((unsigned char)*end)) end++;
+		if (end == p)
+			continue;
+		*end = '\0';
+
+		if (prof.num_syms == cap) {
+			u32 new_cap = cap ? cap * 2 : 1024;
+			ProfSymbol *s = (ProfSymbol *)realloc(prof.syms, new_cap * sizeof(ProfSymbol));
+			if (!s) break;
+			prof.syms = s;
+			cap = new_cap;
+		}
+		prof.syms[prof.num_syms].addr = prof_normalize(addr);
+		prof.syms[prof.num_syms].name = strdup(p);
+		prof.num_syms++;
+	}
+	fclose(f);
+
+	qsort(prof.syms, prof.num_syms, sizeof(ProfSymbol), prof_sym_cmp);
+	printf("Profiler: loaded %u symbols from %s\n", prof.num_syms, filename);
+}
+
+// Returns symbol containing 'addr', or NULL
+static const ProfSymbol* prof_find_symbol(u32 addr)
+{
+	u32 lo = 0, hi = prof.num_syms;
+	while (lo < hi) {
+		u32 mid = (lo + hi) / 2;
+		if (prof.syms[mid].addr <= addr)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo == 0 || addr - prof.syms[lo-1].addr >= PROF_MAX_SYM_DIST)
+		return NULL;
+	return &prof.syms[lo-1];
+}
+
+// Start address of function or address range containing 'addr'
+static u32 prof_func_addr(u32 addr)
+{
+	const ProfSymbol *sym = prof_find_symbol(addr);
+	if (sym)
+		return sym->addr;
+	return addr & ~((1 << PROF_RANGE_SHIFT) - 1);
+}
+
+static const char* prof_func_name(u32 addr, char *buf)
+{
+	const ProfSymbol *sym = prof_find_symbol(addr);
+	if (sym && sym->addr == addr)
+		return sym->name;
+	sprintf(buf, "%08x-%08x", addr, addr + (1 << PROF_RANGE_SHIFT) - 1);
+	return buf;
+}
+
+static int prof_func_cmp_addr(const void *a, const void *b)
+{
+	const ProfFunc *fa = (const ProfFunc *)a, *fb = (const ProfFunc *)b;
+	if (fa->addr != fb->addr)
+		return (fa->addr > fb->addr) - (fa->addr < fb->addr);
+	return (fa->caller > fb->caller) - (fa->caller < fb->caller);
+}
+
+static int prof_func_cmp_count(const void *a, const void *b)
+{
+	const ProfFunc *fa = (const ProfFunc *)a, *fb = (const ProfFunc *)b;
+	return (fa->count < fb->count) - (fa->count > fb->count);
+}
+
+// Merge entries of sorted array 'f' with same addr (and caller, if
+//  'by_caller'), returns new number of entries
+static u32 prof_merge(ProfFunc *f, u32 n, bool by_caller)
+{
+	u32 out = 0;
+	for (u32 i = 0; i < n; i++) {
+		if (out && f[out-1].addr == f[i].addr &&
+		    (!by_caller || f[out-1].caller == f[i].caller)) {
+			f[out-1].count += f[i].count;
+		} else {
+			f[out++] = f[i];
+		}
+	}
+	return out;
+}
+
+static void prof_report(void)
+{
+	ProfFunc *pairs = (ProfFunc *)malloc(prof.used * sizeof(ProfFunc));
+	ProfFunc *funcs = (ProfFunc *)malloc(prof.used * sizeof(ProfFunc));
+	if (!pairs || !funcs) {
+		printf("Error allocating profiler report\n");
+		free(pairs);
+		free(funcs);
+		return;
+	}
+
+	// Resolve samples to caller/function pairs. $ra points past the
+	//  call's delay slot.
+	u32 n = 0;
+	for (u32 i = 0; i < prof.size; i++) {
+		ProfSample *s = &prof.table[i];
+		if (!s->count)
+			continue;
+		pairs[n].addr = prof_func_addr(s->pc);
+		pairs[n].caller = s->ra ? prof_func_addr(s->ra - 8) : 0;
+		pairs[n].count = s->count;
+		n++;
+	}
+	qsort(pairs, n, sizeof(ProfFunc), prof_func_cmp_addr);
+	n = prof_merge(pairs, n, true);
+
+	memcpy(funcs, pairs, n * sizeof(ProfFunc));
+	u32 num_funcs = prof_merge(funcs, n, false);
+	qsort(funcs, num_funcs, sizeof(ProfFunc), prof_func_cmp_count);
+
+	char buf[2][32];
+	printf("\nProfiler: %u samples, %u functions/ranges\n", prof.total, num_funcs);
+	printf("   samples      %%  function (top caller)\n");
+	for (u32 i = 0; i < num_funcs && i < PROF_REPORT_LINES; i++) {
+		// Find top caller: pairs[] is sorted by function address
+		const ProfFunc *top = NULL;
+		for (u32 j = 0; j < n; j++) {
+			if (pairs[j].addr == funcs[i].addr && (!top || pairs[j].count > top->count))
+				top = &pairs[j];
+		}
+		printf("%10u %6.2f  %s", funcs[i].count, funcs[i].count * 100.0 / prof.total,
+		       prof_func_name(funcs[i].addr, buf[0]));
+		if (top && top->caller)
+			printf(" (%s %.0f%%)", prof_func_name(top->caller, buf[1]),
+			       top->count * 100.0 / funcs[i].count);
+		printf("\n");
+	}
+
+	if (prof.folded_file) {
+		FILE *f = fopen(prof.folded_file, "w");
+		if (f) {
+			for (u32 i = 0; i < n; i++) {
+				if (pairs[i].caller)
+					fprintf(f, "%s;", prof_func_name(pairs[i].caller, buf[1]));
+				fprintf(f, "%s %u\n", prof_func_name(pairs[i].addr, buf[0]), pairs[i].count);
+			}
+			fclose(f);
+			printf("Profiler: wrote folded stacks to %s\n", prof.folded_file);
+		} else {
+			printf("Error writing profiler folded stacks to %s\n", prof.folded_file);
+		}
+	}
+
+	free(pairs);
+	free(funcs);
+}
+
+void psxProfilerEnable(const char *folded_file, const char *symbols_file)
+{
+	prof.enabled = true;
+	prof.rng = 1;
+	if (folded_file)
+		prof.folded_file = strdup(folded_file);
+	if (symbols_file)
+		prof_load_symbols(symbols_file);
+}
+
+bool psxProfilerEnabled(void)
+{
+	return prof.enabled;
+}
+
+static void prof_schedule_next(void)
+{
+	prof.rng = prof.rng * 1103515245 + 12345;
+	u32 jitter = (prof.rng >> 16) % (2 * PROF_JITTER);
+	psxEvqueueAdd(PSXINT_PROFILE, PROF_INTERVAL - PROF_JITTER + jitter);
+}
+
+void psxProfilerSchedule(void)
+{
+	if (prof.enabled)
+		prof_schedule_next();
+}
+
+// PSXINT_PROFILE event
+void psxProfilerSample(void)
+{
+	if (!prof.enabled)
+		return;
+	prof_record(prof_normalize(psxRegs.pc), prof_normalize(psxRegs.GPR.n.ra));
+	prof_schedule_next();
+}
+
+void psxProfilerShutdown(void)
+{
+	if (prof.enabled && prof.total)
+		prof_report();
+
+	for (u32 i = 0; i < prof.num_syms; i++)
+		free(prof.syms[i].name);
+	free(prof.syms);
+	free(prof.table);
+	free(prof.folded_file);
+	memset(&prof, 0, sizeof(prof));
+}
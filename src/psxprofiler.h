@@ -0,0 +1,42 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02111-1307 USA.           *
+ ***************************************************************************/
+
+/*
+ * Emulated-CPU hot-spot sampling profiler
+ */
+
+#ifndef PSXPROFILER_H
+#define PSXPROFILER_H
+
+#include "psxcommon.h"
+#include "r3000a.h"
+
+// Enable profiler. Must be called before psxReset(). 'folded_file' receives
+//  'caller;function count' lines for flame graph tools, and can be NULL.
+//  'symbols_file' is an optional symbol map ('address name' lines, or
+//  output of 'nm'), without it samples are grouped by address range.
+void psxProfilerEnable(const char *folded_file, const char *symbols_file);
+bool psxProfilerEnabled(void);
+
+// Schedule first sample, called when event queue is (re)built
+void psxProfilerSchedule(void);
+void psxProfilerSample(void);   // PSXINT_PROFILE event
+
+// Print report, write folded stacks and free everything
+void psxProfilerShutdown(void);
+
+#endif //PSXPROFILER_H
@@ -31,6 +31,9 @@
 #include "mdec.h"
 #include "gte.h"
 #include "psxevents.h"
+#include "psxhle.h"
+#include "sio.h"
+#include "psxprofiler.h"
 
 PcsxConfig Config;
 R3000Acpu *psxCpu=NULL;
@@ -57,8 +60,7 @@ int psxInit() {
 	return psxMemInit();
 }
 
-void psxReset() {
-
+static void psxResetState() {
 	psxCpu->Reset();
 
 	psxMemReset();
@@ -80,18 +82,40 @@ void psxReset() {
 	psxEvqueueInit();  // Event scheduler queue
 	psxHwReset();
 	psxBiosInit();
+	psxHLELibcReset();
+}
 
-	if (!Config.HLE)
-		psxExecuteBios();
+void psxReset() {
+	psxResetState();
+
+	if (!Config.HLE) {
+		// Unless the boot sequence is wanted, restore machine state at the
+		//  BIOS hand-off to the shell from an earlier boot (see misc.cpp)
+		int res = Config.SlowBoot ? 1 : BootSnapshotLoad();
+		if (res < 0) {
+			// Snapshot was bad and left partial state behind: reset again
+			//  and boot the BIOS, whether or not the snapshot was deleted
+			psxResetState();
+		}
+
+		if (res != 0) {
+			psxExecuteBios();
+			if (!Config.SlowBoot)
+				BootSnapshotSave();
+		}
+	}
 }
 
 void psxShutdown() {
-	// Shutdown CPU *before* calling psxMemShutdown(), to allow it to unmap
-	//  psxM,psxH etc, if it has done so.
+	// Shutdown CPU *before* calling psxMemShutdown(), which unmaps or frees
+	//  psxM,psxH etc that the CPU might still be using.
 	psxCpu->Shutdown();
 
 	psxMemShutdown();
 	psxBiosShutdown();
+	psxHLELibcShutdown();
+	sioShutdown();
+	psxProfilerShutdown();
 
 }
 
@@ -160,6 +184,35 @@ void psxBranchTest()
 	}
 }
 
+u32  psxExitRequested;
+bool psxExitAtVBlank;
+
+void psxRequestExit(void)
+{
+	psxExitRequested = 1;
+	// Ensure psxBranchTest() is called soon, CPU checks request after it
+	ResetIoCycle();
+}
+
+// Run until next VBlank, i.e. just after EmuUpdate() is called
+void psxRunFrame(void)
+{
+	psxExitAtVBlank = true;
+	psxCpu->Execute();
+	psxExitAtVBlank = false;
+	psxExitRequested = 0;
+}
+
+// Run for at least 'cycles' (a little more, as requests are only checked
+//  between blocks of code), or until psxRequestExit() is called
+void psxRunCycles(u32 cycles)
+{
+	psxEvqueueAdd(PSXINT_CPU_EXIT, cycles);
+	psxCpu->Execute();
+	psxEvqueueRemove(PSXINT_CPU_EXIT);
+	psxExitRequested = 0;
+}
+
 void psxExecuteBios() {
 	while (psxRegs.pc != 0x80030000)
 		psxCpu->ExecuteBlock(0x80030000);
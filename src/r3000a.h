@@ -262,4 +262,15 @@ int  psxTestLoadDelay(int reg, u32 tmp);
 void psxDelayTest(int reg, u32 bpc);
 void psxTestSWInts(void);
 
+/* Run loop API: psxCpu->Execute() returns once psxRequestExit() is called,
+ *  the next time the CPU checks for events, and can be called again to
+ *  resume. psxRunFrame()/psxRunCycles() use this to give control back to
+ *  the caller (headless benchmarks, run-ahead, rewind, etc).
+ */
+extern u32  psxExitRequested;   // Checked by CPU dispatch loops
+extern bool psxExitAtVBlank;    // psxRequestExit() at next VBlank
+void psxRequestExit(void);
+void psxRunFrame(void);
+void psxRunCycles(u32 cycles);
+
 #endif /* __R3000A_H__ */
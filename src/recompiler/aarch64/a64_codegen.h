@@ -0,0 +1,409 @@
+/*
+ * a64_codegen.h
+ *
+ * Copyright (c) 2009 Ulrich Hecht
+ * Copyright (c) 2018 modified by Dmitry Smagin / Daniel Silsby
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#ifndef A64_CODEGEN_H
+#define A64_CODEGEN_H
+
+/* Host registers
+ *
+ *    USAGE RESTRICTIONS IN CODE EMITTERS:
+ *
+ * A64REG_X0..X7   Arguments/return values of C function calls.
+ *                  -> A call to C code via CALL() clobbers X0..X18.
+ *
+ * A64REG_X9..X12  Temporaries, see TEMP_0..TEMP_3 below.
+ *                  -> A call to C code via CALL() clobbers them.
+ *
+ * A64REG_X16,X17  Used by CALL() to reach far-away C functions.
+ *
+ * A64REG_X19      Holds pointer to psxRegs struct, a.k.a. PERM_REG_1.
+ *
+ * A64REG_X20      Holds host address of PS1 RAM (psxM), a.k.a. PERM_REG_2.
+ *                  When PS1 mem is virtually mapped, this is PSX_MEM_VADDR.
+ *
+ * A64REG_X21      Holds branch decision / indirect jump target across the
+ *                  emitted delay slot, a.k.a. BRANCH_REG. See rec_bcu.cpp.h.
+ *
+ * A64REG_X22..X28 Reserved for reg allocator. These are callee-saved in the
+ *                  AAPCS64 ABI, so cached PS1 regs survive calls to C code.
+ *
+ * A64REG_X29,X30  Frame ptr and link reg, saved by block prologue.
+ *
+ * A64REG_ZR       Register number 31 reads as zero in most data-processing
+ *                  opcodes, and is what regMipsToHost() returns for PS1 $zero.
+ *                  -> In ADD/SUB (immediate) and as a load/store base, it
+ *                     means SP instead! Emitters must not pass it there.
+ */
+typedef enum {
+	A64REG_X0 = 0,
+	A64REG_X1,
+	A64REG_X2,
+	A64REG_X3,
+	A64REG_X4,
+	A64REG_X5,
+	A64REG_X6,
+	A64REG_X7,
+
+	A64REG_X9 = 9,
+	A64REG_X10,
+	A64REG_X11,
+	A64REG_X12,
+	A64REG_X13,
+	A64REG_X14,
+	A64REG_X15,
+
+	A64REG_X16 = 16,
+	A64REG_X17,
+
+	A64REG_X19 = 19,
+	A64REG_X20,
+	A64REG_X21,
+	A64REG_X22,
+	A64REG_X23,
+	A64REG_X24,
+	A64REG_X25,
+	A64REG_X26,
+	A64REG_X27,
+	A64REG_X28,
+
+	A64REG_FP = 29,
+	A64REG_LR = 30,
+	A64REG_ZR = 31
+} A64Reg;
+
+/* Free for use as temporaries in emitted code.
+ * Do NOT let these conflict with registers used below!
+ */
+#define TEMP_0               A64REG_X9
+#define TEMP_1               A64REG_X10
+#define TEMP_2               A64REG_X11
+#define TEMP_3               A64REG_X12
+
+/* PERM_REG_1 is pointer to psxRegs struct */
+#define PERM_REG_1           A64REG_X19
+
+/* PERM_REG_2 is host address of PS1 RAM */
+#define PERM_REG_2           A64REG_X20
+
+/* Survives emitted BD slot, see rec_bcu.cpp.h */
+#define BRANCH_REG           A64REG_X21
+
+#ifndef __aarch64__
+ #error "AArch64 recompiler can only be built for AArch64 hosts."
+#endif
+
+#if !defined(__SIZEOF_POINTER__) || (__SIZEOF_POINTER__ != 8)
+ #error "AArch64 recompiler requires a 64-bit host."
+#endif
+
+#if (defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)) || \
+    defined(__AARCH64EB__)
+ #error "Recompiler has not yet been ported to big-endian platforms."
+#endif
+
+/* Condition codes */
+#define A64_EQ 0x0
+#define A64_NE 0x1
+#define A64_HS 0x2
+#define A64_LO 0x3
+#define A64_MI 0x4
+#define A64_PL 0x5
+#define A64_HI 0x8
+#define A64_LS 0x9
+#define A64_GE 0xa
+#define A64_LT 0xb
+#define A64_GT 0xc
+#define A64_LE 0xd
+
+/* Crazy macro to calculate offset of the field in the structure.
+ *  (Can't use standard offsetof() with non-const expressions)
+ */
+#ifndef OFFSET_OF
+#define OFFSET_OF(T,F) ((unsigned int)((char *)&((T *)0L)->F - (char *)0L))
+#endif
+
+#define off(field)	OFFSET_OF(psxRegisters, field)
+#define offGPR(rx)	OFFSET_OF(psxRegisters, GPR.r[rx])
+#define offCP0(rx)	OFFSET_OF(psxRegisters, CP0.r[rx])
+#define offCP2D(rx)	OFFSET_OF(psxRegisters, CP2D.r[rx])
+#define offCP2C(rx)	OFFSET_OF(psxRegisters, CP2C.r[rx])
+
+#define write32(i) \
+	do { *recMem++ = (u32)(i); } while (0)
+
+/* Encode 'val' as an AArch64 32-bit logical immediate. Returns false if it
+ *  isn't a (rotated, replicated) run of ones and must be loaded with LI32.
+ */
+static inline bool a64_logical_imm32(u32 val, u32 *enc)
+{
+	if (val == 0 || val == 0xffffffff)
+		return false;
+
+	// Find smallest element size that replicates to 'val'
+	u32 size = 32;
+	while (size > 2) {
+		u32 half = size / 2;
+		u32 hmask = (1u << half) - 1;
+		if ((val & hmask) != ((val >> half) & hmask))
+			break;
+		size = half;
+	}
+
+	u32 mask = (size == 32) ? 0xffffffff : ((1u << size) - 1);
+	u32 elt  = val & mask;
+	u32 ones = __builtin_popcount(elt);
+	u32 run  = (1u << ones) - 1;
+
+	// Element must be 'run' rotated right by some amount
+	for (u32 immr = 0; immr < size; immr++) {
+		u32 rot = (immr == 0) ? run : (((run >> immr) | (run << (size - immr))) & mask);
+		if (rot == elt) {
+			u32 imms = ((~(size - 1) << 1) & 0x3f) | (ones - 1);
+			*enc = (immr << 16) | (imms << 10);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/* Data processing (register), 32-bit */
+#define ADD(rd, rn, rm)  write32(0x0b000000 | ((rm) << 16) | ((rn) << 5) | (rd))
+#define SUB(rd, rn, rm)  write32(0x4b000000 | ((rm) << 16) | ((rn) << 5) | (rd))
+#define AND(rd, rn, rm)  write32(0x0a000000 | ((rm) << 16) | ((rn) << 5) | (rd))
+#define ORR(rd, rn, rm)  write32(0x2a000000 | ((rm) << 16) | ((rn) << 5) | (rd))
+#define EOR(rd, rn, rm)  write32(0x4a000000 | ((rm) << 16) | ((rn) << 5) | (rd))
+#define ORN(rd, rn, rm)  write32(0x2a200000 | ((rm) << 16) | ((rn) << 5) | (rd))
+#define CMP(rn, rm)      write32(0x6b000000 | ((rm) << 16) | ((rn) << 5) | A64REG_ZR)
+#define MOV(rd, rm)      ORR(rd, A64REG_ZR, rm)
+#define MVN(rd, rm)      ORN(rd, A64REG_ZR, rm)
+
+#define ADD_X(rd, rn, rm) write32(0x8b000000 | ((rm) << 16) | ((rn) << 5) | (rd))
+#define MOV_X(rd, rm)     write32(0xaa0003e0 | ((rm) << 16) | (rd))
+
+/* ADD Xd, Xn, Wm, UXTW #shift (shift 0..4) */
+#define ADD_X_UXTW(rd, rn, rm, shift) \
+	write32(0x8b204000 | ((rm) << 16) | ((shift) << 10) | ((rn) << 5) | (rd))
+
+#define LSLV(rd, rn, rm) write32(0x1ac02000 | ((rm) << 16) | ((rn) << 5) | (rd))
+#define LSRV(rd, rn, rm) write32(0x1ac02400 | ((rm) << 16) | ((rn) << 5) | (rd))
+#define ASRV(rd, rn, rm) write32(0x1ac02800 | ((rm) << 16) | ((rn) << 5) | (rd))
+
+#define MUL(rd, rn, rm)  write32(0x1b007c00 | ((rm) << 16) | ((rn) << 5) | (rd))
+#define MSUB(rd, rn, rm, ra) \
+	write32(0x1b008000 | ((rm) << 16) | ((ra) << 10) | ((rn) << 5) | (rd))
+#define SMULL(rd, rn, rm) write32(0x9b207c00 | ((rm) << 16) | ((rn) << 5) | (rd))
+#define UMULL(rd, rn, rm) write32(0x9ba07c00 | ((rm) << 16) | ((rn) << 5) | (rd))
+#define SDIV(rd, rn, rm) write32(0x1ac00c00 | ((rm) << 16) | ((rn) << 5) | (rd))
+#define UDIV(rd, rn, rm) write32(0x1ac00800 | ((rm) << 16) | ((rn) << 5) | (rd))
+
+/* Conditional select/set, 32-bit */
+#define CSEL(rd, rn, rm, cond) \
+	write32(0x1a800000 | ((rm) << 16) | ((cond) << 12) | ((rn) << 5) | (rd))
+#define CSET(rd, cond) \
+	write32(0x1a9f07e0 | (((cond) ^ 1) << 12) | (rd))
+
+/* Bitfield ops, 32-bit */
+#define UBFM(rd, rn, immr, imms) \
+	write32(0x53000000 | ((immr) << 16) | ((imms) << 10) | ((rn) << 5) | (rd))
+#define SBFM(rd, rn, immr, imms) \
+	write32(0x13000000 | ((immr) << 16) | ((imms) << 10) | ((rn) << 5) | (rd))
+#define BFM(rd, rn, immr, imms) \
+	write32(0x33000000 | ((immr) << 16) | ((imms) << 10) | ((rn) << 5) | (rd))
+
+#define LSL(rd, rn, sa)  UBFM(rd, rn, ((32 - (sa)) & 31), (31 - (sa)))
+#define LSR(rd, rn, sa)  UBFM(rd, rn, (sa), 31)
+#define ASR(rd, rn, sa)  SBFM(rd, rn, (sa), 31)
+#define UBFX(rd, rn, lsb, width) UBFM(rd, rn, (lsb), ((lsb) + (width) - 1))
+#define BFI(rd, rn, lsb, width)  BFM(rd, rn, ((32 - (lsb)) & 31), ((width) - 1))
+#define SXTB(rd, rn)     SBFM(rd, rn, 0, 7)
+#define SXTH(rd, rn)     SBFM(rd, rn, 0, 15)
+#define UXTB(rd, rn)     UBFM(rd, rn, 0, 7)
+#define UXTH(rd, rn)     UBFM(rd, rn, 0, 15)
+
+/* Xd = Xn >> 32 */
+#define LSR_X32(rd, rn)  write32(0xd360fc00 | ((rn) << 5) | (rd))
+
+/* Add/sub immediate, 32-bit. 'imm12' is unsigned 12 bits.
+ *  NOTE: register 31 is SP here, not ZR!
+ */
+#define ADDI(rd, rn, imm12) write32(0x11000000 | (((imm12) & 0xfff) << 10) | ((rn) << 5) | (rd))
+#define SUBI(rd, rn, imm12) write32(0x51000000 | (((imm12) & 0xfff) << 10) | ((rn) << 5) | (rd))
+#define CMPI(rn, imm12)     write32(0x71000000 | (((imm12) & 0xfff) << 10) | ((rn) << 5) | A64REG_ZR)
+/* Same, with imm12 shifted left 12 */
+#define ADDI_LSL12(rd, rn, imm12) write32(0x11400000 | (((imm12) & 0xfff) << 10) | ((rn) << 5) | (rd))
+#define SUBI_LSL12(rd, rn, imm12) write32(0x51400000 | (((imm12) & 0xfff) << 10) | ((rn) << 5) | (rd))
+#define CMPI_LSL12(rn, imm12)     write32(0x71400000 | (((imm12) & 0xfff) << 10) | ((rn) << 5) | A64REG_ZR)
+
+/* Logical immediate, 32-bit. 'enc' from a64_logical_imm32() */
+#define ANDI_ENC(rd, rn, enc) write32(0x12000000 | (enc) | ((rn) << 5) | (rd))
+#define ORRI_ENC(rd, rn, enc) write32(0x32000000 | (enc) | ((rn) << 5) | (rd))
+#define EORI_ENC(rd, rn, enc) write32(0x52000000 | (enc) | ((rn) << 5) | (rd))
+
+/* Logical immediate, for 'imm' known at compile-time to be encodable */
+#define LOGICAL_IMM(insn_enc, rd, rn, imm) \
+do { \
+	u32 _enc; \
+	if (!a64_logical_imm32((imm), &_enc)) { \
+		printf("Error: 0x%x is not a valid logical immediate\n", (u32)(imm)); \
+		exit(1); \
+	} \
+	insn_enc(rd, rn, _enc); \
+} while (0)
+
+#define ANDI(rd, rn, imm) LOGICAL_IMM(ANDI_ENC, rd, rn, imm)
+#define ORRI(rd, rn, imm) LOGICAL_IMM(ORRI_ENC, rd, rn, imm)
+#define EORI(rd, rn, imm) LOGICAL_IMM(EORI_ENC, rd, rn, imm)
+
+/* Move wide, 32 and 64-bit. 'hw' selects 16-bit field (shift = hw*16) */
+#define MOVZ(rd, imm16, hw)   write32(0x52800000 | ((hw) << 21) | (((imm16) & 0xffff) << 5) | (rd))
+#define MOVN(rd, imm16, hw)   write32(0x12800000 | ((hw) << 21) | (((imm16) & 0xffff) << 5) | (rd))
+#define MOVK(rd, imm16, hw)   write32(0x72800000 | ((hw) << 21) | (((imm16) & 0xffff) << 5) | (rd))
+#define MOVZ_X(rd, imm16, hw) write32(0xd2800000 | ((hw) << 21) | (((imm16) & 0xffff) << 5) | (rd))
+#define MOVK_X(rd, imm16, hw) write32(0xf2800000 | ((hw) << 21) | (((imm16) & 0xffff) << 5) | (rd))
+
+#define LI32(reg, imm32) \
+do { \
+	const u32 _imm = (u32)(imm32); \
+	if ((_imm & 0xffff0000) == 0) { \
+		MOVZ(reg, _imm, 0); \
+	} else if ((_imm & 0xffff) == 0) { \
+		MOVZ(reg, (_imm >> 16), 1); \
+	} else if ((~_imm & 0xffff0000) == 0) { \
+		MOVN(reg, (~_imm & 0xffff), 0); \
+	} else if ((~_imm & 0xffff) == 0) { \
+		MOVN(reg, (~_imm >> 16), 1); \
+	} else { \
+		MOVZ(reg, (_imm & 0xffff), 0); \
+		MOVK(reg, (_imm >> 16), 1); \
+	} \
+} while (0)
+
+#define LI64(reg, imm64) \
+do { \
+	const u64 _imm = (u64)(imm64); \
+	MOVZ_X(reg, (_imm & 0xffff), 0); \
+	for (int _hw = 1; _hw < 4; _hw++) { \
+		if ((_imm >> (_hw * 16)) & 0xffff) \
+			MOVK_X(reg, ((_imm >> (_hw * 16)) & 0xffff), _hw); \
+	} \
+} while (0)
+
+/* Loads/stores, unsigned scaled offset. 'imm' is byte offset.
+ *  NOTE: base register 31 is SP here, not ZR!
+ */
+#define LDR_W(rt, rn, imm)   write32(0xb9400000 | ((((imm) >> 2) & 0xfff) << 10) | ((rn) << 5) | (rt))
+#define STR_W(rt, rn, imm)   write32(0xb9000000 | ((((imm) >> 2) & 0xfff) << 10) | ((rn) << 5) | (rt))
+#define LDR_X(rt, rn, imm)   write32(0xf9400000 | ((((imm) >> 3) & 0xfff) << 10) | ((rn) << 5) | (rt))
+#define STR_X(rt, rn, imm)   write32(0xf9000000 | ((((imm) >> 3) & 0xfff) << 10) | ((rn) << 5) | (rt))
+#define LDRH(rt, rn, imm)    write32(0x79400000 | ((((imm) >> 1) & 0xfff) << 10) | ((rn) << 5) | (rt))
+#define STRH(rt, rn, imm)    write32(0x79000000 | ((((imm) >> 1) & 0xfff) << 10) | ((rn) << 5) | (rt))
+#define LDRSH(rt, rn, imm)   write32(0x79c00000 | ((((imm) >> 1) & 0xfff) << 10) | ((rn) << 5) | (rt))
+#define LDRB(rt, rn, imm)    write32(0x39400000 | (((imm) & 0xfff) << 10) | ((rn) << 5) | (rt))
+#define STRB(rt, rn, imm)    write32(0x39000000 | (((imm) & 0xfff) << 10) | ((rn) << 5) | (rt))
+#define LDRSB(rt, rn, imm)   write32(0x39c00000 | (((imm) & 0xfff) << 10) | ((rn) << 5) | (rt))
+
+/* Loads/stores, [Xn, Wm, UXTW]. Offset register is not scaled. */
+#define LDR_W_UXTW(rt, rn, rm)  write32(0xb8604800 | ((rm) << 16) | ((rn) << 5) | (rt))
+#define STR_W_UXTW(rt, rn, rm)  write32(0xb8204800 | ((rm) << 16) | ((rn) << 5) | (rt))
+#define LDRH_UXTW(rt, rn, rm)   write32(0x78604800 | ((rm) << 16) | ((rn) << 5) | (rt))
+#define STRH_UXTW(rt, rn, rm)   write32(0x78204800 | ((rm) << 16) | ((rn) << 5) | (rt))
+#define LDRSH_UXTW(rt, rn, rm)  write32(0x78e04800 | ((rm) << 16) | ((rn) << 5) | (rt))
+#define LDRB_UXTW(rt, rn, rm)   write32(0x38604800 | ((rm) << 16) | ((rn) << 5) | (rt))
+#define STRB_UXTW(rt, rn, rm)   write32(0x38204800 | ((rm) << 16) | ((rn) << 5) | (rt))
+#define LDRSB_UXTW(rt, rn, rm)  write32(0x38e04800 | ((rm) << 16) | ((rn) << 5) | (rt))
+
+/* STR Xt, [Xn, Wm, UXTW #3] */
+#define STR_X_UXTW3(rt, rn, rm) write32(0xf8205800 | ((rm) << 16) | ((rn) << 5) | (rt))
+
+/* Block prologue/epilogue: save/restore frame ptr and link reg */
+#define PUSH_FP_LR()  write32(0xa9bf7bfd) /* stp x29, x30, [sp, #-16]! */
+#define POP_FP_LR()   write32(0xa8c17bfd) /* ldp x29, x30, [sp], #16   */
+
+/* Branches. Offsets are filled in later by fixup_branch() when zero. */
+#define B(woff)           write32(0x14000000 | ((woff) & 0x3ffffff))
+#define BCOND(cond, woff) write32(0x54000000 | (((woff) & 0x7ffff) << 5) | (cond))
+#define CBZ(rt, woff)     write32(0x34000000 | (((woff) & 0x7ffff) << 5) | (rt))
+#define CBNZ(rt, woff)    write32(0x35000000 | (((woff) & 0x7ffff) << 5) | (rt))
+#define TBZ(rt, bit, woff)  write32(0x36000000 | (((bit) & 0x1f) << 19) | (((woff) & 0x3fff) << 5) | (rt))
+#define TBNZ(rt, bit, woff) write32(0x37000000 | (((bit) & 0x1f) << 19) | (((woff) & 0x3fff) << 5) | (rt))
+#define BR(rn)            write32(0xd61f0000 | ((rn) << 5))
+#define BLR(rn)           write32(0xd63f0000 | ((rn) << 5))
+#define RET()             write32(0xd65f03c0)
+#define NOP()             write32(0xd503201f)
+
+/* Call C function. Uses BL when target is in +-128MB range, which it usually
+ *  is: recMemBase[] is statically allocated, close to .text section.
+ */
+#define CALL(func) \
+do { \
+	const s64 _off = (s64)((uptr)(func) - (uptr)recMem); \
+	if (_off >= -(1LL << 27) && _off < (1LL << 27)) { \
+		write32(0x94000000 | ((_off >> 2) & 0x3ffffff)); \
+	} else { \
+		LI64(A64REG_X16, (uptr)(func)); \
+		BLR(A64REG_X16); \
+	} \
+} while (0)
+
+/* Resolve forward branch emitted at BACKPATCH to current position */
+#define fixup_branch(BACKPATCH) \
+do { \
+	u32 *_bp = (u32 *)(BACKPATCH); \
+	const s32 _woff = (s32)(recMem - _bp); \
+	if ((*_bp & 0x7c000000) == 0x14000000) \
+		*_bp |= (_woff & 0x3ffffff);          /* B */ \
+	else if ((*_bp & 0x7e000000) == 0x36000000) \
+		*_bp |= ((_woff & 0x3fff) << 5);      /* TBZ/TBNZ */ \
+	else \
+		*_bp |= ((_woff & 0x7ffff) << 5);     /* B.cond/CBZ/CBNZ */ \
+} while (0)
+
+static inline u32 ADJUST_CLOCK(u32 cycles)
+{
+	extern u32 cycle_multiplier;
+	return (cycles * cycle_multiplier) >> 8;
+}
+
+/* start of the recompiled block */
+#define rec_recompile_start() \
+do { \
+	PUSH_FP_LR(); \
+} while (0)
+
+/* end of the recompiled block: new PC value must already be in W0.
+ *  Blocks return new PC in W0 and cycles elapsed in W1 to dispatch loop.
+ */
+#define rec_recompile_end() \
+do { \
+	LI32(A64REG_X1, ADJUST_CLOCK((pc - oldpc) / 4)); \
+	POP_FP_LR(); \
+	RET(); \
+} while (0)
+
+#endif /* A64_CODEGEN_H */
@@ -0,0 +1,312 @@
+/******************************************************************************
+ * IMPORTANT: The following host registers have unique usage restrictions.    *
+ *            See notes in a64_codegen.h for full details.                    *
+ *  A64REG_ZR, BRANCH_REG                                                     *
+ *****************************************************************************/
+
+/* Write known-const result 'val' to PS1 reg 'psxreg' */
+static void emitConstResult(u32 psxreg, u32 val)
+{
+	if (!psxreg)
+		return;
+
+	/* Exit if const already loaded */
+	if (IsConst(psxreg) && GetConst(psxreg) == val &&
+	    regcache.psx[psxreg].ismapped)
+		return;
+
+	u32 rd = regMipsToHost(psxreg, REG_FIND, REG_REGISTER);
+	LI32(rd, val);
+	SetConst(psxreg, val);
+	regMipsChanged(psxreg);
+	regUnlock(rd);
+}
+
+/* Map dest reg 'rd' and source reg 'rs' of an ALU op, keeping rd's contents
+ *  when it is also a source.
+ */
+#define REC_MAP_RD_RS(_rd_, _rs_, r1, r2) \
+do { \
+	if ((_rs_) == (_rd_)) { \
+		r1 = regMipsToHost(_rd_, REG_LOAD, REG_REGISTER); \
+		r2 = r1; \
+	} else { \
+		r2 = regMipsToHost(_rs_, REG_LOAD, REG_REGISTER); \
+		r1 = regMipsToHost(_rd_, REG_FIND, REG_REGISTER); \
+	} \
+} while (0)
+
+/* Load u16/s16 immediate 'imm' into TEMP_0, returning TEMP_0 */
+static u32 emitImmToTemp(u32 imm)
+{
+	LI32(TEMP_0, imm);
+	return TEMP_0;
+}
+
+static void recADDIU()
+{
+	// rt = rs + (s32)imm
+
+	if (!_Rt_)
+		return;
+
+	const s32 imm = _Imm_;
+
+	if (IsConst(_Rs_)) {
+		emitConstResult(_Rt_, GetConst(_Rs_) + imm);
+		return;
+	}
+
+	u32 rt, rs;
+	REC_MAP_RD_RS(_Rt_, _Rs_, rt, rs);
+	SetUndef(_Rt_);
+
+	if (imm >= 0 && imm < 0x1000) {
+		ADDI(rt, rs, imm);
+	} else if (imm < 0 && -imm < 0x1000) {
+		SUBI(rt, rs, -imm);
+	} else if (!(imm & 0xfff)) {
+		if (imm >= 0) ADDI_LSL12(rt, rs, (imm >> 12));
+		else          SUBI_LSL12(rt, rs, ((-imm) >> 12));
+	} else {
+		ADD(rt, rs, emitImmToTemp(imm));
+	}
+
+	regMipsChanged(_Rt_);
+	regUnlock(rt);
+	regUnlock(rs);
+}
+static void recADDI() { recADDIU(); }
+
+/* Emit SLTI/SLTIU: rt = rs < imm, with condition 'cond' (LT or LO) */
+static void emitSLTI(u32 cond)
+{
+	const s32 imm = _Imm_;
+
+	u32 rt, rs;
+	REC_MAP_RD_RS(_Rt_, _Rs_, rt, rs);
+	SetUndef(_Rt_);
+
+	if (imm >= 0 && imm < 0x1000) {
+		CMPI(rs, imm);
+	} else {
+		CMP(rs, emitImmToTemp(imm));
+	}
+	CSET(rt, cond);
+
+	regMipsChanged(_Rt_);
+	regUnlock(rt);
+	regUnlock(rs);
+}
+
+static void recSLTI()
+{
+	// rt = (s32)rs < (s32)imm
+
+	if (!_Rt_)
+		return;
+
+	if (IsConst(_Rs_)) {
+		emitConstResult(_Rt_, (s32)GetConst(_Rs_) < (s32)_Imm_);
+		return;
+	}
+
+	emitSLTI(A64_LT);
+}
+
+static void recSLTIU()
+{
+	// rt = (u32)rs < (u32)((s32)imm)
+
+	if (!_Rt_)
+		return;
+
+	if (IsConst(_Rs_)) {
+		emitConstResult(_Rt_, GetConst(_Rs_) < (u32)_Imm_);
+		return;
+	}
+
+	emitSLTI(A64_LO);
+}
+
+/* Emit ANDI/ORI/XORI with zero-extended imm */
+#define REC_LOGICAL_IMM(insn_enc, insn_reg) \
+do { \
+	const u32 imm = _ImmU_; \
+	u32 enc, rt, rs; \
+	REC_MAP_RD_RS(_Rt_, _Rs_, rt, rs); \
+	SetUndef(_Rt_); \
+	if (a64_logical_imm32(imm, &enc)) { \
+		insn_enc(rt, rs, enc); \
+	} else { \
+		insn_reg(rt, rs, emitImmToTemp(imm)); \
+	} \
+	regMipsChanged(_Rt_); \
+	regUnlock(rt); \
+	regUnlock(rs); \
+} while (0)
+
+static void recANDI()
+{
+	// rt = rs & (u32)imm
+
+	if (!_Rt_)
+		return;
+
+	if (IsConst(_Rs_) || !_ImmU_) {
+		emitConstResult(_Rt_, GetConst(_Rs_) & _ImmU_);
+		return;
+	}
+
+	REC_LOGICAL_IMM(ANDI_ENC, AND);
+}
+
+static void recORI()
+{
+	// rt = rs | (u32)imm
+
+	if (!_Rt_)
+		return;
+
+	if (IsConst(_Rs_)) {
+		emitConstResult(_Rt_, GetConst(_Rs_) | _ImmU_);
+		return;
+	}
+
+	REC_LOGICAL_IMM(ORRI_ENC, ORR);
+}
+
+static void recXORI()
+{
+	// rt = rs ^ (u32)imm
+
+	if (!_Rt_)
+		return;
+
+	if (IsConst(_Rs_)) {
+		emitConstResult(_Rt_, GetConst(_Rs_) ^ _ImmU_);
+		return;
+	}
+
+	REC_LOGICAL_IMM(EORI_ENC, EOR);
+}
+
+static void recLUI()
+{
+	// rt = imm << 16
+
+	if (!_Rt_)
+		return;
+
+	emitConstResult(_Rt_, _ImmU_ << 16);
+}
+
+/* Emit 3-op ALU opcode rd = rs OP rt, or propagate const result 'cval'
+ *  when both inputs are known.
+ */
+#define REC_RTYPE_RD_RS_RT(insn, cval) \
+do { \
+	if (!_Rd_) \
+		return; \
+	if (IsConst(_Rs_) && IsConst(_Rt_)) { \
+		const u32 a = GetConst(_Rs_), b = GetConst(_Rt_); \
+		(void)a; (void)b; \
+		emitConstResult(_Rd_, (cval)); \
+		return; \
+	} \
+	u32 rs = regMipsToHost(_Rs_, REG_LOAD, REG_REGISTER); \
+	u32 rt = regMipsToHost(_Rt_, REG_LOAD, REG_REGISTER); \
+	u32 rd = regMipsToHost(_Rd_, (_Rd_ == _Rs_ || _Rd_ == _Rt_) ? REG_LOAD : REG_FIND, REG_REGISTER); \
+	SetUndef(_Rd_); \
+	insn; \
+	regMipsChanged(_Rd_); \
+	regUnlock(rd); \
+	regUnlock(rt); \
+	regUnlock(rs); \
+} while (0)
+
+static void recADDU() { REC_RTYPE_RD_RS_RT(ADD(rd, rs, rt), a + b); }
+static void recADD()  { recADDU(); }
+static void recSUBU() { REC_RTYPE_RD_RS_RT(SUB(rd, rs, rt), a - b); }
+static void recSUB()  { recSUBU(); }
+static void recAND()  { REC_RTYPE_RD_RS_RT(AND(rd, rs, rt), a & b); }
+static void recOR()   { REC_RTYPE_RD_RS_RT(ORR(rd, rs, rt), a | b); }
+static void recXOR()  { REC_RTYPE_RD_RS_RT(EOR(rd, rs, rt), a ^ b); }
+static void recNOR()  { REC_RTYPE_RD_RS_RT({ ORR(rd, rs, rt); MVN(rd, rd); }, ~(a | b)); }
+
+static void recSLT()
+{
+	// rd = (s32)rs < (s32)rt
+	REC_RTYPE_RD_RS_RT({ CMP(rs, rt); CSET(rd, A64_LT); }, (s32)a < (s32)b);
+}
+
+static void recSLTU()
+{
+	// rd = (u32)rs < (u32)rt
+	REC_RTYPE_RD_RS_RT({ CMP(rs, rt); CSET(rd, A64_LO); }, a < b);
+}
+
+/* Emit shift by immediate: rd = rt OP sa */
+#define REC_SHIFT_IMM(insn, cval) \
+do { \
+	if (!_Rd_) \
+		return; \
+	const u32 sa = _Sa_; \
+	if (IsConst(_Rt_)) { \
+		const u32 a = GetConst(_Rt_); \
+		emitConstResult(_Rd_, (cval)); \
+		return; \
+	} \
+	u32 rd, rt; \
+	REC_MAP_RD_RS(_Rd_, _Rt_, rd, rt); \
+	SetUndef(_Rd_); \
+	insn(rd, rt, sa); \
+	regMipsChanged(_Rd_); \
+	regUnlock(rd); \
+	regUnlock(rt); \
+} while (0)
+
+static void recSLL()
+{
+	// rd = rt << sa
+	REC_SHIFT_IMM(LSL, a << sa);
+}
+
+static void recSRL()
+{
+	// rd = (u32)rt >> sa
+	REC_SHIFT_IMM(LSR, a >> sa);
+}
+
+static void recSRA()
+{
+	// rd = (s32)rt >> sa
+	REC_SHIFT_IMM(ASR, (u32)((s32)a >> sa));
+}
+
+/* Emit shift by register: rd = rt OP (rs & 31). AArch64 variable shifts
+ *  use the amount modulo 32, same as MIPS.
+ */
+#define REC_SHIFT_VAR(insn, cval) \
+do { \
+	if (!_Rd_) \
+		return; \
+	if (IsConst(_Rt_) && IsConst(_Rs_)) { \
+		const u32 a = GetConst(_Rt_), sa = GetConst(_Rs_) & 31; \
+		emitConstResult(_Rd_, (cval)); \
+		return; \
+	} \
+	u32 rt = regMipsToHost(_Rt_, REG_LOAD, REG_REGISTER); \
+	u32 rs = regMipsToHost(_Rs_, REG_LOAD, REG_REGISTER); \
+	u32 rd = regMipsToHost(_Rd_, (_Rd_ == _Rs_ || _Rd_ == _Rt_) ? REG_LOAD : REG_FIND, REG_REGISTER); \
+	SetUndef(_Rd_); \
+	insn(rd, rt, rs); \
+	regMipsChanged(_Rd_); \
+	regUnlock(rd); \
+	regUnlock(rs); \
+	regUnlock(rt); \
+} while (0)
+
+static void recSLLV() { REC_SHIFT_VAR(LSLV, a << sa); }
+static void recSRLV() { REC_SHIFT_VAR(LSRV, a >> sa); }
+static void recSRAV() { REC_SHIFT_VAR(ASRV, (u32)((s32)a >> sa)); }
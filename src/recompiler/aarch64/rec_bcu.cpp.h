@@ -0,0 +1,443 @@
+/******************************************************************************
+ * IMPORTANT: The following host registers have unique usage restrictions.    *
+ *            See notes in a64_codegen.h for full details.                    *
+ *  A64REG_ZR, BRANCH_REG                                                     *
+ *****************************************************************************/
+
+/* Branches and jumps read their source regs *before* the opcode in their
+ *  delay slot executes. The branch decision (or indirect jump target) is
+ *  computed into BRANCH_REG first: it is callee-saved, so it survives any C
+ *  calls emitted for the delay slot opcode.
+ *
+ *  Conditional branches don't end a block: the taken path returns to the
+ *  dispatch loop with the branch target as new PC, the not-taken path falls
+ *  through to the rest of the block.
+ *
+ *  A load in the delay slot of a taken branch whose target opcode accesses
+ *  the loaded reg is emulated at runtime by execBranchLoadDelay(), which
+ *  does what the interpreter's psxDelayTest() does.
+ */
+
+static void recSYSCALL()
+{
+	regClearJump();
+
+	LI32(TEMP_0, pc - 4);
+	STR_W(TEMP_0, PERM_REG_1, off(pc));
+
+	LI32(A64REG_X0, 0x20);
+	LI32(A64REG_X1, (branch ? 1 : 0));
+	CALL(psxException);
+
+	LDR_W(A64REG_X0, PERM_REG_1, off(pc)); // New PC set by psxException()
+	rec_recompile_end();
+
+	end_block = 1;
+}
+
+static void recBREAK() { }
+
+/* Check if an opcode has a delayed read if in delay slot */
+static int iLoadTest(u32 code)
+{
+	// check for load delay
+	u32 op = _fOp_(code);
+	switch (op) {
+	case 0x10: // COP0
+		switch (_fRs_(code)) {
+		case 0x00: // MFC0
+		case 0x02: // CFC0
+			return 1;
+		}
+		break;
+	case 0x12: // COP2
+		switch (_fFunct_(code)) {
+		case 0x00:
+			switch (_fRs_(code)) {
+			case 0x00: // MFC2
+			case 0x02: // CFC2
+				return 1;
+			}
+			break;
+		}
+		break;
+	case 0x32: // LWC2
+		return 1;
+	default:
+		// LB/LH/LWL/LW/LBU/LHU/LWR
+		if (op >= 0x20 && op <= 0x26) {
+			return 1;
+		}
+		break;
+	}
+	return 0;
+}
+
+static int DelayTest(const u32 pc, const u32 bpc)
+{
+	const u32 code1 = OPCODE_AT(pc);
+	const u32 code2 = OPCODE_AT(bpc);
+
+	if (iLoadTest(code1)) {
+		return psxTestLoadDelay(_fRt_(code1), code2);
+		// 1: delayReadWrite	// the branch delay load is skipped
+		// 2: delayRead		// branch delay load
+		// 3: delayWrite	// no changes from normal behavior
+	}
+
+	return 0;
+}
+
+extern void (*psxBSC[64])(void);
+
+/* Execute load in delay slot at 'pc' of branch taken to 'bpc' through the
+ *  interpreter, like its psxDelayTest(). Returns new PC.
+ * NOTE: Called at runtime: read opcodes straight from PS1 memory.
+ */
+static u32 execBranchLoadDelay(u32 pc, u32 bpc)
+{
+	const u32 code1 = PSXMu32(pc);
+	const u32 code2 = PSXMu32(bpc);
+	const u32 reg = _fRt_(code1);
+	u32 rold, rnew;
+
+	switch (psxTestLoadDelay(reg, code2)) {
+	case 1:		// branch delay load is skipped
+		return bpc;
+	case 2:		// first branch opcode reads reg before load lands
+		rold = psxRegs.GPR.r[reg];
+		psxRegs.code = code1;
+		psxBSC[code1 >> 26]();
+		rnew = psxRegs.GPR.r[reg];
+
+		// If first branch opcode is a jump, interpreter sets new PC
+		psxRegs.pc = bpc + 4;
+		psxRegs.GPR.r[reg] = rold;
+		psxRegs.code = code2;
+		psxBSC[code2 >> 26]();
+		psxRegs.GPR.r[reg] = rnew;
+		return psxRegs.pc;
+	default:	// simple branch delay
+		psxRegs.code = code1;
+		psxBSC[code1 >> 26]();
+		return bpc;
+	}
+}
+
+/* Emit call to execBranchLoadDelay() for branch target in W1, and return to
+ *  dispatch loop. PS1 regs in host regs must already be written back.
+ */
+static void emitBranchLoadDelay()
+{
+	LI32(A64REG_X0, pc);
+	CALL(execBranchLoadDelay);
+
+	const u32 bd_pc = pc;
+	pc += 4;
+	rec_recompile_end();
+	pc = bd_pc;
+}
+
+/* Recompile opcode in delay slot */
+static void recDelaySlot()
+{
+	branch = 1;
+	rec_code = OPCODE_AT(pc);
+	DISASM_PSX(pc);
+	pc += 4;
+
+	recBSC[rec_code>>26]();
+	branch = 0;
+}
+
+static void iJumpNormal(u32 bpc)
+{
+	const int dt = DelayTest(pc, bpc);
+	if (dt == 1 || dt == 2) {
+		// BD slot trickery has been detected: use a workaround.
+		regClearJump();
+		LI32(A64REG_X1, bpc);
+		emitBranchLoadDelay();
+		pc += 4;
+		end_block = 1;
+		return;
+	}
+
+	recDelaySlot();
+
+	regClearJump();
+	LI32(A64REG_X0, bpc);
+	rec_recompile_end();
+
+	end_block = 1;
+}
+
+static void iJumpAL(u32 bpc, u32 nbpc)
+{
+	emitConstResult(31, nbpc);
+
+	iJumpNormal(bpc);
+}
+
+static void recJ()
+{
+// j target
+
+	iJumpNormal(_Target_ * 4 + (pc & 0xf0000000));
+}
+
+static void recJAL()
+{
+// jal target
+
+	iJumpAL(_Target_ * 4 + (pc & 0xf0000000), (pc + 4));
+}
+
+static void recJR()
+{
+// jr Rs
+
+	if (IsConst(_Rs_)) {
+		iJumpNormal(GetConst(_Rs_));
+		return;
+	}
+
+	u32 rs = regMipsToHost(_Rs_, REG_LOAD, REG_REGISTER);
+	MOV(BRANCH_REG, rs);
+	regUnlock(rs);
+
+	// if possible read delay in branch delay slot
+	if (iLoadTest(OPCODE_AT(pc))) {
+		// BD slot trickery has been detected: use a workaround.
+		// Fixes 'Skullmonkeys'.
+		regClearJump();
+		MOV(A64REG_X1, BRANCH_REG);
+		emitBranchLoadDelay();
+		pc += 4;
+		end_block = 1;
+		return;
+	}
+
+	recDelaySlot();
+
+	regClearJump();
+	MOV(A64REG_X0, BRANCH_REG);
+	rec_recompile_end();
+
+	end_block = 1;
+}
+
+static void recJALR()
+{
+// jalr Rs, Rd=pc+4
+
+	if (IsConst(_Rs_)) {
+		const u32 bpc = GetConst(_Rs_);
+		emitConstResult(_Rd_, pc + 4);
+		iJumpNormal(bpc);
+		return;
+	}
+
+	// Read target before Rd is written, as they might be the same reg
+	u32 rs = regMipsToHost(_Rs_, REG_LOAD, REG_REGISTER);
+	MOV(BRANCH_REG, rs);
+	regUnlock(rs);
+
+	emitConstResult(_Rd_, pc + 4);
+
+	if (iLoadTest(OPCODE_AT(pc))) {
+		regClearJump();
+		MOV(A64REG_X1, BRANCH_REG);
+		emitBranchLoadDelay();
+		pc += 4;
+		end_block = 1;
+		return;
+	}
+
+	recDelaySlot();
+
+	regClearJump();
+	MOV(A64REG_X0, BRANCH_REG);
+	rec_recompile_end();
+
+	end_block = 1;
+}
+
+enum {
+	BRANCH_NEVER, BRANCH_ALWAYS, BRANCH_EMITTED
+};
+
+/* Evaluate condition of branch opcode being recompiled. If not known at
+ *  compile-time, emit code setting BRANCH_REG to 1 if taken, 0 if not.
+ */
+static int emitBranchCond()
+{
+	u32 cond;
+	bool taken;
+	bool two_regs = false;
+
+	switch (_Op_) {
+	case 0x04: // BEQ
+		cond = A64_EQ; two_regs = true;
+		taken = (GetConst(_Rs_) == GetConst(_Rt_));
+		break;
+	case 0x05: // BNE
+		cond = A64_NE; two_regs = true;
+		taken = (GetConst(_Rs_) != GetConst(_Rt_));
+		break;
+	case 0x06: // BLEZ
+		cond = A64_LE;
+		taken = ((s32)GetConst(_Rs_) <= 0);
+		break;
+	case 0x07: // BGTZ
+		cond = A64_GT;
+		taken = ((s32)GetConst(_Rs_) > 0);
+		break;
+	default:   // REGIMM: BLTZ, BGEZ, BLTZAL, BGEZAL
+		if (_Rt_ & 1) {
+			cond = A64_GE;
+			taken = ((s32)GetConst(_Rs_) >= 0);
+		} else {
+			cond = A64_LT;
+			taken = ((s32)GetConst(_Rs_) < 0);
+		}
+		break;
+	}
+
+	if (IsConst(_Rs_) && (!two_regs || IsConst(_Rt_)))
+		return taken ? BRANCH_ALWAYS : BRANCH_NEVER;
+
+	u32 rs = regMipsToHost(_Rs_, REG_LOAD, REG_REGISTER);
+	u32 rt = two_regs ? regMipsToHost(_Rt_, REG_LOAD, REG_REGISTER) : A64REG_ZR;
+
+	CMP(rs, rt);
+	CSET(BRANCH_REG, cond);
+
+	regUnlock(rs);
+	regUnlock(rt);
+
+	return BRANCH_EMITTED;
+}
+
+/* Used for all conditional branches */
+static void emitBxx(u32 bpc, bool andlink)
+{
+	const int res = emitBranchCond();
+
+	// BLTZAL,BGEZAL write $ra whether or not branch is taken
+	if (andlink)
+		emitConstResult(31, pc + 4);
+
+	if (res == BRANCH_ALWAYS) {
+		iJumpNormal(bpc);
+		return;
+	}
+
+	if (res == BRANCH_NEVER) {
+		recDelaySlot();
+		return;
+	}
+
+	// With BD slot trickery, taken path can't share the BD slot opcode
+	//  with the not-taken path: it is emitted after the branch instead.
+	const int dt = DelayTest(pc, bpc);
+	const bool bd_trickery = (dt == 1 || dt == 2);
+
+	if (!bd_trickery)
+		recDelaySlot();
+
+	u32 *backpatch = (u32 *)recMem;
+	CBZ(BRANCH_REG, 0);
+
+	// Taken: write back modified regs, leaving reg cache state as-is for
+	//  the not-taken path that follows.
+	regClearBranch();
+	if (bd_trickery) {
+		LI32(A64REG_X1, bpc);
+		emitBranchLoadDelay();
+	} else {
+		LI32(A64REG_X0, bpc);
+		rec_recompile_end();
+	}
+
+	fixup_branch(backpatch);
+
+	if (bd_trickery)
+		recDelaySlot();
+}
+
+static void recBEQ()
+{
+// Branch if Rs == Rt
+	u32 bpc = _Imm_ * 4 + pc;
+
+	if (_Rs_ == _Rt_) {
+		iJumpNormal(bpc);
+		return;
+	}
+
+	emitBxx(bpc, false);
+}
+
+static void recBNE()
+{
+// Branch if Rs != Rt
+	u32 bpc = _Imm_ * 4 + pc;
+
+	if (_Rs_ == _Rt_) {
+		recDelaySlot();
+		return;
+	}
+
+	emitBxx(bpc, false);
+}
+
+static void recBLEZ()
+{
+// Branch if Rs <= 0
+	emitBxx(_Imm_ * 4 + pc, false);
+}
+
+static void recBGTZ()
+{
+// Branch if Rs > 0
+	emitBxx(_Imm_ * 4 + pc, false);
+}
+
+static void recBLTZ()
+{
+// Branch if Rs < 0
+	emitBxx(_Imm_ * 4 + pc, false);
+}
+
+static void recBGEZ()
+{
+// Branch if Rs >= 0
+	emitBxx(_Imm_ * 4 + pc, false);
+}
+
+static void recBLTZAL()
+{
+// Branch if Rs < 0, $ra = pc+4
+	emitBxx(_Imm_ * 4 + pc, true);
+}
+
+static void recBGEZAL()
+{
+// Branch if Rs >= 0, $ra = pc+4
+	emitBxx(_Imm_ * 4 + pc, true);
+}
+
+static void recHLE()
+{
+	regClearJump();
+
+	LI32(TEMP_0, pc);
+	STR_W(TEMP_0, PERM_REG_1, off(pc));
+	CALL(psxHLEt[rec_code & 0x7]);
+
+	LDR_W(A64REG_X0, PERM_REG_1, off(pc));
+	rec_recompile_end();
+
+	end_block = 1;
+}
@@ -0,0 +1,129 @@
+/******************************************************************************
+ * IMPORTANT: The following host registers have unique usage restrictions.    *
+ *            See notes in a64_codegen.h for full details.                    *
+ *  A64REG_ZR, BRANCH_REG                                                     *
+ *****************************************************************************/
+
+static void recMFC0()
+{
+// Rt = Cop0->Rd
+	if (!_Rt_) return;
+
+	SetUndef(_Rt_);
+	u32 rt = regMipsToHost(_Rt_, REG_FIND, REG_REGISTER);
+
+	LDR_W(rt, PERM_REG_1, offCP0(_Rd_));
+	regMipsChanged(_Rt_);
+	regUnlock(rt);
+}
+
+static void recCFC0()
+{
+// Rt = Cop0->Rd
+
+	recMFC0();
+}
+
+/* Writes to CP0 Status reg 12 or Cause reg 13, called from emitted code.
+ *  Returns non-zero if a software-generated IRQ/exception was raised, in
+ *  which case psxRegs.pc holds the exception vector.
+ */
+static u32 rec_MTC0_status_cause(u32 val, u32 reg, u32 in_bd)
+{
+	if (reg == 12) {
+		psxRegs.CP0.n.Status = val;
+
+		// If new value enables HW irqs/exceptions, reset io_cycle_counter,
+		//  so that psxBranchTest() is called as soon as possible.
+		if ((val & 0x401) == 0x401)
+			psxRegs.io_cycle_counter = 0;
+	} else {
+		// Only bits 8,9 of Cause are writable
+		psxRegs.CP0.n.Cause &= ~0x300;
+		psxRegs.CP0.n.Cause |= val & 0x300;
+	}
+
+	if ((psxRegs.CP0.n.Cause & psxRegs.CP0.n.Status & 0x300) &&
+	    (psxRegs.CP0.n.Status & 0x1)) {
+		psxRegs.CP0.n.Cause &= ~0x7c;
+		psxException(psxRegs.CP0.n.Cause, in_bd);
+		return 1;
+	}
+
+	return 0;
+}
+
+static void recMTC0()
+{
+// Cop0->Rd = Rt
+
+	u32 rt = regMipsToHost(_Rt_, REG_LOAD, REG_REGISTER);
+
+	switch (_Rd_) {
+		case 12: // Status
+		case 13: // Cause
+		{
+			// Modification of CP0 reg 12 or 13 must be followed by test for
+			//  software-generated IRQ/exception, unless value written is
+			//  known const val that would not generate one.
+			//  ** Fixes freeze at start of 'Jackie Chan Stuntmaster'
+			if (_Rd_ == 12 && IsConst(_Rt_) &&
+			    !((GetConst(_Rt_) & 0x300) && (GetConst(_Rt_) & 0x1))) {
+				STR_W(rt, PERM_REG_1, offCP0(12));
+				if ((GetConst(_Rt_) & 0x401) == 0x401)
+					STR_W(A64REG_ZR, PERM_REG_1, off(io_cycle_counter));
+				break;
+			}
+
+			// Exception handler (or HLE BIOS) may read GPRs
+			regClearBranch();
+
+			// psxRegs.pc is set to instruction that caused the exception
+			LI32(TEMP_0, pc - 4);
+			STR_W(TEMP_0, PERM_REG_1, off(pc));
+
+			MOV(A64REG_X0, rt);
+			LI32(A64REG_X1, _Rd_);
+			LI32(A64REG_X2, (branch ? 1 : 0));
+			CALL(rec_MTC0_status_cause);
+
+			u32 *backpatch = (u32 *)recMem;
+			CBZ(A64REG_X0, 0);
+			LDR_W(A64REG_X0, PERM_REG_1, off(pc)); // New PC set by psxException()
+			rec_recompile_end();
+			fixup_branch(backpatch);
+			break;
+		}
+
+		default:
+			STR_W(rt, PERM_REG_1, offCP0(_Rd_));
+			break;
+	}
+
+	regUnlock(rt);
+}
+
+static void recCTC0()
+{
+// Cop0->Rd = Rt
+
+	recMTC0();
+}
+
+static void recRFE()
+{
+// 'Return from exception' opcode
+//  Inside CP0 Status register (12), RFE atomically copies bits 5:2 to
+//  bits 3:0 , unwinding the exception 'stack'
+
+	LDR_W(TEMP_0, PERM_REG_1, offCP0(12));
+
+	// Reset psxRegs.io_cycle_counter, so that psxBranchTest() is called as
+	//  soon as possible to handle any pending interrupts/events
+	STR_W(A64REG_ZR, PERM_REG_1, off(io_cycle_counter));
+
+	UBFX(TEMP_1, TEMP_0, 2, 4);  // TEMP_1 = bits 5:2 of SR
+	BFI(TEMP_0, TEMP_1, 0, 4);   // Copy them to bits 3:0 of SR
+
+	STR_W(TEMP_0, PERM_REG_1, offCP0(12));
+}
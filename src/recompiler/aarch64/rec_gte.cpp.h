@@ -0,0 +1,150 @@
+/******************************************************************************
+ * IMPORTANT: The following host registers have unique usage restrictions.    *
+ *            See notes in a64_codegen.h for full details.                    *
+ *  A64REG_ZR, BRANCH_REG                                                     *
+ *****************************************************************************/
+
+/* GTE opcodes and register transfers call into the C GTE core. Only CFC2 is
+ *  emitted inline, as it needs no conversion.
+ */
+
+/* Emit code to call a GTE func that takes no arguments */
+#define CP2_FUNC_0(f) \
+extern void gte##f(); \
+void rec##f() \
+{ \
+	CALL(gte##f); \
+}
+
+/* Emit code to call a GTE func that takes one argument, which is the 32-bit
+ *  opcode shifted right 10, from which it gets various parameters.
+ */
+#define CP2_FUNC_1(f) \
+extern void gte##f(u32 gteop); \
+void rec##f() \
+{ \
+	LI32(A64REG_X0, (rec_code >> 10)); \
+	CALL(gte##f); \
+}
+
+CP2_FUNC_0(RTPS)
+CP2_FUNC_0(NCLIP)
+CP2_FUNC_0(NCDS)
+CP2_FUNC_0(NCDT)
+CP2_FUNC_0(CDP)
+CP2_FUNC_0(NCCS)
+CP2_FUNC_0(CC)
+CP2_FUNC_0(NCS)
+CP2_FUNC_0(NCT)
+CP2_FUNC_0(DPCT)
+CP2_FUNC_0(AVSZ3)
+CP2_FUNC_0(AVSZ4)
+CP2_FUNC_0(RTPT)
+CP2_FUNC_0(NCCT)
+CP2_FUNC_1(OP)
+CP2_FUNC_1(DPCS)
+CP2_FUNC_1(INTPL)
+CP2_FUNC_1(MVMVA)
+CP2_FUNC_1(SQR)
+CP2_FUNC_1(DCPL)
+CP2_FUNC_1(GPF)
+CP2_FUNC_1(GPL)
+
+static void recCFC2()
+{
+	if (!_Rt_) return;
+
+	SetUndef(_Rt_);
+	u32 rt = regMipsToHost(_Rt_, REG_FIND, REG_REGISTER);
+
+	LDR_W(rt, PERM_REG_1, offCP2C(_Rd_));
+	regMipsChanged(_Rt_);
+	regUnlock(rt);
+}
+
+static void recCTC2()
+{
+	u32 rt = regMipsToHost(_Rt_, REG_LOAD, REG_REGISTER);
+
+	MOV(A64REG_X0, rt);
+	LI32(A64REG_X1, _Rd_);
+	CALL(gtecalcCTC2);
+
+	regUnlock(rt);
+}
+
+static void recMFC2()
+{
+	if (!_Rt_) return;
+
+	// XXX - Fix for 'Front Mission 3' random crashes in battles:
+	//  MFC2 has a 1-cycle load delay, and the game reads its dest reg in
+	//  the very next opcode, expecting the *old* value. Emit both opcodes
+	//  in reversed order. See same fix in MIPS recompiler.
+	const u32 next_code = OPCODE_AT(pc);
+	const int dt = psxTestLoadDelay(_Rt_, next_code);
+	if (!branch && (dt == 1 || dt == 2)) {
+		if (_fOp_(next_code) == 0 && (_fFunct_(next_code) & ~1) == 0x08) {
+			// JR/JALR: probably never encountered, just print a warning
+			printf("%s(): WARNING: Unhandled MFC2 load-delay abuse by branch at PC %08x\n", __func__, pc);
+		} else {
+			const u32 code_tmp = rec_code;
+			rec_code = next_code;
+			DISASM_PSX(pc);
+			pc += 4;
+			recBSC[rec_code>>26]();
+			rec_code = code_tmp;
+		}
+	}
+	// XXX - End of 'Front Mission 3' fix
+
+	SetUndef(_Rt_);
+	u32 rt = regMipsToHost(_Rt_, REG_FIND, REG_REGISTER);
+
+	LI32(A64REG_X0, _Rd_);
+	CALL(gtecalcMFC2);
+	MOV(rt, A64REG_X0);
+
+	regMipsChanged(_Rt_);
+	regUnlock(rt);
+}
+
+static void recMTC2()
+{
+	u32 rt = regMipsToHost(_Rt_, REG_LOAD, REG_REGISTER);
+
+	MOV(A64REG_X0, rt);
+	LI32(A64REG_X1, _Rd_);
+	CALL(gtecalcMTC2);
+
+	regUnlock(rt);
+}
+
+static void rec_LWC2(u32 addr, u32 reg)
+{
+	gtecalcMTC2(psxMemRead32(addr), reg);
+}
+
+static void rec_SWC2(u32 addr, u32 reg)
+{
+	psxMemWrite32(addr, gtecalcMFC2(reg));
+}
+
+static void emitLWC2_SWC2(void *func)
+{
+	u32 rs = regMipsToHost(_Rs_, REG_LOAD, REG_REGISTER);
+
+	if (IsConst(_Rs_))
+		LI32(TEMP_0, GetConst(_Rs_) + _Imm_);
+	else
+		emitEffectiveAddr(rs, _Imm_);
+
+	MOV(A64REG_X0, TEMP_0);
+	LI32(A64REG_X1, _Rt_);
+	CALL(func);
+
+	regUnlock(rs);
+}
+
+static void recLWC2() { emitLWC2_SWC2((void *)rec_LWC2); }
+static void recSWC2() { emitLWC2_SWC2((void *)rec_SWC2); }
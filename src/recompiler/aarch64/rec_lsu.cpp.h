@@ -0,0 +1,384 @@
+/******************************************************************************
+ * IMPORTANT: The following host registers have unique usage restrictions.    *
+ *            See notes in a64_codegen.h for full details.                    *
+ *  A64REG_ZR, BRANCH_REG                                                     *
+ *****************************************************************************/
+
+/* Loads/stores whose address is not known at compile-time check it at
+ *  runtime: RAM (and scratchpad, if PS1 mem is virtually mapped) is accessed
+ *  directly through PERM_REG_2, anything else goes through psxMemRead/Write.
+ *  Const addresses are resolved at compile-time.
+ *
+ *  Direct stores to RAM are followed by a code invalidation, which zeroes the
+ *  block ptr in recRAM[] for the word written (see recClear()). Indirect
+ *  stores get theirs from psxMemWrite*() itself.
+ */
+
+/* C helpers called from emitted code */
+
+static u32 rec_LWL(u32 addr, u32 rt)
+{
+	static const u32 LWL_MASK[4]  = { 0xffffff, 0xffff, 0xff, 0 };
+	static const u32 LWL_SHIFT[4] = { 24, 16, 8, 0 };
+	const u32 shift = addr & 3;
+	const u32 mem = psxMemRead32(addr & ~3);
+	return (rt & LWL_MASK[shift]) | (mem << LWL_SHIFT[shift]);
+}
+
+static u32 rec_LWR(u32 addr, u32 rt)
+{
+	static const u32 LWR_MASK[4]  = { 0, 0xff000000, 0xffff0000, 0xffffff00 };
+	static const u32 LWR_SHIFT[4] = { 0, 8, 16, 24 };
+	const u32 shift = addr & 3;
+	const u32 mem = psxMemRead32(addr & ~3);
+	return (rt & LWR_MASK[shift]) | (mem >> LWR_SHIFT[shift]);
+}
+
+static void rec_SWL(u32 addr, u32 rt)
+{
+	static const u32 SWL_MASK[4]  = { 0xffffff00, 0xffff0000, 0xff000000, 0 };
+	static const u32 SWL_SHIFT[4] = { 24, 16, 8, 0 };
+	const u32 shift = addr & 3;
+	const u32 mem = psxMemRead32(addr & ~3);
+	psxMemWrite32(addr & ~3, (rt >> SWL_SHIFT[shift]) | (mem & SWL_MASK[shift]));
+}
+
+static void rec_SWR(u32 addr, u32 rt)
+{
+	static const u32 SWR_MASK[4]  = { 0, 0xff, 0xffff, 0xffffff };
+	static const u32 SWR_SHIFT[4] = { 0, 8, 16, 24 };
+	const u32 shift = addr & 3;
+	const u32 mem = psxMemRead32(addr & ~3);
+	psxMemWrite32(addr & ~3, (rt << SWR_SHIFT[shift]) | (mem & SWR_MASK[shift]));
+}
+
+enum {
+	LSU_BYTE, LSU_HALF, LSU_WORD
+};
+
+/* Emit TEMP_0 = rs + (s32)imm */
+static void emitEffectiveAddr(u32 rs, s32 imm)
+{
+	if (imm >= 0 && imm < 0x1000) {
+		ADDI(TEMP_0, rs, imm);
+	} else if (imm < 0 && -imm < 0x1000) {
+		SUBI(TEMP_0, rs, -imm);
+	} else {
+		LI32(TEMP_0, imm);
+		ADD(TEMP_0, rs, TEMP_0);
+	}
+}
+
+/* With effective address in TEMP_0, emit check if it can be accessed
+ *  directly. If so, TEMP_1 is left holding its offset from PERM_REG_2.
+ *  Returns ptr to branch taken when it can't, to be fixed up by caller.
+ */
+static u32* emitDirectRangeCheck()
+{
+	u32 *backpatch;
+
+	UBFX(TEMP_1, TEMP_0, 0, 28);       // TEMP_1 = addr & 0x0fffffff
+
+	if (psx_mem_mapped) {
+		// RAM and its mirrors, then 1KB scratchpad at 0x1f80_0000
+		CMPI_LSL12(TEMP_1, 0x800);     // TEMP_1 < 0x0080_0000 ?
+		u32 *backpatch_ram = (u32 *)recMem;
+		BCOND(A64_LO, 0);
+		LI32(TEMP_2, 0x0f800000);
+		SUB(TEMP_2, TEMP_1, TEMP_2);
+		CMPI(TEMP_2, 0x400);
+		backpatch = (u32 *)recMem;
+		BCOND(A64_HS, 0);
+		fixup_branch(backpatch_ram);
+	} else {
+		// Only RAM and its mirrors
+		CMPI_LSL12(TEMP_1, 0x800);     // TEMP_1 < 0x0080_0000 ?
+		backpatch = (u32 *)recMem;
+		BCOND(A64_HS, 0);
+		UBFX(TEMP_1, TEMP_0, 0, 21);   // TEMP_1 = addr & 0x1fffff
+	}
+
+	return backpatch;
+}
+
+/* With effective address of a direct store in TEMP_0 and its offset in
+ *  TEMP_1, emit code invalidation if address is in RAM.
+ */
+static void emitDirectCodeInvalidation()
+{
+	if (!emit_code_invalidations)
+		return;
+
+	u32 *backpatch = 0;
+	if (psx_mem_mapped) {
+		// Skip scratchpad
+		CMPI_LSL12(TEMP_1, 0x800);
+		backpatch = (u32 *)recMem;
+		BCOND(A64_HS, 0);
+	}
+
+	UBFX(TEMP_1, TEMP_0, 2, 19);       // TEMP_1 = (addr & 0x1ffffc) / 4
+	LI64(TEMP_2, (uptr)recRAM);
+	STR_X_UXTW3(A64REG_ZR, TEMP_2, TEMP_1);
+
+	if (backpatch)
+		fixup_branch(backpatch);
+}
+
+/* Returns host address of const PS1 address 'addr' if it can be accessed
+ *  directly, otherwise 0.
+ */
+static uptr constAddrToHost(u32 addr)
+{
+	const u32 masked = addr & 0x0fffffff;
+
+	if (masked < 0x00800000)
+		return (uptr)psxM + (addr & 0x1fffff);
+
+	if (masked >= 0x0f800000 && masked < 0x0f800400)
+		return (uptr)psxH + (addr & 0x3ff);
+
+	return 0;
+}
+
+static void emitDirectLoad(int width, bool sign, u32 rt, u32 base, u32 index)
+{
+	switch (width) {
+	case LSU_BYTE:
+		if (sign) LDRSB_UXTW(rt, base, index);
+		else      LDRB_UXTW(rt, base, index);
+		break;
+	case LSU_HALF:
+		if (sign) LDRSH_UXTW(rt, base, index);
+		else      LDRH_UXTW(rt, base, index);
+		break;
+	default:
+		LDR_W_UXTW(rt, base, index);
+		break;
+	}
+}
+
+static void emitDirectStore(int width, u32 rt, u32 base, u32 index)
+{
+	switch (width) {
+	case LSU_BYTE: STRB_UXTW(rt, base, index); break;
+	case LSU_HALF: STRH_UXTW(rt, base, index); break;
+	default:       STR_W_UXTW(rt, base, index); break;
+	}
+}
+
+/* Call psxMemRead*(), address in TEMP_0 */
+static void emitIndirectLoad(int width, bool sign, u32 rt)
+{
+	MOV(A64REG_X0, TEMP_0);
+
+	switch (width) {
+	case LSU_BYTE:
+		CALL(psxMemRead8);
+		if (sign) SXTB(rt, A64REG_X0);
+		else      UXTB(rt, A64REG_X0);
+		break;
+	case LSU_HALF:
+		CALL(psxMemRead16);
+		if (sign) SXTH(rt, A64REG_X0);
+		else      UXTH(rt, A64REG_X0);
+		break;
+	default:
+		CALL(psxMemRead32);
+		MOV(rt, A64REG_X0);
+		break;
+	}
+}
+
+/* Call psxMemWrite*(), address in TEMP_0 */
+static void emitIndirectStore(int width, u32 rt)
+{
+	MOV(A64REG_X1, rt);
+	MOV(A64REG_X0, TEMP_0);
+
+	switch (width) {
+	case LSU_BYTE: CALL(psxMemWrite8);  break;
+	case LSU_HALF: CALL(psxMemWrite16); break;
+	default:       CALL(psxMemWrite32); break;
+	}
+}
+
+static void emitLoad(int width, bool sign)
+{
+	const s32 imm = _Imm_;
+
+	// Loads to $zero are discarded. Reads from HW I/O ports with side
+	//  effects are not expected to target $zero.
+	if (!_Rt_)
+		return;
+
+	if (IsConst(_Rs_)) {
+		const u32 addr = GetConst(_Rs_) + imm;
+		const uptr host_addr = constAddrToHost(addr);
+
+		u32 rt = regMipsToHost(_Rt_, REG_FIND, REG_REGISTER);
+		SetUndef(_Rt_);
+
+		if (host_addr) {
+			LI64(TEMP_1, host_addr);
+			switch (width) {
+			case LSU_BYTE:
+				if (sign) LDRSB(rt, TEMP_1, 0);
+				else      LDRB(rt, TEMP_1, 0);
+				break;
+			case LSU_HALF:
+				if (sign) LDRSH(rt, TEMP_1, 0);
+				else      LDRH(rt, TEMP_1, 0);
+				break;
+			default:
+				LDR_W(rt, TEMP_1, 0);
+				break;
+			}
+		} else {
+			LI32(TEMP_0, addr);
+			emitIndirectLoad(width, sign, rt);
+		}
+
+		regMipsChanged(_Rt_);
+		regUnlock(rt);
+		return;
+	}
+
+	u32 rs = regMipsToHost(_Rs_, REG_LOAD, REG_REGISTER);
+	u32 rt = regMipsToHost(_Rt_, (_Rt_ == _Rs_) ? REG_LOAD : REG_FIND, REG_REGISTER);
+	SetUndef(_Rt_);
+
+	emitEffectiveAddr(rs, imm);
+
+#ifdef USE_DIRECT_MEM_ACCESS
+	u32 *backpatch_indirect = emitDirectRangeCheck();
+	emitDirectLoad(width, sign, rt, PERM_REG_2, TEMP_1);
+	u32 *backpatch_done = (u32 *)recMem;
+	B(0);
+	fixup_branch(backpatch_indirect);
+#endif
+
+	emitIndirectLoad(width, sign, rt);
+
+#ifdef USE_DIRECT_MEM_ACCESS
+	fixup_branch(backpatch_done);
+#endif
+
+	regMipsChanged(_Rt_);
+	regUnlock(rt);
+	regUnlock(rs);
+}
+
+static void emitStore(int width)
+{
+	const s32 imm = _Imm_;
+
+	u32 rt = regMipsToHost(_Rt_, REG_LOAD, REG_REGISTER);
+
+	if (IsConst(_Rs_)) {
+		const u32 addr = GetConst(_Rs_) + imm;
+		const uptr host_addr = constAddrToHost(addr);
+
+		if (host_addr) {
+			LI64(TEMP_1, host_addr);
+			switch (width) {
+			case LSU_BYTE: STRB(rt, TEMP_1, 0);  break;
+			case LSU_HALF: STRH(rt, TEMP_1, 0);  break;
+			default:       STR_W(rt, TEMP_1, 0); break;
+			}
+
+			if (emit_code_invalidations && (addr & 0x0fffffff) < 0x00800000) {
+				LI64(TEMP_1, (uptr)recRAM + ((addr & 0x1ffffc) / 4) * REC_RAM_PTR_SIZE);
+				STR_X(A64REG_ZR, TEMP_1, 0);
+			}
+		} else {
+			LI32(TEMP_0, addr);
+			emitIndirectStore(width, rt);
+		}
+
+		regUnlock(rt);
+		return;
+	}
+
+	u32 rs = regMipsToHost(_Rs_, REG_LOAD, REG_REGISTER);
+
+	emitEffectiveAddr(rs, imm);
+
+#ifdef USE_DIRECT_MEM_ACCESS
+	u32 *backpatch_indirect = emitDirectRangeCheck();
+	emitDirectStore(width, rt, PERM_REG_2, TEMP_1);
+	emitDirectCodeInvalidation();
+	u32 *backpatch_done = (u32 *)recMem;
+	B(0);
+	fixup_branch(backpatch_indirect);
+#endif
+
+	emitIndirectStore(width, rt);
+
+#ifdef USE_DIRECT_MEM_ACCESS
+	fixup_branch(backpatch_done);
+#endif
+
+	regUnlock(rs);
+	regUnlock(rt);
+}
+
+static void recLB()  { emitLoad(LSU_BYTE, true);  }
+static void recLBU() { emitLoad(LSU_BYTE, false); }
+static void recLH()  { emitLoad(LSU_HALF, true);  }
+static void recLHU() { emitLoad(LSU_HALF, false); }
+static void recLW()  { emitLoad(LSU_WORD, false); }
+
+static void recSB()  { emitStore(LSU_BYTE); }
+static void recSH()  { emitStore(LSU_HALF); }
+static void recSW()  { emitStore(LSU_WORD); }
+
+/* Unaligned loads/stores are done by C helpers: they are uncommon enough
+ *  that it's not worth emitting the merge code inline.
+ */
+static void emitUnalignedLoad(void *func)
+{
+	if (!_Rt_)
+		return;
+
+	u32 rs = regMipsToHost(_Rs_, REG_LOAD, REG_REGISTER);
+	u32 rt = regMipsToHost(_Rt_, REG_LOAD, REG_REGISTER);
+	SetUndef(_Rt_);
+
+	if (IsConst(_Rs_))
+		LI32(TEMP_0, GetConst(_Rs_) + _Imm_);
+	else
+		emitEffectiveAddr(rs, _Imm_);
+
+	MOV(A64REG_X1, rt);
+	MOV(A64REG_X0, TEMP_0);
+	CALL(func);
+	MOV(rt, A64REG_X0);
+
+	regMipsChanged(_Rt_);
+	regUnlock(rt);
+	regUnlock(rs);
+}
+
+static void emitUnalignedStore(void *func)
+{
+	u32 rs = regMipsToHost(_Rs_, REG_LOAD, REG_REGISTER);
+	u32 rt = regMipsToHost(_Rt_, REG_LOAD, REG_REGISTER);
+
+	if (IsConst(_Rs_))
+		LI32(TEMP_0, GetConst(_Rs_) + _Imm_);
+	else
+		emitEffectiveAddr(rs, _Imm_);
+
+	MOV(A64REG_X1, rt);
+	MOV(A64REG_X0, TEMP_0);
+	CALL(func);
+
+	regUnlock(rt);
+	regUnlock(rs);
+}
+
+static void recLWL() { emitUnalignedLoad((void *)rec_LWL); }
+static void recLWR() { emitUnalignedLoad((void *)rec_LWR); }
+static void recSWL() { emitUnalignedStore((void *)rec_SWL); }
+static void recSWR() { emitUnalignedStore((void *)rec_SWR); }
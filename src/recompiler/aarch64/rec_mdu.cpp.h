@@ -0,0 +1,191 @@
+/******************************************************************************
+ * IMPORTANT: The following host registers have unique usage restrictions.    *
+ *            See notes in a64_codegen.h for full details.                    *
+ *  A64REG_ZR, BRANCH_REG                                                     *
+ *****************************************************************************/
+
+/* LO/HI are not cached in host regs: they live in psxRegs.GPR.n.lo/hi.
+ *  Const-propagation still tracks them through PSXREG_LO/PSXREG_HI.
+ */
+
+/* Store known-const results to LO/HI */
+static void emitConstLoHi(u32 lo, u32 hi)
+{
+	LI32(TEMP_0, lo);
+	STR_W(TEMP_0, PERM_REG_1, offGPR(PSXREG_LO));
+	LI32(TEMP_0, hi);
+	STR_W(TEMP_0, PERM_REG_1, offGPR(PSXREG_HI));
+	SetConst(PSXREG_LO, lo);
+	SetConst(PSXREG_HI, hi);
+}
+
+static void recMULT()
+{
+	// LO/HI = (s64)rs * (s64)rt
+
+	if (IsConst(_Rs_) && IsConst(_Rt_)) {
+		const u64 res = (s64)(s32)GetConst(_Rs_) * (s64)(s32)GetConst(_Rt_);
+		emitConstLoHi((u32)res, (u32)(res >> 32));
+		return;
+	}
+
+	u32 rs = regMipsToHost(_Rs_, REG_LOAD, REG_REGISTER);
+	u32 rt = regMipsToHost(_Rt_, REG_LOAD, REG_REGISTER);
+
+	SMULL(TEMP_0, rs, rt);
+	STR_W(TEMP_0, PERM_REG_1, offGPR(PSXREG_LO));
+	LSR_X32(TEMP_0, TEMP_0);
+	STR_W(TEMP_0, PERM_REG_1, offGPR(PSXREG_HI));
+
+	SetUndef(PSXREG_LO);
+	SetUndef(PSXREG_HI);
+
+	regUnlock(rs);
+	regUnlock(rt);
+}
+
+static void recMULTU()
+{
+	// LO/HI = (u64)rs * (u64)rt
+
+	if (IsConst(_Rs_) && IsConst(_Rt_)) {
+		const u64 res = (u64)GetConst(_Rs_) * (u64)GetConst(_Rt_);
+		emitConstLoHi((u32)res, (u32)(res >> 32));
+		return;
+	}
+
+	u32 rs = regMipsToHost(_Rs_, REG_LOAD, REG_REGISTER);
+	u32 rt = regMipsToHost(_Rt_, REG_LOAD, REG_REGISTER);
+
+	UMULL(TEMP_0, rs, rt);
+	STR_W(TEMP_0, PERM_REG_1, offGPR(PSXREG_LO));
+	LSR_X32(TEMP_0, TEMP_0);
+	STR_W(TEMP_0, PERM_REG_1, offGPR(PSXREG_HI));
+
+	SetUndef(PSXREG_LO);
+	SetUndef(PSXREG_HI);
+
+	regUnlock(rs);
+	regUnlock(rt);
+}
+
+static void recDIV()
+{
+	// LO = (s32)rs / (s32)rt
+	// HI = (s32)rs % (s32)rt
+	//  PS1 results for division by zero: LO = (rs >= 0) ? -1 : 1, HI = rs
+	//  PS1 results for 0x80000000 / -1:  LO = 0x80000000, HI = 0
+
+	if (IsConst(_Rs_) && IsConst(_Rt_)) {
+		const s32 a = GetConst(_Rs_), b = GetConst(_Rt_);
+		u32 lo, hi;
+		if (b == 0) {
+			lo = (a >= 0) ? 0xffffffff : 1;
+			hi = a;
+		} else if ((u32)a == 0x80000000 && b == -1) {
+			lo = 0x80000000;
+			hi = 0;
+		} else {
+			lo = a / b;
+			hi = a % b;
+		}
+		emitConstLoHi(lo, hi);
+		return;
+	}
+
+	u32 rs = regMipsToHost(_Rs_, REG_LOAD, REG_REGISTER);
+	u32 rt = regMipsToHost(_Rt_, REG_LOAD, REG_REGISTER);
+
+	// SDIV gives 0 for division by zero and 0x80000000 for 0x80000000 / -1.
+	//  The remainder computed with MSUB is then 'rs' and 0, like a PS1.
+	SDIV(TEMP_0, rs, rt);
+	MSUB(TEMP_1, TEMP_0, rt, rs);  // TEMP_1 = rs - (TEMP_0 * rt)
+
+	u32 *backpatch = (u32 *)recMem;
+	CBNZ(rt, 0);
+	ASR(TEMP_0, rs, 31);           // TEMP_0 = (rs >= 0) ? 0 : -1
+	MVN(TEMP_0, TEMP_0);           // TEMP_0 = (rs >= 0) ? -1 : 0
+	ORRI(TEMP_0, TEMP_0, 1);       // TEMP_0 = (rs >= 0) ? -1 : 1
+	fixup_branch(backpatch);
+
+	STR_W(TEMP_0, PERM_REG_1, offGPR(PSXREG_LO));
+	STR_W(TEMP_1, PERM_REG_1, offGPR(PSXREG_HI));
+
+	SetUndef(PSXREG_LO);
+	SetUndef(PSXREG_HI);
+
+	regUnlock(rs);
+	regUnlock(rt);
+}
+
+static void recDIVU()
+{
+	// LO = (u32)rs / (u32)rt
+	// HI = (u32)rs % (u32)rt
+	//  PS1 results for division by zero: LO = 0xffffffff, HI = rs
+
+	if (IsConst(_Rs_) && IsConst(_Rt_)) {
+		const u32 a = GetConst(_Rs_), b = GetConst(_Rt_);
+		if (b == 0)
+			emitConstLoHi(0xffffffff, a);
+		else
+			emitConstLoHi(a / b, a % b);
+		return;
+	}
+
+	u32 rs = regMipsToHost(_Rs_, REG_LOAD, REG_REGISTER);
+	u32 rt = regMipsToHost(_Rt_, REG_LOAD, REG_REGISTER);
+
+	UDIV(TEMP_0, rs, rt);
+	MSUB(TEMP_1, TEMP_0, rt, rs);  // TEMP_1 = rs - (TEMP_0 * rt)
+
+	u32 *backpatch = (u32 *)recMem;
+	CBNZ(rt, 0);
+	MOVN(TEMP_0, 0, 0);            // TEMP_0 = 0xffffffff
+	fixup_branch(backpatch);
+
+	STR_W(TEMP_0, PERM_REG_1, offGPR(PSXREG_LO));
+	STR_W(TEMP_1, PERM_REG_1, offGPR(PSXREG_HI));
+
+	SetUndef(PSXREG_LO);
+	SetUndef(PSXREG_HI);
+
+	regUnlock(rs);
+	regUnlock(rt);
+}
+
+/* Emit MFLO/MFHI: rd = LO/HI */
+static void emitMFxx(u32 psxreg)
+{
+	if (!_Rd_)
+		return;
+
+	if (IsConst(psxreg)) {
+		emitConstResult(_Rd_, GetConst(psxreg));
+		return;
+	}
+
+	u32 rd = regMipsToHost(_Rd_, REG_FIND, REG_REGISTER);
+	LDR_W(rd, PERM_REG_1, offGPR(psxreg));
+	SetUndef(_Rd_);
+	regMipsChanged(_Rd_);
+	regUnlock(rd);
+}
+
+/* Emit MTLO/MTHI: LO/HI = rs */
+static void emitMTxx(u32 psxreg)
+{
+	u32 rs = regMipsToHost(_Rs_, REG_LOAD, REG_REGISTER);
+	STR_W(rs, PERM_REG_1, offGPR(psxreg));
+	regUnlock(rs);
+
+	if (IsConst(_Rs_))
+		SetConst(psxreg, GetConst(_Rs_));
+	else
+		SetUndef(psxreg);
+}
+
+static void recMFLO() { emitMFxx(PSXREG_LO); }
+static void recMFHI() { emitMFxx(PSXREG_HI); }
+static void recMTLO() { emitMTxx(PSXREG_LO); }
+static void recMTHI() { emitMTxx(PSXREG_HI); }
@@ -0,0 +1,515 @@
+/*
+ * Mips-to-AArch64 recompiler for pcsx4all
+ *
+ * Copyright (c) 2009 Ulrich Hecht
+ * Copyright (c) 2017 modified by Dmitry Smagin, Daniel Silsby
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/* This backend follows the structure of the MIPS recompiler in
+ *  ../mips: same reg cache, const propagation and virtual memory mapping
+ *  (mem_mapping.cpp is shared). See readme.txt for what's not done yet.
+ */
+
+#include <stddef.h>
+#include <sys/mman.h>
+#include "plugin_lib.h"
+#include "psxcommon.h"
+#include "psxhle.h"
+#include "psxmem.h"
+#include "psxhw.h"
+#include "r3000a.h"
+#include "gte.h"
+
+/* Standard console logging */
+#define REC_LOG(...) printf("a64rec: " __VA_ARGS__)
+#ifndef REC_LOG
+#define REC_LOG(...)
+#endif
+
+/* Verbose console logging (uncomment next line to enable) */
+//#define REC_LOG_V REC_LOG
+#ifndef REC_LOG_V
+#define REC_LOG_V(...)
+#endif
+
+/* Generate inline memory access or call psxMemRead/Write C functions */
+#define USE_DIRECT_MEM_ACCESS
+
+/* Virtual memory mapping options: */
+#if defined(SHMEM_MIRRORING) || defined(TMPFS_MIRRORING)
+	/* 2MB of PSX RAM (psxM) is mapped+mirrored virtually, much like
+	 *  a real PS1. We also map 0x1fxx_xxxx regions (psxP,psxH) into this
+	 *  space, inlining scratchpad accesses. See psxmem_mapping.cpp
+	 *
+	 * IMPORTANT: Don't enable if 'USE_DIRECT_MEM_ACCESS' isn't also enabled.
+	 */
+	#ifdef USE_DIRECT_MEM_ACCESS
+		#define USE_VIRTUAL_PSXMEM_MAPPING
+	#else
+		#warning "USE_DIRECT_MEM_ACCESS is undefined! Dynarec will emit slower C memory accesses."
+	#endif
+
+	/* Prefer virtually mapped/mirrored code block pointer array */
+	#define USE_VIRTUAL_RECRAM_MAPPING
+
+#else
+	#warning "Neither SHMEM_MIRRORING nor TMPFS_MIRRORING are defined! Dynarec will emit slower memory accesses. Check your Makefile!"
+#endif // defined(SHMEM_MIRRORING) || defined(TMPFS_MIRRORING)
+
+#include "../mips/mem_mapping.h"
+
+/* Bit vector indicating which PS1 RAM pages contain the start of blocks.
+ *  Used to determine when code invalidation in recClear() can be skipped.
+ */
+static u8 code_pages[0x200000/4096/8];
+
+/* Pointers to the recompiled blocks go here. psxRecLUT[] uses upper 16 bits of
+ *  a PC value as an index to lookup a block pointer stored in recRAM/recROM.
+ */
+static s8 *recRAM;
+static s8 *recROM;
+static uptr psxRecLUT[0x10000];
+
+#undef PC_REC
+#undef PC_REC8
+#undef PC_REC16
+#undef PC_REC32
+#define PC_REC(x)	((uptr)psxRecLUT[(x) >> 16] + (((x) & 0xffff) * (REC_RAM_PTR_SIZE / 4)))
+#define PC_RECPTR(x)	(*(uptr*)PC_REC(x))
+
+/* Const-propagation data and functions */
+typedef struct {
+	u32  constval;
+	bool is_const;
+} iRegisters;
+
+/* MDU regs LO/HI are tracked after the 32 GPRs, matching offGPR(32),offGPR(33) */
+#define PSXREG_LO 32
+#define PSXREG_HI 33
+static iRegisters iRegs[34];
+static inline void ResetConsts()
+{
+	memset(&iRegs, 0, sizeof(iRegs));
+	iRegs[0].is_const = true;  // $r0 is always zero val
+}
+static inline bool IsConst(const u32 reg)  { return iRegs[reg].is_const; }
+static inline u32  GetConst(const u32 reg) { return iRegs[reg].constval; }
+static inline void SetUndef(const u32 reg)
+{
+	if (reg)
+		iRegs[reg].is_const = false;
+}
+static inline void SetConst(const u32 reg, const u32 val)
+{
+	if (reg) {
+		iRegs[reg].constval = val;
+		iRegs[reg].is_const = true;
+	}
+}
+
+
+/* Code cache buffer
+ *  Keep this statically allocated! This keeps it close to the .text section,
+ *  so emitted code can reach C functions with a single BL (+-128MB).
+ *  It is made executable in recInit().
+ */
+#define RECMEM_SIZE         (12 * 1024 * 1024)
+#define RECMEM_SIZE_MAX     (RECMEM_SIZE-(512*1024))
+static u8 recMemBase[RECMEM_SIZE] __attribute__((aligned(4096)));
+
+u32        *recMem;                /* Where does next emitted opcode in block go? */
+static u32 *recMemStart;           /* Where did first emitted opcode in block go? */
+static u32 pc;                     /* Recompiler pc */
+static u32 oldpc;                  /* Recompiler pc at start of block */
+u32 cycle_multiplier = 0x200;      /* Cycle advance per emulated instruction
+                                      Default is 0x200 == 2.00 (24.8 fixed-pt) */
+
+static bool psx_mem_mapped;                /* PS1 RAM mmap'd+mirrored at fixed address? (psxM) */
+static bool rec_mem_mapped;                /* Code ptr arrays mmap'd+mirrored at fixed address? (recRAM,recROM) */
+
+/* Opcode being recompiled. Emitters decode it through the _Rs_,_Rt_,etc.
+ *  macros, which r3000a.h defines in terms of psxRegs.code. That belongs to
+ *  the interpreter, which is also called at runtime from recompiled code, so
+ *  the macros are redefined here to decode the recompiler's own copy.
+ */
+static u32 rec_code;
+#undef _Op_
+#undef _Funct_
+#undef _Rd_
+#undef _Rt_
+#undef _Rs_
+#undef _Sa_
+#undef _Im_
+#undef _Target_
+#undef _Imm_
+#undef _ImmU_
+#define _Op_     _fOp_(rec_code)
+#define _Funct_  _fFunct_(rec_code)
+#define _Rd_     _fRd_(rec_code)
+#define _Rt_     _fRt_(rec_code)
+#define _Rs_     _fRs_(rec_code)
+#define _Sa_     _fSa_(rec_code)
+#define _Im_     _fIm_(rec_code)
+#define _Target_ _fTarget_(rec_code)
+#define _Imm_    _fImm_(rec_code)
+#define _ImmU_   _fImmU_(rec_code)
+
+static bool branch;                        /* Current instruction lies in a BD slot? */
+static bool end_block;                     /* Has recompilation phase ended? */
+
+static bool emit_code_invalidations;       /* Emit code invalidation after stores? */
+static bool flush_code_on_dma3_exe_load;   /* Flush code cache when psxDma3() detects EXE load? */
+
+#define OPCODE_AT(loc) PSXMu32(loc)
+
+#define DISASM_PSX(_PC_)
+#define DISASM_MSG(...)
+
+#include "a64_codegen.h"
+#include "regcache.h"
+
+static void recReset();
+static void recRecompile();
+
+// Set once recExecute() has cleared code cache, cleared by recReset()
+static bool rec_execute_resume;
+static void recClear(u32 Addr, u32 Size);
+static void recNotify(int note, void *data);
+
+extern void (*recBSC[64])();
+extern void (*recSPC[64])();
+extern void (*recREG[32])();
+extern void (*recCP0[32])();
+extern void (*recCP2[64])();
+extern void (*recCP2BSC[32])();
+
+#include "opcodes.h"
+
+
+static inline void clear_insn_cache(void *start, void *end)
+{
+	__builtin___clear_cache((char *)start, (char *)end);
+}
+
+
+/* Set default recompilation options, and any per-game settings */
+static void rec_set_options()
+{
+	// Default options
+	emit_code_invalidations = true;
+	flush_code_on_dma3_exe_load = false;
+
+	// Per-game options
+	// -> Use case-insensitive comparisons! Some CDs have lowercase CdromId.
+
+	// 'Studio 33' game workarounds (other Studio 33 games seem to be OK)
+	//  See comments in recNotify(), psxDma3().
+	if (strncasecmp(CdromId, "SCES03886", 9) == 0  ||  // Formula 1 Arcade
+	    strncasecmp(CdromId, "SLUS00870", 9) == 0  ||  // Formula 1 '99  NTSC US
+	    strncasecmp(CdromId, "SCPS10101", 9) == 0  ||  // Formula 1 '99  NTSC J (untested)
+	    strncasecmp(CdromId, "SCES01979", 9) == 0  ||  // Formula 1 '99  PAL  E (requires .SBI subchannel file)
+	    strncasecmp(CdromId, "SLES01979", 9) == 0  ||  // Formula 1 '99  PAL  E (unknown revision, couldn't test)
+	    strncasecmp(CdromId, "SCES03404", 9) == 0  ||  // Formula 1 2001 PAL  E,Fi (fixes broken AI/controls)
+	    strncasecmp(CdromId, "SCES03423", 9) == 0)     // Formula 1 2001 PAL  Fr,G (fixes broken AI/controls)
+	{
+		REC_LOG("Using Icache workarounds for trouble games 'Formula One 99/2001/etc'.\n");
+		emit_code_invalidations = false;
+		flush_code_on_dma3_exe_load = true;
+	}
+}
+
+
+/* Discard all recompiled code */
+static void rec_flush_code_cache()
+{
+	memset(code_pages, 0, sizeof(code_pages));
+	memset(recRAM, 0, REC_RAM_SIZE);
+	memset(recROM, 0, REC_ROM_SIZE);
+
+	recMem = (u32*)recMemBase;
+
+	regReset();
+}
+
+
+static void recRecompile()
+{
+	// Notify plugin_lib that we're recompiling (affects frameskip timing)
+	pl_dynarec_notify();
+
+	if (((uptr)recMem - (uptr)recMemBase) >= RECMEM_SIZE_MAX ) {
+		REC_LOG("Code cache size limit exceeded: flushing code cache.\n");
+		rec_flush_code_cache();
+	}
+
+	recMemStart = recMem;
+
+	regReset();
+
+	oldpc = pc = psxRegs.pc;
+
+	rec_recompile_start();
+
+	// Reset const-propagation
+	ResetConsts();
+
+	// Flag indicates when recompilation should stop
+	end_block = false;
+
+	do {
+		// Flag indicates if next instruction lies in a BD slot
+		branch = false;
+
+		rec_code = OPCODE_AT(pc);
+		DISASM_PSX(pc);
+		pc += 4;
+
+		// Recompile next instruction.
+		recBSC[rec_code>>26]();
+		regUpdate();
+	} while (!end_block);
+
+	clear_insn_cache(recMemStart, recMem);
+
+	PC_RECPTR(oldpc) = (uptr)recMemStart;
+
+	// Mark the page of PS1 RAM this block starts in as containing code.
+	if ((oldpc & 0x0fffffff) < 0x00800000) {
+		u32 masked_pc = oldpc & 0x1fffff;
+		code_pages[masked_pc/4096/8] |= 1 << ((masked_pc/4096) & 7);
+	}
+}
+
+
+static int recInit()
+{
+	REC_LOG("Initializing\n");
+
+	// Code buffer lives in .bss, which isn't executable by default.
+	if (mprotect(recMemBase, RECMEM_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC) != 0) {
+		printf("Error making code buffer executable\n"); return -1;
+	}
+
+	recMem = (u32*)recMemBase;
+
+#ifdef USE_VIRTUAL_RECRAM_MAPPING
+	if (!rec_mem_mapped && !recRAM && !recROM) {
+		if (rec_mmap_rec_mem() >= 0) {
+			rec_mem_mapped = true;
+			recRAM = (s8*)REC_RAM_VADDR;
+			recROM = (s8*)REC_ROM_VADDR;
+		}
+	}
+#endif
+
+	if (!rec_mem_mapped) {
+		recRAM = (s8*)malloc(REC_RAM_SIZE);
+		recROM = (s8*)malloc(REC_ROM_SIZE);
+	}
+
+	if (recRAM == NULL || recROM == NULL) {
+		printf("Error allocating memory\n"); return -1;
+	}
+
+	recReset();
+
+	for (int i = 0; i < 0x80; i++)
+		psxRecLUT[i + 0x0000] = (uptr)recRAM + (((i & 0x1f) << 16) * (REC_RAM_PTR_SIZE/4));
+
+	memcpy(&psxRecLUT[0x8000], psxRecLUT, 0x80 * sizeof(psxRecLUT[0]));
+	memcpy(&psxRecLUT[0xa000], psxRecLUT, 0x80 * sizeof(psxRecLUT[0]));
+
+	for (int i = 0; i < 0x08; i++)
+		psxRecLUT[i + 0xbfc0] = (uptr)recROM + ((i << 16) * (REC_RAM_PTR_SIZE/4));
+
+	// Map/mirror PSX RAM, other regions, i.e. psxM, psxP, psxH, psxR at
+	//  PSX_MEM_VADDR (see psxmem_mapping.cpp)
+	// NOTE: if mapping fails or isn't enabled at compile-time, PSX mem will be
+	//       allocated using traditional methods in psxmem.cpp
+#ifdef USE_VIRTUAL_PSXMEM_MAPPING
+	if (!psx_mem_mapped)
+		psx_mem_mapped = (psxMemMapVirtual(true) >= 0);
+#endif
+
+	if (!psx_mem_mapped)
+		printf("WARNING: Recompiler is emitting slower non-virtual mem access code.\n");
+
+	return 0;
+}
+
+
+static void recShutdown()
+{
+	REC_LOG("Shutting down\n");
+
+	// NOTE: PSX mem mapping is released by psxMemShutdown()
+	if (rec_mem_mapped)
+		rec_munmap_rec_mem();
+	psx_mem_mapped = rec_mem_mapped = false;
+}
+
+
+/* Call block 'fn', then apply the new PC and cycle count it returns.
+ *  Blocks expect X19 to hold &psxRegs and X20 to hold psxM. They use
+ *  X19..X28 freely without saving them, so every callee-saved register is
+ *  listed as clobbered here: GCC saves them once in this function's frame.
+ *
+ * IMPORTANT: Functions containing inline ASM should have attribute 'noinline'.
+ */
+__attribute__((noinline)) static void recFunc(void *fn)
+{
+	register uptr x0 __asm__("x0") = (uptr)fn;
+	register uptr x1 __asm__("x1") = (uptr)&psxRegs;
+	register uptr x2 __asm__("x2") = (uptr)psxM;
+
+	__asm__ __volatile__ (
+		"mov    x19, x1     \n" // PERM_REG_1 = &psxRegs
+		"mov    x20, x2     \n" // PERM_REG_2 = psxM
+		"blr    x0          \n" // Execute block: returns W0 = PC, W1 = cycles
+		: "+r" (x0), "+r" (x1), "+r" (x2)
+		:
+		: "x3", "x4", "x5", "x6", "x7", "x8", "x9", "x10", "x11", "x12",
+		  "x13", "x14", "x15", "x16", "x17", "x18",
+		  "x19", "x20", "x21", "x22", "x23", "x24", "x25", "x26", "x27", "x28",
+		  "x30",
+		  "v0", "v1", "v2", "v3", "v4", "v5", "v6", "v7",
+		  "v16", "v17", "v18", "v19", "v20", "v21", "v22", "v23",
+		  "v24", "v25", "v26", "v27", "v28", "v29", "v30", "v31",
+		  "memory", "cc"
+	);
+
+	psxRegs.pc = (u32)x0;
+	psxRegs.cycle += (u32)x1;
+}
+
+
+/* Execute block at psxRegs.pc, recompiling it first if needed */
+static inline void recRunBlock()
+{
+	uptr *p = (uptr*)PC_REC(psxRegs.pc);
+	if (*p == 0)
+		recRecompile();
+
+	recFunc((void *)*p);
+
+	if (psxRegs.cycle >= psxRegs.io_cycle_counter)
+		psxBranchTest();
+}
+
+
+static void recExecute()
+{
+	// Clear code cache, which also clears out any now-dead code emitted
+	//  during BIOS startup. Non-dead BIOS code gets recompiled fresh.
+	//  Not done when resuming after psxRequestExit().
+	if (!rec_execute_resume) {
+		recReset();
+		rec_execute_resume = true;
+	}
+
+	while (!psxExitRequested)
+		recRunBlock();
+}
+
+
+/* Execute blocks until PC reaches 'target_pc'. Also called by HLE BIOS for
+ *  'softcalls' from within recompiled code, so it must be re-entrant.
+ */
+static void recExecuteBlock(unsigned target_pc)
+{
+	do {
+		recRunBlock();
+	} while (psxRegs.pc != target_pc);
+}
+
+
+/* Invalidate 'Size' code block pointers at word-aligned PS1 address 'Addr'. */
+static void recClear(u32 Addr, u32 Size)
+{
+	const u32 masked_ram_addr = Addr & 0x1ffffc;
+
+	// Check if the page(s) of PS1 RAM that 'Addr','Size' target contain the
+	//  start of any blocks. If not, invalidation would have no effect and is
+	//  skipped.
+	u32 page = masked_ram_addr/4096;
+	u32 end_page = ((masked_ram_addr + (Size-1)*4)/4096) + 1;
+	bool has_code = false;
+	do {
+		u32 pflag = 1 << (page & 7);  // Each byte in code_pages[] represents 8 pages
+		has_code = code_pages[page/8] & pflag;
+	} while ((++page != end_page) && !has_code);
+
+	if (has_code) {
+		void *dst = (void*)((uptr)recRAM + (masked_ram_addr * REC_RAM_PTR_SIZE/4));
+		memset(dst, 0, Size*REC_RAM_PTR_SIZE);
+	}
+}
+
+
+/* Notification from emulator. See MIPS recompiler for full details. */
+void recNotify(int note, void *data __attribute__((unused)))
+{
+	switch (note)
+	{
+		case R3000ACPU_NOTIFY_CACHE_ISOLATED:
+			REC_LOG_V("R3000ACPU_NOTIFY_CACHE_ISOLATED\n");
+			break;
+		case R3000ACPU_NOTIFY_CACHE_UNISOLATED:
+			/* Flush entire code cache, game has loaded new code */
+			recClear(0, 0x200000/4);
+			REC_LOG_V("R3000ACPU_NOTIFY_CACHE_UNISOLATED\n");
+			break;
+		case R3000ACPU_NOTIFY_DMA3_EXE_LOAD:
+			if (flush_code_on_dma3_exe_load) {
+				recClear(0, 0x200000/4);
+				REC_LOG_V("R3000ACPU_NOTIFY_DMA3_EXE_LOAD .. Flushing dynarec cache\n");
+			} else {
+				REC_LOG_V("R3000ACPU_NOTIFY_DMA3_EXE_LOAD\n");
+			}
+			break;
+		default:
+			break;
+	}
+}
+
+
+static void recReset()
+{
+	rec_execute_resume = false;
+	rec_flush_code_cache();
+
+	// Set default recompilation options and any per-game options
+	rec_set_options();
+}
+
+
+R3000Acpu psxRec =
+{
+	recInit,
+	recReset,
+	recExecute,
+	recExecuteBlock,
+	recClear,
+	recNotify,
+	recShutdown
+};
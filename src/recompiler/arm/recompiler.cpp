@@ -2995,7 +2995,7 @@ static void recRecompile() {
 }
 
 static void recExecute() {
-	for (;;)
+	while (!psxExitRequested)
 	{
 		u32 *p = (u32*)PC_REC(psxRegs.pc);
 		if (*p == 0) recRecompile();
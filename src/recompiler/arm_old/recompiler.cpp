@@ -466,7 +466,7 @@ static void recRecompile() {
 }
 
 static void recExecute() {
-	for (;;)
+	while (!psxExitRequested)
 	{
 		u32 *p = (u32*)PC_REC(psxRegs.pc);
 		if (*p == 0) recRecompile();
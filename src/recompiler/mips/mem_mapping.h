@@ -28,30 +28,12 @@
 #ifndef MEM_MAPPING_H
 #define MEM_MAPPING_H
 
-/* This is used for direct writes in mips recompiler, as well as mapping
- *  of PS1 PC values to block code ptrs (replaces use of psxRecLUT[]).
- */
-
-
+#include "psxmem.h"
 
-/* Lower 28 bits of this address should be zero! Offsets between 0 and
- * 0xF81_0000 from this address should be free for mapping. PSX RAM, ROM
- * expansion, and I/O regions are mapped into this virtual address region,
- * i.e. psxM,psxP,psxH
+/* This is used for mapping of PS1 PC values to block code ptrs (replaces
+ *  use of psxRecLUT[]). PS1 memory itself is mapped by psxMemMapVirtual(),
+ *  see PSX_MEM_VADDR in psxmem.h.
  */
-#ifdef MMAP_TO_ADDRESS_ZERO
-	// Allows address-conversion optimization.
-	#define PSX_MEM_VADDR 0ULL
-#else
-	// For development: null pointer dereferences will segfault as normal.
-	// Address conversions will need more instructions.
-	#define PSX_MEM_VADDR 0x10000000ULL
-#endif
-
-int rec_mmap_psx_mem();
-void rec_munmap_psx_mem();
-
-
 
 /* Lower 28 bits of this virtual address should be zero!
  * Recompiler's code ptr tables are mapped into this virtual address region,
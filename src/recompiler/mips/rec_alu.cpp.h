@@ -690,7 +690,7 @@ static void recSLLV()
 	REC_RTYPE_RD_RT_RS(SLLV, _Rd_, _Rt_, _Rs_);
 
 	if (set_const)
-		SetConst(_Rd_, GetConst(_Rt_) << GetConst(_Rs_));
+		SetConst(_Rd_, GetConst(_Rt_) << (GetConst(_Rs_) & 0x1f));
 }
 
 static void recSRLV()
@@ -702,7 +702,7 @@ static void recSRLV()
 	REC_RTYPE_RD_RT_RS(SRLV, _Rd_, _Rt_, _Rs_);
 
 	if (set_const)
-		SetConst(_Rd_, GetConst(_Rt_) >> GetConst(_Rs_));
+		SetConst(_Rd_, GetConst(_Rt_) >> (GetConst(_Rs_) & 0x1f));
 }
 
 static void recSRAV()
@@ -714,5 +714,5 @@ static void recSRAV()
 	REC_RTYPE_RD_RT_RS(SRAV, _Rd_, _Rt_, _Rs_);
 
 	if (set_const)
-		SetConst(_Rd_, (s32)GetConst(_Rt_) >> GetConst(_Rs_));
+		SetConst(_Rd_, (s32)GetConst(_Rt_) >> (GetConst(_Rs_) & 0x1f));
 }
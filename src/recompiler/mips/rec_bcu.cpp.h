@@ -249,11 +249,11 @@ static void recRevDelaySlot(u32 pc, u32 bpc)
 
 	branch = 1;
 
-	psxRegs.code = OPCODE_AT(bpc);
-	recBSC[psxRegs.code>>26]();
+	rec_code = OPCODE_AT(bpc);
+	recBSC[rec_code>>26]();
 
-	psxRegs.code = OPCODE_AT(pc);
-	recBSC[psxRegs.code>>26]();
+	rec_code = OPCODE_AT(pc);
+	recBSC[rec_code>>26]();
 
 	branch = 0;
 }
@@ -262,11 +262,11 @@ static void recRevDelaySlot(u32 pc, u32 bpc)
 static void recDelaySlot()
 {
 	branch = 1;
-	psxRegs.code = OPCODE_AT(pc);
+	rec_code = OPCODE_AT(pc);
 	DISASM_PSX(pc);
 	pc+=4;
 
-	recBSC[psxRegs.code>>26]();
+	recBSC[rec_code>>26]();
 	branch = 0;
 }
 
@@ -278,6 +278,9 @@ static void iJumpNormal(u32 bpc)
 
 	recDelaySlot();
 
+	const_carry_record_exit(bpc);
+	aot_record_exit(bpc);
+
 	// Can block use 'fastpath' return? (branches backward to its beginning)
 	const bool use_fastpath_return = rec_recompile_use_fastpath_return(bpc);
 
@@ -312,6 +315,10 @@ static void iJumpAL(u32 bpc, u32 nbpc)
 		recDelaySlot();
 	}
 
+	const_carry_record_exit(bpc);
+	aot_record_exit(bpc);
+	aot_record_exit(nbpc);  // Callee will likely return here
+
 	// Can block use 'fastpath' return? (branches backward to its beginning)
 	const bool use_fastpath_return = rec_recompile_use_fastpath_return(bpc);
 
@@ -330,7 +337,7 @@ static void iJumpAL(u32 bpc, u32 nbpc)
 /* Used for BLTZ, BGTZ, BLTZAL, BGEZAL, BLEZ, BGEZ */
 static void emitBxxZ(int andlink, u32 bpc, u32 nbpc)
 {
-	const u32 code = psxRegs.code;
+	const u32 code = rec_code;
 	const int dt = DelayTest(pc, bpc);
 
 #ifdef USE_CONST_BRANCH_OPTIMIZATIONS
@@ -427,8 +434,11 @@ static void emitBxxZ(int andlink, u32 bpc, u32 nbpc)
 		regMipsChanged(31);
 	}
 
-	if (dt == 3 || dt == 0)
+	if (dt == 3 || dt == 0) {
 		recDelaySlot();
+		const_carry_record_exit(bpc);
+	}
+	aot_record_exit(bpc);
 
 	u32* const backpatch = (u32 *)recMem;
 
@@ -497,7 +507,7 @@ static void emitBxxZ(int andlink, u32 bpc, u32 nbpc)
 /* Used for BEQ and BNE */
 static void emitBxx(u32 bpc)
 {
-	const u32 code = psxRegs.code;
+	const u32 code = rec_code;
 #ifdef LOG_BRANCHLOADDELAYS
 	const u32 dt = DelayTest(pc, bpc);
 #endif
@@ -571,6 +581,9 @@ static void emitBxx(u32 bpc)
 
 	recDelaySlot();
 
+	const_carry_record_exit(bpc);
+	aot_record_exit(bpc);
+
 	u32* const backpatch = (u32 *)recMem;
 
 	// Check opcode and emit branch with REVERSED logic!
@@ -690,20 +703,22 @@ static void recJAL()
 
 extern void (*psxBSC[64])(void);
 
-/* HACK: Execute load delay in branch delay via interpreter */
+/* HACK: Execute load delay in branch delay via interpreter
+ * NOTE: Called at runtime, and could run while a block is being compiled on
+ *       the AOT thread: don't touch any recompilation state here, and read
+ *       opcodes straight from PS1 memory, not through OPCODE_AT().
+ */
 static u32 execBranchLoadDelay(u32 pc, u32 bpc)
 {
-	const u32 code1 = OPCODE_AT(pc);
-	const u32 code2 = OPCODE_AT(bpc);
-
-	branch = 1;
+	const u32 code1 = PSXMu32(pc);
+	const u32 code2 = PSXMu32(bpc);
 
 #ifdef LOG_BRANCHLOADDELAYS
 	const int i = psxTestLoadDelay(_fRt_(code1), code2);
 	if (i == 1 || i == 2) {
 		char buffer[512];
 		printf("Case %d at %08x\n", i, pc);
-		const u32 jcode = OPCODE_AT(pc - 4);
+		const u32 jcode = PSXMu32(pc - 4);
 		disasm_mips_instruction(jcode, buffer, pc - 4, 0, 0);
 		printf("%08x: %s\n", pc - 4, buffer);
 		disasm_mips_instruction(code1, buffer, pc, 0, 0);
@@ -730,8 +745,6 @@ static u32 execBranchLoadDelay(u32 pc, u32 bpc)
 		break;
 	}
 
-	branch = 0;
-
 	return bpc;
 }
 
@@ -801,6 +814,8 @@ static void recJALR()
 	SetConst(_Rd_, pc + 4);
 	regMipsChanged(_Rd_);
 
+	aot_record_exit(pc + 4);  // Callee will likely return here
+
 	recDelaySlot();
 
 	// If new PC is unknown, cannot use 'fastpath' return
@@ -896,7 +911,7 @@ static void recHLE()
 	regClearJump();
 
 	LI32(TEMP_1, pc);
-	JAL(((u32)psxHLEt[psxRegs.code & 0x7]));
+	JAL(((u32)psxHLEt[rec_code & 0x7]));
 	SW(TEMP_1, PERM_REG_1, off(pc));        // <BD> BD slot of JAL() above
 
 	// If new PC is unknown, cannot use 'fastpath' return
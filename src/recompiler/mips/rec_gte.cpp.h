@@ -41,7 +41,7 @@ extern void gte##f(u32 gteop); \
 void rec##f() \
 { \
 	JAL(gte##f); \
-	LI16(MIPSREG_A0, (u16)(psxRegs.code >> 10)); /* <BD slot> */ \
+	LI16(MIPSREG_A0, (u16)(rec_code >> 10)); /* <BD slot> */ \
 }
 
 CP2_FUNC_0(RTPS)
@@ -293,13 +293,13 @@ static void recMFC2()
 			printf("%s(): WARNING: Unhandled MFC2 load-delay abuse by branch at PC %08x\n", __func__, pc);
 		} else {
 			// Emit the op *after* the MFC2 *before* emitting the MFC2 itself.
-			const u32 code_tmp = psxRegs.code;
-			psxRegs.code = OPCODE_AT(pc);
+			const u32 code_tmp = rec_code;
+			rec_code = OPCODE_AT(pc);
 			DISASM_PSX(pc);
 			DISASM_MSG("%s(): Applying MFC2 load-delay abuse fix at PC %08x\n", __func__, pc);
 			pc += 4;
-			recBSC[psxRegs.code>>26]();
-			psxRegs.code = code_tmp;
+			recBSC[rec_code>>26]();
+			rec_code = code_tmp;
 		}
 	}
 	// XXX - End of 'Front Mission 3' fix
@@ -330,7 +330,7 @@ static int count_LWC2_SWC2()
 	int count = 0;
 	u32 PC = pc;
 	u32 nops_at_end = 0;
-	u32 opcode = psxRegs.code;
+	u32 opcode = rec_code;
 	u32 rs = _Rs_;
 
 	/* If in delay slot, set count to 1 */
@@ -346,7 +346,7 @@ static int count_LWC2_SWC2()
 		else
 			nops_at_end = 0;
 
-		opcode = *(u32 *)((char *)PSXM(PC));
+		opcode = OPCODE_AT(PC);
 		PC += 4;
 		count++;
 	}
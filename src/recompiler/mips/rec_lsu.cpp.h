@@ -54,7 +54,7 @@
 // 2MB of PSX RAM (psxM) is now mirrored four times in virtual address
 //  space, like a real PS1. This allows skipping mirror-region boundary
 //  checks which special-cased loads/stores that crossed the boundary,
-//  the 'Einhander' game fix. See notes in mem_mapping.cpp.
+//  the 'Einhander' game fix. See notes in psxmem_mapping.cpp.
 #define SKIP_SAME_2MB_REGION_CHECK
 
 // Bypass 'writeok' cache-isolation check before stores. We now backup first
@@ -621,7 +621,7 @@ static void general_loads_stores(const int  count,
 
 			if (psx_mem_mapped)
 			{
-				// See comments in mem_mapping.cpp for full explanation.
+				// See comments in psxmem_mapping.cpp for full explanation.
 				//  PSX addresses between [0x0000_0000 .. 0x1f80_ffff] are
 				//  mapped virtually to PSX_MEM_VADDR location. The PS1's
 				//  four 2MB RAM mirror regions are mirrored virtually,
@@ -36,11 +36,70 @@
 
 static bool convertMultiplyTo3Op();
 
+/* Propagate constness of LO/HI results of a MULT/MULTU/DIV/DIVU. Results
+ *  depend only on the operand values, so this is called before emitting.
+ */
+static void mduPropagateConsts()
+{
+	const bool rs_const = IsConst(_Rs_);
+	const bool rt_const = IsConst(_Rt_);
+	const u32  rs_val = GetConst(_Rs_);
+	const u32  rt_val = GetConst(_Rt_);
+
+	SetUndef(PSXREG_LO);
+	SetUndef(PSXREG_HI);
+
+	switch (_Funct_) {
+	case 0x18: /* MULT */
+	case 0x19: /* MULTU */
+		if ((rs_const && !rs_val) || (rt_const && !rt_val)) {
+			SetConst(PSXREG_LO, 0);
+			SetConst(PSXREG_HI, 0);
+		} else if (rs_const && rt_const) {
+			u64 res;
+			if (_Funct_ == 0x18)
+				res = (u64)((s64)(s32)rs_val * (s64)(s32)rt_val);
+			else
+				res = (u64)rs_val * (u64)rt_val;
+			SetConst(PSXREG_LO, (u32)res);
+			SetConst(PSXREG_HI, (u32)(res >> 32));
+		}
+		break;
+	case 0x1a: /* DIV */
+		if (rs_const && rt_const) {
+			if (!rt_val) {
+				SetConst(PSXREG_LO, ((s32)rs_val >= 0) ? 0xffffffff : 1);
+				SetConst(PSXREG_HI, rs_val);
+			} else if (rs_val == 0x80000000 && rt_val == 0xffffffff) {
+				SetConst(PSXREG_LO, 0x80000000);
+				SetConst(PSXREG_HI, 0);
+			} else {
+				SetConst(PSXREG_LO, (s32)rs_val / (s32)rt_val);
+				SetConst(PSXREG_HI, (s32)rs_val % (s32)rt_val);
+			}
+		}
+		break;
+	case 0x1b: /* DIVU */
+		if (rs_const && rt_const) {
+			if (!rt_val) {
+				SetConst(PSXREG_LO, 0xffffffff);
+				SetConst(PSXREG_HI, rs_val);
+			} else {
+				SetConst(PSXREG_LO, rs_val / rt_val);
+				SetConst(PSXREG_HI, rs_val % rt_val);
+			}
+		}
+		break;
+	}
+}
+
 
 static void recMULT()
 {
 // Lo/Hi = Rs * Rt (signed)
 
+	mduPropagateConsts();
+
 #ifdef USE_CONST_MULT_OPTIMIZATIONS
 	// First, check if either or both operands are const values
 	bool rs_const = IsConst(_Rs_);
@@ -175,6 +234,8 @@ static void recMULTU()
 {
 // Lo/Hi = Rs * Rt (unsigned)
 
+	mduPropagateConsts();
+
 	// First, check if either or both operands are const values
 #ifdef USE_CONST_MULT_OPTIMIZATIONS
 	bool rs_const = IsConst(_Rs_);
@@ -289,6 +350,8 @@ static void recDIV()
 {
 // Hi, Lo = rs / rt signed
 
+	mduPropagateConsts();
+
 #ifdef USE_CONST_DIV_OPTIMIZATIONS
 	bool rs_const = IsConst(_Rs_);
 	bool rt_const = IsConst(_Rt_);
@@ -330,8 +393,9 @@ static void recDIV()
 			return;
 		} else if (rs_const) {
 			// If both operands are known-const, compute result statically
-			u32 lo_res = rs_val / rt_val;
-			u32 hi_res = rs_val % rt_val;
+			//  (mduPropagateConsts() already did, handling signed overflow)
+			u32 lo_res = GetConst(PSXREG_LO);
+			u32 hi_res = GetConst(PSXREG_HI);
 
 			if (lo_res) {
 				LI32(TEMP_1, lo_res);
@@ -459,6 +523,8 @@ static void recDIVU()
 {
 // Hi, Lo = rs / rt unsigned
 
+	mduPropagateConsts();
+
 	// First, check if divisor operand is const value
 #ifdef USE_CONST_DIV_OPTIMIZATIONS
 	bool rt_const = IsConst(_Rt_);
@@ -601,12 +667,20 @@ static void recMFHI()
 {
 // Rd = Hi
 	if (!_Rd_) return;
+	const bool set_const = IsConst(PSXREG_HI);
+	const u32  const_val = GetConst(PSXREG_HI);
 	SetUndef(_Rd_);
 	u32 rd = regMipsToHost(_Rd_, REG_FIND, REG_REGISTER);
 
-	LW(rd, PERM_REG_1, offGPR(33));
+	if (set_const)
+		LI32(rd, const_val);
+	else
+		LW(rd, PERM_REG_1, offGPR(33));
 	regMipsChanged(_Rd_);
 	regUnlock(rd);
+
+	if (set_const)
+		SetConst(_Rd_, const_val);
 }
 
 static void recMTHI()
@@ -615,6 +689,11 @@ static void recMTHI()
 	u32 rs = regMipsToHost(_Rs_, REG_LOAD, REG_REGISTER);
 	SW(rs, PERM_REG_1, offGPR(33));
 	regUnlock(rs);
+
+	if (IsConst(_Rs_))
+		SetConst(PSXREG_HI, GetConst(_Rs_));
+	else
+		SetUndef(PSXREG_HI);
 }
 
 
@@ -633,12 +712,20 @@ static void recMFLO()
 
 	if (!_Rd_) return;
 
+	const bool set_const = IsConst(PSXREG_LO);
+	const u32  const_val = GetConst(PSXREG_LO);
 	SetUndef(_Rd_);
 	u32 rd = regMipsToHost(_Rd_, REG_FIND, REG_REGISTER);
 
-	LW(rd, PERM_REG_1, offGPR(32));
+	if (set_const)
+		LI32(rd, const_val);
+	else
+		LW(rd, PERM_REG_1, offGPR(32));
 	regMipsChanged(_Rd_);
 	regUnlock(rd);
+
+	if (set_const)
+		SetConst(_Rd_, const_val);
 }
 
 
@@ -648,6 +735,11 @@ static void recMTLO()
 	u32 rs = regMipsToHost(_Rs_, REG_LOAD, REG_REGISTER);
 	SW(rs, PERM_REG_1, offGPR(32));
 	regUnlock(rs);
+
+	if (IsConst(_Rs_))
+		SetConst(PSXREG_LO, GetConst(_Rs_));
+	else
+		SetUndef(PSXREG_LO);
 }
 
 
@@ -77,6 +77,17 @@
 /* Const propagation is extended to optimize 'fuzzy' non-const addresses */
 #define USE_CONST_FUZZY_ADDRESSES
 
+/* Const propagation is carried across direct block transitions, guarded by
+ *  a check at block entry. See const_carry_emit_guard().
+ */
+#define USE_CONST_CARRY_ACROSS_BLOCKS
+
+/* Blocks that are likely to run soon (static branch/jump targets and JAL
+ *  return addresses of freshly compiled blocks) are compiled ahead of time
+ *  on a background thread. See section 'AOT compilation thread' below.
+ */
+#define USE_AOT_COMPILE_THREAD
+
 /* Generate inline memory access or call psxMemRead/Write C functions */
 #define USE_DIRECT_MEM_ACCESS
 
@@ -155,7 +166,11 @@ typedef struct {
 	bool is_fuzzy_scratchpad_addr; /* GPR is not known-const, but at least known
 	                                   to be address somewhere in 1KB scratcpad? */
 } iRegisters;
-static iRegisters iRegs[32];
+
+/* MDU regs LO/HI are tracked after the 32 GPRs, matching offGPR(32),offGPR(33) */
+#define PSXREG_LO 32
+#define PSXREG_HI 33
+static iRegisters iRegs[34];
 static inline void ResetConsts()
 {
 	memset(&iRegs, 0, sizeof(iRegs));
@@ -190,6 +205,7 @@ static inline void SetFuzzyScratchpadAddr(const u32 reg) { iRegs[reg].is_fuzzy_s
 static inline bool IsFuzzyScratchpadAddr(const u32 reg)  { return iRegs[reg].is_fuzzy_scratchpad_addr; }
 
 
+
 /* Code cache buffer
  *  Keep this statically allocated! This keeps it close to the
  *  .text section, so C code and recompiled code lie in the same 256MiB region.
@@ -216,6 +232,33 @@ static uptr block_fast_ret_addr;           /* Non-zero when blocks are using dir
 static bool psx_mem_mapped;                /* PS1 RAM mmap'd+mirrored at fixed address? (psxM) */
 static bool rec_mem_mapped;                /* Code ptr arrays mmap'd+mirrored at fixed address? (recRAM,recROM) */
 
+/* Opcode being recompiled. Emitters decode it through the _Rs_,_Rt_,etc.
+ *  macros, which r3000a.h defines in terms of psxRegs.code. That belongs to
+ *  the interpreter, which is also called at runtime from recompiled code, so
+ *  the macros are redefined here to decode the recompiler's own copy.
+ */
+static u32 rec_code;
+#undef _Op_
+#undef _Funct_
+#undef _Rd_
+#undef _Rt_
+#undef _Rs_
+#undef _Sa_
+#undef _Im_
+#undef _Target_
+#undef _Imm_
+#undef _ImmU_
+#define _Op_     _fOp_(rec_code)
+#define _Funct_  _fFunct_(rec_code)
+#define _Rd_     _fRd_(rec_code)
+#define _Rt_     _fRt_(rec_code)
+#define _Rs_     _fRs_(rec_code)
+#define _Sa_     _fSa_(rec_code)
+#define _Im_     _fIm_(rec_code)
+#define _Target_ _fTarget_(rec_code)
+#define _Imm_    _fImm_(rec_code)
+#define _ImmU_   _fImmU_(rec_code)
+
 /* Flags used during a recompilation phase */
 static bool branch;                        /* Current instruction lies in a BD slot? */
 static bool end_block;                     /* Has recompilation phase ended? */
@@ -238,6 +281,9 @@ char	disasm_buffer[512];
 
 static void recReset();
 static void recRecompile();
+
+// Set once recExecute() has cleared code cache, cleared by recReset()
+static bool rec_execute_resume;
 static void recClear(u32 Addr, u32 Size);
 static void recNotify(int note, void *data);
 
@@ -340,7 +386,7 @@ do { \
 
 #define DISASM_PSX(_PC_) \
 do { \
-	u32 opcode = *(u32 *)((char *)PSXM(_PC_)); \
+	u32 opcode = OPCODE_AT(_PC_); \
 	disasm_mips_instruction(opcode, disasm_buffer, _PC_, 0, 0); \
 	printf("%08x: %08x %s\n", _PC_, opcode, disasm_buffer); \
 } while (0)
@@ -372,6 +418,516 @@ do { \
 #endif
 
 
+static u32* rec_compile_block(const u32 start_pc);
+
+/* Make recompiled code at 'code' the block for PS1 address 'start_pc' */
+static void rec_publish_block(const u32 start_pc, u32 *code)
+{
+	PC_REC32(start_pc) = (u32)code;
+
+	// If 'start_pc' is in PS1 RAM, mark the page of RAM as containing the
+	//  start of a block. For the range check, bit 27 is interpreted as a sign bit.
+	if ((s32)(start_pc << 4) >= 0) {
+		u32 masked_pc = start_pc & 0x1fffff;
+		code_pages[masked_pc/4096/8] |= (1 << ((masked_pc/4096) & 7));
+	}
+}
+
+#ifdef USE_AOT_COMPILE_THREAD
+/* AOT compilation thread
+ *  Whenever a block is compiled, the static PCs it can exit to are queued as
+ * predictions. A background thread compiles them into the code cache, but
+ * does not touch their code block ptrs: finished blocks go onto a 'ready'
+ * list that only the main thread publishes, at the start of recRecompile().
+ * Code invalidation (recClear(), stores in emitted code) runs on the main
+ * thread and only ever zeroes block ptrs, so it never races a publish.
+ *  The worker compiles from a private snapshot of PS1 code. Opcodes read
+ * outside of it, i.e. at branch targets, are recorded too. A ready block is
+ * only published if PS1 memory still matches everything that was read while
+ * compiling it, so blocks whose code was overwritten in the meantime are
+ * dropped. Dropped blocks at the end of the code cache are reclaimed.
+ *  All recompilation state is shared, so compiling on either thread is done
+ * holding 'rec_mutex'. The worker runs at idle priority, so the main thread
+ * never waits for it to finish a block: it sets 'aot_cancel', and the worker
+ * abandons the block at the next opcode.
+ */
+#include <pthread.h>
+#include <sched.h>
+
+#define AOT_MAX_DEPTH      2     /* How many exits past an on-demand block to predict */
+#define AOT_PENDING_SIZE   64
+#define AOT_READY_SIZE     256
+#define AOT_SNAPSHOT_LEN   1024  /* Max # of PS1 opcodes a worker block can read */
+#define AOT_EXTRA_READS    16    /* Max # of opcodes read outside of snapshot */
+
+typedef struct {
+	u32  pc;
+	u32  depth;
+} AotPending;
+
+typedef struct {
+	u32  pc;
+	u32 *code;
+	u32 *end;
+	uptr ret_addr;                    /* Value of 'block_ret_addr' when compiled */
+	u32  len;                         /* # of snapshot opcodes read when compiled */
+	u32  hash;                        /* Hash of those opcodes */
+	u32  extra_cnt;                   /* Opcodes read outside of snapshot */
+	u32  extra_loc[AOT_EXTRA_READS];
+	u32  extra_op[AOT_EXTRA_READS];
+} AotReady;
+
+static pthread_mutex_t rec_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  aot_cond  = PTHREAD_COND_INITIALIZER;
+static pthread_t       aot_thread;
+static bool            aot_thread_running;
+static bool            aot_thread_quit;
+static volatile bool   aot_cancel;    /* Main thread is waiting for 'rec_mutex' */
+
+static AotPending aot_pending[AOT_PENDING_SIZE];  /* LIFO: newest predictions first */
+static int        aot_pending_cnt;
+static AotReady   aot_ready[AOT_READY_SIZE];
+static int        aot_ready_cnt;
+static u32        aot_depth;          /* Depth of block being compiled, 0 if on-demand */
+
+static bool aot_compiling;            /* Worker is compiling: opcodes come from snapshot */
+static u32  aot_snap_pc;
+static u32  aot_snap_len;
+static u32  aot_snap_used;
+static bool aot_snap_overrun;         /* Compile read too many opcodes outside snapshot? */
+static u32  aot_snap[AOT_SNAPSHOT_LEN];
+static u32  aot_extra_cnt;
+static u32  aot_extra_loc[AOT_EXTRA_READS];
+static u32  aot_extra_op[AOT_EXTRA_READS];
+
+/* Main thread only. The worker locks 'rec_mutex' directly. */
+static inline void rec_lock()
+{
+	if (pthread_mutex_trylock(&rec_mutex) != 0) {
+		aot_cancel = true;
+		pthread_mutex_lock(&rec_mutex);
+		aot_cancel = false;
+	}
+}
+static inline void rec_unlock() { pthread_mutex_unlock(&rec_mutex); }
+
+/* Opcode outside of snapshot, i.e. at a branch target: read live PS1 code,
+ *  remembering it so it can be verified before publishing the block.
+ */
+static u32 aot_extra_opcode_at(const u32 loc)
+{
+	for (u32 i = 0; i < aot_extra_cnt; ++i)
+		if (aot_extra_loc[i] == loc)
+			return aot_extra_op[i];
+
+	const u32 opcode = PSXMu32(loc);
+	if (aot_extra_cnt == AOT_EXTRA_READS) {
+		aot_snap_overrun = true;
+		return opcode;
+	}
+	aot_extra_loc[aot_extra_cnt] = loc;
+	aot_extra_op[aot_extra_cnt] = opcode;
+	++aot_extra_cnt;
+	return opcode;
+}
+
+static inline u32 rec_opcode_at(const u32 loc)
+{
+	if (!aot_compiling)
+		return PSXMu32(loc);
+
+	const u32 idx = (loc - aot_snap_pc) >> 2;
+	if (idx >= aot_snap_len)
+		return aot_extra_opcode_at(loc);
+	if (idx >= aot_snap_used)
+		aot_snap_used = idx + 1;
+	return aot_snap[idx];
+}
+#undef OPCODE_AT
+#define OPCODE_AT(loc) rec_opcode_at(loc)
+
+/* Hash 'len' PS1 opcodes at 'start_pc', or, if 'src' is non-NULL, from it */
+static u32 aot_hash(const u32 start_pc, const u32 *src, const u32 len)
+{
+	u32 hash = 2166136261u;
+	for (u32 i = 0; i < len; ++i)
+		hash = (hash ^ (src ? src[i] : PSXMu32(start_pc + i*4))) * 16777619u;
+	return hash;
+}
+
+/* Called by emitters when a block exits to a PC known at compile-time */
+static void aot_record_exit(const u32 target_pc)
+{
+	if (!aot_thread_running || aot_depth >= AOT_MAX_DEPTH)
+		return;
+	if (target_pc == oldpc || !psxRecLUT[target_pc >> 16] || PC_REC32(target_pc) != 0)
+		return;
+
+	for (int i = 0; i < aot_pending_cnt; ++i)
+		if (aot_pending[i].pc == target_pc)
+			return;
+	for (int i = 0; i < aot_ready_cnt; ++i)
+		if (aot_ready[i].pc == target_pc)
+			return;
+
+	// When full, oldest prediction is dropped
+	if (aot_pending_cnt == AOT_PENDING_SIZE) {
+		memmove(&aot_pending[0], &aot_pending[1], (AOT_PENDING_SIZE-1) * sizeof(aot_pending[0]));
+		--aot_pending_cnt;
+	}
+	aot_pending[aot_pending_cnt].pc = target_pc;
+	aot_pending[aot_pending_cnt].depth = aot_depth + 1;
+	++aot_pending_cnt;
+}
+
+/* Compile a predicted block on the worker thread. 'rec_mutex' must be held. */
+static void aot_compile_block(const AotPending &p)
+{
+	if (PC_REC32(p.pc) != 0 || ((uptr)recMem - (uptr)recMemBase) >= RECMEM_SIZE_MAX)
+		return;
+
+	// Snapshot PS1 code, stopping at the end of any mapped region
+	u32 len = 0;
+	while (len < AOT_SNAPSHOT_LEN) {
+		const u32 loc = p.pc + len*4;
+		if (!psxMemIsMapped(loc))
+			break;
+		aot_snap[len++] = PSXMu32(loc);
+	}
+	if (len == 0)
+		return;
+
+	aot_snap_pc = p.pc;
+	aot_snap_len = len;
+	aot_snap_used = 0;
+	aot_snap_overrun = false;
+	aot_extra_cnt = 0;
+	aot_depth = p.depth;
+	aot_compiling = true;
+
+	const uptr ret_addr = block_ret_addr;
+	u32 *code = rec_compile_block(p.pc);
+
+	aot_compiling = false;
+	aot_depth = 0;
+
+	if (code == NULL) {
+		// Cancelled by main thread: try again later
+		if (aot_pending_cnt < AOT_PENDING_SIZE)
+			aot_pending[aot_pending_cnt++] = p;
+		return;
+	}
+
+	// Overrun blocks read live PS1 code we can't verify. Block is the last
+	//  thing in the code cache, so its space is taken back right away.
+	if (aot_snap_overrun || aot_ready_cnt == AOT_READY_SIZE) {
+		recMem = code;
+		return;
+	}
+
+	AotReady *r = &aot_ready[aot_ready_cnt++];
+	r->pc = p.pc;
+	r->code = code;
+	r->end = recMem;
+	r->ret_addr = ret_addr;
+	r->len = aot_snap_used;
+	r->hash = aot_hash(p.pc, aot_snap, aot_snap_used);
+	r->extra_cnt = aot_extra_cnt;
+	memcpy(r->extra_loc, aot_extra_loc, aot_extra_cnt * sizeof(u32));
+	memcpy(r->extra_op, aot_extra_op, aot_extra_cnt * sizeof(u32));
+}
+
+static void* aot_thread_func(void *arg __attribute__((unused)))
+{
+	pthread_mutex_lock(&rec_mutex);
+	for (;;) {
+		while (!aot_thread_quit && aot_pending_cnt == 0)
+			pthread_cond_wait(&aot_cond, &rec_mutex);
+		if (aot_thread_quit)
+			break;
+
+		const AotPending p = aot_pending[--aot_pending_cnt];
+		aot_compile_block(p);
+
+		// Give main thread a chance at the lock between blocks
+		pthread_mutex_unlock(&rec_mutex);
+		sched_yield();
+		pthread_mutex_lock(&rec_mutex);
+	}
+	pthread_mutex_unlock(&rec_mutex);
+	return NULL;
+}
+
+/* Does PS1 memory still hold the code ready block 'r' was compiled from? */
+static bool aot_ready_valid(const AotReady *r)
+{
+	if (r->ret_addr != block_ret_addr || PC_REC32(r->pc) != 0 ||
+	    aot_hash(r->pc, NULL, r->len) != r->hash)
+		return false;
+	for (u32 i = 0; i < r->extra_cnt; ++i)
+		if (PSXMu32(r->extra_loc[i]) != r->extra_op[i])
+			return false;
+	return true;
+}
+
+/* Publish blocks the worker has finished. Main thread only, 'rec_mutex' held. */
+static void aot_publish_ready()
+{
+	// Ready blocks are the code cache's most recent contents, in compile
+	//  order. Dropped ones at its end are reclaimed, others stay unused
+	//  until next code cache flush.
+	bool reclaim = true;
+	for (int i = aot_ready_cnt-1; i >= 0; --i) {
+		const AotReady *r = &aot_ready[i];
+		if (aot_ready_valid(r)) {
+			rec_publish_block(r->pc, r->code);
+			reclaim = false;
+		} else if (reclaim && r->end == recMem) {
+			recMem = r->code;
+		}
+	}
+	aot_ready_cnt = 0;
+}
+
+static void aot_reset()
+{
+	aot_pending_cnt = 0;
+	aot_ready_cnt = 0;
+}
+
+static inline void aot_wake()
+{
+	if (aot_pending_cnt)
+		pthread_cond_signal(&aot_cond);
+}
+
+static void aot_thread_start()
+{
+	if (aot_thread_running)
+		return;
+
+	aot_thread_quit = false;
+	aot_thread_running = (pthread_create(&aot_thread, NULL, aot_thread_func, NULL) == 0);
+	if (!aot_thread_running) {
+		printf("WARNING: Recompiler couldn't start AOT compile thread.\n");
+		return;
+	}
+
+#ifdef SCHED_IDLE
+	// Worker should only soak up time the emulator leaves idle
+	struct sched_param param = { 0 };
+	pthread_setschedparam(aot_thread, SCHED_IDLE, &param);
+#endif
+}
+
+static void aot_thread_stop()
+{
+	if (!aot_thread_running)
+		return;
+
+	rec_lock();
+	aot_thread_quit = true;
+	pthread_cond_signal(&aot_cond);
+	rec_unlock();
+	pthread_join(aot_thread, NULL);
+	aot_thread_running = false;
+	aot_reset();
+}
+
+#else
+static inline void rec_lock() {}
+static inline void rec_unlock() {}
+static inline void aot_record_exit(const u32 target_pc) {}
+static inline void aot_publish_ready() {}
+static inline void aot_reset() {}
+static inline void aot_wake() {}
+static inline void aot_thread_start() {}
+static inline void aot_thread_stop() {}
+#endif // USE_AOT_COMPILE_THREAD
+
+
+#ifdef USE_CONST_CARRY_ACROSS_BLOCKS
+/* Cross-block const propagation data
+ *  When a block exits to a PC known at compile-time, its known-const GPRs are
+ * recorded here for that target PC. If more than one such predecessor is
+ * seen, only the values they agree on are kept. When the block at the target
+ * PC is compiled, recorded regs it uses as load/store base regs are assumed
+ * to hold their recorded values. A guard emitted at block entry verifies this:
+ * on a mismatch, the block clears its own code ptr, disables carrying consts
+ * to its PC, and returns to the dispatch loop to be recompiled normally.
+ */
+#define CONST_CARRY_TABLE_SIZE  2048  /* Must be a power of two */
+#define CONST_CARRY_MAX_REGS    4
+#define CONST_CARRY_SCAN_LEN    32    /* Max # of opcodes scanned for base-reg uses */
+
+typedef struct {
+	u32  pc;
+	u32  disabled;                    /* Written to by emitted guard code! */
+	bool in_use;
+	u8   num_regs;
+	u8   reg[CONST_CARRY_MAX_REGS];
+	u32  val[CONST_CARRY_MAX_REGS];
+} ConstCarryEntry;
+static ConstCarryEntry const_carry[CONST_CARRY_TABLE_SIZE];
+
+static u32  const_carry_guarded;      /* GPRs assumed const by current block's guard */
+static u32  const_carry_guarded_val[32];
+static bool const_carry_restart;      /* Current block contradicts its own guard? */
+
+static inline ConstCarryEntry* const_carry_lookup(const u32 target_pc)
+{
+	return &const_carry[(target_pc >> 2) & (CONST_CARRY_TABLE_SIZE-1)];
+}
+
+static inline void const_carry_reset()
+{
+	memset(const_carry, 0, sizeof(const_carry));
+}
+
+/* Record known-const GPRs at a block exit to 'target_pc' */
+static void const_carry_record_exit(const u32 target_pc)
+{
+	ConstCarryEntry *e = const_carry_lookup(target_pc);
+
+	if (target_pc == oldpc && const_carry_guarded) {
+		// Block branches back to its own top. If that path changes any of
+		//  the regs its guard assumed const, the guard would always fail on
+		//  the next iteration: recompile the block without carried consts.
+		for (int r = 1; r < 32; ++r) {
+			if ((const_carry_guarded & (1 << r)) &&
+			    (!IsConst(r) || GetConst(r) != const_carry_guarded_val[r]))
+				const_carry_restart = true;
+		}
+	}
+
+	if (!e->in_use || e->pc != target_pc) {
+		// New entry, or replacing one belonging to a different PC
+		e->in_use = true;
+		e->pc = target_pc;
+		e->disabled = 0;
+		e->num_regs = 0;
+
+		// Scan downwards: $gp,$sp,$fp,$s* regs are most likely to be base regs
+		for (int r = 31; r > 0 && e->num_regs < CONST_CARRY_MAX_REGS; --r) {
+			if (IsConst(r)) {
+				e->reg[e->num_regs] = r;
+				e->val[e->num_regs] = GetConst(r);
+				e->num_regs++;
+			}
+		}
+	} else if (!e->disabled) {
+		// Another predecessor: keep only the values both agree on
+		int n = 0;
+		for (int i = 0; i < e->num_regs; ++i) {
+			const u32 r = e->reg[i];
+			if (IsConst(r) && GetConst(r) == e->val[i]) {
+				e->reg[n] = r;
+				e->val[n] = e->val[i];
+				n++;
+			}
+		}
+		e->num_regs = n;
+	}
+}
+
+/* Emit guard code at block entry for carried consts, if any are worth using */
+static void const_carry_emit_guard()
+{
+	const_carry_guarded = 0;
+	const_carry_restart = false;
+
+	ConstCarryEntry *e = const_carry_lookup(pc);
+	if (!e->in_use || e->pc != pc || e->disabled || !e->num_regs)
+		return;
+
+	u32 carried = 0;
+	for (int i = 0; i < e->num_regs; ++i)
+		carried |= 1 << e->reg[i];
+
+	// Find carried regs used as load/store base regs before being written.
+	//  Stop at first opcode that isn't a simple ALU op or load/store.
+	u32 written = 0;
+	for (u32 scan_pc = pc; scan_pc < pc + CONST_CARRY_SCAN_LEN*4; scan_pc += 4) {
+		const u32 op = OPCODE_AT(scan_pc);
+		struct ALUOpInfo info;
+
+		if (opcodeIsLoad(op) || opcodeIsStore(op) ||
+		    _fOp_(op) == 0x32 || _fOp_(op) == 0x3a) { // LWC2,SWC2
+			const u32 base = 1 << _fRs_(op);
+			if ((carried & base) && !(written & base))
+				const_carry_guarded |= base;
+			if (opcodeIsLoad(op))
+				written |= 1 << _fRt_(op);
+		} else if (opcodeIsALU(op, &info)) {
+			written |= 1 << (info.writes_rt ? _fRt_(op) : _fRd_(op));
+		} else {
+			break;
+		}
+	}
+
+	if (!const_carry_guarded)
+		return;
+
+	DISASM_MSG(" ->CONST-CARRY GUARD: regs mask %08x\n", const_carry_guarded);
+
+	// TEMP_2 = OR of (reg ^ expected_val) for all guarded regs
+	bool first = true;
+	for (int i = 0; i < e->num_regs; ++i) {
+		const u32 r = e->reg[i];
+		if (!(const_carry_guarded & (1 << r)))
+			continue;
+
+		if (first) {
+			LW(TEMP_2, PERM_REG_1, offGPR(r));
+			LI32(TEMP_1, e->val[i]);
+			XOR(TEMP_2, TEMP_2, TEMP_1);
+			first = false;
+		} else {
+			LW(TEMP_0, PERM_REG_1, offGPR(r));
+			LI32(TEMP_1, e->val[i]);
+			XOR(TEMP_0, TEMP_0, TEMP_1);
+			OR(TEMP_2, TEMP_2, TEMP_0);
+		}
+	}
+
+	u32* const backpatch = (u32 *)recMem;
+	BEQZ(TEMP_2, 0);
+	NOP(); // <BD>
+
+	// Guard failed: clear this block's code ptr and disable carrying consts
+	//  to its PC, then return to dispatch loop, which will recompile it.
+	// NOTE: Nothing here alters cached $v0,$ra contents on the non-failing
+	//  path, so no caching flags are touched.
+	const uptr block_ptr_loc = PC_REC(pc);
+	LUI(TEMP_0, ADR_HI(block_ptr_loc));
+	SW(0, TEMP_0, ADR_LO(block_ptr_loc));
+	LUI(TEMP_0, ADR_HI(&e->disabled));
+	LI16(TEMP_1, 1);
+	SW(TEMP_1, TEMP_0, ADR_LO(&e->disabled));
+	LI32(MIPSREG_V0, pc);
+	if (block_ret_addr)
+		J(block_ret_addr);
+	else
+		JR(MIPSREG_RA); // $ra holds block return address at entry
+	LI16(MIPSREG_V1, 0); // <BD> No cycles have elapsed
+
+	fixup_branch(backpatch);
+
+	for (int i = 0; i < e->num_regs; ++i) {
+		const u32 r = e->reg[i];
+		if (const_carry_guarded & (1 << r)) {
+			const_carry_guarded_val[r] = e->val[i];
+			SetConst(r, e->val[i]);
+		}
+	}
+}
+#else
+static inline void const_carry_reset() {}
+static inline void const_carry_record_exit(const u32 target_pc) {}
+static inline void const_carry_emit_guard() {}
+#endif // USE_CONST_CARRY_ACROSS_BLOCKS
+
+
 #include "opcodes.h"
 
 #ifndef HAVE_MIPS32R2_CACHE_OPS
@@ -425,29 +981,61 @@ static void rec_set_options()
 }
 
 
+/* Discard all recompiled code. 'rec_mutex' must be held. */
+static void rec_flush_code_cache()
+{
+	memset(code_pages, 0, sizeof(code_pages));
+	const_carry_reset();
+	aot_reset();
+	memset(recRAM, 0, REC_RAM_SIZE);
+	memset(recROM, 0, REC_ROM_SIZE);
+
+	recMem = (u32*)recMemBase;
+
+	regReset();
+}
+
+
 static void recRecompile()
 {
 	// Notify plugin_lib that we're recompiling (affects frameskip timing)
 	pl_dynarec_notify();
 
+	rec_lock();
+
 	if (((uptr)recMem - (uptr)recMemBase) >= RECMEM_SIZE_MAX ) {
 		REC_LOG("Code cache size limit exceeded: flushing code cache.\n");
-		recReset();
+		rec_flush_code_cache();
 	}
 
+	// Block might already have been compiled ahead-of-time. Dispatch loops
+	//  re-read the block ptr after we return.
+	aot_publish_ready();
+
+	if (PC_REC32(psxRegs.pc) == 0) {
+		u32 *code = rec_compile_block(psxRegs.pc);
+		rec_publish_block(psxRegs.pc, code);
+	}
+
+	aot_wake();
+	rec_unlock();
+}
+
+
+/* Recompile block at PS1 address 'start_pc', returning its recompiled code.
+ *  The block ptr for 'start_pc' is left untouched: see rec_publish_block().
+ *  Returns NULL if the AOT worker's compile was cancelled.
+ */
+static u32* rec_compile_block(const u32 start_pc)
+{
 	recMemStart = recMem;
 
+#ifdef USE_CONST_CARRY_ACROSS_BLOCKS
+recompile_start:
+#endif
 	regReset();
 
-	PC_REC32(psxRegs.pc) = (u32)recMem;
-	oldpc = pc = psxRegs.pc;
-
-	// If 'pc' is in PS1 RAM, mark the page of RAM as containing the start of
-	//  a block. For the range check, bit 27 is interpreted as a sign bit.
-	if ((s32)(pc << 4) >= 0) {
-		u32 masked_pc = pc & 0x1fffff;
-		code_pages[masked_pc/4096/8] |= (1 << ((masked_pc/4096) & 7));
-	}
+	oldpc = pc = start_pc;
 
 	DISASM_INIT();
 
@@ -468,13 +1056,17 @@ static void recRecompile()
 	// Flag indicates when a PC value is cached in $v0. All dispatch loops set
 	//  $v0 to block start PC before entry. See rec_bcu.cpp.h
 	host_v0_reg_is_const = true;
-	host_v0_reg_constval = psxRegs.pc;
+	host_v0_reg_constval = start_pc;
 
 	// Flag indicates when $ra holds block return address. This is only used
 	//  by blocks returning indirectly. The indirect-return dispatch loops
 	//  set $ra before block entry. See rec_recompile_end_part1().
 	host_ra_reg_has_block_retaddr = (block_ret_addr == 0);
 
+	// Emit guard for any consts carried over from predecessor blocks. Must
+	//  come after $v0,$ra caching flags above are initialized.
+	const_carry_emit_guard();
+
 	// Number of discardable instructions we are currently skipping
 	int discard_cnt = 0;
 
@@ -482,7 +1074,15 @@ static void recRecompile()
 		// Flag indicates if next instruction lies in a BD slot
 		branch = false;
 
-		psxRegs.code = OPCODE_AT(pc);
+#ifdef USE_AOT_COMPILE_THREAD
+		// Main thread wants 'rec_mutex': abandon worker's block
+		if (aot_compiling && aot_cancel) {
+			recMem = recMemStart;
+			return NULL;
+		}
+#endif
+
+		rec_code = OPCODE_AT(pc);
 
 #ifdef USE_CODE_DISCARD
 		// If we are not already skipping past discardable code, scan
@@ -509,12 +1109,25 @@ static void recRecompile()
 #endif
 
 		// Recompile next instruction.
-		recBSC[psxRegs.code>>26]();
+		recBSC[rec_code>>26]();
 		regUpdate();
 	} while (!end_block);
 
+#ifdef USE_CONST_CARRY_ACROSS_BLOCKS
+	if (const_carry_restart) {
+		// Block branches back to its top with a guarded reg altered: the
+		//  guard would fail every time. Start over, carrying no consts.
+		DISASM_MSG(" ->CONST-CARRY GUARD CONTRADICTED: recompiling block\n");
+		const_carry_lookup(oldpc)->disabled = 1;
+		recMem = recMemStart;
+		goto recompile_start;
+	}
+#endif
+
 	DISASM_HOST();
 	clear_insn_cache(recMemStart, recMem, 0);
+
+	return recMemStart;
 }
 
 
@@ -575,17 +1188,20 @@ static int recInit()
 	for (int i = 0; i < 0x08; i++)
 		psxRecLUT[i + 0xbfc0] = (uptr)recROM + ((i << 16) * (REC_RAM_PTR_SIZE/4));
 
-	// Map/mirror PSX RAM, other regions, i.e. psxM, psxP, psxH
+	// Map/mirror PSX RAM, other regions, i.e. psxM, psxP, psxH, psxR at
+	//  PSX_MEM_VADDR (see psxmem_mapping.cpp)
 	// NOTE: if mapping fails or isn't enabled at compile-time, PSX mem will be
 	//       allocated using traditional methods in psxmem.cpp
 #ifdef USE_VIRTUAL_PSXMEM_MAPPING
 	if (!psx_mem_mapped)
-		psx_mem_mapped = (rec_mmap_psx_mem() >= 0);
+		psx_mem_mapped = (psxMemMapVirtual(true) >= 0);
 #endif
 
 	if (!psx_mem_mapped)
 		printf("WARNING: Recompiler is emitting slower non-virtual mem access code.\n");
 
+	aot_thread_start();
+
 	return 0;
 }
 
@@ -594,8 +1210,9 @@ static void recShutdown()
 {
 	REC_LOG("Shutting down\n");
 
-	if (psx_mem_mapped)
-		rec_munmap_psx_mem();
+	aot_thread_stop();
+
+	// NOTE: PSX mem mapping is released by psxMemShutdown()
 	if (rec_mem_mapped)
 		rec_munmap_rec_mem();
 	psx_mem_mapped = rec_mem_mapped = false;
@@ -672,7 +1289,7 @@ __attribute__((noinline)) void recExecute_indirect_return_lut()
 	block_ret_addr = block_fast_ret_addr = 0;
 
 #ifndef ASM_EXECUTE_LOOP
-	for (;;) {
+	while (!psxExitRequested) {
 		u32 *p = (u32*)PC_REC(psxRegs.pc);
 		if (*p == 0)
 			recRecompile();
@@ -782,6 +1399,10 @@ __asm__ __volatile__ (
 "lw    $v0, %[psxRegs_pc_off]($fp)            \n" // After psxBranchTest() returns, load psxRegs.pc
                                                   //  back into $v0, which could be different than
                                                   //  before the call if an exception was issued.
+"lui   $t0, %%hi(%[psxExitRequested])         \n" // Leave loop if psxRequestExit() was called.
+"lw    $t0, %%lo(%[psxExitRequested])($t0)    \n" //  psxRegs.pc and psxRegs.cycle are already
+"bnez  $t0, exit%=                            \n" //  up to date.
+"nop                                          \n" // <BD>
 "b     loop%=                                 \n" // Go back to top to process psxRegs.pc again..
 "move  $v1, $0                                \n" // <BD> ..using BD slot to set $v1 to 0, since
                                                   //  psxRegs.cycle shouldn't be incremented again.
@@ -796,13 +1417,7 @@ __asm__ __volatile__ (
 "lw    $t0, 0($t2)                            \n" // <BD> ..load $t0 with ptr to block code
 
 // Destroy stack frame, exiting inlined ASM block
-// NOTE: We'd never reach this point because the block dispatch loop is
-//  currently infinite. This could change in the future.
-// TODO: Could add a way to reset a game or load a new game from within
-//  the running emulator by setting a global boolean, resetting
-//  psxRegs.io_cycle_counter to 0, and checking if it's been set before
-//  calling pxsBranchTest() here. If set, you must jump here to
-//  exit the loop, to ensure that stack frame is adjusted before return!
+// NOTE: Reached after psxBranchTest() returns, if psxRequestExit() was called.
 "exit%=:                                      \n"
 "addiu $sp, $sp, frame_size                   \n"
 ".set pop                                     \n"
@@ -815,6 +1430,7 @@ __asm__ __volatile__ (
   [psxRegs_io_cycle_ctr_off]   "i" (off(io_cycle_counter)),
   [recRecompile]               "i" (&recRecompile),
   [psxBranchTest]              "i" (&psxBranchTest),
+  [psxExitRequested]           "i" (&psxExitRequested),
   [psxRecLUT]                  "i" (psxRecLUT)
 : // Clobber - No need to list anything but 'saved' regs
   "s0", "s1", "s2", "s3", "s4", "s5", "s6", "s7", "fp", "ra", "memory"
@@ -837,7 +1453,7 @@ __attribute__((noinline)) static void recExecute_indirect_return_mmap()
 	block_ret_addr = block_fast_ret_addr = 0;
 
 #ifndef ASM_EXECUTE_LOOP
-	for (;;) {
+	while (!psxExitRequested) {
 		u32 *p = (u32*)PC_REC(psxRegs.pc);
 		if (*p == 0)
 			recRecompile();
@@ -951,6 +1567,10 @@ __asm__ __volatile__ (
 "lw    $v0, %[psxRegs_pc_off]($fp)            \n" // After psxBranchTest() returns, load psxRegs.pc
                                                   //  back into $v0, which could be different than
                                                   //  before the call if an exception was issued.
+"lui   $t0, %%hi(%[psxExitRequested])         \n" // Leave loop if psxRequestExit() was called.
+"lw    $t0, %%lo(%[psxExitRequested])($t0)    \n" //  psxRegs.pc and psxRegs.cycle are already
+"bnez  $t0, exit%=                            \n" //  up to date.
+"nop                                          \n" // <BD>
 "b     loop%=                                 \n" // Go back to top to process psxRegs.pc again..
 "move  $v1, $0                                \n" // <BD> ..using BD slot to set $v1 to 0, since
                                                   //  psxRegs.cycle shouldn't be incremented again.
@@ -965,13 +1585,7 @@ __asm__ __volatile__ (
 "lw    $t0, 0($t2)                            \n" // <BD> ..load $t0 with ptr to block code
 
 // Destroy stack frame, exiting inlined ASM block
-// NOTE: We'd never reach this point because the block dispatch loop is
-//  currently infinite. This could change in the future.
-// TODO: Could add a way to reset a game or load a new game from within
-//  the running emulator by setting a global boolean, resetting
-//  psxRegs.io_cycle_counter to 0, and checking if it's been set before
-//  calling pxsBranchTest() here. If set, you must jump here to
-//  exit the loop, to ensure that stack frame is adjusted before return!
+// NOTE: Reached after psxBranchTest() returns, if psxRequestExit() was called.
 "exit%=:                                      \n"
 "addiu $sp, $sp, frame_size                   \n"
 ".set pop                                     \n"
@@ -984,6 +1598,7 @@ __asm__ __volatile__ (
   [psxRegs_io_cycle_ctr_off]   "i" (off(io_cycle_counter)),
   [recRecompile]               "i" (&recRecompile),
   [psxBranchTest]              "i" (&psxBranchTest),
+  [psxExitRequested]           "i" (&psxExitRequested),
   [REC_RAM_VADDR_UPPER]        "i" (REC_RAM_VADDR >> 16)
 : // Clobber - No need to list anything but 'saved' regs
   "s0", "s1", "s2", "s3", "s4", "s5", "s6", "s7", "fp", "ra", "memory"
@@ -1119,10 +1734,14 @@ __asm__ __volatile__ (
 "call_psxBranchTest%=:                        \n"
 "jal   %[psxBranchTest]                       \n"
 "sw    $v0, %[psxRegs_pc_off]($fp)            \n" // <BD> Store new psxRegs.pc val before calling C
-"branchtest_fastpath_retaddr%=:               \n" // Next 3 instructions shared with 'fastpath' code..
+"branchtest_fastpath_retaddr%=:               \n" // Following instructions shared with 'fastpath'..
 "lw    $v0, %[psxRegs_pc_off]($fp)            \n" // After psxBranchTest() returns, load psxRegs.pc
                                                   //  back into $v0, which could be different than
                                                   //  before the call if an exception was issued.
+"lui   $t0, %%hi(%[psxExitRequested])         \n" // Leave loop if psxRequestExit() was called.
+"lw    $t0, %%lo(%[psxExitRequested])($t0)    \n" //  psxRegs.pc and psxRegs.cycle are already
+"bnez  $t0, exit%=                            \n" //  up to date.
+"nop                                          \n" // <BD>
 "b     loop%=                                 \n" // Go back to top to process new psxRegs.pc value..
 "move  $v1, $0                                \n" // <BD> ..using BD slot to set $v1 to 0, since
                                                   //  psxRegs.cycle shouldn't be incremented again.
@@ -1182,13 +1801,7 @@ __asm__ __volatile__ (
 
 
 // Destroy stack frame, exiting inlined ASM block
-// NOTE: During block executions, we'd never reach this point because the block
-//  dispatch loop is currently infinite. This could change in the future.
-// TODO: Could add a way to reset a game or load a new game from within
-//  the running emulator by setting a global boolean, resetting
-//  psxRegs.io_cycle_counter to 0, and checking if it's been set before
-//  calling pxsBranchTest() here. If set, you must jump here to
-//  exit the loop, to ensure that stack frame is adjusted before return!
+// NOTE: Reached after psxBranchTest() returns, if psxRequestExit() was called.
 "exit%=:                                      \n"
 "addiu $sp, $sp, frame_size                   \n"
 ".set pop                                     \n"
@@ -1203,6 +1816,7 @@ __asm__ __volatile__ (
   [psxRegs_io_cycle_ctr_off]   "i" (off(io_cycle_counter)),
   [recRecompile]               "i" (&recRecompile),
   [psxBranchTest]              "i" (&psxBranchTest),
+  [psxExitRequested]           "i" (&psxExitRequested),
   [psxRecLUT]                  "i" (psxRecLUT)
 : // Clobber - No need to list anything but 'saved' regs
   "s0", "s1", "s2", "s3", "s4", "s5", "s6", "s7", "fp", "ra", "memory"
@@ -1341,10 +1955,14 @@ __asm__ __volatile__ (
 "call_psxBranchTest%=:                        \n"
 "jal   %[psxBranchTest]                       \n"
 "sw    $v0, %[psxRegs_pc_off]($fp)            \n" // <BD> Store new psxRegs.pc val before calling C
-"branchtest_fastpath_retaddr%=:               \n" // Next 3 instructions shared with 'fastpath' code..
+"branchtest_fastpath_retaddr%=:               \n" // Following instructions shared with 'fastpath'..
 "lw    $v0, %[psxRegs_pc_off]($fp)            \n" // After psxBranchTest() returns, load psxRegs.pc
                                                   //  back into $v0, which could be different than
                                                   //  before the call if an exception was issued.
+"lui   $t0, %%hi(%[psxExitRequested])         \n" // Leave loop if psxRequestExit() was called.
+"lw    $t0, %%lo(%[psxExitRequested])($t0)    \n" //  psxRegs.pc and psxRegs.cycle are already
+"bnez  $t0, exit%=                            \n" //  up to date.
+"nop                                          \n" // <BD>
 "b     loop%=                                 \n" // Go back to top to process new psxRegs.pc value..
 "move  $v1, $0                                \n" // <BD> ..using BD slot to set $v1 to 0, since
                                                   //  psxRegs.cycle shouldn't be incremented again.
@@ -1404,13 +2022,7 @@ __asm__ __volatile__ (
 
 
 // Destroy stack frame, exiting inlined ASM block
-// NOTE: During block executions, we'd never reach this point because the block
-//  dispatch loop is currently infinite. This could change in the future.
-// TODO: Could add a way to reset a game or load a new game from within
-//  the running emulator by setting a global boolean, resetting
-//  psxRegs.io_cycle_counter to 0, and checking if it's been set before
-//  calling pxsBranchTest() here. If set, you must jump here to
-//  exit the loop, to ensure that stack frame is adjusted before return!
+// NOTE: Reached after psxBranchTest() returns, if psxRequestExit() was called.
 "exit%=:                                      \n"
 "addiu $sp, $sp, frame_size                   \n"
 ".set pop                                     \n"
@@ -1425,6 +2037,7 @@ __asm__ __volatile__ (
   [psxRegs_io_cycle_ctr_off]   "i" (off(io_cycle_counter)),
   [recRecompile]               "i" (&recRecompile),
   [psxBranchTest]              "i" (&psxBranchTest),
+  [psxExitRequested]           "i" (&psxExitRequested),
   [REC_RAM_VADDR_UPPER]        "i" (REC_RAM_VADDR >> 16)
 : // Clobber - No need to list anything but 'saved' regs
   "s0", "s1", "s2", "s3", "s4", "s5", "s6", "s7", "fp", "ra", "memory"
@@ -1612,7 +2225,12 @@ static void recExecute()
 	// Clear code cache so that all emitted code from this point forward uses
 	//  the correct block-return method. This also clears out any now-dead code
 	//  emitted during BIOS startup. Non-dead BIOS code gets recompiled fresh.
-	recReset();
+	//  When resuming after psxRequestExit() made us return, code is kept:
+	//  the same dispatch loop is chosen again below.
+	if (!rec_execute_resume) {
+		recReset();
+		rec_execute_resume = true;
+	}
 
 	// By default, emit code that returns to dispatch loop indirectly, using
 	//  address kept on stack. This return method is safe for use with both
@@ -1752,16 +2370,16 @@ void recNotify(int note, void *data __attribute__((unused)))
 
 static void recReset()
 {
-	memset(code_pages, 0, sizeof(code_pages));
-	memset(recRAM, 0, REC_RAM_SIZE);
-	memset(recROM, 0, REC_ROM_SIZE);
+	rec_execute_resume = false;
 
-	recMem = (u32*)recMemBase;
+	rec_lock();
 
-	regReset();
+	rec_flush_code_cache();
 
 	// Set default recompilation options and any per-game options
 	rec_set_options();
+
+	rec_unlock();
 }
 
 
@@ -27,6 +27,8 @@
 #include "misc.h"
 #include <sys/stat.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <time.h>
 
 // Status Flags
 #define TX_RDY		0x0001
@@ -64,16 +66,34 @@ struct SioStruct {
 	unsigned int mcdst,rdwr;
 	unsigned char adrH,adrL;
 	unsigned int padst;
+	unsigned int padfast; /* port whose reply was fetched by sioPadBatch(), or 0 */
+	unsigned char padbuf[2 + 32 + 1]; /* reply fetched by sioPadBatch() */
+	bool fast;            /* transaction on the fast path, see SIO_INT() */
+	bool int_pending;     /* PSXINT_SIO scheduled and not fired yet */
 
 	u32 sio_cycle; /* for SIO_INT() */
 };
 
 static SioStruct psxSio;
 
+/* Transaction counters, reported by sioShutdown() */
+static struct {
+	u32 pad_fast;      /* pad polls completed on the fast path */
+	u32 pad_bytewise;  /* pad polls emulated byte by byte */
+	u32 mcd_fast;      /* memcard sector reads/writes on the fast path */
+	u32 mcd_bytewise;  /* memcard sector reads/writes emulated byte by byte */
+} sio_stats;
+
+static void mcd_writer_shutdown(void);
+
 void sioInit(void) {
 	//senquack - added initialization of sio data:
 	memset(&psxSio, 0, sizeof(psxSio));
 
+	// Event queue is cleared on reset, so hand any changed memcard
+	//  frames to writer now rather than waiting for PSXINT_SIO_SYNC_MCD
+	sioSyncMcds();
+
 	//senquack-Rearmed uses 535 in all cases, so we'll use that instead:
 	//sio_cycle=200*BIAS; /* for SIO_INT() */
 
@@ -96,10 +116,61 @@ void sioInit(void) {
 //             535 (SIO_CYCLES) but I've left PCSX4ALL using this older SIO_INT(void)
 //           TODO: Add support for newer PCSXR Config.Sio option
 // clk cycle byte
+//
+// Fast transaction path:
+//  Once a standard pad poll or memcard sector read/write is recognised,
+//  psxSio.fast is set and the remaining bytes are acked at once instead of
+//  through a PSXINT_SIO event each: the CPU is charged the byte's transfer
+//  time (halted, like for the DMAs in psxdma.cpp) and the IRQ is raised
+//  right away, so total cycle cost is the same. This is only done while
+//  the SIO IRQ is masked in I_MASK, i.e. the game busy-waits on I_STAT for
+//  every byte anyway, and the previous byte's IRQ was acked. Otherwise, the
+//  rest of the transaction falls back to one event per byte.
 static inline void SIO_INT(void) {
+	if (psxSio.fast) {
+		if (!psxSio.int_pending && !(psxSio.StatReg & IRQ) &&
+		    !(psxHu32(0x1074) & 0x80)) {
+			psxRegs.cycle += psxSio.sio_cycle;
+			sioInterrupt();
+			return;
+		}
+		psxSio.fast = false;
+	}
+	psxSio.int_pending = true;
 	psxEvqueueAdd(PSXINT_SIO, psxSio.sio_cycle);
 }
 
+/* Pad polls on the fast path also have their reply fetched in one go:
+ *  A pad poll is a command byte (usually 0x42, 'read buttons') followed by
+ *  dummy bytes the game sends to clock out the rest of the reply. Unless
+ *  those bytes drive the vibration motors or a config command, the pad's
+ *  reply doesn't depend on them, so the whole reply is fetched from the pad
+ *  when the command byte arrives. The remaining bytes are then just copied
+ *  from padbuf[] to buf[] as they are clocked out.
+ *  Returns the port select bits the reply was fetched for, or 0 if the
+ *  poll must be emulated byte by byte.
+ */
+static unsigned int sioPadBatch(unsigned char cmd)
+{
+	unsigned int i;
+
+	switch (psxSio.CtrlReg & 0x2002) {
+		case 0x0002:
+			if (!PAD1_pollIsStatic(cmd)) return 0;
+			for (i = 2; i <= psxSio.bufcount; i++)
+				psxSio.padbuf[i] = PAD1_poll(0);
+			break;
+		case 0x2002:
+			if (!PAD2_pollIsStatic(cmd)) return 0;
+			for (i = 2; i <= psxSio.bufcount; i++)
+				psxSio.padbuf[i] = PAD2_poll(0);
+			break;
+		default:
+			return 0;
+	}
+	return psxSio.CtrlReg & 0x2002;
+}
+
 void sioWrite8(unsigned char value) {
 #ifdef PAD_LOG
 	PAD_LOG("sio write8 %x\n", value);
@@ -107,7 +178,7 @@ void sioWrite8(unsigned char value) {
 	//senquack - all calls to SIO_INT() here now pass param SIO_CYCLES
 	//           whereas before they passed nothing:
 	switch (psxSio.padst) {
-		case 1: SIO_INT();
+		case 1:
 			if ((value & 0x40) == 0x40) {
 				psxSio.padst = 2; psxSio.parp = 1;
 
@@ -135,32 +206,51 @@ void sioWrite8(unsigned char value) {
 							break;
 					}
 				}
+
+				psxSio.padfast = sioPadBatch(value);
+				psxSio.fast = (psxSio.padfast != 0);
 			}
 			else psxSio.padst = 0;
+			SIO_INT();
 			return;
 		case 2:
 			psxSio.parp++;
 
-			switch (psxSio.CtrlReg & 0x2002) {
-				case 0x0002: psxSio.buf[psxSio.parp] = PAD1_poll(value); break;
-				case 0x2002: psxSio.buf[psxSio.parp] = PAD2_poll(value); break;
+			// Reply already in padbuf[] if fetched by sioPadBatch(), unless
+			//  game switched ports in the middle of the transfer
+			if (psxSio.padfast == (psxSio.CtrlReg & 0x2002u)) {
+				psxSio.buf[psxSio.parp] = psxSio.padbuf[psxSio.parp];
+			} else {
+				psxSio.padfast = 0;
+				psxSio.fast = false;
+				switch (psxSio.CtrlReg & 0x2002) {
+					case 0x0002: psxSio.buf[psxSio.parp] = PAD1_poll(value); break;
+					case 0x2002: psxSio.buf[psxSio.parp] = PAD2_poll(value); break;
+				}
 			}
 
-			if (psxSio.parp == psxSio.bufcount) { psxSio.padst = 0; return; }
+			if (psxSio.parp == psxSio.bufcount) {
+				psxSio.padst = 0;
+				if (psxSio.fast)
+					sio_stats.pad_fast++;
+				else
+					sio_stats.pad_bytewise++;
+				return;
+			}
 			SIO_INT();
 			return;
 	}
 
 	switch (psxSio.mcdst) {
 		case 1:
-			SIO_INT();
-			if (psxSio.rdwr) { psxSio.parp++; return; }
+			if (psxSio.rdwr) { psxSio.parp++; SIO_INT(); return; }
 			psxSio.parp = 1;
 			switch (value) {
-				case 0x52: psxSio.rdwr = 1; break;
-				case 0x57: psxSio.rdwr = 2; break;
+				case 0x52: psxSio.rdwr = 1; psxSio.fast = true; break;
+				case 0x57: psxSio.rdwr = 2; psxSio.fast = true; break;
 				default: psxSio.mcdst = 0;
 			}
+			SIO_INT();
 			return;
 		case 2: // address H
 			SIO_INT();
@@ -247,6 +337,8 @@ void sioWrite8(unsigned char value) {
 			psxSio.bufcount = 2;
 			psxSio.parp = 0;
 			psxSio.padst = 1;
+			psxSio.padfast = 0;
+			psxSio.fast = false;
 			SIO_INT();
 			return;
 		case 0x81: // start memcard
@@ -264,6 +356,7 @@ void sioWrite8(unsigned char value) {
 			psxSio.bufcount = 3;
 			psxSio.mcdst = 1;
 			psxSio.rdwr = 0;
+			psxSio.fast = false;
 			SIO_INT();
 			return;
 		default:
@@ -306,8 +399,10 @@ void sioWriteCtrl16(unsigned short value) {
 	//if ((psxSio.CtrlReg & SIO_RESET) || (!psxSio.CtrlReg)) {
 	if ((psxSio.CtrlReg & SIO_RESET) || !(psxSio.CtrlReg & DTR)) {
 		psxSio.padst = 0; psxSio.mcdst = 0; psxSio.parp = 0;
+		psxSio.padfast = 0; psxSio.fast = false;
 		psxSio.StatReg = TX_RDY | TX_EMPTY;
 		psxEvqueueRemove(PSXINT_SIO);
+		psxSio.int_pending = false;
 	}
 }
 
@@ -325,6 +420,10 @@ unsigned char sioRead8() {
 			psxSio.StatReg &= ~RX_RDY;		// Receive is not Ready now
 			if (psxSio.mcdst == 5) {
 				psxSio.mcdst = 0;
+				if (psxSio.fast)
+					sio_stats.mcd_fast++;
+				else
+					sio_stats.mcd_bytewise++;
 				if (psxSio.rdwr == 2) {
 					switch (psxSio.CtrlReg & 0x2002) {
 						case 0x0002:
@@ -387,6 +486,7 @@ void sioInterrupt() {
 	PAD_LOG("Sio Interrupt (CP0.Status = %x)\n", psxRegs.CP0.n.Status);
 #endif
 	//printf("Sio Interrupt\n");
+	psxSio.int_pending = false;
 	//  pcsx_rearmed: only do IRQ if it's bit has been cleared
 	if (!(psxSio.StatReg & IRQ)) {
 		psxSio.StatReg |= IRQ;
@@ -411,8 +511,38 @@ int sioFreeze(void* f, FreezeMode mode)
 	     || freeze_rw(f, mode, &psxSio.adrL, sizeof(psxSio.adrL))
 	     || freeze_rw(f, mode, &psxSio.padst, sizeof(psxSio.padst)) )
 		return -1;
-	else
-		return 0;
+
+	// Not saved: a transaction in progress continues byte by byte after
+	//  load, and a PSXINT_SIO event may be pending
+	if (mode == FREEZE_LOAD) {
+		psxSio.padfast = 0;
+		psxSio.fast = false;
+		psxSio.int_pending = true;
+		// Pending PSXINT_SIO_SYNC_MCD event may have been lost
+		sioSyncMcds();
+	}
+
+	// Memcards must be on disk and consistent with savestate
+	if (mode == FREEZE_SAVE) {
+		FlushMcd(MCD1, true);
+		FlushMcd(MCD2, true);
+	}
+	return 0;
+}
+
+void sioShutdown(void)
+{
+	if (sio_stats.pad_fast || sio_stats.pad_bytewise)
+		printf("SIO: %u pad polls on fast path, %u byte-wise\n",
+		       sio_stats.pad_fast, sio_stats.pad_bytewise);
+	if (sio_stats.mcd_fast || sio_stats.mcd_bytewise)
+		printf("SIO: %u memcard sectors on fast path, %u byte-wise\n",
+		       sio_stats.mcd_fast, sio_stats.mcd_bytewise);
+	memset(&sio_stats, 0, sizeof(sio_stats));
+
+	FlushMcd(MCD1, true);
+	FlushMcd(MCD2, true);
+	mcd_writer_shutdown();
 }
 
 ////////////////////////
@@ -421,45 +551,294 @@ int sioFreeze(void* f, FreezeMode mode)
 
 //TODO: Provide callback for error reporting in frontend GUIs
 
-struct Memcard {
-	Memcard() :
-		filename(NULL),
-		file(NULL),
-		cur_offset(0)
-	{}
-
-	~Memcard()
-	{
-		if (file) {
-			const char *tmpstr = filename ? filename : "";
-			printf("Warning: memcard file not closed, closing via dtor: %s\n", tmpstr);
-			fclose(file);
-			file = NULL;
-		}
-	}
+#define MCD_FRAME_SIZE  128
+#define MCD_NUM_FRAMES  (MCD_SIZE / MCD_FRAME_SIZE)
 
-	char* filename;       // Filename ptr, or NULL if card is disabled
-	FILE* file;           // File ptr is non-NULL when card is being written to
-	long  cur_offset;     // Current file offset (when file is open for writing)
+struct Memcard {
+	char  filename[MAXPATHLEN]; // Empty if card is disabled
+	u32   dirty[MCD_NUM_FRAMES / 32]; // Frames changed since last flush
 	char  data[MCD_SIZE];
 };
 
 static Memcard memcards[2];
 
-// Number of cycles after last memcard write to wait until
-//  PSXINT_SIO_SYNC_MCD event closes the memcard file.
+// Number of cycles after a memcard write until PSXINT_SIO_SYNC_MCD event
+//  hands changed frames to the writer thread. Not pushed back by further
+//  writes, so a game saving continuously is flushed at least this often.
 #define MEMCARD_SYNC_DELAY (PSXCLK / 4)
 
-// Intended to be called from within the running emulator after a small
-//  amount of time has passed after a memcard has been written to.
-//  This is done by scheduling a PSXINT_SIO_SYNC_MCD event. This allows
-//  memcard I/O to be done against a file kept open for a decent amount of
-//  time, allowing buffering and fewer open/close system calls.
-//  Will flush, sync, and close any memcard files opened for writing.
+/* Memcard write-behind:
+ *  Writes by the game only update memcards[].data and mark 128-byte frames
+ *  dirty. PSXINT_SIO_SYNC_MCD event (or FlushMcd()) copies dirty frames to
+ *  the writer thread, which writes runs of contiguous frames to the file,
+ *  then fsync()s and closes it. The emu thread never waits on file I/O,
+ *  except in FlushMcd(), used where data must be on disk: savestates,
+ *  ejecting/replacing a card, entering the menu and shutdown.
+ *  Frames that fail to write are kept by the writer and retried with the
+ *  next frames queued; the next FlushMcd() reports the failure.
+ *  If the thread can't be started, frames are written by the caller.
+ */
+static struct {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond_work;   // Frames queued, or quit requested
+	pthread_cond_t cond_done;   // Queue drained and nothing being written
+	bool started;
+	bool quit;
+	bool writing;
+	u32  queued[2][MCD_NUM_FRAMES / 32];
+	u32  failed[2][MCD_NUM_FRAMES / 32]; // Frames to retry with next queueing
+	bool error[2];              // Write failed since last FlushMcd()
+	char filename[2][MAXPATHLEN];   // Copied when queueing
+	char data[2][MCD_SIZE];     // Copies of queued and failed frames
+	u64  queued_at[2];          // Time oldest queued frame was queued (usec)
+
+	// Instrumentation: time from queueing frames until they're on disk
+	u32  flushes;
+	u32  frames_written;
+	u64  latency_total;
+	u64  latency_max;
+} mcd_writer;
+
+static u64 mcd_time_usec(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static bool mcd_frames_any(const u32 *frames)
+{
+	for (int w = 0; w < MCD_NUM_FRAMES / 32; w++)
+		if (frames[w]) return true;
+	return false;
+}
+
+// Write frames set in 'frames' bitmap from 'data' to memcard file,
+//  coalescing runs of contiguous frames into one write.
+//  Returns number of frames written, or -1 on error.
+static int mcd_write_frames(enum MemcardNum mcd_num, const char *filename,
+                            const u32 *frames, const char *data)
+{
+	FILE *f = NULL;
+	int written = 0;
+	int i = 0;
+
+	if (filename == NULL || *filename == '\0')
+		return 0;
+
+	while (i < MCD_NUM_FRAMES) {
+		if (!(frames[i / 32] & (1u << (i % 32)))) {
+			i++;
+			continue;
+		}
+		int start = i;
+		while (i < MCD_NUM_FRAMES && (frames[i / 32] & (1u << (i % 32))))
+			i++;
+		long adr = (long)start * MCD_FRAME_SIZE;
+		size_t size = (size_t)(i - start) * MCD_FRAME_SIZE;
+
+		if ( (f == NULL && (f = fopen(filename, "r+b")) == NULL) ||
+		     fseek(f, adr, SEEK_SET) ||
+		     fwrite(data + adr, 1, size, f) != size )
+			goto error;
+		written += i - start;
+	}
+
+	if (f) {
+		if (fflush(f) || fsync(fileno(f)))
+			goto error;
+		if (fclose(f)) {
+			f = NULL;
+			goto error;
+		}
+	}
+#ifdef DEBUG_MEMCARDS
+	printf("%s(): wrote %d frames to memcard %d\n", __func__, written, mcd_num+1);
+#endif
+	return written;
+
+error:
+	printf("Error in %s() writing to memcard %d\n", __func__, mcd_num+1);
+	perror(NULL);
+	printf("Error writing to memcard file %s\n", filename);
+	if (f) fclose(f);
+	return -1;
+}
+
+static void* mcd_writer_thread(void *arg)
+{
+	static u32  frames[MCD_NUM_FRAMES / 32];
+	static char data[MCD_SIZE];
+	static char filename[MAXPATHLEN];
+
+	pthread_mutex_lock(&mcd_writer.lock);
+	for (;;) {
+		int mcd_num;
+		for (mcd_num = 0; mcd_num < 2; mcd_num++) {
+			if (mcd_frames_any(mcd_writer.queued[mcd_num]))
+				break;
+		}
+		if (mcd_num == 2) {
+			mcd_writer.writing = false;
+			pthread_cond_broadcast(&mcd_writer.cond_done);
+			if (mcd_writer.quit)
+				break;
+			pthread_cond_wait(&mcd_writer.cond_work, &mcd_writer.lock);
+			continue;
+		}
+
+		// Take queued frames, then write them without holding the lock
+		mcd_writer.writing = true;
+		memcpy(frames, mcd_writer.queued[mcd_num], sizeof(frames));
+		memset(mcd_writer.queued[mcd_num], 0, sizeof(frames));
+		for (int i = 0; i < MCD_NUM_FRAMES; i++) {
+			if (frames[i / 32] & (1u << (i % 32)))
+				memcpy(data + i * MCD_FRAME_SIZE,
+				       mcd_writer.data[mcd_num] + i * MCD_FRAME_SIZE, MCD_FRAME_SIZE);
+		}
+		strcpy(filename, mcd_writer.filename[mcd_num]);
+		u64 queued_at = mcd_writer.queued_at[mcd_num];
+		pthread_mutex_unlock(&mcd_writer.lock);
+
+		int written = mcd_write_frames((enum MemcardNum)mcd_num, filename, frames, data);
+		u64 latency = mcd_time_usec() - queued_at;
+
+		pthread_mutex_lock(&mcd_writer.lock);
+		if (written < 0) {
+			// Keep frames for retry, unless newer data was queued meanwhile
+			for (int i = 0; i < MCD_NUM_FRAMES; i++) {
+				u32 bit = 1u << (i % 32);
+				if ((frames[i / 32] & bit) && !(mcd_writer.queued[mcd_num][i / 32] & bit)) {
+					memcpy(mcd_writer.data[mcd_num] + i * MCD_FRAME_SIZE,
+					       data + i * MCD_FRAME_SIZE, MCD_FRAME_SIZE);
+					mcd_writer.failed[mcd_num][i / 32] |= bit;
+				}
+			}
+			mcd_writer.error[mcd_num] = true;
+		} else if (written > 0) {
+			mcd_writer.flushes++;
+			mcd_writer.frames_written += written;
+			mcd_writer.latency_total += latency;
+			if (latency > mcd_writer.latency_max)
+				mcd_writer.latency_max = latency;
+		}
+	}
+	pthread_mutex_unlock(&mcd_writer.lock);
+	return NULL;
+}
+
+static bool mcd_writer_start(void)
+{
+	if (mcd_writer.started)
+		return true;
+
+	if (pthread_mutex_init(&mcd_writer.lock, NULL))
+		goto fail_mutex;
+	if (pthread_cond_init(&mcd_writer.cond_work, NULL))
+		goto fail_cond_work;
+	if (pthread_cond_init(&mcd_writer.cond_done, NULL))
+		goto fail_cond_done;
+	mcd_writer.quit = false;
+	mcd_writer.writing = false;
+	if (pthread_create(&mcd_writer.thread, NULL, mcd_writer_thread, NULL))
+		goto fail_thread;
+
+	mcd_writer.started = true;
+	return true;
+
+fail_thread:
+	pthread_cond_destroy(&mcd_writer.cond_done);
+fail_cond_done:
+	pthread_cond_destroy(&mcd_writer.cond_work);
+fail_cond_work:
+	pthread_mutex_destroy(&mcd_writer.lock);
+fail_mutex:
+	printf("Warning: memcard writer thread could not be started, writing synchronously\n");
+	return false;
+}
+
+static void mcd_writer_shutdown(void)
+{
+	if (mcd_writer.started) {
+		pthread_mutex_lock(&mcd_writer.lock);
+		mcd_writer.quit = true;
+		pthread_cond_signal(&mcd_writer.cond_work);
+		pthread_mutex_unlock(&mcd_writer.lock);
+		pthread_join(mcd_writer.thread, NULL);
+		pthread_cond_destroy(&mcd_writer.cond_done);
+		pthread_cond_destroy(&mcd_writer.cond_work);
+		pthread_mutex_destroy(&mcd_writer.lock);
+		mcd_writer.started = false;
+	}
+
+	if (mcd_writer.flushes)
+		printf("SIO: %u memcard flushes (%u frames), latency avg %.1f ms, max %.1f ms\n",
+		       mcd_writer.flushes, mcd_writer.frames_written,
+		       mcd_writer.latency_total / 1000.0 / mcd_writer.flushes,
+		       mcd_writer.latency_max / 1000.0);
+	mcd_writer.flushes = mcd_writer.frames_written = 0;
+	mcd_writer.latency_total = mcd_writer.latency_max = 0;
+}
+
+// Hand dirty frames of memcard to writer thread, along with any that failed
+//  to write before (or write them right away, if there's no thread).
+//  Clears the memcard's dirty frames, unless written right away and that
+//  failed. Returns -1 in that case.
+static int mcd_queue_dirty(enum MemcardNum mcd_num)
+{
+	Memcard &mc = memcards[mcd_num];
+	if (!mcd_frames_any(mc.dirty) && !mcd_writer.started)
+		return 0;
+
+	if (!mcd_writer_start()) {
+		u64 t = mcd_time_usec();
+		int written = mcd_write_frames(mcd_num, mc.filename, mc.dirty, mc.data);
+		if (written < 0)
+			return -1;
+		if (written > 0) {
+			u64 latency = mcd_time_usec() - t;
+			mcd_writer.flushes++;
+			mcd_writer.frames_written += written;
+			mcd_writer.latency_total += latency;
+			if (latency > mcd_writer.latency_max)
+				mcd_writer.latency_max = latency;
+		}
+		memset(mc.dirty, 0, sizeof(mc.dirty));
+		return 0;
+	}
+
+	pthread_mutex_lock(&mcd_writer.lock);
+	if (!mcd_frames_any(mc.dirty) && !mcd_frames_any(mcd_writer.failed[mcd_num])) {
+		pthread_mutex_unlock(&mcd_writer.lock);
+		return 0;
+	}
+	if (!mcd_frames_any(mcd_writer.queued[mcd_num]))
+		mcd_writer.queued_at[mcd_num] = mcd_time_usec();
+	for (int i = 0; i < MCD_NUM_FRAMES; i++) {
+		if (mc.dirty[i / 32] & (1u << (i % 32)))
+			memcpy(mcd_writer.data[mcd_num] + i * MCD_FRAME_SIZE,
+			       mc.data + i * MCD_FRAME_SIZE, MCD_FRAME_SIZE);
+	}
+	for (int w = 0; w < MCD_NUM_FRAMES / 32; w++) {
+		mcd_writer.queued[mcd_num][w] |= mc.dirty[w] | mcd_writer.failed[mcd_num][w];
+		mcd_writer.failed[mcd_num][w] = 0;
+	}
+	strcpy(mcd_writer.filename[mcd_num], mc.filename);
+	pthread_cond_signal(&mcd_writer.cond_work);
+	pthread_mutex_unlock(&mcd_writer.lock);
+
+	memset(mc.dirty, 0, sizeof(mc.dirty));
+	return 0;
+}
+
+// Called from PSXINT_SIO_SYNC_MCD event, a while after memcard was first
+//  written to, and when entering the menu. Hands any changed frames to the
+//  writer thread without waiting for them to reach the disk.
 void sioSyncMcds()
 {
-	FlushMcd(MCD1, true);
-	FlushMcd(MCD2, true);
+	mcd_queue_dirty(MCD1);
+	mcd_queue_dirty(MCD2);
 #ifdef DEBUG_MEMCARDS
 	printf("%s()\n", __func__);
 #endif
@@ -467,11 +846,11 @@ void sioSyncMcds()
 
 // If 'src' pointer is non-NULL, memcard data array will be updated
 //  with data at offset 'adr' starting from source 'src' of size 'size',
-//  then, memcard file will be written with this new data. If the data
+//  and the frames it covers are marked for writing. If the data
 //  at 'src' pointer is identical to existing array data, it is a no-op.
 //  This prevents unnecessary sector writes, particularly write-tests
 //  to offset 0x1f80 (block 0, sector 63) at BIOS/game startup.
-// If 'src' pointer is NULL, just the file write will occur.
+// If 'src' pointer is NULL, frames are just marked for writing.
 int sioMcdWrite(enum MemcardNum mcd_num, const char *src, uint32_t adr, int size)
 {
 	if (adr >= MCD_SIZE) {
@@ -487,35 +866,36 @@ int sioMcdWrite(enum MemcardNum mcd_num, const char *src, uint32_t adr, int size
 		printf("Adjusted size to within 128KB range: %x\n", size);
 	}
 
-	bool write_file = true;
+	if (size <= 0)
+		return 0;
+
+	Memcard &mc = memcards[mcd_num];
 	if (src) {
-		char* dst = memcards[mcd_num].data + adr;
+		char* dst = mc.data + adr;
 		if (memcmp(dst, src, size) != 0) {
 			memcpy(dst, src, size);
 		} else {
 			// Source data is identical to existing memcard data
-			write_file = false;
 #ifdef DEBUG_MEMCARDS
 			printf("Prevented redundant write of %u bytes to memcard %d at addr %x\n",
 					size, mcd_num+1, adr);
 #endif
+			return 0;
 		}
 	}
 
-	int retval = 0;
-	if (write_file) {
 #ifdef DEBUG_MEMCARDS
-		printf("Writing %u bytes to memcard %d\n", size, mcd_num + 1);
+	printf("Marking %u bytes of memcard %d dirty\n", size, mcd_num + 1);
 #endif
-		retval = SaveMcd(mcd_num, adr, size);
-	}
+	for (u32 i = adr / MCD_FRAME_SIZE; i <= (adr + size - 1) / MCD_FRAME_SIZE; i++)
+		mc.dirty[i / 32] |= 1u << (i % 32);
 
-	// If memcard file was already open for writing, or was just opened by
-	//  call to SaveMcd(), (re)schedule a memcard file flush/sync/close
-	if (memcards[mcd_num].file != NULL)
+	// Schedule flush unless one is already pending: delay is bounded from
+	//  the first unflushed write
+	if (!(psxRegs.interrupt & (1 << PSXINT_SIO_SYNC_MCD)))
 		psxEvqueueAdd(PSXINT_SIO_SYNC_MCD, MEMCARD_SYNC_DELAY);
 
-	return retval;
+	return 0;
 }
 
 int sioMcdRead(enum MemcardNum mcd_num, char *dst, uint32_t adr, int size)
@@ -545,7 +925,7 @@ char* sioMcdDataPtr(enum MemcardNum mcd_num)
 
 bool sioMcdInserted(enum MemcardNum mcd_num)
 {
-	return memcards[mcd_num].filename != NULL;
+	return memcards[mcd_num].filename[0] != '\0';
 }
 
 int sioMcdFormat(enum MemcardNum mcd_num)
@@ -558,38 +938,56 @@ int sioMcdFormat(enum MemcardNum mcd_num)
 	return sioMcdWrite(mcd_num, NULL, 0, MCD_SIZE);
 }
 
-// FlushMcd() ensures a memcard file temporarily opened for writing gets
-//  closed. If 'sync_file' is true, it will call fsync() before closing it.
+// FlushMcd() writes any changed frames of a memcard to its file and waits
+//  until the writer thread is done with them. If 'sync_file' is false, it
+//  doesn't wait (files are always fsync()'ed by the writer).
+//  Returns -1 if any frames failed to write since the last call. These are
+//  kept and retried by the next flush.
 int FlushMcd(enum MemcardNum mcd_num, bool sync_file)
 {
-	Memcard &mc = memcards[mcd_num];
+	bool error;
 
-	if (!mc.file)
+	if (mcd_queue_dirty(mcd_num))
+		return -1;
+
+	if (!sync_file || !mcd_writer.started)
 		return 0;
 
-	int retval = 0;
-	if (sync_file) {
-		if (fflush(mc.file)) retval = -1;
-		if (fsync(fileno(mc.file))) retval = -1;
-	}
-	if (fclose(mc.file)) retval = -1;
-	mc.file = NULL;
-	mc.cur_offset = 0;
-	if (retval < 0) {
-		perror(__func__);
-		const char* tmpstr = mc.filename ? mc.filename : "";
-		printf("Error in %s() writing memcard file %s\n", __func__, tmpstr);
+	u64 t = mcd_time_usec();
+	pthread_mutex_lock(&mcd_writer.lock);
+	for (;;) {
+		if (!mcd_frames_any(mcd_writer.queued[mcd_num]) && !mcd_writer.writing)
+			break;
+		pthread_cond_wait(&mcd_writer.cond_done, &mcd_writer.lock);
 	}
-	return retval;
+	error = mcd_writer.error[mcd_num];
+	mcd_writer.error[mcd_num] = false;
+	pthread_mutex_unlock(&mcd_writer.lock);
+#ifdef DEBUG_MEMCARDS
+	printf("%s(): memcard %d waited %u usec\n", __func__, mcd_num+1, (unsigned)(mcd_time_usec() - t));
+#else
+	(void)t;
+#endif
+	return error ? -1 : 0;
 }
 
 int EjectMcd(enum MemcardNum mcd_num)
 {
 	int retval = FlushMcd(mcd_num, true);
 	Memcard &mc = memcards[mcd_num];
-	mc.filename = NULL;
-	mc.file = NULL;
-	mc.cur_offset = 0;
+
+	// Frames that still couldn't be written are lost with the card: they
+	//  must not end up in the next card's file
+	if (mcd_writer.started) {
+		pthread_mutex_lock(&mcd_writer.lock);
+		memset(mcd_writer.failed[mcd_num], 0, sizeof(mcd_writer.failed[mcd_num]));
+		pthread_mutex_unlock(&mcd_writer.lock);
+	}
+	if (retval)
+		printf("Error: memcard %d ejected with unsaved changes\n", mcd_num+1);
+
+	mc.filename[0] = '\0';
+	memset(mc.dirty, 0, sizeof(mc.dirty));
 	memset(mc.data, 0, MCD_SIZE);
 	return retval;
 }
@@ -688,10 +1086,11 @@ int LoadMcd(enum MemcardNum mcd_num, char* filename)
 		psxSio.cardh2[1] |= 8;
 	}
 
-	mc.filename = filename;
-	if (*mc.filename == 0) {
+	if (*filename == 0) {
 		sprintf(mc.filename, "memcards/card%d.mcd", mcd_num+1);
 		printf("No memory card value was specified - creating a default card %s\n", mc.filename);
+	} else {
+		snprintf(mc.filename, sizeof(mc.filename), "%s", filename);
 	}
 
 	if ((f = fopen(mc.filename, "rb")) == NULL) {
@@ -700,7 +1099,7 @@ int LoadMcd(enum MemcardNum mcd_num, char* filename)
 			printf("Error in %s(): Creating memcard file failed.\n", __func__);
 			printf("Maybe file already exists and file/folder lacks permissions?\n");
 			printf("Memcard slot %d is now empty.\n", mcd_num+1);
-			mc.filename = NULL;
+			mc.filename[0] = '\0';
 			return -1;
 		}
 		if ((f = fopen(mc.filename, "rb")) == NULL)
@@ -756,7 +1155,7 @@ int LoadMcd(enum MemcardNum mcd_num, char* filename)
 			printf("Maybe file/folder lacks write permissions?\n");
 			printf("Memcard slot %d is now empty.\n", mcd_num+1);
 			if (f) fclose(f);
-			mc.filename = NULL;
+			mc.filename[0] = '\0';
 			return -1;
 		}
 		printf("Converted memcard file to native raw format.\n");
@@ -782,42 +1181,12 @@ error:
 	return -1;
 }
 
+// Write 'size' bytes of memcard data at 'adr' to the file right away
 int SaveMcd(enum MemcardNum mcd_num, uint32_t adr, int size)
 {
-	Memcard &mc = memcards[mcd_num];
-
-	// File isn't currently open for writing
-	if (mc.file == NULL) {
-		if (mc.filename == NULL || *mc.filename == '\0')
-			return 0;
-		mc.cur_offset = 0;
-		if ((mc.file = fopen(mc.filename, "r+b")) == NULL)
-			goto error;
-	}
-
-	if (mc.cur_offset != adr) {
-		if (fseek(mc.file, adr, SEEK_SET))
-			goto error;
-		mc.cur_offset = adr;
-	}
-
-	if (fwrite(mc.data + adr, 1, size, mc.file) != size)
-		goto error;
-
-	mc.cur_offset += size;
-
-	// Leave file open for writing, it will be close automatically
-	//  by PSXINT_SIO_SYNC_MCD event
-	return 0;
-
-error:
-	printf("Error in %s() writing to memcard %d\n", __func__, mcd_num+1);
-	perror(NULL);
-	{
-		const char* tmpstr = mc.filename ? mc.filename : "";
-		printf("Error writing to memcard file %s\n", tmpstr);
-	}
-	return -1;
+	if (sioMcdWrite(mcd_num, NULL, adr, size))
+		return -1;
+	return FlushMcd(mcd_num, true);
 }
 
 // remove the leading and trailing spaces in a string
@@ -52,6 +52,7 @@ unsigned short sioReadBaud16(void);
 
 void sioInterrupt(void);
 int sioFreeze(void* f, FreezeMode mode);
+void sioShutdown(void);
 
 ////////////////////////
 // Memcard operations //